@@ -33,6 +33,7 @@
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/executor.hpp"
 #include "xmrstak/misc/environment.hpp"
+#include "xmrstak/misc/traceRecorder.hpp"
 #include "xmrstak/params.hpp"
 #include "xmrstak/backend/cpu/hwlocMemory.hpp"
 
@@ -123,6 +124,9 @@ std::vector<iBackend*>* minethd::thread_starter(uint32_t threadOffset, miner_wor
 		win_exit();
 	}
 
+	// the CPU hash code of this plugin verifies the results
+	cpu::minethd::select_implementations(false);
+
 	// \ todo get device count and exit if no opencl device
 
 	if(!init_gpus())
@@ -179,6 +183,10 @@ void minethd::work_main()
 		printer::inst()->print_msg(L0, "ERROR: miner was not able to allocate memory, miner will be stopped.");
 		win_exit(1);
 	}
+
+	globalStates::inst().wait_thread_numbers();
+	traceRecorder::inst().set_thread_name("amd " + std::to_string(iThreadNo));
+
 	// start with root algorithm and switch later if fork version is reached
 	auto miner_algo = ::jconf::inst()->GetCurrentCoinSelection().GetDescription(1).GetMiningAlgoRoot();
 	cn_hash_fun hash_fun = cpu::minethd::func_selector(::jconf::inst()->HaveHardwareAes(), true /*bNoPrefetch*/, miner_algo);
@@ -195,10 +203,13 @@ void minethd::work_main()
 			 * raison d'etre of this software it us sensible to just wait until we have something
 			 */
 
+			uint64_t iStallStartUs = traceRecorder::now_us();
 			while (globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 			globalStates::inst().consume_work(oWork, iJobNo);
+			traceRecorder::inst().complete("worker", "stall", iStallStartUs, traceRecorder::now_us(),
+				oWork.bStall ? nullptr : oWork.sJobID);
 			continue;
 		}
 
@@ -266,9 +277,7 @@ void minethd::work_main()
 			}
 
 			iCount += pGpuCtx->rawIntensity;
-			uint64_t iStamp = get_timestamp_ms();
-			iHashCount.store(iCount, std::memory_order_relaxed);
-			iTimestamp.store(iStamp, std::memory_order_relaxed);
+			update_hash_count(iCount, get_timestamp_ms());
 			std::this_thread::yield();
 		}
 
@@ -28,6 +28,7 @@
 #include "plugin.hpp"
 #include "xmrstak/misc/environment.hpp"
 #include "xmrstak/misc/console.hpp"
+#include "xmrstak/misc/startupTiming.hpp"
 #include "xmrstak/params.hpp"
 
 #include "cpu/minethd.hpp"
@@ -48,6 +49,7 @@
 #include <cstring>
 #include <thread>
 #include <bitset>
+#include <future>
 
 
 namespace xmrstak
@@ -136,109 +138,125 @@ void BackendConnector::self_tests()
 
 std::vector<iBackend*>* BackendConnector::thread_starter(miner_work& pWork)
 {
-
-	std::vector<iBackend*>* pvThreads = new std::vector<iBackend*>;
+	// All backends are started concurrently with a thread offset of zero,
+	// the threads are renumbered after all backends are up. The workers wait
+	// in globalStates::wait_thread_numbers() before they use their number.
+	std::vector<std::future<std::vector<iBackend*>*>> backends;
 
 #ifndef CONF_NO_OPENCL
 	if(params::inst().useAMD)
 	{
-		const std::string backendName = xmrstak::params::inst().openCLVendor;
-		plugin amdplugin;
-		amdplugin.load(backendName, "xmrstak_opencl_backend");
-		std::vector<iBackend*>* amdThreads = amdplugin.startBackend(static_cast<uint32_t>(pvThreads->size()), pWork, environment::inst());
-		size_t numWorkers = 0u;
-		if(amdThreads != nullptr)
-		{
-			pvThreads->insert(std::end(*pvThreads), std::begin(*amdThreads), std::end(*amdThreads));
-			numWorkers = amdThreads->size();
-			delete amdThreads;
-		}
-		if(numWorkers == 0)
-			printer::inst()->print_msg(L0, "WARNING: backend %s (OpenCL) disabled.", backendName.c_str());
+		backends.push_back(std::async(std::launch::async, [&pWork]() {
+			size_t iStart = startupTiming::inst()->now();
+			const std::string backendName = xmrstak::params::inst().openCLVendor;
+			plugin amdplugin;
+			amdplugin.load(backendName, "xmrstak_opencl_backend");
+			std::vector<iBackend*>* amdThreads = amdplugin.startBackend(0u, pWork, environment::inst());
+			if(amdThreads == nullptr || amdThreads->size() == 0)
+				printer::inst()->print_msg(L0, "WARNING: backend %s (OpenCL) disabled.", backendName.c_str());
+			startupTiming::inst()->record("backend amd start", iStart);
+			return amdThreads;
+		}));
 	}
 #endif
 
 #ifndef CONF_NO_CUDA
 	if(params::inst().useNVIDIA)
 	{
-		plugin nvidiaplugin;
-		std::vector<std::string> libNames = {"xmrstak_cuda_backend_cuda10_0", "xmrstak_cuda_backend_cuda9_2", "xmrstak_cuda_backend"};
-		size_t numWorkers = 0u;
+		backends.push_back(std::async(std::launch::async, [&pWork]() {
+			size_t iStart = startupTiming::inst()->now();
+			plugin nvidiaplugin;
+			std::vector<std::string> libNames = {"xmrstak_cuda_backend_cuda10_0", "xmrstak_cuda_backend_cuda9_2", "xmrstak_cuda_backend"};
+			std::vector<iBackend*>* nvidiaThreads = nullptr;
 
-		for( const auto & name : libNames)
-		{
-			printer::inst()->print_msg(L0, "NVIDIA: try to load library '%s'", name.c_str());
-			nvidiaplugin.load("NVIDIA", name);
-			std::vector<iBackend*>* nvidiaThreads = nvidiaplugin.startBackend(static_cast<uint32_t>(pvThreads->size()), pWork, environment::inst());
-			if(nvidiaThreads != nullptr)
-			{
-				pvThreads->insert(std::end(*pvThreads), std::begin(*nvidiaThreads), std::end(*nvidiaThreads));
-				numWorkers = nvidiaThreads->size();
-				delete nvidiaThreads;
-			}
-			else
+			for( const auto & name : libNames)
 			{
+				printer::inst()->print_msg(L0, "NVIDIA: try to load library '%s'", name.c_str());
+				nvidiaplugin.load("NVIDIA", name);
+				nvidiaThreads = nvidiaplugin.startBackend(0u, pWork, environment::inst());
+				// we found at leat one working GPU
+				if(nvidiaThreads != nullptr && nvidiaThreads->size() != 0)
+				{
+					printer::inst()->print_msg(L0, "NVIDIA: use library '%s'", name.c_str());
+					break;
+				}
 				// remove the plugin if we have found no GPUs
 				nvidiaplugin.unload();
+				delete nvidiaThreads;
+				nvidiaThreads = nullptr;
 			}
-			// we found at leat one working GPU
-			if(numWorkers != 0)
-			{
-				printer::inst()->print_msg(L0, "NVIDIA: use library '%s'", name.c_str());
-				break;
-			}
-		}
-		if(numWorkers == 0)
-			printer::inst()->print_msg(L0, "WARNING: backend NVIDIA disabled.");
+			if(nvidiaThreads == nullptr)
+				printer::inst()->print_msg(L0, "WARNING: backend NVIDIA disabled.");
+			startupTiming::inst()->record("backend nvidia start", iStart);
+			return nvidiaThreads;
+		}));
 	}
 #endif
 
 #ifndef CONF_NO_FPGA
 	if (params::inst().useFPGA)
 	{
-		plugin fpgaplugin;
-		std::vector<std::string> libNames = { "xmrstak_fpga_backend" };
-		size_t numWorkers = 0u;
+		backends.push_back(std::async(std::launch::async, [&pWork]() {
+			size_t iStart = startupTiming::inst()->now();
+			plugin fpgaplugin;
+			std::vector<std::string> libNames = { "xmrstak_fpga_backend" };
+			std::vector<iBackend*>* fpgaThreads = nullptr;
 
-		for (const auto & name : libNames)
-		{
-			printer::inst()->print_msg(L0, "FPGA: try to load library '%s'", name.c_str());
-			fpgaplugin.load("FPGA", name);
-			std::vector<iBackend*>* fpgaThreads = fpgaplugin.startBackend(static_cast<uint32_t>(pvThreads->size()), pWork, environment::inst());
-			if (fpgaThreads != nullptr)
+			for (const auto & name : libNames)
 			{
-				pvThreads->insert(std::end(*pvThreads), std::begin(*fpgaThreads), std::end(*fpgaThreads));
-				numWorkers = fpgaThreads->size();
-				delete fpgaThreads;
-			}
-			else
-			{
-				// remove the plugin if we have found no GPUs
+				printer::inst()->print_msg(L0, "FPGA: try to load library '%s'", name.c_str());
+				fpgaplugin.load("FPGA", name);
+				fpgaThreads = fpgaplugin.startBackend(0u, pWork, environment::inst());
+				// we found at leat one working FPGA
+				if (fpgaThreads != nullptr && fpgaThreads->size() != 0)
+				{
+					printer::inst()->print_msg(L0, "FPGA: use library '%s'", name.c_str());
+					break;
+				}
+				// remove the plugin if we have found no FPGAs
 				fpgaplugin.unload();
+				delete fpgaThreads;
+				fpgaThreads = nullptr;
 			}
-			// we found at leat one working GPU
-			if (numWorkers != 0)
-			{
-				printer::inst()->print_msg(L0, "FPGA: use library '%s'", name.c_str());
-				break;
-			}
-		}
-		if (numWorkers == 0)
-			printer::inst()->print_msg(L0, "WARNING: backend FPGA disabled.");
+			if (fpgaThreads == nullptr)
+				printer::inst()->print_msg(L0, "WARNING: backend FPGA disabled.");
+			startupTiming::inst()->record("backend fpga start", iStart);
+			return fpgaThreads;
+		}));
 	}
 #endif
 
 #ifndef CONF_NO_CPU
 	if(params::inst().useCPU)
 	{
-		auto cpuThreads = cpu::minethd::thread_starter(static_cast<uint32_t>(pvThreads->size()), pWork);
-		pvThreads->insert(std::end(*pvThreads), std::begin(cpuThreads), std::end(cpuThreads));
-		if(cpuThreads.size() == 0)
-			printer::inst()->print_msg(L0, "WARNING: backend CPU disabled.");
+		backends.push_back(std::async(std::launch::async, [&pWork]() {
+			size_t iStart = startupTiming::inst()->now();
+			std::vector<iBackend*>* cpuThreads = new std::vector<iBackend*>(cpu::minethd::thread_starter(0u, pWork));
+			if(cpuThreads->size() == 0)
+				printer::inst()->print_msg(L0, "WARNING: backend CPU disabled.");
+			startupTiming::inst()->record("backend cpu start", iStart);
+			return cpuThreads;
+		}));
 	}
 #endif
 
+	std::vector<iBackend*>* pvThreads = new std::vector<iBackend*>;
+	for(auto& backend : backends)
+	{
+		std::vector<iBackend*>* threads = backend.get();
+		if(threads == nullptr)
+			continue;
+
+		for(iBackend* thd : *threads)
+		{
+			thd->iThreadNo = static_cast<uint32_t>(pvThreads->size());
+			pvThreads->push_back(thd);
+		}
+		delete threads;
+	}
+
 	globalStates::inst().iThreadCount = pvThreads->size();
+	globalStates::inst().bThreadsNumbered.store(true, std::memory_order_release);
 	return pvThreads;
 }
 
@@ -0,0 +1,263 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "backgroundMonitor.hpp"
+#include "xmrstak/misc/console.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace xmrstak
+{
+namespace cpu
+{
+
+backgroundMonitor::thd_slot* backgroundMonitor::add_thread(int64_t affinity)
+{
+	std::unique_lock<std::mutex> lck(slot_mutex);
+	vSlots.push_back(new thd_slot(affinity));
+	return vSlots.back();
+}
+
+void backgroundMonitor::enter_background(thd_slot* slot)
+{
+#if defined(_WIN32)
+	if(!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE))
+		printer::inst()->print_msg(L1, "WARNING: background mode can't lower the thread priority.");
+#else
+#	if defined(__linux__) && defined(SCHED_IDLE)
+	sched_param param;
+	param.sched_priority = 0;
+	if(pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0)
+	{
+		// nice is per thread on Linux
+		if(setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19) != 0)
+			printer::inst()->print_msg(L1, "WARNING: background mode can't lower the thread priority.");
+	}
+#	else
+	if(setpriority(PRIO_PROCESS, 0, 19) != 0)
+		printer::inst()->print_msg(L1, "WARNING: background mode can't lower the process priority.");
+#	endif
+
+#	if defined(__linux__)
+	// only the monitor thread reads the clock, macOS has no pthread_getcpuclockid
+	if(pthread_getcpuclockid(pthread_self(), &slot->iCpuClock) == 0)
+		slot->bHaveClock.store(true, std::memory_order_release);
+#	endif
+#endif
+}
+
+void backgroundMonitor::start()
+{
+#if defined(__linux__)
+	printer::inst()->print_msg(L1, "Background mode enabled, CPU threads yield to foreground load.");
+	oMonitorThd = std::thread(&backgroundMonitor::monitor_main, this);
+	oMonitorThd.detach();
+#else
+	printer::inst()->print_msg(L1, "Background mode: load monitoring is only supported on Linux, threads only run with idle priority.");
+#endif
+}
+
+#if defined(__linux__)
+
+struct cpu_stat
+{
+	uint64_t iBusy = 0;
+	uint64_t iTotal = 0;
+};
+
+/** read the per core jiffies from /proc/stat
+ *
+ * @param cores out: busy and total jiffies indexed by cpu id
+ * @param all out: sum over all cores
+ */
+static bool read_proc_stat(std::vector<cpu_stat>& cores, cpu_stat& all)
+{
+	FILE* fp = fopen("/proc/stat", "r");
+	if(fp == nullptr)
+		return false;
+
+	char line[512];
+	while(fgets(line, sizeof(line), fp) != nullptr)
+	{
+		if(strncmp(line, "cpu", 3) != 0)
+			break;
+
+		unsigned long long v[8] = {0};
+		char name[16];
+		if(sscanf(line, "%15s %llu %llu %llu %llu %llu %llu %llu %llu", name,
+			&v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) < 5)
+			continue;
+
+		cpu_stat st;
+		// user nice system irq softirq steal
+		st.iBusy = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+		// + idle iowait
+		st.iTotal = st.iBusy + v[3] + v[4];
+
+		if(name[3] == '\0')
+		{
+			all = st;
+			continue;
+		}
+
+		size_t id = strtoul(name + 3, nullptr, 10);
+		if(id >= cores.size())
+			cores.resize(id + 1);
+		cores[id] = st;
+	}
+	fclose(fp);
+	return true;
+}
+
+/** read the cpu pressure stall information
+ *
+ * @return "some avg10" in percent, 0.0 if PSI is not available
+ */
+static double read_cpu_pressure()
+{
+	FILE* fp = fopen("/proc/pressure/cpu", "r");
+	if(fp == nullptr)
+		return 0.0;
+
+	double avg10 = 0.0;
+	if(fscanf(fp, "some avg10=%lf", &avg10) != 1)
+		avg10 = 0.0;
+	fclose(fp);
+	return avg10;
+}
+
+void backgroundMonitor::monitor_main()
+{
+	const double jiffy_ns = 1e9 / double(sysconf(_SC_CLK_TCK));
+
+	std::vector<cpu_stat> last_cores, cores;
+	cpu_stat last_all, all;
+	if(!read_proc_stat(last_cores, last_all))
+	{
+		printer::inst()->print_msg(L0, "Background mode: can't read /proc/stat, load monitoring disabled.");
+		return;
+	}
+
+	while(true)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(iSampleMs));
+
+		if(!read_proc_stat(cores, all))
+			continue;
+		double pressure = read_cpu_pressure();
+
+		std::unique_lock<std::mutex> lck(slot_mutex);
+
+		// Time spent by our own workers, attributed to the core they are pinned to
+		std::vector<double> own_ns(cores.size(), 0.0);
+		double own_all_ns = 0.0;
+		for(thd_slot* slot : vSlots)
+		{
+			if(!slot->bHaveClock.load(std::memory_order_acquire))
+				continue;
+
+			timespec ts;
+			if(clock_gettime(slot->iCpuClock, &ts) != 0)
+				continue;
+
+			uint64_t ns = uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+			double delta = slot->iLastCpuNs != 0 ? double(ns - slot->iLastCpuNs) : 0.0;
+			slot->iLastCpuNs = ns;
+
+			own_all_ns += delta;
+			if(slot->iCpuAff >= 0 && size_t(slot->iCpuAff) < own_ns.size())
+				own_ns[slot->iCpuAff] += delta;
+		}
+
+		auto foreign_load = [&](const cpu_stat& now, const cpu_stat& last, double own) -> double
+		{
+			if(now.iTotal <= last.iTotal)
+				return 0.0;
+			double busy_ns = double(now.iBusy - last.iBusy) * jiffy_ns;
+			double total_ns = double(now.iTotal - last.iTotal) * jiffy_ns;
+			double load = 100.0 * (busy_ns - own) / total_ns;
+			return load < 0.0 ? 0.0 : load;
+		};
+
+		// Unpinned workers can run on any core, so they follow the system wide load
+		double all_load = foreign_load(all, last_all, own_all_ns);
+
+		for(thd_slot* slot : vSlots)
+		{
+			double load = all_load;
+			if(slot->iCpuAff >= 0 && size_t(slot->iCpuAff) < cores.size() && size_t(slot->iCpuAff) < last_cores.size())
+				load = foreign_load(cores[slot->iCpuAff], last_cores[slot->iCpuAff], own_ns[slot->iCpuAff]);
+
+			bool parked = slot->bParked.load(std::memory_order_relaxed);
+			if(!parked)
+			{
+				slot->iBusyStreak = load >= fParkLoad ? slot->iBusyStreak + 1 : 0;
+				if(slot->iBusyStreak >= iParkSamples)
+				{
+					slot->bParked.store(true, std::memory_order_relaxed);
+					slot->iBusyStreak = 0;
+					printer::inst()->print_msg(L3, "Background mode: parking thread on cpu %lld (foreign load %.0f%%).", (long long)slot->iCpuAff, load);
+				}
+			}
+			else
+			{
+				slot->iIdleStreak = (load < fResumeLoad && pressure < fResumePressure) ? slot->iIdleStreak + 1 : 0;
+				if(slot->iIdleStreak >= iResumeSamples)
+				{
+					slot->bParked.store(false, std::memory_order_relaxed);
+					slot->iIdleStreak = 0;
+					printer::inst()->print_msg(L3, "Background mode: resuming thread on cpu %lld.", (long long)slot->iCpuAff);
+				}
+			}
+		}
+		lck.unlock();
+
+		last_cores.swap(cores);
+		last_all = all;
+	}
+}
+
+#else
+
+void backgroundMonitor::monitor_main()
+{
+}
+
+#endif
+
+} // namespace cpu
+} // namespace xmrstak
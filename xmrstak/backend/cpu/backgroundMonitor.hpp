@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace xmrstak
+{
+namespace cpu
+{
+
+/** Cooperative background mode
+ *
+ * Worker threads are run with the lowest scheduling priority and a monitor
+ * thread watches the utilization of every core by other processes. Threads
+ * running on contended cores are parked and resumed again once the cores are
+ * idle (with hysteresis to avoid flapping).
+ */
+class backgroundMonitor
+{
+public:
+	static backgroundMonitor* inst()
+	{
+		// the initialization of a local static is thread safe
+		static backgroundMonitor* oInst = new backgroundMonitor;
+		return oInst;
+	};
+
+	struct thd_slot
+	{
+		std::atomic<bool> bParked;
+		int64_t iCpuAff;
+#if defined(__linux__)
+		//! written by the worker before bHaveClock is set
+		clockid_t iCpuClock;
+#endif
+		std::atomic<bool> bHaveClock;
+		uint64_t iLastCpuNs = 0;
+		uint32_t iBusyStreak = 0;
+		uint32_t iIdleStreak = 0;
+
+		thd_slot(int64_t aff) : bParked(false), iCpuAff(aff), bHaveClock(false) {}
+	};
+
+	/** register a worker thread
+	 *
+	 * Must be called before the worker thread is started.
+	 *
+	 * @param affinity cpu id the worker is pinned to, -1 if the worker is not pinned
+	 * @return slot shared between the worker and the monitor
+	 */
+	thd_slot* add_thread(int64_t affinity);
+
+	/** lower the priority of the calling thread and register its cpu clock
+	 *
+	 * Must be called from the worker thread itself.
+	 */
+	static void enter_background(thd_slot* slot);
+
+	/** start the monitor thread once all workers are registered */
+	void start();
+
+private:
+	backgroundMonitor() {}
+
+	// Sampling period of the monitor in milliseconds
+	constexpr static uint32_t iSampleMs = 1000;
+	// Foreign load (in percent of a core) needed to park / resume a worker
+	constexpr static double fParkLoad = 50.0;
+	constexpr static double fResumeLoad = 20.0;
+	// CPU pressure (PSI some avg10) that prevents resuming a worker
+	constexpr static double fResumePressure = 10.0;
+	// Number of consecutive samples needed to change the state of a worker
+	constexpr static uint32_t iParkSamples = 2;
+	constexpr static uint32_t iResumeSamples = 5;
+
+	void monitor_main();
+
+	std::mutex slot_mutex;
+	std::vector<thd_slot*> vSlots;
+	std::thread oMonitorThd;
+};
+
+} // namespace cpu
+} // namespace xmrstak
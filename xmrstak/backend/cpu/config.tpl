@@ -11,17 +11,33 @@ R"===(// generated by XMRSTAK_VERSION
  * no_prefetch    - Some systems can gain up to extra 5% here, but sometimes it will have no difference or make
  *                  things slower.
  *
- * asm            - Allow to switch to a assembler version of cryptonight_v8; allowed value [auto, off, intel_avx, amd_avx]
+ * asm            - Allow to switch to a assembler version of cryptonight_v8; allowed value [auto, off, intel_avx, amd_avx, jit, avx2_div, vaes]
  *                    - auto: xmr-stak will automatically detect the asm type (default)
  *                    - off: disable the usage of optimized assembler
  *                    - intel_avx: supports Intel cpus with avx instructions e.g. Xeon v2, Core i7/i5/i3 3xxx, Pentium G2xxx, Celeron G1xxx
  *                    - amd_avx: supports AMD cpus with avx instructions e.g. AMD Ryzen 1xxx and 2xxx series
+ *                    - jit: (experimental) generate the main loop at runtime for the algorithm and low_power_mode,
+ *                           needs hardware AES, not available for cryptonight_v8 and cryptonight_bittube2.
+ *                           It is checked against the normal hashes on start. Measure it with the xmr-stak-jit tool.
+ *                    - avx2_div: cryptonight_v8 with low_power_mode 2 to 5 computes the division and square root of
+ *                                all hashes of the thread together with AVX2 instead of one after another.
+ *                                Measure it with the xmr-stak-v8div tool.
+ *                    - vaes: low_power_mode 2 or 4 computes the AES rounds of the main loop of all hashes of the thread
+ *                            with one VAES instruction (Intel Ice Lake, AMD Zen 3 and newer), needs hardware AES,
+ *                            not available for cryptonight_bittube2. It is checked against the normal hashes and
+ *                            timed on start, the normal main loop is used if it is not faster.
  *
  * affine_to_cpu  - This can be either false (no affinity), or the CPU core number. Note that on hyperthreading
  *                  systems it is better to assign threads to physical cores. On Windows this usually means selecting
  *                  even or odd numbered cpu numbers. For Linux it will be usually the lower CPU numbers, so for a 4
  *                  physical core CPU you should select cpu numbers 0-3.
  *
+ * pipeline       - (optional, experimental) Only used if low_power_mode is 2 or more. Instead of running the hashes
+ *                  in lockstep, the main loop of one hash is run while the scratchpad of the next hash is created
+ *                  and the scratchpad of the previous hash is consumed in small slices. Measure it with the
+ *                  xmr-stak-pipeline tool before enabling it, the gain depends on the CPU and the algorithm.
+ *                  The asm option is ignored for pipelined threads. Default is false.
+ *
  * On the first run the miner will look at your system and suggest a basic configuration that will work,
  * you can try to tweak it from there to get the best performance.
  *
@@ -40,4 +56,21 @@ R"===(// generated by XMRSTAK_VERSION
 [
 CPUCONFIG
 ],
+
+/*
+ * Background mode - Run the CPU threads with the lowest scheduling priority and watch the load caused by
+ *                   other processes (/proc/stat and CPU pressure stall information). Threads on cores that are
+ *                   used by other processes are parked and resumed after the cores are idle again for a few
+ *                   seconds. The time the threads were parked is shown in the hashrate report.
+ *                   Load monitoring is only supported on Linux, other systems only lower the thread priority.
+ */
+"background_mode" : false,
+
+/*
+ * Hardware counters - Count the cycles, instructions, last level cache misses and dTLB misses of every
+ *                     CPU thread. The IPC, the L3 miss rate, the misses per hash and the memory bandwidth
+ *                     (estimated from the L3 misses) of the last 10 seconds are shown next to the hashrate.
+ *                     Only supported on Linux, /proc/sys/kernel/perf_event_paranoid must be 2 or less.
+ */
+"perf_counters" : false,
 )==="
@@ -27,6 +27,17 @@ namespace cpu
 	#endif
 	}
 
+	uint64_t xgetbv0()
+	{
+	#ifdef _WIN32
+		return _xgetbv(0);
+	#else
+		uint32_t eax, edx;
+		__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (uint64_t(edx) << 32) | eax;
+	#endif
+	}
+
 	int32_t get_masked(int32_t val, int32_t h, int32_t l)
 	{
 		val &= (0x7FFFFFFF >> (31-(h-l))) << l;
@@ -65,6 +76,30 @@ namespace cpu
 		result.aes = has_feature(cpu_info[2], 25);
 		// avx
 		result.avx = has_feature(cpu_info[2], 28);	
+		// ssse3
+		result.ssse3 = has_feature(cpu_info[2], 9);
+
+		// avx2 and avx512, need the OS to save the ymm (xcr0 bits 1 and 2) and zmm registers (xcr0 bits 5 to 7)
+		bool os_ymm = false;
+		bool os_zmm = false;
+		if(has_feature(cpu_info[2], 27))
+		{
+			uint64_t xcr0 = xgetbv0();
+			os_ymm = (xcr0 & 0x6) == 0x6;
+			os_zmm = (xcr0 & 0xe6) == 0xe6;
+		}
+
+		int32_t max_leaf[4];
+		cpuid(0, 0, max_leaf);
+		if(max_leaf[0] >= 7)
+		{
+			int32_t ext_info[4];
+			cpuid(7, 0, ext_info);
+			result.avx2 = os_ymm && result.avx && has_feature(ext_info[1], 5);
+			// avx512f
+			result.avx512 = os_zmm && has_feature(ext_info[1], 16);
+			result.vaes = result.avx2 && result.aes && has_feature(ext_info[2], 9);
+		}
 
 		if(strcmp(cpustr, "AuthenticAMD") == 0)
 		{
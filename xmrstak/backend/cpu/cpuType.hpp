@@ -15,6 +15,12 @@ namespace cpu
 		bool aes = false;
 		bool sse2 = false;
 		bool avx = false;
+		bool ssse3 = false;
+		// avx2 and avx512 are only set if the OS saves the ymm / zmm registers
+		bool avx2 = false;
+		bool avx512 = false;
+		// AES instructions on ymm registers (zmm registers only together with avx512)
+		bool vaes = false;
 		std::string type_name = "unknown";
 	};
 
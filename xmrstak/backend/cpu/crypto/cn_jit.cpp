@@ -0,0 +1,575 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * x86-64 code generator for the cryptonight main loop.
+ *
+ * The loop is generated for a fixed algorithm, lane count and prefetch flag,
+ * so the mask, the iteration count and the algorithm tweaks are constants in
+ * the code and no branch is left in the loop. It does the same as CN_STEP1 to
+ * CN_STEP5 in cryptonight_aesni.h.
+ *
+ * Register allocation, hottest values first:
+ * - the scratchpad pointer and the low half of a of every lane
+ * - the high half of a of every lane
+ * - the loop counter, the scratchpad base and monero_const of every lane
+ * Everything that doesn't fit into the 12 free general purpose registers is
+ * kept on the stack and used as a memory operand. rax, rcx and rdx are
+ * scratch registers for mul, idiv and the monero tweak. b and c of lane i are
+ * xmm i and xmm N+i.
+ */
+
+#include "cn_jit.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+
+enum gpr
+{
+	RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+//! register or [base + disp] memory operand
+struct operand
+{
+	bool mem;
+	int reg;
+	int32_t disp;
+};
+
+inline operand reg(int r)
+{
+	return { false, r, 0 };
+}
+
+inline operand mem(int base, int32_t disp = 0)
+{
+	return { true, base, disp };
+}
+
+/** encoder for the few instructions used by the main loop */
+class emitter
+{
+public:
+	std::vector<uint8_t> code;
+
+	void byte(uint8_t v)
+	{
+		code.push_back(v);
+	}
+
+	void imm32(uint32_t v)
+	{
+		for(size_t i = 0; i < 4; i++)
+			code.push_back(static_cast<uint8_t>(v >> (8 * i)));
+	}
+
+	/** instruction with a ModRM byte
+	 *
+	 * @param prefix mandatory prefix (0x66 or 0xF3), 0 for none
+	 * @param w 64 bit operand size (REX.W)
+	 * @param opc opcode bytes
+	 * @param r register or opcode extension in the reg field
+	 * @param rm register or memory operand
+	 */
+	void modrm(uint8_t prefix, bool w, std::initializer_list<uint8_t> opc, int r, const operand& rm)
+	{
+		if(prefix != 0)
+			byte(prefix);
+		const uint8_t rex = 0x40 | (w ? 8 : 0) | ((r & 8) ? 4 : 0) | ((rm.reg & 8) ? 1 : 0);
+		if(rex != 0x40)
+			byte(rex);
+		code.insert(code.end(), opc);
+
+		if(!rm.mem)
+		{
+			byte(0xC0 | (r & 7) << 3 | (rm.reg & 7));
+			return;
+		}
+
+		const int base = rm.reg & 7;
+		uint8_t mod = 0x80;
+		if(rm.disp == 0 && base != RBP)
+			mod = 0x00;
+		else if(rm.disp >= -128 && rm.disp <= 127)
+			mod = 0x40;
+		byte(mod | (r & 7) << 3 | base);
+		// rsp and r12 as base need a SIB byte
+		if(base == RSP)
+			byte(0x24);
+		if(mod == 0x40)
+			byte(static_cast<uint8_t>(rm.disp));
+		else if(mod == 0x80)
+			imm32(rm.disp);
+	}
+
+	/** 64 bit ALU instruction, one operand can be a memory operand
+	 *
+	 * @param opc opcode of the `op r/m, r` form, `op r, r/m` is opc + 2
+	 */
+	void alu(uint8_t opc, const operand& dst, const operand& src)
+	{
+		if(dst.mem)
+			modrm(0, true, {opc}, src.reg, dst);
+		else
+			modrm(0, true, {static_cast<uint8_t>(opc + 2)}, dst.reg, src);
+	}
+
+	void mov(const operand& dst, const operand& src) { alu(0x89, dst, src); }
+	void add(const operand& dst, const operand& src) { alu(0x01, dst, src); }
+	void or_(const operand& dst, const operand& src) { alu(0x09, dst, src); }
+	void and_(const operand& dst, const operand& src) { alu(0x21, dst, src); }
+	void xor_(const operand& dst, const operand& src) { alu(0x31, dst, src); }
+
+	/** 64 bit ALU instruction with a sign extended immediate
+	 *
+	 * @param ext opcode extension: add 0, or 1, and 4, sub 5, xor 6
+	 */
+	void alu_imm(int ext, const operand& dst, int32_t imm)
+	{
+		if(imm >= -128 && imm <= 127)
+		{
+			modrm(0, true, {0x83}, ext, dst);
+			byte(static_cast<uint8_t>(imm));
+		}
+		else
+		{
+			modrm(0, true, {0x81}, ext, dst);
+			imm32(imm);
+		}
+	}
+
+	void mov_imm(const operand& dst, int32_t imm)
+	{
+		modrm(0, true, {0xC7}, 0, dst);
+		imm32(imm);
+	}
+
+	//! 32 bit `op r, r` for the tweak: mov 0x8B, or 0x0B, add 0x03
+	void alu32(uint8_t opc, int dst, int src) { modrm(0, false, {opc}, dst, reg(src)); }
+	//! 32 bit `op r, imm8`: and 4
+	void alu32_imm8(int ext, int dst, int8_t imm) { modrm(0, false, {0x83}, ext, reg(dst)); byte(imm); }
+	void mov32_imm(int dst, uint32_t imm) { if(dst & 8) byte(0x41); byte(0xB8 + (dst & 7)); imm32(imm); }
+	//! shift by an immediate: shl 4, shr 5
+	void shift_imm(int ext, bool w, int dst, uint8_t cnt) { modrm(0, w, {0xC1}, ext, reg(dst)); byte(cnt); }
+	void shr32_cl(int dst) { modrm(0, false, {0xD3}, 5, reg(dst)); }
+
+	void mul(const operand& src) { modrm(0, true, {0xF7}, 4, src); }
+	void idiv(const operand& src) { modrm(0, true, {0xF7}, 7, src); }
+	void not_(const operand& dst) { modrm(0, true, {0xF7}, 2, dst); }
+	void cqo() { byte(0x48); byte(0x99); }
+	void movsxd(int dst, const operand& src) { modrm(0, true, {0x63}, dst, src); }
+
+	void movq_to_xmm(int x, const operand& src) { modrm(0x66, true, {0x0F, 0x6E}, x, src); }
+	void movq_from_xmm(const operand& dst, int x) { modrm(0x66, true, {0x0F, 0x7E}, x, dst); }
+	void movdqa_load(int x, const operand& src) { modrm(0x66, false, {0x0F, 0x6F}, x, src); }
+	void movdqa_store(const operand& dst, int x) { modrm(0x66, false, {0x0F, 0x7F}, x, dst); }
+	void movdqu_load(int x, const operand& src) { modrm(0xF3, false, {0x0F, 0x6F}, x, src); }
+	void movdqu_store(const operand& dst, int x) { modrm(0xF3, false, {0x0F, 0x7F}, x, dst); }
+	void pxor(int x, int y) { modrm(0x66, false, {0x0F, 0xEF}, x, reg(y)); }
+	void punpcklqdq(int x, int y) { modrm(0x66, false, {0x0F, 0x6C}, x, reg(y)); }
+	void punpckhqdq(int x, int y) { modrm(0x66, false, {0x0F, 0x6D}, x, reg(y)); }
+	void aesenc(int x, int y) { modrm(0x66, false, {0x0F, 0x38, 0xDC}, x, reg(y)); }
+	void prefetcht0(const operand& m) { modrm(0, false, {0x0F, 0x18}, 1, m); }
+
+	void push(int r) { if(r & 8) byte(0x41); byte(0x50 + (r & 7)); }
+	void pop(int r) { if(r & 8) byte(0x41); byte(0x58 + (r & 7)); }
+	void ret() { byte(0xC3); }
+
+	void jnz(size_t target)
+	{
+		byte(0x0F);
+		byte(0x85);
+		imm32(static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(code.size() + 4)));
+	}
+
+	void align(size_t n)
+	{
+		while(code.size() % n != 0)
+			byte(0x90);
+	}
+};
+
+enum tweak_type
+{
+	TWEAK_NONE,
+	//! monero tweak of the scratchpad write, shift 3 or 4 of the index
+	TWEAK_MONERO,
+	TWEAK_STELLITE,
+	//! monero tweak with the low half of the written value in the second write
+	TWEAK_IPBC
+};
+
+enum div_type
+{
+	DIV_NONE,
+	DIV_HEAVY,
+	DIV_HAVEN
+};
+
+struct loop_config
+{
+	size_t lanes;
+	int32_t mask;
+	int32_t iterations;
+	bool prefetch;
+	cn_jit_schedule schedule;
+	tweak_type tweak;
+	div_type div;
+};
+
+bool get_variant(xmrstak_algo algo, tweak_type& tweak, div_type& div)
+{
+	tweak = TWEAK_NONE;
+	div = DIV_NONE;
+	switch(algo)
+	{
+	case cryptonight:
+	case cryptonight_lite:
+		return true;
+	case cryptonight_monero:
+	case cryptonight_aeon:
+	case cryptonight_masari:
+		tweak = TWEAK_MONERO;
+		return true;
+	case cryptonight_stellite:
+		tweak = TWEAK_STELLITE;
+		return true;
+	case cryptonight_ipbc:
+		tweak = TWEAK_IPBC;
+		return true;
+	case cryptonight_heavy:
+		div = DIV_HEAVY;
+		return true;
+	case cryptonight_haven:
+		div = DIV_HAVEN;
+		return true;
+	default:
+		// cryptonight_bittube2 has an own AES round, cryptonight_monero_v8 has asm code
+		return false;
+	}
+}
+
+constexpr size_t MAX_LANES = 5;
+constexpr size_t LANE_SIZE = sizeof(cn_jit_lane);
+
+struct lane_alloc
+{
+	int ptr;
+	int al;
+	operand ah;
+	operand l;
+	operand k;
+};
+
+/** generate the main loop
+ *
+ * @param cfg loop configuration
+ * @param e emitter which gets the code
+ */
+void generate(const loop_config& cfg, emitter& e)
+{
+	const size_t N = cfg.lanes;
+	const bool tweak = cfg.tweak != TWEAK_NONE;
+
+	// register allocation in the order of the access frequency
+	static const int pool[] = { RBX, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+	size_t next_reg = 0;
+	int32_t next_slot = 0;
+	auto alloc = [&]() -> operand {
+		if(next_reg < sizeof(pool) / sizeof(pool[0]))
+			return reg(pool[next_reg++]);
+		operand slot = mem(RSP, next_slot);
+		next_slot += 8;
+		return slot;
+	};
+
+	std::vector<lane_alloc> lane(N);
+	for(size_t i = 0; i < N; i++)
+		lane[i].ptr = alloc().reg;
+	for(size_t i = 0; i < N; i++)
+		lane[i].al = alloc().reg;
+	for(size_t i = 0; i < N; i++)
+		lane[i].ah = alloc();
+	const operand counter = alloc();
+	for(size_t i = 0; i < N; i++)
+		lane[i].l = alloc();
+	for(size_t i = 0; i < N; i++)
+		lane[i].k = tweak ? alloc() : reg(RAX);
+
+	const int XA = 2 * N;
+	const int XT = 2 * N + 1;
+	auto b = [](size_t i) { return static_cast<int>(i); };
+	auto c = [N](size_t i) { return static_cast<int>(N + i); };
+
+#ifdef _WIN32
+	// xmm6 to xmm15 are callee saved on Windows
+	const int32_t xmm_save = next_slot;
+	const int xmm_saved = XT >= 6 ? XT - 5 : 0;
+	const int32_t frame = ((xmm_save + 16 * xmm_saved) | 15) + 1 + 8;
+#else
+	const int32_t frame = ((next_slot | 15) + 1) + 8;
+#endif
+
+	static const int saved[] = { RBX, RBP, RSI, RDI, R12, R13, R14, R15 };
+	for(int r : saved)
+		e.push(r);
+	e.alu_imm(5, reg(RSP), frame);
+#ifdef _WIN32
+	for(int x = 0; x < xmm_saved; x++)
+		e.movdqu_store(mem(RSP, xmm_save + 16 * x), 6 + x);
+	e.mov(reg(RAX), reg(RCX));
+#else
+	e.mov(reg(RAX), reg(RDI));
+#endif
+
+	auto load = [&e](const operand& dst, const operand& src) {
+		if(dst.mem)
+		{
+			e.mov(reg(RCX), src);
+			e.mov(dst, reg(RCX));
+		}
+		else
+			e.mov(dst, src);
+	};
+
+	// ptr = l + (idx & MASK)
+	auto set_ptr = [&](size_t i, int idx) {
+		if(idx != lane[i].ptr)
+			e.mov(reg(lane[i].ptr), reg(idx));
+		e.alu_imm(4, reg(lane[i].ptr), cfg.mask);
+		e.add(reg(lane[i].ptr), lane[i].l);
+		if(cfg.prefetch)
+			e.prefetcht0(mem(lane[i].ptr));
+	};
+
+	for(size_t i = 0; i < N; i++)
+	{
+		const int32_t o = static_cast<int32_t>(LANE_SIZE * i);
+		load(reg(lane[i].al), mem(RAX, o + offsetof(cn_jit_lane, a)));
+		load(lane[i].ah, mem(RAX, o + offsetof(cn_jit_lane, a) + 8));
+		e.movdqu_load(b(i), mem(RAX, o + offsetof(cn_jit_lane, b)));
+		load(lane[i].l, mem(RAX, o + offsetof(cn_jit_lane, l)));
+		if(tweak)
+			load(lane[i].k, mem(RAX, o + offsetof(cn_jit_lane, k)));
+	}
+	e.mov_imm(counter, cfg.iterations);
+	for(size_t i = 0; i < N; i++)
+		set_ptr(i, lane[i].al);
+
+	std::vector<std::function<void(size_t)>> steps;
+
+	// CN_STEP1: c = aesenc(scratchpad[ptr], a)
+	steps.push_back([&](size_t i) {
+		e.movdqa_load(c(i), mem(lane[i].ptr));
+		e.movq_to_xmm(XA, reg(lane[i].al));
+		e.movq_to_xmm(XT, lane[i].ah);
+		e.punpcklqdq(XA, XT);
+		e.aesenc(c(i), XA);
+	});
+
+	// CN_STEP2: scratchpad[ptr] = b ^ c, b = c, ptr = l + (c & MASK)
+	steps.push_back([&](size_t i) {
+		e.pxor(b(i), c(i));
+		if(tweak)
+		{
+			e.movq_from_xmm(mem(lane[i].ptr), b(i));
+			e.punpckhqdq(b(i), b(i));
+			e.movq_from_xmm(reg(RAX), b(i));
+			// vh ^= ((0x7531 >> index) & 3) << 28 with x = vh >> 24
+			// index = (((x >> 3) & 6) | (x & 1)) << 1, stellite shifts x by 4
+			e.alu32(0x8B, RDX, RAX);
+			e.shift_imm(5, false, RDX, 24);
+			e.alu32(0x8B, RCX, RDX);
+			e.shift_imm(5, false, RCX, cfg.tweak == TWEAK_STELLITE ? 4 : 3);
+			e.alu32_imm8(4, RCX, 6);
+			e.alu32_imm8(4, RDX, 1);
+			e.alu32(0x0B, RCX, RDX);
+			e.alu32(0x03, RCX, RCX);
+			e.mov32_imm(RDX, 0x7531);
+			e.shr32_cl(RDX);
+			e.alu32_imm8(4, RDX, 3);
+			e.shift_imm(4, true, RDX, 28);
+			e.xor_(reg(RAX), reg(RDX));
+			e.mov(mem(lane[i].ptr, 8), reg(RAX));
+		}
+		else
+			e.movdqa_store(mem(lane[i].ptr), b(i));
+		e.movdqa_load(b(i), reg(c(i)));
+		e.movq_from_xmm(reg(lane[i].ptr), b(i));
+		set_ptr(i, lane[i].ptr);
+	});
+
+	// CN_STEP3 and CN_STEP4: multiply, add and xor with the scratchpad
+	steps.push_back([&](size_t i) {
+		const operand p0 = mem(lane[i].ptr);
+		const operand p1 = mem(lane[i].ptr, 8);
+		e.movq_from_xmm(reg(RAX), b(i));
+		e.mul(p0);
+		e.add(lane[i].ah, reg(RAX));
+		e.add(reg(lane[i].al), reg(RDX));
+		e.mov(reg(RAX), p0);
+		e.mov(reg(RDX), p1);
+		e.mov(p0, reg(lane[i].al));
+		if(!tweak && !lane[i].ah.mem)
+			e.mov(p1, lane[i].ah);
+		else
+		{
+			e.mov(reg(RCX), lane[i].ah);
+			if(tweak)
+				e.xor_(reg(RCX), lane[i].k);
+			if(cfg.tweak == TWEAK_IPBC)
+				e.xor_(reg(RCX), reg(lane[i].al));
+			e.mov(p1, reg(RCX));
+		}
+		e.xor_(reg(lane[i].al), reg(RAX));
+		e.xor_(lane[i].ah, reg(RDX));
+		set_ptr(i, lane[i].al);
+	});
+
+	// CN_STEP5: signed division of the heavy algorithms, changes only the index
+	if(cfg.div != DIV_NONE)
+	{
+		steps.push_back([&](size_t i) {
+			const operand p0 = mem(lane[i].ptr);
+			const operand p1 = mem(lane[i].ptr, 8);
+			e.movsxd(RCX, p1);
+			e.alu_imm(1, reg(RCX), 5);
+			e.mov(reg(RAX), p0);
+			e.cqo();
+			e.idiv(reg(RCX));
+			e.xor_(p0, reg(RAX));
+			e.movsxd(RCX, p1);
+			if(cfg.div == DIV_HAVEN)
+				e.not_(reg(RCX));
+			e.xor_(reg(RCX), reg(RAX));
+			set_ptr(i, RCX);
+		});
+	}
+
+	e.align(16);
+	const size_t loop = e.code.size();
+	if(cfg.schedule == cn_jit_interleaved)
+	{
+		for(auto& step : steps)
+			for(size_t i = 0; i < N; i++)
+				step(i);
+	}
+	else
+	{
+		for(size_t i = 0; i < N; i++)
+			for(auto& step : steps)
+				step(i);
+	}
+	e.alu_imm(5, counter, 1);
+	e.jnz(loop);
+
+#ifdef _WIN32
+	for(int x = 0; x < xmm_saved; x++)
+		e.movdqu_load(6 + x, mem(RSP, xmm_save + 16 * x));
+#endif
+	e.alu_imm(0, reg(RSP), frame);
+	for(size_t r = sizeof(saved) / sizeof(saved[0]); r-- > 0;)
+		e.pop(saved[r]);
+	e.ret();
+}
+
+/** copy the code into executable memory, the memory is never released */
+cn_jit_fun make_executable(const std::vector<uint8_t>& code)
+{
+#ifdef _WIN32
+	void* ptr = VirtualAlloc(nullptr, code.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if(ptr == nullptr)
+		return nullptr;
+	memcpy(ptr, code.data(), code.size());
+	DWORD old;
+	if(!VirtualProtect(ptr, code.size(), PAGE_EXECUTE_READ, &old))
+		return nullptr;
+	FlushInstructionCache(GetCurrentProcess(), ptr, code.size());
+#else
+	void* ptr = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(ptr == MAP_FAILED)
+		return nullptr;
+	memcpy(ptr, code.data(), code.size());
+	if(mprotect(ptr, code.size(), PROT_READ | PROT_EXEC) != 0)
+	{
+		munmap(ptr, code.size());
+		return nullptr;
+	}
+#endif
+	return reinterpret_cast<cn_jit_fun>(ptr);
+}
+
+std::mutex cache_mutex;
+std::map<uint32_t, cn_jit_fun> cache;
+
+} // namespace
+
+bool cn_jit_supported(xmrstak_algo algo, size_t N)
+{
+	tweak_type tweak;
+	div_type div;
+	return N >= 1 && N <= MAX_LANES && get_variant(algo, tweak, div);
+}
+
+cn_jit_fun cn_jit_get(xmrstak_algo algo, size_t N, bool prefetch, cn_jit_schedule schedule)
+{
+	loop_config cfg;
+	if(!cn_jit_supported(algo, N) || !get_variant(algo, cfg.tweak, cfg.div))
+		return nullptr;
+
+	const uint32_t key = static_cast<uint32_t>(algo) | static_cast<uint32_t>(N) << 8 |
+		(prefetch ? 1u : 0u) << 12 | static_cast<uint32_t>(schedule) << 13;
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	auto it = cache.find(key);
+	if(it != cache.end())
+		return it->second;
+
+	cfg.lanes = N;
+	cfg.mask = static_cast<int32_t>(cn_select_mask(algo));
+	cfg.iterations = static_cast<int32_t>(cn_select_iter(algo));
+	cfg.prefetch = prefetch;
+	cfg.schedule = schedule;
+
+	emitter e;
+	generate(cfg, e);
+	cn_jit_fun fun = make_executable(e.code);
+	cache[key] = fun;
+	return fun;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "xmrstak/backend/cryptonight.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** state of one hash at the start of the main loop */
+struct cn_jit_lane
+{
+	uint64_t a[2];
+	uint64_t b[2];
+	uint8_t* l;
+	//! monero_const of the monero tweak, unused by the other algorithms
+	uint64_t k;
+};
+
+/** main loop of N hashes generated at runtime
+ *
+ * @param lanes N lane states, the scratchpads must be initialized
+ */
+typedef void (*cn_jit_fun)(cn_jit_lane* lanes);
+
+/** order of the instructions of the lanes in the generated loop */
+enum cn_jit_schedule
+{
+	//! every step of an iteration is emitted for all lanes before the next step
+	cn_jit_interleaved = 0,
+	//! the whole iteration of a lane is emitted before the next lane
+	cn_jit_sequential = 1
+};
+
+/** check if the main loop of an algorithm can be generated
+ *
+ * Only the hardware AES variants of the algorithms without a dedicated AES
+ * round or the cryptonight_monero_v8 division are supported.
+ *
+ * @param algo algorithm
+ * @param N number of hashes per call (1 to 5)
+ */
+bool cn_jit_supported(xmrstak_algo algo, size_t N);
+
+/** get the generated main loop (cn_jit.cpp)
+ *
+ * The code is generated on the first call and cached, the function is thread safe.
+ *
+ * @return nullptr if the algorithm is not supported or no executable memory is available
+ */
+cn_jit_fun cn_jit_get(xmrstak_algo algo, size_t N, bool prefetch, cn_jit_schedule schedule = cn_jit_interleaved);
@@ -21,6 +21,8 @@ typedef struct {
 size_t cryptonight_init(size_t use_fast_mem, size_t use_mlock, alloc_msg* msg);
 cryptonight_ctx* cryptonight_alloc_ctx(size_t use_fast_mem, size_t use_mlock, alloc_msg* msg);
 void cryptonight_free_ctx(cryptonight_ctx* ctx);
+/* remove all unused scratchpad files from a hugetlbfs directory, returns the number of removed files */
+size_t cryptonight_release_hugepage_files(const char* dir);
 
 #ifdef __cplusplus
 }
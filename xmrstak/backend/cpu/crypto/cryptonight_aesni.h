@@ -40,6 +40,11 @@ static inline uint64_t _umul128(uint64_t a, uint64_t b, uint64_t* hi)
 #endif
 
 #include "soft_aes.hpp"
+#include "keccak_multi.hpp"
+#include "extra_hashes_multi.hpp"
+#include "cn_jit.hpp"
+#include "fast_div_heavy.hpp"
+#include "xmrstak/misc/phaseStats.hpp"
 
 extern "C"
 {
@@ -141,6 +146,12 @@ static inline void aes_round(__m128i key, __m128i* x0, __m128i* x1, __m128i* x2,
 
 static inline void soft_aes_round(__m128i key, __m128i* x0, __m128i* x1, __m128i* x2, __m128i* x3, __m128i* x4, __m128i* x5, __m128i* x6, __m128i* x7)
 {
+	if(soft_aes_vperm.aes_round != nullptr)
+	{
+		soft_aes_vperm.aes_round(key, x0, x1, x2, x3, x4, x5, x6, x7);
+		return;
+	}
+
 	*x0 = soft_aesenc(*x0, key);
 	*x1 = soft_aesenc(*x1, key);
 	*x2 = soft_aesenc(*x2, key);
@@ -261,11 +272,13 @@ void cn_explode_scratchpad(const __m128i* input, __m128i* output)
 		if(PREFETCH)
 			_mm_prefetch((const char*)output + i + 4, _MM_HINT_T2);
 	}
+	XMRSTAK_PHASE(EXPLODE);
 }
 
 template<size_t MEM, bool SOFT_AES, bool PREFETCH, xmrstak_algo ALGO>
 void cn_implode_scratchpad(const __m128i* input, __m128i* output)
 {
+	XMRSTAK_PHASE(MAIN_LOOP);
 	// This is more than we have registers, compiler will assign 2 keys on the stack
 	__m128i xout0, xout1, xout2, xout3, xout4, xout5, xout6, xout7;
 	__m128i k0, k1, k2, k3, k4, k5, k6, k7, k8, k9;
@@ -422,8 +435,138 @@ void cn_implode_scratchpad(const __m128i* input, __m128i* output)
 	_mm_store_si128(output + 9, xout5);
 	_mm_store_si128(output + 10, xout6);
 	_mm_store_si128(output + 11, xout7);
+	XMRSTAK_PHASE(IMPLODE);
 }
 
+/** explode or implode a scratchpad in slices
+ *
+ * Produces the same result as cn_explode_scratchpad / cn_implode_scratchpad but the
+ * work can be split into many small steps. This allows to interleave the AES
+ * throughput bound scratchpad work of one hash with the latency bound main loop
+ * of another hash.
+ */
+template<size_t MEM, bool SOFT_AES, bool PREFETCH, xmrstak_algo ALGO>
+struct cn_scratchpad_stream
+{
+	static constexpr bool HEAVY = ALGO == cryptonight_heavy || ALGO == cryptonight_haven || ALGO == cryptonight_bittube2;
+	//! number of 128 byte blocks of the scratchpad
+	static constexpr size_t BLOCKS = MEM / (8 * sizeof(__m128i));
+
+	__m128i k[10];
+	__m128i x[8];
+	__m128i* long_state = nullptr;
+	__m128i* hash_state = nullptr;
+	size_t pos = 0;
+	size_t total = 0;
+	bool implode = false;
+
+	static void rounds(const __m128i* key, __m128i* v)
+	{
+		for(size_t r = 0; r < 10; r++)
+		{
+			if(SOFT_AES)
+				soft_aes_round(key[r], &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+			else
+				aes_round(key[r], &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+		}
+	}
+
+	void mix_rounds()
+	{
+		for(size_t i = 0; i < 16; i++)
+		{
+			rounds(k, x);
+			mix_and_propagate(x[0], x[1], x[2], x[3], x[4], x[5], x[6], x[7]);
+		}
+	}
+
+	/** start to explode the scratchpad of a hash, the keccak state must be calculated already */
+	void begin_explode(cryptonight_ctx* ctx)
+	{
+		hash_state = (__m128i*)ctx->hash_state;
+		long_state = (__m128i*)ctx->long_state;
+		aes_genkey<SOFT_AES>(hash_state, &k[0], &k[1], &k[2], &k[3], &k[4], &k[5], &k[6], &k[7], &k[8], &k[9]);
+		for(size_t i = 0; i < 8; i++)
+			x[i] = _mm_load_si128(hash_state + 4 + i);
+		if(HEAVY)
+			mix_rounds();
+		pos = 0;
+		total = BLOCKS;
+		implode = false;
+	}
+
+	/** start to implode the scratchpad of a hash, the main loop must be finished */
+	void begin_implode(cryptonight_ctx* ctx)
+	{
+		hash_state = (__m128i*)ctx->hash_state;
+		long_state = (__m128i*)ctx->long_state;
+		aes_genkey<SOFT_AES>(hash_state + 2, &k[0], &k[1], &k[2], &k[3], &k[4], &k[5], &k[6], &k[7], &k[8], &k[9]);
+		for(size_t i = 0; i < 8; i++)
+			x[i] = _mm_load_si128(hash_state + 4 + i);
+		pos = 0;
+		total = HEAVY ? 2 * BLOCKS : BLOCKS;
+		implode = true;
+	}
+
+	/** process blocks until `target` blocks are done in total */
+	void run_to(size_t target)
+	{
+		if(target > total)
+			target = total;
+		if(pos >= target)
+			return;
+
+		// work on local copies, the members would be reloaded for every round
+		__m128i key[10], v[8];
+		for(size_t i = 0; i < 10; i++)
+			key[i] = k[i];
+		for(size_t i = 0; i < 8; i++)
+			v[i] = x[i];
+
+		for(; pos < target; pos++)
+		{
+			__m128i* block = long_state + (pos % BLOCKS) * 8;
+			if(implode)
+			{
+				if(PREFETCH)
+					_mm_prefetch((const char*)block, _MM_HINT_NTA);
+				for(size_t i = 0; i < 8; i++)
+					v[i] = _mm_xor_si128(_mm_load_si128(block + i), v[i]);
+				rounds(key, v);
+				if(HEAVY)
+					mix_and_propagate(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+			}
+			else
+			{
+				rounds(key, v);
+				for(size_t i = 0; i < 8; i++)
+					_mm_store_si128(block + i, v[i]);
+				if(PREFETCH)
+					_mm_prefetch((const char*)block, _MM_HINT_T2);
+			}
+		}
+
+		for(size_t i = 0; i < 8; i++)
+			x[i] = v[i];
+	}
+
+	//! process all remaining blocks, an implode writes the result back to the keccak state
+	void finish()
+	{
+		if(total == 0)
+			return;
+		run_to(total);
+		if(implode)
+		{
+			if(HEAVY)
+				mix_rounds();
+			for(size_t i = 0; i < 8; i++)
+				_mm_store_si128(hash_state + 4 + i, x[i]);
+		}
+		total = 0;
+	}
+};
+
 inline uint64_t int_sqrt33_1_double_precision(const uint64_t n0)
 {
 	__m128d x = _mm_castsi128_pd(_mm_add_epi64(_mm_cvtsi64_si128(n0 >> 12), _mm_set_epi64x(0, 1023ULL << 52)));
@@ -447,8 +590,35 @@ inline uint64_t int_sqrt33_1_double_precision(const uint64_t n0)
 	return r;
 }
 
+template<bool SOFT_AES>
 inline __m128i aes_round_bittube2(const __m128i& val, const __m128i& key)
 {
+	if(SOFT_AES && soft_aes_vperm.aes_round_bittube2 != nullptr)
+		return soft_aes_vperm.aes_round_bittube2(val, key);
+
+	if(!SOFT_AES)
+	{
+		// Every column of the round is added to the state before the next column is calculated.
+		// Each column is taken from a full aesenc with a zero key, this keeps the round free of table lookups.
+		const __m128i zero = _mm_setzero_si128();
+		__m128i x = _mm_xor_si128(val, _mm_cmpeq_epi32(zero, zero)); // x = ~val
+		__m128i k = key;
+		__m128i mask;
+
+		mask = _mm_set_epi32(0, 0, 0, -1);
+		k = _mm_xor_si128(k, _mm_and_si128(_mm_aesenc_si128(x, zero), mask));
+		x = _mm_xor_si128(x, _mm_and_si128(k, mask));
+		mask = _mm_set_epi32(0, 0, -1, 0);
+		k = _mm_xor_si128(k, _mm_and_si128(_mm_aesenc_si128(x, zero), mask));
+		x = _mm_xor_si128(x, _mm_and_si128(k, mask));
+		mask = _mm_set_epi32(0, -1, 0, 0);
+		k = _mm_xor_si128(k, _mm_and_si128(_mm_aesenc_si128(x, zero), mask));
+		x = _mm_xor_si128(x, _mm_and_si128(k, mask));
+		mask = _mm_set_epi32(-1, 0, 0, 0);
+		return _mm_xor_si128(k, _mm_and_si128(_mm_aesenc_si128(x, zero), mask));
+	}
+
+	// lookup tables if the CPU has no SSSE3
 	alignas(16) uint32_t k[4];
 	alignas(16) uint32_t x[4];
 	_mm_store_si128((__m128i*)k, key);
@@ -602,16 +772,64 @@ inline void set_float_rounding_mode()
 		return; \
 	}
 
+/** keccak state of all N hashes
+ *
+ * The states of a multi hash are calculated in one pass, see keccak_multi.cpp.
+ */
+template<size_t N>
+inline void cn_keccak_init(const void* input, size_t len, cryptonight_ctx** ctx)
+{
+	XMRSTAK_PHASE(WORKER);
+	if(N == 1)
+		keccak((const uint8_t *)input, len, ctx[0]->hash_state, 200);
+	else
+	{
+		uint8_t* md[N];
+		for(size_t i = 0; i < N; i++)
+			md[i] = ctx[i]->hash_state;
+		keccak1600_multi((const uint8_t *)input, len, md, N);
+	}
+	XMRSTAK_PHASE(KECCAK);
+}
+
+/** keccak permutation and final hash of all N hashes */
+template<size_t N>
+inline void cn_keccak_finalize(void* output, cryptonight_ctx** ctx)
+{
+	// the pipelined kernels explode and implode in slices during the main loop
+	XMRSTAK_PHASE(MAIN_LOOP);
+	if(N == 1)
+		keccakf((uint64_t*)ctx[0]->hash_state, 24);
+	else
+	{
+		uint64_t* st[N];
+		for(size_t i = 0; i < N; i++)
+			st[i] = (uint64_t*)ctx[i]->hash_state;
+		keccakf_multi(st, N);
+	}
+
+	uint8_t* st[N];
+	for(size_t i = 0; i < N; i++)
+		st[i] = ctx[i]->hash_state;
+	extra_hashes_multi(st, N, output);
+	XMRSTAK_PHASE(FINAL);
+}
+
 #define CN_INIT(n, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm) \
-	keccak((const uint8_t *)input + len * n, len, ctx[n]->hash_state, 200); \
+	if(n == 0) \
+		cn_keccak_init<N>(input, len, ctx); \
+	/* Optim - 99% time boundary */ \
+	cn_explode_scratchpad<MEM, SOFT_AES, PREFETCH, ALGO>((__m128i*)ctx[n]->hash_state, (__m128i*)ctx[n]->long_state); \
+	CN_INIT_STATE(n, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm)
+
+//! main loop state of a hash, the keccak state must be calculated already
+#define CN_INIT_STATE(n, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm) \
 	uint64_t monero_const; \
 	if(ALGO == cryptonight_monero || ALGO == cryptonight_aeon || ALGO == cryptonight_ipbc || ALGO == cryptonight_stellite || ALGO == cryptonight_masari || ALGO == cryptonight_bittube2) \
 	{ \
 		monero_const =  *reinterpret_cast<const uint64_t*>(reinterpret_cast<const uint8_t*>(input) + len * n + 35); \
 		monero_const ^=  *(reinterpret_cast<const uint64_t*>(ctx[n]->hash_state) + 24); \
 	} \
-	/* Optim - 99% time boundary */ \
-	cn_explode_scratchpad<MEM, SOFT_AES, PREFETCH, ALGO>((__m128i*)ctx[n]->hash_state, (__m128i*)ctx[n]->long_state); \
 	\
 	__m128i ax0; \
 	uint64_t idx0; \
@@ -643,7 +861,7 @@ inline void set_float_rounding_mode()
 	cx = _mm_load_si128(ptr0); \
 	if (ALGO == cryptonight_bittube2) \
 	{ \
-		cx = aes_round_bittube2(cx, ax0); \
+		cx = aes_round_bittube2<SOFT_AES>(cx, ax0); \
 	} \
 	else \
 	{ \
@@ -668,12 +886,24 @@ inline void set_float_rounding_mode()
 		bx0 = cx
 
 #define CN_STEP3(n, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm) \
+	CN_STEP3_LOAD(n, ax0, ptr0, lo, cl, ch, al0, ah0); \
+	CN_MONERO_V8_DIV(n, cx, sqrt_result, division_result_xmm, cl); \
+	CN_STEP3_MUL(n, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1)
+
+//! CN_STEP3 with the division and square root of all lanes done by cn_v8_div_sqrt_avx2
+#define CN_STEP3_V8_AVX2(n, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm) \
+	CN_STEP3_LOAD(n, ax0, ptr0, lo, cl, ch, al0, ah0); \
+	cl ^= v8_xor[n]; \
+	CN_STEP3_MUL(n, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1)
+
+#define CN_STEP3_LOAD(n, ax0, ptr0, lo, cl, ch, al0, ah0) \
 	uint64_t lo, cl, ch; \
 	uint64_t al0 = _mm_cvtsi128_si64(ax0); \
 	uint64_t ah0 = ((uint64_t*)&ax0)[1]; \
 	cl = ((uint64_t*)ptr0)[0]; \
-	ch = ((uint64_t*)ptr0)[1]; \
-	CN_MONERO_V8_DIV(n, cx, sqrt_result, division_result_xmm, cl); \
+	ch = ((uint64_t*)ptr0)[1]
+
+#define CN_STEP3_MUL(n, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1) \
 	{ \
 		uint64_t hi; \
 		lo = _umul128(idx0, cl, &hi); \
@@ -710,8 +940,9 @@ inline void set_float_rounding_mode()
 	{ \
 		ptr0 = (__m128i *)&l0[idx0 & MASK]; \
 		int64_t u  = ((int64_t*)ptr0)[0]; \
-		int32_t d  = ((int32_t*)ptr0)[2]; \
-		int64_t q = u / (d | 0x5); \
+		/* low half of the word written by CN_STEP4, an int32_t access may be moved before that store */ \
+		int32_t d  = static_cast<int32_t>(((int64_t*)ptr0)[1]); \
+		int64_t q = cn_heavy_fast_div ? fast_div_heavy(u, d | 0x5) : u / (d | 0x5); \
 		\
 		((int64_t*)ptr0)[0] = u ^ q; \
 		idx0 = d ^ q; \
@@ -720,8 +951,9 @@ inline void set_float_rounding_mode()
 	{ \
 		ptr0 = (__m128i *)&l0[idx0 & MASK]; \
 		int64_t u  = ((int64_t*)ptr0)[0]; \
-		int32_t d  = ((int32_t*)ptr0)[2]; \
-		int64_t q = u / (d | 0x5); \
+		/* low half of the word written by CN_STEP4, an int32_t access may be moved before that store */ \
+		int32_t d  = static_cast<int32_t>(((int64_t*)ptr0)[1]); \
+		int64_t q = cn_heavy_fast_div ? fast_div_heavy(u, d | 0x5) : u / (d | 0x5); \
 		\
 		((int64_t*)ptr0)[0] = u ^ q; \
 		idx0 = (~d) ^ q; \
@@ -731,8 +963,8 @@ inline void set_float_rounding_mode()
 	/* Optim - 90% time boundary */ \
 	cn_implode_scratchpad<MEM, SOFT_AES, PREFETCH, ALGO>((__m128i*)ctx[n]->long_state, (__m128i*)ctx[n]->hash_state); \
 	/* Optim - 99% time boundary */ \
-	keccakf((uint64_t*)ctx[n]->hash_state, 24); \
-	extra_hashes[ctx[n]->hash_state[0] & 3](ctx[n]->hash_state, 200, (char*)output + 32 * n)
+	if(n == N - 1) \
+		cn_keccak_finalize<N>(output, ctx)
 
 //! defer the evaluation of an macro
 #ifndef _MSC_VER
@@ -938,6 +1170,520 @@ struct Cryptonight_hash<5>
 	}
 };
 
+#ifdef __GNUC__
+#	define CN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#	define CN_TARGET_AVX2
+#endif
+
+/** low (HI = false) or high 64 bit of four lanes in one AVX2 register */
+template<bool HI>
+CN_TARGET_AVX2 inline __m256i cn_v8_pack(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+	const __m128i ab = HI ? _mm_unpackhi_epi64(a, b) : _mm_unpacklo_epi64(a, b);
+	const __m128i cd = HI ? _mm_unpackhi_epi64(c, d) : _mm_unpacklo_epi64(c, d);
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(ab), cd, 1);
+}
+
+//! low 64 bit of the products, AVX2 has no 64 bit multiplication
+CN_TARGET_AVX2 inline __m256i cn_mullo_epi64_avx2(__m256i a, __m256i b)
+{
+	const __m256i cross = _mm256_add_epi64(
+		_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+		_mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+	return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+//! integers below 2^52 to double, exact
+CN_TARGET_AVX2 inline __m256d cn_u52_to_pd(__m256i v)
+{
+	const __m256i magic = _mm256_set1_epi64x(0x4330000000000000ULL);
+	return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(v, magic)), _mm256_castsi256_pd(magic));
+}
+
+/** CN_MONERO_V8_DIV of four lanes
+ *
+ * The quotient is estimated with a double division and corrected with the
+ * exact remainder, the square root is the vector version of
+ * int_sqrt33_1_double_precision(). The results are bit identical to the
+ * scalar code for every input.
+ *
+ * @param cx_lo, cx_hi low and high 64 bit of cx of the lanes
+ * @param div division_result of the lanes, replaced by the new value
+ * @param sqrt sqrt_result of the lanes, replaced by the new value
+ * @param xor_term value which is xored to cl of every lane, calculated from the previous results
+ */
+CN_TARGET_AVX2 inline void cn_v8_div_sqrt_avx2(__m256i cx_lo, __m256i cx_hi, __m256i& div, __m256i& sqrt, uint64_t* xor_term)
+{
+	_mm256_store_si256((__m256i*)xor_term, _mm256_xor_si256(div, _mm256_slli_epi64(sqrt, 32)));
+
+	const __m256i lo32 = _mm256_set1_epi64x(0xFFFFFFFFULL);
+	const __m256i d = _mm256_and_si256(
+		_mm256_or_si256(_mm256_add_epi64(cx_lo, _mm256_slli_epi64(sqrt, 1)), _mm256_set1_epi64x(0x80000001ULL)), lo32);
+
+	// the quotient is below 2^33, the estimate is off by at most one
+	const __m256d num = _mm256_add_pd(
+		_mm256_mul_pd(cn_u52_to_pd(_mm256_srli_epi64(cx_hi, 32)), _mm256_set1_pd(4294967296.0)),
+		cn_u52_to_pd(_mm256_and_si256(cx_hi, lo32)));
+	const __m256d magic = _mm256_set1_pd(4503599627370496.0);
+	__m256i q = _mm256_sub_epi64(
+		_mm256_castpd_si256(_mm256_add_pd(_mm256_div_pd(num, cn_u52_to_pd(d)), magic)),
+		_mm256_castpd_si256(magic));
+	__m256i r = _mm256_sub_epi64(cx_hi, cn_mullo_epi64_avx2(q, d));
+
+	__m256i m = _mm256_cmpgt_epi64(_mm256_setzero_si256(), r);
+	q = _mm256_add_epi64(q, m);
+	r = _mm256_add_epi64(r, _mm256_and_si256(m, d));
+	m = _mm256_cmpgt_epi64(r, _mm256_sub_epi64(d, _mm256_set1_epi64x(1)));
+	q = _mm256_sub_epi64(q, m);
+	r = _mm256_sub_epi64(r, _mm256_and_si256(m, d));
+	div = _mm256_add_epi64(_mm256_and_si256(q, lo32), _mm256_slli_epi64(r, 32));
+
+	const __m256i n0 = _mm256_add_epi64(cx_lo, div);
+	const __m256d x = _mm256_castsi256_pd(_mm256_add_epi64(_mm256_srli_epi64(n0, 12), _mm256_set1_epi64x(1023ULL << 52)));
+	const __m256i root = _mm256_castpd_si256(_mm256_sqrt_pd(x));
+	const __m256i c1022 = _mm256_set1_epi64x(1022ULL << 32);
+	const __m256i s = _mm256_srli_epi64(root, 20);
+	r = _mm256_srli_epi64(root, 19);
+	const __m256i x2 = cn_mullo_epi64_avx2(
+		_mm256_sub_epi64(s, c1022),
+		_mm256_add_epi64(_mm256_sub_epi64(_mm256_sub_epi64(r, s), c1022), _mm256_set1_epi64x(1)));
+	// r + 1 if x2 < n0 (unsigned)
+	const __m256i sign = _mm256_set1_epi64x(0x8000000000000000ULL);
+	sqrt = _mm256_sub_epi64(r, _mm256_cmpgt_epi64(_mm256_xor_si256(n0, sign), _mm256_xor_si256(x2, sign)));
+}
+
+/** N-way cryptonight_monero_v8 with the division and square root of all lanes in AVX2 registers
+ *
+ * Instead of one 64 bit division and one scalar square root per lane the lanes
+ * share vdivpd and vsqrtpd (four lanes per register). Only for
+ * cryptonight_monero_v8, the CPU must support AVX2.
+ */
+template<size_t N>
+struct Cryptonight_hash_v8_avx2;
+
+template< >
+struct Cryptonight_hash_v8_avx2<2>
+{
+	static constexpr size_t N = 2;
+
+	template<xmrstak_algo ALGO, bool SOFT_AES, bool PREFETCH>
+	CN_TARGET_AVX2 static void hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
+	{
+		constexpr size_t MASK = cn_select_mask<ALGO>();
+		constexpr size_t ITERATIONS = cn_select_iter<ALGO>();
+		constexpr size_t MEM = cn_select_memory<ALGO>();
+
+		REPEAT_2(9, CN_INIT, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm);
+
+		const __m128i z = _mm_setzero_si128();
+		__m256i v8_div = cn_v8_pack<false>(division_result_xmm0, division_result_xmm1, z, z);
+		__m256i v8_sqrt = cn_v8_pack<false>(sqrt_result0, sqrt_result1, z, z);
+		alignas(32) uint64_t v8_xor[4];
+
+		// Optim - 90% time boundary
+		for(size_t i = 0; i < ITERATIONS; i++)
+		{
+			REPEAT_2(8, CN_STEP1, monero_const, l0, ax0, bx0, idx0, ptr0, cx, bx1);
+			REPEAT_2(7, CN_STEP2, monero_const, l0, ax0, bx0, idx0, ptr0, cx);
+			cn_v8_div_sqrt_avx2(cn_v8_pack<false>(cx0, cx1, z, z), cn_v8_pack<true>(cx0, cx1, z, z), v8_div, v8_sqrt, v8_xor);
+			REPEAT_2(15, CN_STEP3_V8_AVX2, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm);
+			REPEAT_2(11, CN_STEP4, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0);
+		}
+
+		REPEAT_2(0, CN_FINALIZE);
+	}
+};
+
+template< >
+struct Cryptonight_hash_v8_avx2<3>
+{
+	static constexpr size_t N = 3;
+
+	template<xmrstak_algo ALGO, bool SOFT_AES, bool PREFETCH>
+	CN_TARGET_AVX2 static void hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
+	{
+		constexpr size_t MASK = cn_select_mask<ALGO>();
+		constexpr size_t ITERATIONS = cn_select_iter<ALGO>();
+		constexpr size_t MEM = cn_select_memory<ALGO>();
+
+		REPEAT_3(9, CN_INIT, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm);
+
+		const __m128i z = _mm_setzero_si128();
+		__m256i v8_div = cn_v8_pack<false>(division_result_xmm0, division_result_xmm1, division_result_xmm2, z);
+		__m256i v8_sqrt = cn_v8_pack<false>(sqrt_result0, sqrt_result1, sqrt_result2, z);
+		alignas(32) uint64_t v8_xor[4];
+
+		// Optim - 90% time boundary
+		for(size_t i = 0; i < ITERATIONS; i++)
+		{
+			REPEAT_3(8, CN_STEP1, monero_const, l0, ax0, bx0, idx0, ptr0, cx, bx1);
+			REPEAT_3(7, CN_STEP2, monero_const, l0, ax0, bx0, idx0, ptr0, cx);
+			cn_v8_div_sqrt_avx2(cn_v8_pack<false>(cx0, cx1, cx2, z), cn_v8_pack<true>(cx0, cx1, cx2, z), v8_div, v8_sqrt, v8_xor);
+			REPEAT_3(15, CN_STEP3_V8_AVX2, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm);
+			REPEAT_3(11, CN_STEP4, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0);
+		}
+
+		REPEAT_3(0, CN_FINALIZE);
+	}
+};
+
+template< >
+struct Cryptonight_hash_v8_avx2<4>
+{
+	static constexpr size_t N = 4;
+
+	template<xmrstak_algo ALGO, bool SOFT_AES, bool PREFETCH>
+	CN_TARGET_AVX2 static void hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
+	{
+		constexpr size_t MASK = cn_select_mask<ALGO>();
+		constexpr size_t ITERATIONS = cn_select_iter<ALGO>();
+		constexpr size_t MEM = cn_select_memory<ALGO>();
+
+		REPEAT_4(9, CN_INIT, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm);
+
+		__m256i v8_div = cn_v8_pack<false>(division_result_xmm0, division_result_xmm1, division_result_xmm2, division_result_xmm3);
+		__m256i v8_sqrt = cn_v8_pack<false>(sqrt_result0, sqrt_result1, sqrt_result2, sqrt_result3);
+		alignas(32) uint64_t v8_xor[4];
+
+		// Optim - 90% time boundary
+		for(size_t i = 0; i < ITERATIONS; i++)
+		{
+			REPEAT_4(8, CN_STEP1, monero_const, l0, ax0, bx0, idx0, ptr0, cx, bx1);
+			REPEAT_4(7, CN_STEP2, monero_const, l0, ax0, bx0, idx0, ptr0, cx);
+			cn_v8_div_sqrt_avx2(cn_v8_pack<false>(cx0, cx1, cx2, cx3), cn_v8_pack<true>(cx0, cx1, cx2, cx3), v8_div, v8_sqrt, v8_xor);
+			REPEAT_4(15, CN_STEP3_V8_AVX2, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm);
+			REPEAT_4(11, CN_STEP4, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0);
+		}
+
+		REPEAT_4(0, CN_FINALIZE);
+	}
+};
+
+template< >
+struct Cryptonight_hash_v8_avx2<5>
+{
+	static constexpr size_t N = 5;
+
+	template<xmrstak_algo ALGO, bool SOFT_AES, bool PREFETCH>
+	CN_TARGET_AVX2 static void hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
+	{
+		constexpr size_t MASK = cn_select_mask<ALGO>();
+		constexpr size_t ITERATIONS = cn_select_iter<ALGO>();
+		constexpr size_t MEM = cn_select_memory<ALGO>();
+
+		REPEAT_5(9, CN_INIT, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm);
+
+		// lanes 0 to 3 in the first, lane 4 in the second register
+		const __m128i z = _mm_setzero_si128();
+		__m256i v8_div[2] = {
+			cn_v8_pack<false>(division_result_xmm0, division_result_xmm1, division_result_xmm2, division_result_xmm3),
+			cn_v8_pack<false>(division_result_xmm4, z, z, z)
+		};
+		__m256i v8_sqrt[2] = {
+			cn_v8_pack<false>(sqrt_result0, sqrt_result1, sqrt_result2, sqrt_result3),
+			cn_v8_pack<false>(sqrt_result4, z, z, z)
+		};
+		alignas(32) uint64_t v8_xor[8];
+
+		// Optim - 90% time boundary
+		for(size_t i = 0; i < ITERATIONS; i++)
+		{
+			REPEAT_5(8, CN_STEP1, monero_const, l0, ax0, bx0, idx0, ptr0, cx, bx1);
+			REPEAT_5(7, CN_STEP2, monero_const, l0, ax0, bx0, idx0, ptr0, cx);
+			cn_v8_div_sqrt_avx2(cn_v8_pack<false>(cx0, cx1, cx2, cx3), cn_v8_pack<true>(cx0, cx1, cx2, cx3), v8_div[0], v8_sqrt[0], v8_xor);
+			cn_v8_div_sqrt_avx2(cn_v8_pack<false>(cx4, z, z, z), cn_v8_pack<true>(cx4, z, z, z), v8_div[1], v8_sqrt[1], v8_xor + 4);
+			REPEAT_5(15, CN_STEP3_V8_AVX2, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm);
+			REPEAT_5(11, CN_STEP4, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0);
+		}
+
+		REPEAT_5(0, CN_FINALIZE);
+	}
+};
+
+#ifdef __GNUC__
+#	define CN_TARGET_VAES __attribute__((target("avx2,vaes")))
+#	define CN_TARGET_VAES512 __attribute__((target("avx512f,vaes")))
+#else
+#	define CN_TARGET_VAES
+#	define CN_TARGET_VAES512
+#endif
+
+/** CN_STEP1 without the AES round, the rounds of all lanes are done together with VAES */
+#define CN_STEP1_VAES_LOAD(n, l0, idx0, ptr0, cx) \
+	__m128i cx; \
+	ptr0 = (__m128i *)&l0[idx0 & MASK]; \
+	cx = _mm_load_si128(ptr0)
+
+//! one AES round of two lanes in a ymm register
+CN_TARGET_VAES inline void cn_vaes_round2(__m128i& c0, __m128i& c1, __m128i k0, __m128i k1)
+{
+	const __m256i k = _mm256_inserti128_si256(_mm256_castsi128_si256(k0), k1, 1);
+	__m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(c0), c1, 1);
+	c = _mm256_aesenc_epi128(c, k);
+	c0 = _mm256_castsi256_si128(c);
+	c1 = _mm256_extracti128_si256(c, 1);
+}
+
+//! one AES round of four lanes in a zmm register
+CN_TARGET_VAES512 inline void cn_vaes_round4(__m128i& c0, __m128i& c1, __m128i& c2, __m128i& c3, __m128i k0, __m128i k1, __m128i k2, __m128i k3)
+{
+	__m512i k = _mm512_castsi128_si512(k0);
+	k = _mm512_inserti32x4(k, k1, 1);
+	k = _mm512_inserti32x4(k, k2, 2);
+	k = _mm512_inserti32x4(k, k3, 3);
+	__m512i c = _mm512_castsi128_si512(c0);
+	c = _mm512_inserti32x4(c, c1, 1);
+	c = _mm512_inserti32x4(c, c2, 2);
+	c = _mm512_inserti32x4(c, c3, 3);
+	c = _mm512_aesenc_epi128(c, k);
+	c0 = _mm512_castsi512_si128(c);
+	c1 = _mm512_extracti32x4_epi32(c, 1);
+	c2 = _mm512_extracti32x4_epi32(c, 2);
+	c3 = _mm512_extracti32x4_epi32(c, 3);
+}
+
+/** N-way hash with the AES rounds of the main loop of all lanes in one VAES instruction
+ *
+ * Hardware AES only, cryptonight_bittube2 is not supported because its round
+ * is built from four dependent AES rounds. ZMM selects one zmm register for
+ * four lanes (needs AVX-512F), otherwise two lanes share a ymm register.
+ */
+template<size_t N, bool ZMM = false>
+struct Cryptonight_hash_vaes;
+
+template< >
+struct Cryptonight_hash_vaes<2, false>
+{
+	static constexpr size_t N = 2;
+
+	template<xmrstak_algo ALGO, bool PREFETCH>
+	CN_TARGET_VAES static void hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
+	{
+		constexpr bool SOFT_AES = false;
+		constexpr size_t MASK = cn_select_mask<ALGO>();
+		constexpr size_t ITERATIONS = cn_select_iter<ALGO>();
+		constexpr size_t MEM = cn_select_memory<ALGO>();
+
+		CN_INIT_SINGLE;
+		REPEAT_2(9, CN_INIT, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm);
+
+		// Optim - 90% time boundary
+		for(size_t i = 0; i < ITERATIONS; i++)
+		{
+			REPEAT_2(4, CN_STEP1_VAES_LOAD, l0, idx0, ptr0, cx);
+			cn_vaes_round2(cx0, cx1, ax00, ax01);
+			REPEAT_2(5, CN_MONERO_V8_SHUFFLE_0, l0, idx0, ax0, bx0, bx1);
+			REPEAT_2(7, CN_STEP2, monero_const, l0, ax0, bx0, idx0, ptr0, cx);
+			REPEAT_2(15, CN_STEP3, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm);
+			REPEAT_2(11, CN_STEP4, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0);
+			REPEAT_2(6, CN_STEP5, monero_const, l0, ax0, bx0, idx0, ptr0);
+		}
+
+		REPEAT_2(0, CN_FINALIZE);
+	}
+};
+
+template< >
+struct Cryptonight_hash_vaes<4, false>
+{
+	static constexpr size_t N = 4;
+
+	template<xmrstak_algo ALGO, bool PREFETCH>
+	CN_TARGET_VAES static void hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
+	{
+		constexpr bool SOFT_AES = false;
+		constexpr size_t MASK = cn_select_mask<ALGO>();
+		constexpr size_t ITERATIONS = cn_select_iter<ALGO>();
+		constexpr size_t MEM = cn_select_memory<ALGO>();
+
+		CN_INIT_SINGLE;
+		REPEAT_4(9, CN_INIT, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm);
+
+		// Optim - 90% time boundary
+		for(size_t i = 0; i < ITERATIONS; i++)
+		{
+			REPEAT_4(4, CN_STEP1_VAES_LOAD, l0, idx0, ptr0, cx);
+			cn_vaes_round2(cx0, cx1, ax00, ax01);
+			cn_vaes_round2(cx2, cx3, ax02, ax03);
+			REPEAT_4(5, CN_MONERO_V8_SHUFFLE_0, l0, idx0, ax0, bx0, bx1);
+			REPEAT_4(7, CN_STEP2, monero_const, l0, ax0, bx0, idx0, ptr0, cx);
+			REPEAT_4(15, CN_STEP3, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm);
+			REPEAT_4(11, CN_STEP4, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0);
+			REPEAT_4(6, CN_STEP5, monero_const, l0, ax0, bx0, idx0, ptr0);
+		}
+
+		REPEAT_4(0, CN_FINALIZE);
+	}
+};
+
+template< >
+struct Cryptonight_hash_vaes<4, true>
+{
+	static constexpr size_t N = 4;
+
+	template<xmrstak_algo ALGO, bool PREFETCH>
+	CN_TARGET_VAES512 static void hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
+	{
+		constexpr bool SOFT_AES = false;
+		constexpr size_t MASK = cn_select_mask<ALGO>();
+		constexpr size_t ITERATIONS = cn_select_iter<ALGO>();
+		constexpr size_t MEM = cn_select_memory<ALGO>();
+
+		CN_INIT_SINGLE;
+		REPEAT_4(9, CN_INIT, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm);
+
+		// Optim - 90% time boundary
+		for(size_t i = 0; i < ITERATIONS; i++)
+		{
+			REPEAT_4(4, CN_STEP1_VAES_LOAD, l0, idx0, ptr0, cx);
+			cn_vaes_round4(cx0, cx1, cx2, cx3, ax00, ax01, ax02, ax03);
+			REPEAT_4(5, CN_MONERO_V8_SHUFFLE_0, l0, idx0, ax0, bx0, bx1);
+			REPEAT_4(7, CN_STEP2, monero_const, l0, ax0, bx0, idx0, ptr0, cx);
+			REPEAT_4(15, CN_STEP3, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm);
+			REPEAT_4(11, CN_STEP4, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0);
+			REPEAT_4(6, CN_STEP5, monero_const, l0, ax0, bx0, idx0, ptr0);
+		}
+
+		REPEAT_4(0, CN_FINALIZE);
+	}
+};
+
+/** main loop of a single hash which interleaves the slices of two scratchpad streams
+ *
+ * @param next stream of the following hash (explode), spread over the main loop
+ * @param prev stream of the previous hash (implode), spread over the main loop
+ */
+template<xmrstak_algo ALGO, bool SOFT_AES, bool PREFETCH, typename STREAM>
+void cn_pipelined_main_loop(const void* input, size_t len, cryptonight_ctx** ctx, STREAM& next, STREAM& prev)
+{
+	// the hash macros are written for the lanes of a N-way hash, this is a single lane
+	constexpr size_t N = 1;
+	constexpr size_t MASK = cn_select_mask<ALGO>();
+	constexpr size_t ITERATIONS = cn_select_iter<ALGO>();
+	// main loop iterations between two slices of scratchpad work
+	constexpr size_t GROUP = 16;
+	static_assert(ITERATIONS % GROUP == 0, "iterations must be a multiple of the slice group");
+
+	const size_t next_total = next.total;
+	const size_t prev_total = prev.total;
+
+	REPEAT_1(9, CN_INIT_STATE, monero_const, l0, ax0, bx0, idx0, ptr0, bx1, sqrt_result, division_result_xmm);
+
+	// Optim - 90% time boundary
+	for(size_t i = 0; i < ITERATIONS; i += GROUP)
+	{
+		for(size_t j = 0; j < GROUP; j++)
+		{
+			REPEAT_1(8, CN_STEP1, monero_const, l0, ax0, bx0, idx0, ptr0, cx, bx1);
+			REPEAT_1(7, CN_STEP2, monero_const, l0, ax0, bx0, idx0, ptr0, cx);
+			REPEAT_1(15, CN_STEP3, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0, cx, bx1, sqrt_result, division_result_xmm);
+			REPEAT_1(11, CN_STEP4, monero_const, l0, ax0, bx0, idx0, ptr0, lo, cl, ch, al0, ah0);
+			REPEAT_1(6, CN_STEP5, monero_const, l0, ax0, bx0, idx0, ptr0);
+		}
+
+		// spread the scratchpad work evenly over the main loop
+		next.run_to(next_total * (i + GROUP) / ITERATIONS);
+		prev.run_to(prev_total * (i + GROUP) / ITERATIONS);
+	}
+}
+
+/** phase pipelined N-way hash (experimental)
+ *
+ * The hashes are not run in lockstep like Cryptonight_hash<N>. The main loop of
+ * hash n runs alone while the scratchpad of hash n+1 is exploded and the
+ * scratchpad of hash n-1 is imploded in small slices between groups of main loop
+ * iterations. The independent AES work fills the pipeline bubbles of the latency
+ * bound main loop instead of running in separate phases.
+ *
+ * Only the first explode and the last implode are not overlapped.
+ */
+template<size_t N>
+struct Cryptonight_hash_pipelined
+{
+	template<xmrstak_algo ALGO, bool SOFT_AES, bool PREFETCH>
+	static void hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
+	{
+		constexpr size_t MEM = cn_select_memory<ALGO>();
+
+		CN_INIT_SINGLE;
+
+		cn_keccak_init<N>(input, len, ctx);
+
+		cn_scratchpad_stream<MEM, SOFT_AES, PREFETCH, ALGO> next, prev;
+
+		/* Optim - 99% time boundary */
+		next.begin_explode(ctx[0]);
+		next.finish();
+
+		for(size_t n = 0; n < N; n++)
+		{
+			if(n + 1 < N)
+				next.begin_explode(ctx[n + 1]);
+			if(n > 0)
+				prev.begin_implode(ctx[n - 1]);
+
+			cn_pipelined_main_loop<ALGO, SOFT_AES, PREFETCH>((const uint8_t*)input + len * n, len, ctx + n, next, prev);
+
+			next.finish();
+			if(n > 0)
+			{
+				prev.finish();
+				cn_keccak_finalize<1>((char*)output + 32 * (n - 1), ctx + n - 1);
+			}
+		}
+
+		/* Optim - 90% time boundary */
+		prev.begin_implode(ctx[N - 1]);
+		prev.finish();
+		/* Optim - 99% time boundary */
+		cn_keccak_finalize<1>((char*)output + 32 * (N - 1), ctx + N - 1);
+	}
+};
+
+/** N-way hash with a main loop generated at runtime, see cn_jit.cpp
+ *
+ * Hardware AES only, the algorithm must be supported by cn_jit_supported().
+ */
+template<size_t N>
+struct Cryptonight_hash_jit
+{
+	template<xmrstak_algo ALGO, bool PREFETCH, cn_jit_schedule SCHEDULE = cn_jit_interleaved>
+	static void hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
+	{
+		constexpr size_t MEM = cn_select_memory<ALGO>();
+		static const cn_jit_fun main_loop = cn_jit_get(ALGO, N, PREFETCH, SCHEDULE);
+
+		CN_INIT_SINGLE;
+		cn_keccak_init<N>(input, len, ctx);
+
+		cn_jit_lane lanes[N];
+		for(size_t n = 0; n < N; n++)
+		{
+			/* Optim - 99% time boundary */
+			cn_explode_scratchpad<MEM, false, PREFETCH, ALGO>((__m128i*)ctx[n]->hash_state, (__m128i*)ctx[n]->long_state);
+
+			const uint64_t* h0 = (const uint64_t*)ctx[n]->hash_state;
+			lanes[n].a[0] = h0[0] ^ h0[4];
+			lanes[n].a[1] = h0[1] ^ h0[5];
+			lanes[n].b[0] = h0[2] ^ h0[6];
+			lanes[n].b[1] = h0[3] ^ h0[7];
+			lanes[n].l = ctx[n]->long_state;
+			lanes[n].k = 0;
+			if(ALGO == cryptonight_monero || ALGO == cryptonight_aeon || ALGO == cryptonight_ipbc || ALGO == cryptonight_stellite || ALGO == cryptonight_masari)
+				lanes[n].k = *reinterpret_cast<const uint64_t*>(reinterpret_cast<const uint8_t*>(input) + len * n + 35) ^ h0[24];
+		}
+
+		main_loop(lanes);
+
+		/* Optim - 90% time boundary */
+		for(size_t n = 0; n < N; n++)
+			cn_implode_scratchpad<MEM, false, PREFETCH, ALGO>((__m128i*)ctx[n]->long_state, (__m128i*)ctx[n]->hash_state);
+		/* Optim - 99% time boundary */
+		cn_keccak_finalize<N>(output, ctx);
+	}
+};
+
 extern "C" void cryptonight_v8_mainloop_ivybridge_asm(cryptonight_ctx* ctx0);
 extern "C" void cryptonight_v8_mainloop_ryzen_asm(cryptonight_ctx* ctx0);
 extern "C" void cryptonight_v8_double_mainloop_sandybridge_asm(cryptonight_ctx* ctx0, cryptonight_ctx* ctx1);
@@ -956,7 +1702,7 @@ struct Cryptonight_hash_asm<1, asm_version>
 	{
 		constexpr size_t MEM = cn_select_memory<ALGO>();
 
-		keccak((const uint8_t *)input, len, ctx[0]->hash_state, 200);
+		cn_keccak_init<1>(input, len, ctx);
 		cn_explode_scratchpad<MEM, false, false, ALGO>((__m128i*)ctx[0]->hash_state, (__m128i*)ctx[0]->long_state);
 
 		if(asm_version == 0)
@@ -965,8 +1711,7 @@ struct Cryptonight_hash_asm<1, asm_version>
 			cryptonight_v8_mainloop_ryzen_asm(ctx[0]);
 
 		cn_implode_scratchpad<MEM, false, false, ALGO>((__m128i*)ctx[0]->long_state, (__m128i*)ctx[0]->hash_state);
-		keccakf((uint64_t*)ctx[0]->hash_state, 24);
-		extra_hashes[ctx[0]->hash_state[0] & 3](ctx[0]->hash_state, 200, (char*)output);
+		cn_keccak_finalize<1>(output, ctx);
 	}
 };
 
@@ -981,9 +1726,9 @@ struct Cryptonight_hash_asm<2, 0>
 	{
 		constexpr size_t MEM = cn_select_memory<ALGO>();
 
+		cn_keccak_init<N>(input, len, ctx);
 		for(size_t i = 0; i < N; ++i)
 		{
-			keccak((const uint8_t *)input + len * i, len, ctx[i]->hash_state, 200);
 			/* Optim - 99% time boundary */
 			cn_explode_scratchpad<MEM, false, false, ALGO>((__m128i*)ctx[i]->hash_state, (__m128i*)ctx[i]->long_state);
 		}
@@ -994,9 +1739,8 @@ struct Cryptonight_hash_asm<2, 0>
 		{
 			/* Optim - 90% time boundary */
 			cn_implode_scratchpad<MEM, false, false, ALGO>((__m128i*)ctx[i]->long_state, (__m128i*)ctx[i]->hash_state);
-			/* Optim - 99% time boundary */
-			keccakf((uint64_t*)ctx[i]->hash_state, 24);
-			extra_hashes[ctx[i]->hash_state[0] & 3](ctx[i]->hash_state, 200, (char*)output + 32 * i);
 		}
+		/* Optim - 99% time boundary */
+		cn_keccak_finalize<N>(output, ctx);
 	}
 };
@@ -56,6 +56,18 @@ extern "C"
 #include <string.h>
 #endif // _WIN32
 
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
+#include <linux/magic.h>
+#include <string>
+#endif // __linux__
+
 void do_blake_hash(const void* input, uint32_t len, char* output) {
 	blake256_hash((uint8_t*)output, (const uint8_t*)input, len);
 }
@@ -201,6 +213,112 @@ size_t cryptonight_init(size_t use_fast_mem, size_t use_mlock, alloc_msg* msg)
 #endif // _WIN32
 }
 
+#if defined(__linux__)
+static constexpr const char* hugepage_file_prefix = "xmr-stak-";
+
+// hugetlbfs only accepts sizes which are a multiple of the huge page size
+static size_t hugepage_file_size(int fd, size_t size)
+{
+	struct statfs fs;
+	if(fstatfs(fd, &fs) != 0 || fs.f_bsize == 0)
+		return size;
+	return (size + fs.f_bsize - 1) / fs.f_bsize * fs.f_bsize;
+}
+
+/** map a scratchpad backed by a file in a hugetlbfs mount
+ *
+ * The files are named <dir>/xmr-stak-<numa node>-<index> and are kept after
+ * the miner exits, a restarted miner maps the same huge pages again. A file
+ * is locked while it is mapped, so it is never shared between two threads.
+ *
+ * @param fd out: file descriptor of the mapped file
+ * @return nullptr if the mapping failed
+ */
+static uint8_t* hugepage_file_alloc(const char* dir, size_t hashMemSize, int& fd, alloc_msg* msg)
+{
+	// a file on another file system would be ordinary memory and a scratchpad on disk
+	struct statfs fs;
+	if(statfs(dir, &fs) != 0 || fs.f_type != HUGETLBFS_MAGIC)
+	{
+		msg->warning = "'hugepage_dir' in 'config.txt' is not a hugetlbfs mount";
+		return nullptr;
+	}
+
+	unsigned int cpu = 0, node = 0;
+	// the memory policy is already bound, name the file after the node we are running on
+	if(syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+		node = 0;
+
+	for(size_t idx = 0; idx < 1024; idx++)
+	{
+		std::string path = std::string(dir) + "/" + hugepage_file_prefix + std::to_string(node) + "-" + std::to_string(idx);
+		fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+		if(fd < 0)
+		{
+			msg->warning = "opening the hugetlbfs file failed, check attribute 'hugepage_dir' in 'config.txt'";
+			return nullptr;
+		}
+
+		// used by another thread or miner
+		if(flock(fd, LOCK_EX | LOCK_NB) != 0)
+		{
+			close(fd);
+			continue;
+		}
+
+		size_t len = hugepage_file_size(fd, hashMemSize);
+		struct stat st;
+		if(fstat(fd, &st) != 0 || (size_t(st.st_size) < len && ftruncate(fd, len) != 0))
+		{
+			close(fd);
+			msg->warning = "resizing the hugetlbfs file failed";
+			return nullptr;
+		}
+
+		void* ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+		if(ptr == MAP_FAILED)
+		{
+			close(fd);
+			msg->warning = "mmap of the hugetlbfs file failed, not enough huge pages?";
+			return nullptr;
+		}
+		return (uint8_t*)ptr;
+	}
+
+	msg->warning = "no unused hugetlbfs file found";
+	return nullptr;
+}
+#endif // __linux__
+
+size_t cryptonight_release_hugepage_files(const char* dir)
+{
+	size_t released = 0;
+#if defined(__linux__)
+	DIR* d = opendir(dir);
+	if(d == nullptr)
+		return 0;
+
+	struct dirent* ent;
+	while((ent = readdir(d)) != nullptr)
+	{
+		if(strncmp(ent->d_name, hugepage_file_prefix, strlen(hugepage_file_prefix)) != 0)
+			continue;
+
+		std::string path = std::string(dir) + "/" + ent->d_name;
+		int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+		if(fd < 0)
+			continue;
+
+		// keep files which are mapped by a running miner
+		if(flock(fd, LOCK_EX | LOCK_NB) == 0 && unlink(path.c_str()) == 0)
+			released++;
+		close(fd);
+	}
+	closedir(d);
+#endif // __linux__
+	return released;
+}
+
 cryptonight_ctx* cryptonight_alloc_ctx(size_t use_fast_mem, size_t use_mlock, alloc_msg* msg)
 {
 	size_t hashMemSize = std::max(
@@ -256,8 +374,33 @@ cryptonight_ctx* cryptonight_alloc_ctx(size_t use_fast_mem, size_t use_mlock, al
 	ptr->long_state = (uint8_t*)mmap(NULL, hashMemSize, PROT_READ | PROT_WRITE,
 		MAP_PRIVATE | MAP_ANON, -1, 0);
 #else
-	ptr->long_state = (uint8_t*)mmap(NULL, hashMemSize, PROT_READ | PROT_WRITE,
-		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+	ptr->long_state = (uint8_t*)MAP_FAILED;
+	ptr->ctx_info[2] = 0;
+
+#	if defined(__linux__)
+	const char* hugepage_dir = ::jconf::inst()->GetHugepageDir();
+	if(hugepage_dir[0] != '\0')
+	{
+		int fd;
+		uint8_t* mem = hugepage_file_alloc(hugepage_dir, hashMemSize, fd, msg);
+		if(mem != nullptr)
+		{
+			ptr->long_state = mem;
+			ptr->ctx_info[2] = 1;
+			memcpy(ptr->ctx_info + 4, &fd, sizeof(fd));
+		}
+		else
+		{
+			// not an error yet, only if the anonymous large pages fail too
+			printer::inst()->print_msg(L1, "Hugetlbfs file not used: %s, using anonymous large pages.", msg->warning);
+			msg->warning = nullptr;
+		}
+	}
+#	endif
+
+	if(ptr->long_state == MAP_FAILED)
+		ptr->long_state = (uint8_t*)mmap(NULL, hashMemSize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
 #endif
 
 	if (ptr->long_state == MAP_FAILED)
@@ -296,6 +439,17 @@ void cryptonight_free_ctx(cryptonight_ctx* ctx)
 #else
 		if(ctx->ctx_info[1] != 0)
 			munlock(ctx->long_state, hashMemSize);
+#	if defined(__linux__)
+		if(ctx->ctx_info[2] != 0)
+		{
+			// the file and its huge pages are kept for the next start
+			int fd;
+			memcpy(&fd, ctx->ctx_info + 4, sizeof(fd));
+			munmap(ctx->long_state, hugepage_file_size(fd, hashMemSize));
+			close(fd);
+		}
+		else
+#	endif
 		munmap(ctx->long_state, hashMemSize);
 #endif // _WIN32
 	}
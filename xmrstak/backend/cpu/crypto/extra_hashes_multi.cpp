@@ -0,0 +1,779 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Final hashes of the cryptonight keccak state with SIMD instructions.
+ *
+ * The input is always the 200 byte keccak state, so the padding of the last
+ * blocks is a constant and no buffering is needed.
+ *
+ * - BLAKE-256 hashes 4 states in one pass, word i of state k is element k of
+ *   an SSE2 register.
+ * - Skein-512-256 hashes 4 states in one pass in AVX2 registers.
+ * - JH-256 keeps both 64 bit halves of a row of the bitsliced state in one
+ *   SSE2 register, AVX2 hashes 2 states in one pass.
+ * - Groestl-256 computes P and Q in parallel, row i of P is in the low and
+ *   row i of Q in the high half of register i. SubBytes is done with AES-NI.
+ *
+ * Every hash is bit identical to the scalar implementation in the c_*.c files.
+ */
+
+#include "extra_hashes_multi.hpp"
+
+#ifdef __GNUC__
+#include <x86intrin.h>
+#	define FINAL_HASH_TARGET(x) __attribute__((target(x)))
+#else
+#include <intrin.h>
+#	define FINAL_HASH_TARGET(x)
+#endif
+
+#include <cstring>
+
+extern "C"
+{
+	extern void (* const extra_hashes[4])(const void *, uint32_t, char *);
+	extern const unsigned char JH256_H0[128];
+	extern const unsigned char E8_bitslice_roundconstant[42][32];
+}
+
+namespace
+{
+
+constexpr size_t STATE_SIZE = 200;
+
+typedef void (*final_hash_fun)(const uint8_t* const* in, uint8_t* const* out, size_t n);
+
+template<size_t ALGO>
+void hash_scalar(const uint8_t* const* in, uint8_t* const* out, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+		extra_hashes[ALGO](in[i], STATE_SIZE, reinterpret_cast<char*>(out[i]));
+}
+
+inline uint32_t load_be32(const uint8_t* p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline uint64_t load_le64(const uint8_t* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/*
+ * BLAKE-256
+ *
+ * The last block contains the 8 remaining state bytes, the padding bit, the
+ * final 0x01 marker of BLAKE-256 and the message length of 1600 bit.
+ */
+
+const uint8_t blake_sigma[14][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15},
+	{14,10, 4, 8, 9,15,13, 6, 1,12, 0, 2,11, 7, 5, 3},
+	{11, 8,12, 0, 5, 2,15,13,10,14, 3, 6, 7, 1, 9, 4},
+	{ 7, 9, 3, 1,13,12,11,14, 2, 6, 5,10, 4, 0,15, 8},
+	{ 9, 0, 5, 7, 2, 4,10,15,14, 1,11,12, 6, 8, 3,13},
+	{ 2,12, 6,10, 0,11, 8, 3, 4,13, 7, 5,15,14, 1, 9},
+	{12, 5, 1,15,14,13, 4,10, 0, 7, 6, 3, 9, 2, 8,11},
+	{13,11, 7,14,12, 1, 3, 9, 5, 0,15, 4, 8, 6, 2,10},
+	{ 6,15,14, 9,11, 3, 0, 8,12, 2,13, 7, 1, 4,10, 5},
+	{10, 2, 8, 4, 7, 6, 1, 5,15,11, 9,14, 3,12,13, 0},
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15},
+	{14,10, 4, 8, 9,15,13, 6, 1,12, 0, 2,11, 7, 5, 3},
+	{11, 8,12, 0, 5, 2,15,13,10,14, 3, 6, 7, 1, 9, 4},
+	{ 7, 9, 3, 1,13,12,11,14, 2, 6, 5,10, 4, 0,15, 8}
+};
+
+const uint32_t blake_cst[16] = {
+	0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344,
+	0xA4093822, 0x299F31D0, 0x082EFA98, 0xEC4E6C89,
+	0x452821E6, 0x38D01377, 0xBE5466CF, 0x34E90C6C,
+	0xC0AC29B7, 0xC97C50DD, 0x3F84D5B5, 0xB5470917
+};
+
+const uint32_t blake_iv[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+#define BLAKE_ROTR(x, n) _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - (n)))
+
+#define BLAKE_G(r, a, b, c, d, e) \
+	v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), _mm_xor_si128(m[blake_sigma[r][e]], _mm_set1_epi32(blake_cst[blake_sigma[r][e + 1]]))); \
+	v[d] = BLAKE_ROTR(_mm_xor_si128(v[d], v[a]), 16); \
+	v[c] = _mm_add_epi32(v[c], v[d]); \
+	v[b] = BLAKE_ROTR(_mm_xor_si128(v[b], v[c]), 12); \
+	v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), _mm_xor_si128(m[blake_sigma[r][e + 1]], _mm_set1_epi32(blake_cst[blake_sigma[r][e]]))); \
+	v[d] = BLAKE_ROTR(_mm_xor_si128(v[d], v[a]), 8); \
+	v[c] = _mm_add_epi32(v[c], v[d]); \
+	v[b] = BLAKE_ROTR(_mm_xor_si128(v[b], v[c]), 7);
+
+inline void blake_compress_sse2(__m128i h[8], const __m128i m[16], uint32_t t0)
+{
+	__m128i v[16];
+	for(size_t i = 0; i < 8; i++)
+		v[i] = h[i];
+	for(size_t i = 0; i < 4; i++)
+		v[8 + i] = _mm_set1_epi32(blake_cst[i]);
+	v[12] = _mm_set1_epi32(blake_cst[4] ^ t0);
+	v[13] = _mm_set1_epi32(blake_cst[5] ^ t0);
+	v[14] = _mm_set1_epi32(blake_cst[6]);
+	v[15] = _mm_set1_epi32(blake_cst[7]);
+
+	for(size_t r = 0; r < 14; r++)
+	{
+		BLAKE_G(r, 0, 4,  8, 12,  0);
+		BLAKE_G(r, 1, 5,  9, 13,  2);
+		BLAKE_G(r, 2, 6, 10, 14,  4);
+		BLAKE_G(r, 3, 7, 11, 15,  6);
+		BLAKE_G(r, 3, 4,  9, 14, 14);
+		BLAKE_G(r, 2, 7,  8, 13, 12);
+		BLAKE_G(r, 0, 5, 10, 15,  8);
+		BLAKE_G(r, 1, 6, 11, 12, 10);
+	}
+
+	for(size_t i = 0; i < 8; i++)
+		h[i] = _mm_xor_si128(h[i], _mm_xor_si128(v[i], v[i + 8]));
+}
+
+#undef BLAKE_G
+#undef BLAKE_ROTR
+
+/** BLAKE-256 of up to 4 states */
+void blake_sse2_4(const uint8_t* const* in, uint8_t* const* out, size_t n)
+{
+	const uint8_t* p[4];
+	for(size_t k = 0; k < 4; k++)
+		p[k] = in[k < n ? k : 0];
+
+	__m128i h[8];
+	for(size_t i = 0; i < 8; i++)
+		h[i] = _mm_set1_epi32(blake_iv[i]);
+
+	__m128i m[16];
+	for(size_t b = 0; b < 3; b++)
+	{
+		for(size_t i = 0; i < 16; i++)
+		{
+			const size_t o = b * 64 + i * 4;
+			m[i] = _mm_set_epi32(load_be32(p[3] + o), load_be32(p[2] + o), load_be32(p[1] + o), load_be32(p[0] + o));
+		}
+		blake_compress_sse2(h, m, 512 * (b + 1));
+	}
+
+	m[0] = _mm_set_epi32(load_be32(p[3] + 192), load_be32(p[2] + 192), load_be32(p[1] + 192), load_be32(p[0] + 192));
+	m[1] = _mm_set_epi32(load_be32(p[3] + 196), load_be32(p[2] + 196), load_be32(p[1] + 196), load_be32(p[0] + 196));
+	m[2] = _mm_set1_epi32(0x80000000);
+	for(size_t i = 3; i < 16; i++)
+		m[i] = _mm_setzero_si128();
+	m[13] = _mm_set1_epi32(1);
+	m[15] = _mm_set1_epi32(STATE_SIZE * 8);
+	blake_compress_sse2(h, m, STATE_SIZE * 8);
+
+	alignas(16) uint32_t w[8][4];
+	for(size_t i = 0; i < 8; i++)
+		_mm_store_si128(reinterpret_cast<__m128i*>(w[i]), h[i]);
+	for(size_t k = 0; k < n; k++)
+	{
+		for(size_t i = 0; i < 8; i++)
+		{
+			out[k][i * 4 + 0] = uint8_t(w[i][k] >> 24);
+			out[k][i * 4 + 1] = uint8_t(w[i][k] >> 16);
+			out[k][i * 4 + 2] = uint8_t(w[i][k] >> 8);
+			out[k][i * 4 + 3] = uint8_t(w[i][k]);
+		}
+	}
+}
+
+void blake_sse2(const uint8_t* const* in, uint8_t* const* out, size_t n)
+{
+	// one lane of a vector pass is slower than the scalar hash
+	if(n == 1)
+	{
+		hash_scalar<0>(in, out, n);
+		return;
+	}
+	for(size_t i = 0; i < n; i += 4)
+		blake_sse2_4(in + i, out + i, n - i < 4 ? n - i : 4);
+}
+
+/*
+ * Groestl-256
+ *
+ * The message and the chaining value are transposed to rows. After the last
+ * block (8 state bytes, padding and the block count 4) only P is needed for
+ * the output transformation, the Q half of the registers is ignored.
+ */
+
+const uint8_t groestl_shift_p[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+const uint8_t groestl_shift_q[8] = {1, 3, 5, 7, 0, 2, 4, 6};
+
+struct groestl_consts
+{
+	// pshufb masks which undo the ShiftRows of aesenclast and do ShiftBytes of P (low half) and Q (high half)
+	alignas(16) uint8_t shuffle[8][16];
+	// AddRoundConstant without the round number for row 0, rows 1 to 6 and row 7
+	alignas(16) uint8_t rc_row0[16];
+	alignas(16) uint8_t rc_rows[16];
+	alignas(16) uint8_t rc_row7[16];
+	// the initial chaining value, one row in every 8 bytes
+	alignas(16) uint8_t iv[64];
+
+	groestl_consts()
+	{
+		for(size_t r = 0; r < 8; r++)
+		{
+			for(size_t k = 0; k < 16; k++)
+			{
+				// the byte which ShiftRows moves to k
+				const size_t col = k / 4, row = k % 4;
+				const size_t src = 4 * ((col + 4 - row) % 4) + row;
+				if(src < 8)
+					shuffle[r][k] = uint8_t((src + groestl_shift_p[r]) % 8);
+				else
+					shuffle[r][k] = uint8_t(8 + (src - 8 + groestl_shift_q[r]) % 8);
+			}
+		}
+
+		for(size_t c = 0; c < 8; c++)
+		{
+			rc_row0[c] = uint8_t(c << 4);
+			rc_row0[8 + c] = 0xff;
+			rc_rows[c] = 0;
+			rc_rows[8 + c] = 0xff;
+			rc_row7[c] = 0;
+			rc_row7[8 + c] = uint8_t(0xff ^ (c << 4));
+		}
+
+		memset(iv, 0, sizeof(iv));
+		// u32BIG(256) in the last word, byte 6 of column 7
+		iv[6 * 8 + 7] = 0x01;
+	}
+};
+
+const groestl_consts groestl_c;
+
+/** transpose a 8x8 byte matrix, in[i] and out[i] hold row 2i and 2i+1 */
+inline void groestl_transpose(const __m128i in[4], __m128i out[4])
+{
+	const __m128i t0 = _mm_unpacklo_epi8(in[0], _mm_srli_si128(in[0], 8));
+	const __m128i t1 = _mm_unpacklo_epi8(in[1], _mm_srli_si128(in[1], 8));
+	const __m128i t2 = _mm_unpacklo_epi8(in[2], _mm_srli_si128(in[2], 8));
+	const __m128i t3 = _mm_unpacklo_epi8(in[3], _mm_srli_si128(in[3], 8));
+	const __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+	const __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+	const __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+	const __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+	out[0] = _mm_unpacklo_epi32(u0, u2);
+	out[1] = _mm_unpackhi_epi32(u0, u2);
+	out[2] = _mm_unpacklo_epi32(u1, u3);
+	out[3] = _mm_unpackhi_epi32(u1, u3);
+}
+
+#define GROESTL_XTIME(x) _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(_mm_cmplt_epi8(x, zero), poly))
+
+/** 10 rounds of P (low halves) and Q (high halves) */
+FINAL_HASH_TARGET("aes,ssse3") inline void groestl_pq(__m128i x[8])
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i poly = _mm_set1_epi8(0x1b);
+	const __m128i lo = _mm_set_epi64x(0, -1);
+	const __m128i rc0 = _mm_load_si128(reinterpret_cast<const __m128i*>(groestl_c.rc_row0));
+	const __m128i rcq = _mm_load_si128(reinterpret_cast<const __m128i*>(groestl_c.rc_rows));
+	const __m128i rc7 = _mm_load_si128(reinterpret_cast<const __m128i*>(groestl_c.rc_row7));
+
+	for(int r = 0; r < 10; r++)
+	{
+		// AddRoundConstant
+		const __m128i round = _mm_set1_epi8(char(r));
+		x[0] = _mm_xor_si128(x[0], _mm_xor_si128(rc0, _mm_and_si128(round, lo)));
+		for(size_t i = 1; i < 7; i++)
+			x[i] = _mm_xor_si128(x[i], rcq);
+		x[7] = _mm_xor_si128(x[7], _mm_xor_si128(rc7, _mm_andnot_si128(lo, round)));
+
+		// ShiftBytes and SubBytes
+		for(size_t i = 0; i < 8; i++)
+			x[i] = _mm_aesenclast_si128(_mm_shuffle_epi8(x[i], _mm_load_si128(reinterpret_cast<const __m128i*>(groestl_c.shuffle[i]))), zero);
+
+		// MixBytes with the circulant matrix (02, 02, 03, 04, 05, 03, 05, 07)
+		__m128i x2[8], x4[8];
+		for(size_t i = 0; i < 8; i++)
+		{
+			x2[i] = GROESTL_XTIME(x[i]);
+			x4[i] = GROESTL_XTIME(x2[i]);
+		}
+		__m128i y[8];
+		for(size_t i = 0; i < 8; i++)
+		{
+			const size_t i1 = (i + 1) & 7, i2 = (i + 2) & 7, i3 = (i + 3) & 7, i4 = (i + 4) & 7;
+			const size_t i5 = (i + 5) & 7, i6 = (i + 6) & 7, i7 = (i + 7) & 7;
+			__m128i t = _mm_xor_si128(_mm_xor_si128(x2[i], x2[i1]), _mm_xor_si128(x2[i2], x2[i5]));
+			t = _mm_xor_si128(t, _mm_xor_si128(x2[i7], x4[i3]));
+			t = _mm_xor_si128(t, _mm_xor_si128(x4[i4], x4[i6]));
+			t = _mm_xor_si128(t, _mm_xor_si128(x4[i7], x[i2]));
+			t = _mm_xor_si128(t, _mm_xor_si128(x[i4], x[i5]));
+			y[i] = _mm_xor_si128(t, _mm_xor_si128(x[i6], x[i7]));
+		}
+		for(size_t i = 0; i < 8; i++)
+			x[i] = y[i];
+	}
+}
+
+#undef GROESTL_XTIME
+
+/** h = P(h ^ m) ^ Q(m) ^ h, h and m hold two rows per register */
+FINAL_HASH_TARGET("aes,ssse3") inline void groestl_compress(__m128i h[4], const __m128i m[4])
+{
+	__m128i x[8];
+	for(size_t i = 0; i < 4; i++)
+	{
+		const __m128i p = _mm_xor_si128(h[i], m[i]);
+		x[2 * i] = _mm_unpacklo_epi64(p, m[i]);
+		x[2 * i + 1] = _mm_unpackhi_epi64(p, m[i]);
+	}
+	groestl_pq(x);
+	for(size_t i = 0; i < 4; i++)
+	{
+		const __m128i a = _mm_xor_si128(x[2 * i], _mm_srli_si128(x[2 * i], 8));
+		const __m128i b = _mm_xor_si128(x[2 * i + 1], _mm_srli_si128(x[2 * i + 1], 8));
+		h[i] = _mm_xor_si128(h[i], _mm_unpacklo_epi64(a, b));
+	}
+}
+
+FINAL_HASH_TARGET("aes,ssse3") void groestl_aesni(const uint8_t* const* in, uint8_t* const* out, size_t n)
+{
+	for(size_t k = 0; k < n; k++)
+	{
+		__m128i h[4], cols[4], m[4];
+		for(size_t i = 0; i < 4; i++)
+			h[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(groestl_c.iv) + i);
+
+		for(size_t b = 0; b < 3; b++)
+		{
+			for(size_t i = 0; i < 4; i++)
+				cols[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[k] + b * 64) + i);
+			groestl_transpose(cols, m);
+			groestl_compress(h, m);
+		}
+
+		alignas(16) uint8_t last[64] = {0};
+		memcpy(last, in[k] + 192, 8);
+		last[8] = 0x80;
+		last[63] = 4;
+		for(size_t i = 0; i < 4; i++)
+			cols[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(last) + i);
+		groestl_transpose(cols, m);
+		groestl_compress(h, m);
+
+		// output transformation P(h) ^ h
+		__m128i x[8];
+		for(size_t i = 0; i < 4; i++)
+		{
+			x[2 * i] = h[i];
+			x[2 * i + 1] = _mm_srli_si128(h[i], 8);
+		}
+		groestl_pq(x);
+		for(size_t i = 0; i < 4; i++)
+			h[i] = _mm_xor_si128(h[i], _mm_unpacklo_epi64(x[2 * i], x[2 * i + 1]));
+
+		groestl_transpose(h, cols);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out[k]), cols[2]);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out[k] + 16), cols[3]);
+	}
+}
+
+/*
+ * JH-256
+ *
+ * Register i holds row i of the bitsliced state (x[i][0] and x[i][1] of
+ * c_jh.c) of one state per 128 bit lane. The 200 byte state is followed by
+ * one padding block with the 8 remaining bytes and one length block.
+ */
+
+#define JH_SS(XOR, AND, ANDNOT, OR, ones, m0, m1, m2, m3, m4, m5, m6, m7, cc0, cc1) \
+	m3 = XOR(m3, ones); \
+	m7 = XOR(m7, ones); \
+	m0 = XOR(m0, ANDNOT(m2, cc0)); \
+	m4 = XOR(m4, ANDNOT(m6, cc1)); \
+	t0 = XOR(cc0, AND(m0, m1)); \
+	t1 = XOR(cc1, AND(m4, m5)); \
+	m0 = XOR(m0, AND(m2, m3)); \
+	m4 = XOR(m4, AND(m6, m7)); \
+	m3 = XOR(m3, ANDNOT(m1, m2)); \
+	m7 = XOR(m7, ANDNOT(m5, m6)); \
+	m1 = XOR(m1, AND(m0, m2)); \
+	m5 = XOR(m5, AND(m4, m6)); \
+	m2 = XOR(m2, ANDNOT(m3, m0)); \
+	m6 = XOR(m6, ANDNOT(m7, m4)); \
+	m0 = XOR(m0, OR(m1, m3)); \
+	m4 = XOR(m4, OR(m5, m7)); \
+	m3 = XOR(m3, AND(m1, m2)); \
+	m7 = XOR(m7, AND(m5, m6)); \
+	m1 = XOR(m1, AND(t0, m0)); \
+	m5 = XOR(m5, AND(t1, m4)); \
+	m2 = XOR(m2, t0); \
+	m6 = XOR(m6, t1);
+
+#define JH_L(XOR, m0, m1, m2, m3, m4, m5, m6, m7) \
+	m4 = XOR(m4, m1); \
+	m5 = XOR(m5, m2); \
+	m6 = XOR(m6, XOR(m0, m3)); \
+	m7 = XOR(m7, m0); \
+	m0 = XOR(m0, m5); \
+	m1 = XOR(m1, m6); \
+	m2 = XOR(m2, XOR(m4, m7)); \
+	m3 = XOR(m3, m4);
+
+/** Sbox and MDS layer of round r, the swapping layer SWAP_ODD is applied to the odd rows */
+#define JH_ROUND(V, XOR, AND, ANDNOT, OR, LOAD_RC, SWAP_ODD, x, r) \
+	{ \
+		const V cc0 = LOAD_RC(E8_bitslice_roundconstant[r]); \
+		const V cc1 = LOAD_RC(E8_bitslice_roundconstant[r] + 16); \
+		V t0, t1; \
+		JH_SS(XOR, AND, ANDNOT, OR, ones, x[0], x[2], x[4], x[6], x[1], x[3], x[5], x[7], cc0, cc1) \
+		JH_L(XOR, x[0], x[2], x[4], x[6], x[1], x[3], x[5], x[7]) \
+		for(size_t i = 1; i < 8; i += 2) \
+			x[i] = SWAP_ODD; \
+	}
+
+/** the bijective function E8
+ *
+ * SWAP(x, n, m) swaps the bit groups of size n in the 64 bit words of x, m
+ * masks the lower groups. SWAP32 swaps the 32 bit halves of the 64 bit words
+ * and SWAP_HALF swaps the 64 bit words of each 128 bit lane.
+ */
+#define JH_E8(V, XOR, AND, ANDNOT, OR, SET1, SWAP, SWAP32, SWAP_HALF, LOAD_RC, x) \
+	{ \
+		const V ones = SET1(-1); \
+		const V m1 = SET1(0x5555555555555555ull); \
+		const V m2 = SET1(0x3333333333333333ull); \
+		const V m4 = SET1(0x0f0f0f0f0f0f0f0full); \
+		const V m8 = SET1(0x00ff00ff00ff00ffull); \
+		const V m16 = SET1(0x0000ffff0000ffffull); \
+		for(size_t r = 0; r < 42; r += 7) \
+		{ \
+			JH_ROUND(V, XOR, AND, ANDNOT, OR, LOAD_RC, SWAP(x[i], 1, m1), x, r + 0) \
+			JH_ROUND(V, XOR, AND, ANDNOT, OR, LOAD_RC, SWAP(x[i], 2, m2), x, r + 1) \
+			JH_ROUND(V, XOR, AND, ANDNOT, OR, LOAD_RC, SWAP(x[i], 4, m4), x, r + 2) \
+			JH_ROUND(V, XOR, AND, ANDNOT, OR, LOAD_RC, SWAP(x[i], 8, m8), x, r + 3) \
+			JH_ROUND(V, XOR, AND, ANDNOT, OR, LOAD_RC, SWAP(x[i], 16, m16), x, r + 4) \
+			JH_ROUND(V, XOR, AND, ANDNOT, OR, LOAD_RC, SWAP32(x[i]), x, r + 5) \
+			JH_ROUND(V, XOR, AND, ANDNOT, OR, LOAD_RC, SWAP_HALF(x[i]), x, r + 6) \
+		} \
+	}
+
+#define SSE2_XOR(a, b) _mm_xor_si128(a, b)
+#define SSE2_AND(a, b) _mm_and_si128(a, b)
+#define SSE2_ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define SSE2_OR(a, b) _mm_or_si128(a, b)
+#define SSE2_SET1(c) _mm_set1_epi64x(c)
+#define SSE2_SWAP(a, n, m) _mm_or_si128(_mm_slli_epi64(_mm_and_si128(a, m), n), _mm_and_si128(_mm_srli_epi64(a, n), m))
+#define SSE2_SWAP32(a) _mm_shuffle_epi32(a, 0xb1)
+#define SSE2_SWAP_HALF(a) _mm_shuffle_epi32(a, 0x4e)
+#define SSE2_LOAD_RC(p) _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))
+
+#define AVX2_XOR(a, b) _mm256_xor_si256(a, b)
+#define AVX2_AND(a, b) _mm256_and_si256(a, b)
+#define AVX2_ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define AVX2_OR(a, b) _mm256_or_si256(a, b)
+#define AVX2_SET1(c) _mm256_set1_epi64x(c)
+#define AVX2_SWAP(a, n, m) _mm256_or_si256(_mm256_slli_epi64(_mm256_and_si256(a, m), n), _mm256_and_si256(_mm256_srli_epi64(a, n), m))
+#define AVX2_SWAP32(a) _mm256_shuffle_epi32(a, 0xb1)
+#define AVX2_SWAP_HALF(a) _mm256_shuffle_epi32(a, 0x4e)
+#define AVX2_LOAD_RC(p) _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))
+
+/** the padding block and the length block of a 200 byte message */
+struct jh_final_blocks
+{
+	alignas(16) uint8_t pad[64];
+	alignas(16) uint8_t len[64];
+
+	jh_final_blocks(const uint8_t* in)
+	{
+		memset(pad, 0, sizeof(pad));
+		memcpy(pad, in + 192, 8);
+		pad[8] = 0x80;
+		memset(len, 0, sizeof(len));
+		len[62] = uint8_t((STATE_SIZE * 8) >> 8);
+		len[63] = uint8_t(STATE_SIZE * 8);
+	}
+};
+
+inline void jh_sse2_f8(__m128i x[8], const uint8_t* block)
+{
+	__m128i m[4];
+	for(size_t i = 0; i < 4; i++)
+	{
+		m[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block) + i);
+		x[i] = _mm_xor_si128(x[i], m[i]);
+	}
+	JH_E8(__m128i, SSE2_XOR, SSE2_AND, SSE2_ANDNOT, SSE2_OR, SSE2_SET1, SSE2_SWAP, SSE2_SWAP32, SSE2_SWAP_HALF, SSE2_LOAD_RC, x);
+	for(size_t i = 0; i < 4; i++)
+		x[4 + i] = _mm_xor_si128(x[4 + i], m[i]);
+}
+
+void jh_sse2(const uint8_t* const* in, uint8_t* const* out, size_t n)
+{
+	for(size_t k = 0; k < n; k++)
+	{
+		__m128i x[8];
+		for(size_t i = 0; i < 8; i++)
+			x[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(JH256_H0) + i);
+		for(size_t b = 0; b < 3; b++)
+			jh_sse2_f8(x, in[k] + b * 64);
+		jh_final_blocks fin(in[k]);
+		jh_sse2_f8(x, fin.pad);
+		jh_sse2_f8(x, fin.len);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out[k]), x[6]);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out[k] + 16), x[7]);
+	}
+}
+
+FINAL_HASH_TARGET("avx2") inline void jh_avx2_f8(__m256i x[8], const uint8_t* b0, const uint8_t* b1)
+{
+	__m256i m[4];
+	for(size_t i = 0; i < 4; i++)
+	{
+		m[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b0) + i)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b1) + i), 1);
+		x[i] = _mm256_xor_si256(x[i], m[i]);
+	}
+	JH_E8(__m256i, AVX2_XOR, AVX2_AND, AVX2_ANDNOT, AVX2_OR, AVX2_SET1, AVX2_SWAP, AVX2_SWAP32, AVX2_SWAP_HALF, AVX2_LOAD_RC, x);
+	for(size_t i = 0; i < 4; i++)
+		x[4 + i] = _mm256_xor_si256(x[4 + i], m[i]);
+}
+
+/** JH-256 of 2 states, one state per 128 bit lane */
+FINAL_HASH_TARGET("avx2") void jh_avx2_2(const uint8_t* const* in, uint8_t* const* out)
+{
+	__m256i x[8];
+	for(size_t i = 0; i < 8; i++)
+		x[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(JH256_H0) + i));
+	for(size_t b = 0; b < 3; b++)
+		jh_avx2_f8(x, in[0] + b * 64, in[1] + b * 64);
+	jh_final_blocks fin0(in[0]), fin1(in[1]);
+	jh_avx2_f8(x, fin0.pad, fin1.pad);
+	jh_avx2_f8(x, fin0.len, fin1.len);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out[0]), _mm256_castsi256_si128(x[6]));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out[0] + 16), _mm256_castsi256_si128(x[7]));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out[1]), _mm256_extracti128_si256(x[6], 1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out[1] + 16), _mm256_extracti128_si256(x[7], 1));
+}
+
+void jh_avx2(const uint8_t* const* in, uint8_t* const* out, size_t n)
+{
+	size_t i = 0;
+	for(; i + 2 <= n; i += 2)
+		jh_avx2_2(in + i, out + i);
+	if(i < n)
+		jh_sse2(in + i, out + i, 1);
+}
+
+#undef JH_E8
+#undef JH_ROUND
+#undef JH_L
+#undef JH_SS
+
+/*
+ * Skein-512-256
+ *
+ * 3 message blocks, the final message block with the 8 remaining bytes and
+ * the output block. The tweaks are the same for all states.
+ */
+
+const uint64_t skein_iv_256[8] = {
+	0xCCD044A12FDB3E13ull, 0xE83590301A79A9EBull, 0x55AEA0614F816E6Full, 0x2A2767A4AE9B94DBull,
+	0xEC06025E74DD7683ull, 0xE7A436CDC4746251ull, 0xC36FBAF9393AD185ull, 0x3EEDBA1833EDFC13ull
+};
+
+constexpr uint64_t SKEIN_KS_PARITY = 0x1BD11BDAA9FC1A22ull;
+constexpr uint64_t SKEIN_T1_FIRST = 1ull << 62;
+constexpr uint64_t SKEIN_T1_FINAL = 1ull << 63;
+constexpr uint64_t SKEIN_T1_MSG = 48ull << 56;
+constexpr uint64_t SKEIN_T1_OUT = 63ull << 56;
+
+#define SKEIN_ROL(x, n) _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - (n)))
+
+#define SKEIN_MIX(a, b, rot) \
+	a = _mm256_add_epi64(a, b); \
+	b = _mm256_xor_si256(SKEIN_ROL(b, rot), a);
+
+#define SKEIN_ROUND(p0, p1, p2, p3, p4, p5, p6, p7, r0, r1, r2, r3) \
+	SKEIN_MIX(X[p0], X[p1], r0) \
+	SKEIN_MIX(X[p2], X[p3], r1) \
+	SKEIN_MIX(X[p4], X[p5], r2) \
+	SKEIN_MIX(X[p6], X[p7], r3)
+
+#define SKEIN_INJECT(s) \
+	for(size_t i = 0; i < 8; i++) \
+		X[i] = _mm256_add_epi64(X[i], ks[((s) + i) % 9]); \
+	X[5] = _mm256_add_epi64(X[5], _mm256_set1_epi64x(ts[(s) % 3])); \
+	X[6] = _mm256_add_epi64(X[6], _mm256_set1_epi64x(ts[((s) + 1) % 3])); \
+	X[7] = _mm256_add_epi64(X[7], _mm256_set1_epi64x(s));
+
+/** Threefish-512 encryption of w with the key h and the tweak t0, t1 and the feed forward into h */
+FINAL_HASH_TARGET("avx2") inline void skein_block_avx2(__m256i h[8], const __m256i w[8], uint64_t t0, uint64_t t1)
+{
+	__m256i ks[9];
+	ks[8] = _mm256_set1_epi64x(SKEIN_KS_PARITY);
+	for(size_t i = 0; i < 8; i++)
+	{
+		ks[i] = h[i];
+		ks[8] = _mm256_xor_si256(ks[8], h[i]);
+	}
+	const uint64_t ts[3] = {t0, t1, t0 ^ t1};
+
+	__m256i X[8];
+	for(size_t i = 0; i < 8; i++)
+		X[i] = _mm256_add_epi64(w[i], ks[i]);
+	X[5] = _mm256_add_epi64(X[5], _mm256_set1_epi64x(ts[0]));
+	X[6] = _mm256_add_epi64(X[6], _mm256_set1_epi64x(ts[1]));
+
+	for(size_t s = 1; s < 19; s += 2)
+	{
+		SKEIN_ROUND(0, 1, 2, 3, 4, 5, 6, 7, 46, 36, 19, 37)
+		SKEIN_ROUND(2, 1, 4, 7, 6, 5, 0, 3, 33, 27, 14, 42)
+		SKEIN_ROUND(4, 1, 6, 3, 0, 5, 2, 7, 17, 49, 36, 39)
+		SKEIN_ROUND(6, 1, 0, 7, 2, 5, 4, 3, 44,  9, 54, 56)
+		SKEIN_INJECT(s)
+		SKEIN_ROUND(0, 1, 2, 3, 4, 5, 6, 7, 39, 30, 34, 24)
+		SKEIN_ROUND(2, 1, 4, 7, 6, 5, 0, 3, 13, 50, 10, 17)
+		SKEIN_ROUND(4, 1, 6, 3, 0, 5, 2, 7, 25, 29, 39, 43)
+		SKEIN_ROUND(6, 1, 0, 7, 2, 5, 4, 3,  8, 35, 56, 22)
+		SKEIN_INJECT(s + 1)
+	}
+
+	for(size_t i = 0; i < 8; i++)
+		h[i] = _mm256_xor_si256(X[i], w[i]);
+}
+
+#undef SKEIN_INJECT
+#undef SKEIN_ROUND
+#undef SKEIN_MIX
+#undef SKEIN_ROL
+
+/** Skein-512-256 of up to 4 states */
+FINAL_HASH_TARGET("avx2") void skein_avx2_4(const uint8_t* const* in, uint8_t* const* out, size_t n)
+{
+	const uint8_t* p[4];
+	for(size_t k = 0; k < 4; k++)
+		p[k] = in[k < n ? k : 0];
+
+	__m256i h[8], w[8];
+	for(size_t i = 0; i < 8; i++)
+		h[i] = _mm256_set1_epi64x(skein_iv_256[i]);
+
+	for(size_t b = 0; b < 3; b++)
+	{
+		for(size_t i = 0; i < 8; i++)
+		{
+			const size_t o = b * 64 + i * 8;
+			w[i] = _mm256_set_epi64x(load_le64(p[3] + o), load_le64(p[2] + o), load_le64(p[1] + o), load_le64(p[0] + o));
+		}
+		skein_block_avx2(h, w, 64 * (b + 1), SKEIN_T1_MSG | (b == 0 ? SKEIN_T1_FIRST : 0));
+	}
+
+	w[0] = _mm256_set_epi64x(load_le64(p[3] + 192), load_le64(p[2] + 192), load_le64(p[1] + 192), load_le64(p[0] + 192));
+	for(size_t i = 1; i < 8; i++)
+		w[i] = _mm256_setzero_si256();
+	skein_block_avx2(h, w, STATE_SIZE, SKEIN_T1_MSG | SKEIN_T1_FINAL);
+
+	// output stage, counter 0
+	w[0] = _mm256_setzero_si256();
+	skein_block_avx2(h, w, 8, SKEIN_T1_OUT | SKEIN_T1_FIRST | SKEIN_T1_FINAL);
+
+	alignas(32) uint64_t v[4][4];
+	for(size_t i = 0; i < 4; i++)
+		_mm256_store_si256(reinterpret_cast<__m256i*>(v[i]), h[i]);
+	for(size_t k = 0; k < n; k++)
+		for(size_t i = 0; i < 4; i++)
+			memcpy(out[k] + 8 * i, &v[i][k], sizeof(uint64_t));
+}
+
+void skein_avx2(const uint8_t* const* in, uint8_t* const* out, size_t n)
+{
+	// a vector pass with two lanes is not faster than two scalar hashes
+	if(n < 3)
+	{
+		hash_scalar<3>(in, out, n);
+		return;
+	}
+	size_t i = 0;
+	for(; i + 3 <= n; i += 4)
+		skein_avx2_4(in + i, out + i, n - i < 4 ? n - i : 4);
+	if(i < n)
+		hash_scalar<3>(in + i, out + i, n - i);
+}
+
+struct final_hash_impl
+{
+	const char* name;
+	// indexed by the low two bits of the first state byte
+	final_hash_fun hash[4];
+};
+
+const final_hash_impl impl_scalar = { "scalar", { hash_scalar<0>, hash_scalar<1>, hash_scalar<2>, hash_scalar<3> } };
+const final_hash_impl impl_sse2 = { "SSE2", { blake_sse2, hash_scalar<1>, jh_sse2, hash_scalar<3> } };
+const final_hash_impl impl_sse2_aes = { "SSE2 / AES-NI Groestl", { blake_sse2, groestl_aesni, jh_sse2, hash_scalar<3> } };
+const final_hash_impl impl_avx2 = { "AVX2", { blake_sse2, hash_scalar<1>, jh_avx2, skein_avx2 } };
+const final_hash_impl impl_avx2_aes = { "AVX2 / AES-NI Groestl", { blake_sse2, groestl_aesni, jh_avx2, skein_avx2 } };
+
+const final_hash_impl* impl = &impl_scalar;
+
+} // namespace
+
+const char* extra_hashes_select(bool aes, bool avx2)
+{
+	if(avx2)
+		impl = aes ? &impl_avx2_aes : &impl_avx2;
+	else
+		impl = aes ? &impl_sse2_aes : &impl_sse2;
+	return impl->name;
+}
+
+void extra_hashes_multi(uint8_t* const* st, size_t n, void* output)
+{
+	constexpr size_t MAX_N = 8;
+	const final_hash_impl* cur = impl;
+	for(size_t i = 0; i < n; i += MAX_N)
+	{
+		const uint8_t* in[4][MAX_N];
+		uint8_t* out[4][MAX_N];
+		size_t cnt[4] = {0, 0, 0, 0};
+		for(size_t k = i; k < n && k < i + MAX_N; k++)
+		{
+			const size_t algo = st[k][0] & 3;
+			in[algo][cnt[algo]] = st[k];
+			out[algo][cnt[algo]] = static_cast<uint8_t*>(output) + 32 * k;
+			cnt[algo]++;
+		}
+		for(size_t algo = 0; algo < 4; algo++)
+		{
+			if(cnt[algo] != 0)
+				cur->hash[algo](in[algo], out[algo], cnt[algo]);
+		}
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** select the final hash implementations (extra_hashes_multi.cpp)
+ *
+ * Must be called before the hash threads are started, the scalar final hashes
+ * of cryptonight_common.cpp are used until then.
+ *
+ * @param aes CPU supports AES-NI and SSSE3
+ * @param avx2 CPU and OS support AVX2
+ * @return name of the selected implementation
+ */
+const char* extra_hashes_select(bool aes, bool avx2);
+
+/** final hash of n keccak states
+ *
+ * The low two bits of the first state byte select BLAKE-256, Groestl-256,
+ * JH-256 or Skein-512-256 like the extra_hashes table. States which use the
+ * same hash are hashed together.
+ *
+ * @param st n pointers to 200 byte keccak states
+ * @param output n hashes with 32 bytes each
+ */
+void extra_hashes_multi(uint8_t* const* st, size_t n, void* output);
@@ -0,0 +1,119 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Selection between the hardware division and fast_div_heavy().
+ *
+ * The 64 bit hardware division takes 40 to 90 cycles on older Intel and AMD
+ * cores but less than 20 cycles on newer ones. Both divisions are timed as a
+ * dependent chain like in the main loop and the faster one is used.
+ */
+
+#include "fast_div_heavy.hpp"
+
+#include <chrono>
+
+bool cn_heavy_fast_div = false;
+
+namespace
+{
+
+//! divisions per timed chain
+constexpr uint32_t CHAIN = 1 << 16;
+
+//! xorshift64
+inline uint64_t next_rand(uint64_t& s)
+{
+	s ^= s << 13;
+	s ^= s >> 7;
+	s ^= s << 17;
+	return s;
+}
+
+bool check(uint64_t seed, uint32_t rounds)
+{
+	const int64_t edge_a[] = { INT64_MAX, INT64_MAX - 1, INT64_MIN + 1, 0, 1, -1, 1LL << 62, -(1LL << 62), (1LL << 53) + 1 };
+	const int32_t edge_b[] = { 1, -1, 5, -3, 7, INT32_MAX, INT32_MIN | 5, 0x40000005 };
+
+	for(int64_t a : edge_a)
+		for(int32_t b : edge_b)
+			if(fast_div_heavy(a, b) != a / b)
+				return false;
+
+	for(uint32_t i = 0; i < rounds; i++)
+	{
+		const int64_t a = static_cast<int64_t>(next_rand(seed)) >> (i & 31);
+		const int32_t b = static_cast<int32_t>(next_rand(seed) >> (32 + (i >> 5 & 31))) | 0x5;
+		if(fast_div_heavy(a, b) != a / b)
+			return false;
+	}
+	return true;
+}
+
+/** time a dependent chain of divisions like in CN_STEP5
+ *
+ * @return nanoseconds
+ */
+template<bool FAST>
+uint64_t time_chain(uint64_t& sink)
+{
+	uint64_t s = 0x9E3779B97F4A7C15ULL;
+	int64_t q = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for(uint32_t i = 0; i < CHAIN; i++)
+	{
+		const int64_t u = static_cast<int64_t>(next_rand(s) ^ static_cast<uint64_t>(q));
+		const int32_t d = static_cast<int32_t>(u >> 17) | 0x5;
+		q = FAST ? fast_div_heavy(u, d) : u / d;
+	}
+	const auto end = std::chrono::steady_clock::now();
+	sink += static_cast<uint64_t>(q);
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+} // namespace
+
+const char* heavy_div_select()
+{
+	cn_heavy_fast_div = false;
+	if(!check(0x2545F4914F6CDD1DULL, 1 << 16))
+		return "hardware (reciprocal division failed the check)";
+
+	// best of three to skip interrupts and frequency changes
+	uint64_t sink = 0;
+	uint64_t hw = UINT64_MAX, fast = UINT64_MAX;
+	for(int i = 0; i < 3; i++)
+	{
+		const uint64_t t_hw = time_chain<false>(sink);
+		const uint64_t t_fast = time_chain<true>(sink);
+		hw = t_hw < hw ? t_hw : hw;
+		fast = t_fast < fast ? t_fast : fast;
+	}
+
+	// keep the chain results alive
+	if(sink == 1)
+		hw++;
+
+	cn_heavy_fast_div = fast < hw;
+	return cn_heavy_fast_div ? "reciprocal" : "hardware";
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __GNUC__
+#include <x86intrin.h>
+#else
+#include <intrin.h>
+#endif // __GNUC__
+
+/** use fast_div_heavy() instead of the hardware division in the main loop of
+ * cryptonight_heavy, cryptonight_haven and cryptonight_bittube2
+ *
+ * Set by heavy_div_select(), false until then.
+ */
+extern bool cn_heavy_fast_div;
+
+/** select the division of the heavy algorithms (fast_div_heavy.cpp)
+ *
+ * Checks fast_div_heavy() against the hardware division and uses it if it is
+ * faster on this CPU. Must be called before the hash threads are started.
+ *
+ * @return name of the selected division
+ */
+const char* heavy_div_select();
+
+/** signed 64 by 32 bit division with a double precision reciprocal
+ *
+ * Same result as `a / b` for all b with |b| >= 1, except INT64_MIN / -1 which
+ * wraps to INT64_MIN instead of raising an exception.
+ *
+ * The reciprocal is lowered by 16 ulp so that both quotient estimates never
+ * exceed the exact quotient in any float rounding mode. The first estimate
+ * leaves a remainder below 2^15 + 2 * |b|, the second one is at most one too
+ * small, which is corrected with an integer compare.
+ */
+inline int64_t fast_div_heavy(int64_t a, int32_t b)
+{
+	const uint64_t ua = a < 0 ? 0 - static_cast<uint64_t>(a) : static_cast<uint64_t>(a);
+	const uint64_t ub = b < 0 ? 0 - static_cast<uint64_t>(static_cast<int64_t>(b)) : static_cast<uint64_t>(b);
+
+	// the bit pattern of the reciprocal is changed in the vector register to avoid two register moves
+	const __m128i rcp = _mm_castpd_si128(_mm_div_sd(_mm_set_sd(1.0), _mm_cvtsi64_sd(_mm_setzero_pd(), static_cast<int64_t>(ub))));
+	const double rcp_lo = _mm_cvtsd_f64(_mm_castsi128_pd(_mm_sub_epi64(rcp, _mm_cvtsi64_si128(16))));
+	// 2 * rcp_lo, the first estimate uses a / 2 to stay in the signed range
+	const double rcp_hi = _mm_cvtsd_f64(_mm_castsi128_pd(_mm_add_epi64(rcp, _mm_cvtsi64_si128((1LL << 52) - 16))));
+
+	uint64_t q = static_cast<uint64_t>(static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(ua >> 1)) * rcp_hi));
+	uint64_t r = ua - q * ub;
+	const uint64_t q2 = static_cast<uint64_t>(static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(r)) * rcp_lo));
+	r -= q2 * ub;
+	q += q2 + (r >= ub ? 1 : 0);
+
+	return (a ^ static_cast<int64_t>(b)) < 0 ? static_cast<int64_t>(0 - q) : static_cast<int64_t>(q);
+}
@@ -0,0 +1,306 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Keccak-f[1600] of several independent states in one pass.
+ *
+ * Lane j of every state is kept in one vector register (state i in element i),
+ * so every step of the permutation is a single vector operation for all states.
+ * AVX2 interleaves 4 states, AVX-512 interleaves 8 states and uses the rotate
+ * and ternary logic instructions for Theta and Chi.
+ */
+
+#include "keccak_multi.hpp"
+
+#ifdef __GNUC__
+#include <x86intrin.h>
+#	define KECCAK_TARGET(x) __attribute__((target(x)))
+#else
+#include <intrin.h>
+#	define KECCAK_TARGET(x)
+#endif
+
+#include <cstring>
+
+extern "C"
+{
+	void keccak(const uint8_t *in, int inlen, uint8_t *md, int mdlen);
+	void keccakf(uint64_t st[25], int rounds);
+	extern const uint64_t keccakf_rndc[24];
+}
+
+namespace
+{
+
+constexpr size_t KECCAK_RATE = 136;
+
+/** 24 rounds of Keccak-f[1600]
+ *
+ * V is the vector type, XOR, XOR5, ROL, CHI and RC are the vector operations
+ * and s is the interleaved state with 25 elements.
+ */
+#define KECCAK_MULTI_PERMUTE(V, XOR, XOR5, ROL, CHI, RC, s) \
+	for(int round = 0; round < 24; ++round) \
+	{ \
+		/* Theta */ \
+		const V bc0 = XOR5(s[0], s[5], s[10], s[15], s[20]); \
+		const V bc1 = XOR5(s[1], s[6], s[11], s[16], s[21]); \
+		const V bc2 = XOR5(s[2], s[7], s[12], s[17], s[22]); \
+		const V bc3 = XOR5(s[3], s[8], s[13], s[18], s[23]); \
+		const V bc4 = XOR5(s[4], s[9], s[14], s[19], s[24]); \
+		const V d0 = XOR(bc4, ROL(bc1, 1)); \
+		const V d1 = XOR(bc0, ROL(bc2, 1)); \
+		const V d2 = XOR(bc1, ROL(bc3, 1)); \
+		const V d3 = XOR(bc2, ROL(bc4, 1)); \
+		const V d4 = XOR(bc3, ROL(bc0, 1)); \
+		s[0] = XOR(s[0], d0); s[5] = XOR(s[5], d0); s[10] = XOR(s[10], d0); s[15] = XOR(s[15], d0); s[20] = XOR(s[20], d0); \
+		s[1] = XOR(s[1], d1); s[6] = XOR(s[6], d1); s[11] = XOR(s[11], d1); s[16] = XOR(s[16], d1); s[21] = XOR(s[21], d1); \
+		s[2] = XOR(s[2], d2); s[7] = XOR(s[7], d2); s[12] = XOR(s[12], d2); s[17] = XOR(s[17], d2); s[22] = XOR(s[22], d2); \
+		s[3] = XOR(s[3], d3); s[8] = XOR(s[8], d3); s[13] = XOR(s[13], d3); s[18] = XOR(s[18], d3); s[23] = XOR(s[23], d3); \
+		s[4] = XOR(s[4], d4); s[9] = XOR(s[9], d4); s[14] = XOR(s[14], d4); s[19] = XOR(s[19], d4); s[24] = XOR(s[24], d4); \
+		/* Rho Pi */ \
+		const V t = s[1]; \
+		s[1] = ROL(s[6], 44); \
+		s[6] = ROL(s[9], 20); \
+		s[9] = ROL(s[22], 61); \
+		s[22] = ROL(s[14], 39); \
+		s[14] = ROL(s[20], 18); \
+		s[20] = ROL(s[2], 62); \
+		s[2] = ROL(s[12], 43); \
+		s[12] = ROL(s[13], 25); \
+		s[13] = ROL(s[19], 8); \
+		s[19] = ROL(s[23], 56); \
+		s[23] = ROL(s[15], 41); \
+		s[15] = ROL(s[4], 27); \
+		s[4] = ROL(s[24], 14); \
+		s[24] = ROL(s[21], 2); \
+		s[21] = ROL(s[8], 55); \
+		s[8] = ROL(s[16], 45); \
+		s[16] = ROL(s[5], 36); \
+		s[5] = ROL(s[3], 28); \
+		s[3] = ROL(s[18], 21); \
+		s[18] = ROL(s[17], 15); \
+		s[17] = ROL(s[11], 10); \
+		s[11] = ROL(s[7], 6); \
+		s[7] = ROL(s[10], 3); \
+		s[10] = ROL(t, 1); \
+		/* Chi */ \
+		for(int y = 0; y < 25; y += 5) \
+		{ \
+			const V b0 = s[y], b1 = s[y + 1], b2 = s[y + 2], b3 = s[y + 3], b4 = s[y + 4]; \
+			s[y] = CHI(b0, b1, b2); \
+			s[y + 1] = CHI(b1, b2, b3); \
+			s[y + 2] = CHI(b2, b3, b4); \
+			s[y + 3] = CHI(b3, b4, b0); \
+			s[y + 4] = CHI(b4, b0, b1); \
+		} \
+		/* Iota */ \
+		s[0] = XOR(s[0], RC(keccakf_rndc[round])); \
+	}
+
+#define AVX2_XOR(a, b) _mm256_xor_si256(a, b)
+#define AVX2_XOR5(a, b, c, d, e) _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(c, d)), e)
+#define AVX2_ROL(x, n) _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - (n)))
+#define AVX2_CHI(a, b, c) _mm256_xor_si256(a, _mm256_andnot_si256(b, c))
+#define AVX2_RC(c) _mm256_set1_epi64x(c)
+
+#define AVX512_XOR(a, b) _mm512_xor_si512(a, b)
+#define AVX512_XOR5(a, b, c, d, e) _mm512_ternarylogic_epi64(_mm512_ternarylogic_epi64(a, b, c, 0x96), d, e, 0x96)
+// the unmasked _mm512_rol_epi64 of GCC 12 triggers a false uninitialized warning
+#define AVX512_ROL(x, n) _mm512_maskz_rol_epi64(0xff, x, n)
+#define AVX512_CHI(a, b, c) _mm512_ternarylogic_epi64(a, b, c, 0xd2)
+#define AVX512_RC(c) _mm512_set1_epi64(c)
+
+inline uint64_t load64(const uint8_t* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/** last block of a message with the keccak padding */
+inline void pad_block(const uint8_t* in, size_t len, uint8_t* block)
+{
+	memcpy(block, in, len);
+	block[len++] = 1;
+	memset(block + len, 0, KECCAK_RATE - len);
+	block[KECCAK_RATE - 1] |= 0x80;
+}
+
+// lane element i of every vector belongs to state i, unused elements hash zero length messages
+struct lanes
+{
+	static constexpr size_t MAX_N = 8;
+	alignas(64) uint64_t v[25][MAX_N];
+
+	void absorb(const uint8_t* const* blocks, size_t n)
+	{
+		for(size_t j = 0; j < KECCAK_RATE / 8; j++)
+			for(size_t i = 0; i < n; i++)
+				v[j][i] ^= load64(blocks[i] + 8 * j);
+	}
+
+	void load(uint64_t* const* st, size_t n)
+	{
+		memset(v, 0, sizeof(v));
+		for(size_t j = 0; j < 25; j++)
+			for(size_t i = 0; i < n; i++)
+				v[j][i] = st[i][j];
+	}
+
+	void store(uint64_t* const* st, size_t n) const
+	{
+		for(size_t j = 0; j < 25; j++)
+			for(size_t i = 0; i < n; i++)
+				st[i][j] = v[j][i];
+	}
+
+	void store(uint8_t* const* md, size_t n) const
+	{
+		for(size_t j = 0; j < 25; j++)
+			for(size_t i = 0; i < n; i++)
+				memcpy(md[i] + 8 * j, &v[j][i], sizeof(uint64_t));
+	}
+};
+
+KECCAK_TARGET("avx2") void permute_avx2(lanes& l)
+{
+	__m256i s[25];
+	for(size_t j = 0; j < 25; j++)
+		s[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(l.v[j]));
+	KECCAK_MULTI_PERMUTE(__m256i, AVX2_XOR, AVX2_XOR5, AVX2_ROL, AVX2_CHI, AVX2_RC, s);
+	for(size_t j = 0; j < 25; j++)
+		_mm256_store_si256(reinterpret_cast<__m256i*>(l.v[j]), s[j]);
+}
+
+KECCAK_TARGET("avx512f") void permute_avx512(lanes& l)
+{
+	__m512i s[25];
+	for(size_t j = 0; j < 25; j++)
+		s[j] = _mm512_load_si512(l.v[j]);
+	KECCAK_MULTI_PERMUTE(__m512i, AVX512_XOR, AVX512_XOR5, AVX512_ROL, AVX512_CHI, AVX512_RC, s);
+	for(size_t j = 0; j < 25; j++)
+		_mm512_store_si512(l.v[j], s[j]);
+}
+
+struct keccak_multi_impl
+{
+	const char* name;
+	// permutation of 4 states, nullptr for the scalar keccak
+	void (*permute4)(lanes&);
+	// permutation of 8 states, nullptr if not supported
+	void (*permute8)(lanes&);
+};
+
+const keccak_multi_impl impl_scalar = { "scalar", nullptr, nullptr };
+const keccak_multi_impl impl_avx2 = { "4-way AVX2", permute_avx2, nullptr };
+// 8 states in one zmm pass are slower than 4 states in ymm registers, the 8-way permutation is only used for more than 4 states
+const keccak_multi_impl impl_avx512 = { "4-way AVX2 / 8-way AVX-512", permute_avx2, permute_avx512 };
+
+const keccak_multi_impl* impl = &impl_scalar;
+
+/** select the permutation for n states
+ *
+ * @return states per permutation
+ */
+inline size_t select_permute(const keccak_multi_impl* cur, size_t n, void (*&permute)(lanes&))
+{
+	if(n > 4 && cur->permute8 != nullptr)
+	{
+		permute = cur->permute8;
+		return 8;
+	}
+	permute = cur->permute4;
+	return 4;
+}
+
+} // namespace
+
+const char* keccak_multi_select(bool avx2, bool avx512)
+{
+	impl = (avx2 && avx512) ? &impl_avx512 : (avx2 ? &impl_avx2 : &impl_scalar);
+	return impl->name;
+}
+
+void keccakf_multi(uint64_t* const* st, size_t n)
+{
+	const keccak_multi_impl* cur = impl;
+	if(cur->permute4 == nullptr || n == 1)
+	{
+		for(size_t i = 0; i < n; i++)
+			keccakf(st[i], 24);
+		return;
+	}
+
+	void (*permute)(lanes&);
+	const size_t width = select_permute(cur, n, permute);
+	lanes l;
+	for(size_t i = 0; i < n; i += width)
+	{
+		const size_t w = n - i < width ? n - i : width;
+		l.load(st + i, w);
+		permute(l);
+		l.store(st + i, w);
+	}
+}
+
+void keccak1600_multi(const uint8_t* in, size_t len, uint8_t* const* md, size_t n)
+{
+	const keccak_multi_impl* cur = impl;
+	if(cur->permute4 == nullptr || n == 1)
+	{
+		for(size_t i = 0; i < n; i++)
+			keccak(in + len * i, static_cast<int>(len), md[i], 200);
+		return;
+	}
+
+	void (*permute)(lanes&);
+	const size_t width = select_permute(cur, n, permute);
+	lanes l;
+	const uint8_t* blocks[lanes::MAX_N];
+	uint8_t last[lanes::MAX_N][KECCAK_RATE];
+	for(size_t i = 0; i < n; i += width)
+	{
+		const size_t w = n - i < width ? n - i : width;
+		memset(l.v, 0, sizeof(l.v));
+
+		size_t offset = 0;
+		for(; len - offset >= KECCAK_RATE; offset += KECCAK_RATE)
+		{
+			for(size_t k = 0; k < w; k++)
+				blocks[k] = in + len * (i + k) + offset;
+			l.absorb(blocks, w);
+			permute(l);
+		}
+
+		for(size_t k = 0; k < w; k++)
+		{
+			pad_block(in + len * (i + k) + offset, len - offset, last[k]);
+			blocks[k] = last[k];
+		}
+		l.absorb(blocks, w);
+		permute(l);
+
+		l.store(md + i, w);
+	}
+}
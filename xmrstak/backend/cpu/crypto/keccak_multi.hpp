@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** select the keccak implementation for several states (keccak_multi.cpp)
+ *
+ * Must be called before the hash threads are started, the scalar keccak from
+ * c_keccak.c is used until then.
+ *
+ * @param avx2 CPU and OS support AVX2
+ * @param avx512 CPU and OS support AVX-512F
+ * @return name of the selected implementation
+ */
+const char* keccak_multi_select(bool avx2, bool avx512);
+
+/** Keccak-f[1600] with 24 rounds of n independent states
+ *
+ * @param st n pointers to states with 25 lanes each
+ */
+void keccakf_multi(uint64_t* const* st, size_t n);
+
+/** keccak1600 of n messages with the same length
+ *
+ * @param in messages, message i starts at in + len * i
+ * @param md n pointers to 200 byte outputs
+ */
+void keccak1600_multi(const uint8_t* in, size_t len, uint8_t* const* md, size_t n);
@@ -85,8 +85,36 @@
 alignas(16) const uint32_t saes_table[4][256] = { saes_data(saes_u0), saes_data(saes_u1), saes_data(saes_u2), saes_data(saes_u3) };
 alignas(16) const uint8_t  saes_sbox[256] = saes_data(saes_h0);
 
+/** constant time software AES built on byte shuffles, see soft_aes_vperm.cpp
+ *
+ * All members are nullptr until soft_aes_select() found SSSE3, the lookup
+ * table implementation in this file is used in that case.
+ */
+struct soft_aes_vperm_t
+{
+	__m128i (*aesenc)(__m128i in, __m128i key);
+	void (*aes_round)(__m128i key, __m128i* x0, __m128i* x1, __m128i* x2, __m128i* x3, __m128i* x4, __m128i* x5, __m128i* x6, __m128i* x7);
+	__m128i (*aes_round_bittube2)(__m128i val, __m128i key);
+	__m128i (*aeskeygenassist)(__m128i key, uint8_t rcon);
+};
+
+extern soft_aes_vperm_t soft_aes_vperm;
+
+/** select the software AES implementation
+ *
+ * Must be called before the hash threads are started.
+ *
+ * @param ssse3 CPU supports SSSE3
+ * @param avx2 CPU and OS support AVX2
+ * @return name of the selected implementation
+ */
+const char* soft_aes_select(bool ssse3, bool avx2);
+
 static inline __m128i soft_aesenc(__m128i in, __m128i key)
 {
+	if(soft_aes_vperm.aesenc != nullptr)
+		return soft_aes_vperm.aesenc(in, key);
+
 	uint32_t x0, x1, x2, x3;
 	x0 = _mm_cvtsi128_si32(in);
 	x1 = _mm_cvtsi128_si32(_mm_shuffle_epi32(in, 0x55));
@@ -119,6 +147,9 @@ static inline uint32_t _rotr(uint32_t value, uint32_t amount)
 
 static inline __m128i soft_aeskeygenassist(__m128i key, uint8_t rcon)
 {
+	if(soft_aes_vperm.aeskeygenassist != nullptr)
+		return soft_aes_vperm.aeskeygenassist(key, rcon);
+
 	uint32_t X1 = sub_word(_mm_cvtsi128_si32(_mm_shuffle_epi32(key, 0x55)));
 	uint32_t X3 = sub_word(_mm_cvtsi128_si32(_mm_shuffle_epi32(key, 0xFF)));
 	return _mm_set_epi32(_rotr(X3, 8) ^ rcon, X3,_rotr(X1, 8) ^ rcon, X1);
@@ -0,0 +1,254 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Constant time software AES for CPUs without AES-NI.
+ *
+ * The S-box is evaluated with 16 entry lookups done by pshufb instead of memory
+ * lookups, so the run time does not depend on the data (vector permute AES).
+ * The byte is moved into a basis where GF(2^8) is GF(2^4)^2, inverted there with
+ * the 4 bit inverse table and moved back by the output tables which also contain
+ * the affine transformation of the S-box. Entries with bit 7 set are used to let
+ * pshufb return zero for the inverse of zero.
+ *
+ * ShiftRows and the rotations of MixColumns are byte shuffles, too. The S-box
+ * constant 0x63 commutes with MixColumns and is added to the round key.
+ *
+ * The AVX2 variant processes two blocks per register for the 8 block rounds of
+ * the scratchpad explode / implode.
+ */
+
+#include "soft_aes.hpp"
+
+#ifdef __GNUC__
+#	define VPERM_TARGET(x) __attribute__((target(x)))
+#else
+#	define VPERM_TARGET(x)
+#endif
+
+soft_aes_vperm_t soft_aes_vperm = { nullptr, nullptr, nullptr, nullptr };
+
+namespace
+{
+
+alignas(16) const uint8_t vperm_ipt_lo[16] = {
+	0x00, 0x10, 0xc2, 0xd2, 0xd4, 0xc4, 0x16, 0x06, 0x74, 0x64, 0xb6, 0xa6, 0xa0, 0xb0, 0x62, 0x72 };
+alignas(16) const uint8_t vperm_ipt_hi[16] = {
+	0x00, 0x63, 0xdd, 0xbe, 0xe3, 0x80, 0x3e, 0x5d, 0x7e, 0x1d, 0xa3, 0xc0, 0x9d, 0xfe, 0x40, 0x23 };
+alignas(16) const uint8_t vperm_inv[16] = {
+	0x80, 0x01, 0x09, 0x0e, 0x0d, 0x0b, 0x07, 0x06, 0x0f, 0x02, 0x0c, 0x05, 0x0a, 0x04, 0x03, 0x08 };
+alignas(16) const uint8_t vperm_inva[16] = {
+	0x80, 0x02, 0x01, 0x0f, 0x09, 0x05, 0x0e, 0x0c, 0x0d, 0x04, 0x0b, 0x0a, 0x07, 0x08, 0x06, 0x03 };
+alignas(16) const uint8_t vperm_sbou[16] = {
+	0x00, 0x62, 0x1d, 0x8f, 0x51, 0xa1, 0x92, 0xf0, 0xed, 0xbc, 0x33, 0x2e, 0xc3, 0x4c, 0xde, 0x7f };
+alignas(16) const uint8_t vperm_sbot[16] = {
+	0x00, 0x7d, 0x34, 0xa0, 0xd3, 0x3a, 0x94, 0xe9, 0xdd, 0x0e, 0xae, 0x9a, 0x47, 0xe7, 0x73, 0x49 };
+
+// ShiftRows, ShiftRows followed by rotating each column by one byte, rotating each column by two bytes
+alignas(16) const uint8_t vperm_sr[16] = {
+	0x00, 0x05, 0x0a, 0x0f, 0x04, 0x09, 0x0e, 0x03, 0x08, 0x0d, 0x02, 0x07, 0x0c, 0x01, 0x06, 0x0b };
+alignas(16) const uint8_t vperm_sr_rot1[16] = {
+	0x05, 0x0a, 0x0f, 0x00, 0x09, 0x0e, 0x03, 0x04, 0x0d, 0x02, 0x07, 0x08, 0x01, 0x06, 0x0b, 0x0c };
+alignas(16) const uint8_t vperm_rot2[16] = {
+	0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05, 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d };
+
+// SubWord(X1), RotWord(SubWord(X1)), SubWord(X3), RotWord(SubWord(X3))
+alignas(16) const uint8_t vperm_keygen[16] = {
+	0x04, 0x05, 0x06, 0x07, 0x05, 0x06, 0x07, 0x04, 0x0c, 0x0d, 0x0e, 0x0f, 0x0d, 0x0e, 0x0f, 0x0c };
+
+#define VPERM_LOAD(t) _mm_load_si128(reinterpret_cast<const __m128i*>(t))
+
+struct vperm_ssse3
+{
+	__m128i ipt_lo, ipt_hi, inv, inva, sbou, sbot, sr, sr_rot1, rot2, nibble, poly;
+
+	VPERM_TARGET("ssse3") vperm_ssse3() :
+		ipt_lo(VPERM_LOAD(vperm_ipt_lo)), ipt_hi(VPERM_LOAD(vperm_ipt_hi)), inv(VPERM_LOAD(vperm_inv)),
+		inva(VPERM_LOAD(vperm_inva)), sbou(VPERM_LOAD(vperm_sbou)), sbot(VPERM_LOAD(vperm_sbot)),
+		sr(VPERM_LOAD(vperm_sr)), sr_rot1(VPERM_LOAD(vperm_sr_rot1)), rot2(VPERM_LOAD(vperm_rot2)),
+		nibble(_mm_set1_epi8(0x0f)), poly(_mm_set1_epi8(0x1b))
+	{
+	}
+
+	/** S-box of all bytes without the constant 0x63 */
+	VPERM_TARGET("ssse3") inline __m128i sub_bytes(__m128i x) const
+	{
+		__m128i lo = _mm_and_si128(x, nibble);
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), nibble);
+		__m128i t = _mm_xor_si128(_mm_shuffle_epi8(ipt_lo, lo), _mm_shuffle_epi8(ipt_hi, hi));
+
+		__m128i i = _mm_and_si128(_mm_srli_epi16(t, 4), nibble);
+		__m128i k = _mm_and_si128(t, nibble);
+		__m128i ak = _mm_shuffle_epi8(inva, k);
+		__m128i j = _mm_xor_si128(i, k);
+		__m128i iak = _mm_xor_si128(_mm_shuffle_epi8(inv, i), ak);
+		__m128i jak = _mm_xor_si128(_mm_shuffle_epi8(inv, j), ak);
+		__m128i io = _mm_xor_si128(_mm_shuffle_epi8(inv, iak), j);
+		__m128i jo = _mm_xor_si128(_mm_shuffle_epi8(inv, jak), i);
+		return _mm_xor_si128(_mm_shuffle_epi8(sbou, io), _mm_shuffle_epi8(sbot, jo));
+	}
+
+	/** aesenc with the S-box constant already added to key */
+	VPERM_TARGET("ssse3") inline __m128i aesenc(__m128i x, __m128i key63) const
+	{
+		__m128i s = sub_bytes(x);
+		__m128i a = _mm_shuffle_epi8(s, sr);
+		__m128i r1 = _mm_shuffle_epi8(s, sr_rot1);
+		// MixColumns: 2 * (a ^ rot1) ^ rot1 ^ rot2 ^ rot3
+		__m128i t = _mm_xor_si128(a, r1);
+		__m128i t2 = _mm_xor_si128(_mm_add_epi8(t, t), _mm_and_si128(_mm_cmpgt_epi8(_mm_setzero_si128(), t), poly));
+		__m128i out = _mm_xor_si128(_mm_xor_si128(t2, r1), _mm_shuffle_epi8(t, rot2));
+		return _mm_xor_si128(out, key63);
+	}
+};
+
+struct vperm_avx2
+{
+	__m256i ipt_lo, ipt_hi, inv, inva, sbou, sbot, sr, sr_rot1, rot2, nibble, poly;
+
+	VPERM_TARGET("avx2") vperm_avx2() :
+		ipt_lo(_mm256_broadcastsi128_si256(VPERM_LOAD(vperm_ipt_lo))), ipt_hi(_mm256_broadcastsi128_si256(VPERM_LOAD(vperm_ipt_hi))),
+		inv(_mm256_broadcastsi128_si256(VPERM_LOAD(vperm_inv))), inva(_mm256_broadcastsi128_si256(VPERM_LOAD(vperm_inva))),
+		sbou(_mm256_broadcastsi128_si256(VPERM_LOAD(vperm_sbou))), sbot(_mm256_broadcastsi128_si256(VPERM_LOAD(vperm_sbot))),
+		sr(_mm256_broadcastsi128_si256(VPERM_LOAD(vperm_sr))), sr_rot1(_mm256_broadcastsi128_si256(VPERM_LOAD(vperm_sr_rot1))),
+		rot2(_mm256_broadcastsi128_si256(VPERM_LOAD(vperm_rot2))), nibble(_mm256_set1_epi8(0x0f)), poly(_mm256_set1_epi8(0x1b))
+	{
+	}
+
+	// same as vperm_ssse3::aesenc, the shuffles never cross the 128 bit lanes
+	VPERM_TARGET("avx2") inline __m256i aesenc(__m256i x, __m256i key63) const
+	{
+		__m256i lo = _mm256_and_si256(x, nibble);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+		__m256i t = _mm256_xor_si256(_mm256_shuffle_epi8(ipt_lo, lo), _mm256_shuffle_epi8(ipt_hi, hi));
+
+		__m256i i = _mm256_and_si256(_mm256_srli_epi16(t, 4), nibble);
+		__m256i k = _mm256_and_si256(t, nibble);
+		__m256i ak = _mm256_shuffle_epi8(inva, k);
+		__m256i j = _mm256_xor_si256(i, k);
+		__m256i iak = _mm256_xor_si256(_mm256_shuffle_epi8(inv, i), ak);
+		__m256i jak = _mm256_xor_si256(_mm256_shuffle_epi8(inv, j), ak);
+		__m256i io = _mm256_xor_si256(_mm256_shuffle_epi8(inv, iak), j);
+		__m256i jo = _mm256_xor_si256(_mm256_shuffle_epi8(inv, jak), i);
+		__m256i s = _mm256_xor_si256(_mm256_shuffle_epi8(sbou, io), _mm256_shuffle_epi8(sbot, jo));
+
+		__m256i a = _mm256_shuffle_epi8(s, sr);
+		__m256i r1 = _mm256_shuffle_epi8(s, sr_rot1);
+		__m256i m = _mm256_xor_si256(a, r1);
+		__m256i m2 = _mm256_xor_si256(_mm256_add_epi8(m, m), _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), m), poly));
+		__m256i out = _mm256_xor_si256(_mm256_xor_si256(m2, r1), _mm256_shuffle_epi8(m, rot2));
+		return _mm256_xor_si256(out, key63);
+	}
+};
+
+#undef VPERM_LOAD
+
+VPERM_TARGET("ssse3") inline __m128i key_add63(__m128i key)
+{
+	return _mm_xor_si128(key, _mm_set1_epi8(0x63));
+}
+
+VPERM_TARGET("ssse3") __m128i aesenc_ssse3(__m128i in, __m128i key)
+{
+	const vperm_ssse3 v;
+	return v.aesenc(in, key_add63(key));
+}
+
+VPERM_TARGET("ssse3") void aes_round_ssse3(__m128i key, __m128i* x0, __m128i* x1, __m128i* x2, __m128i* x3, __m128i* x4, __m128i* x5, __m128i* x6, __m128i* x7)
+{
+	const vperm_ssse3 v;
+	const __m128i k = key_add63(key);
+	*x0 = v.aesenc(*x0, k);
+	*x1 = v.aesenc(*x1, k);
+	*x2 = v.aesenc(*x2, k);
+	*x3 = v.aesenc(*x3, k);
+	*x4 = v.aesenc(*x4, k);
+	*x5 = v.aesenc(*x5, k);
+	*x6 = v.aesenc(*x6, k);
+	*x7 = v.aesenc(*x7, k);
+}
+
+VPERM_TARGET("avx2") inline __m256i vperm_pair(const __m128i* lo, const __m128i* hi)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128(lo)), _mm_load_si128(hi), 1);
+}
+
+VPERM_TARGET("avx2") inline void vperm_unpair(__m256i v, __m128i* lo, __m128i* hi)
+{
+	_mm_store_si128(lo, _mm256_castsi256_si128(v));
+	_mm_store_si128(hi, _mm256_extracti128_si256(v, 1));
+}
+
+VPERM_TARGET("avx2") void aes_round_avx2(__m128i key, __m128i* x0, __m128i* x1, __m128i* x2, __m128i* x3, __m128i* x4, __m128i* x5, __m128i* x6, __m128i* x7)
+{
+	const vperm_avx2 v;
+	const __m256i k = _mm256_xor_si256(_mm256_broadcastsi128_si256(key), _mm256_set1_epi8(0x63));
+	vperm_unpair(v.aesenc(vperm_pair(x0, x1), k), x0, x1);
+	vperm_unpair(v.aesenc(vperm_pair(x2, x3), k), x2, x3);
+	vperm_unpair(v.aesenc(vperm_pair(x4, x5), k), x4, x5);
+	vperm_unpair(v.aesenc(vperm_pair(x6, x7), k), x6, x7);
+}
+
+/** see aes_round_bittube2 in cryptonight_aesni.h
+ *
+ * Every column of the round is added to the state before the next column is calculated.
+ */
+VPERM_TARGET("ssse3") __m128i aes_round_bittube2_ssse3(__m128i val, __m128i key)
+{
+	const vperm_ssse3 v;
+	const __m128i zero63 = key_add63(_mm_setzero_si128());
+	__m128i x = _mm_xor_si128(val, _mm_cmpeq_epi32(_mm_setzero_si128(), _mm_setzero_si128())); // x = ~val
+	__m128i k = key;
+	for(int c = 0; c < 4; c++)
+	{
+		const __m128i mask = _mm_set_epi32(c == 3 ? -1 : 0, c == 2 ? -1 : 0, c == 1 ? -1 : 0, c == 0 ? -1 : 0);
+		k = _mm_xor_si128(k, _mm_and_si128(v.aesenc(x, zero63), mask));
+		x = _mm_xor_si128(x, _mm_and_si128(k, mask));
+	}
+	return k;
+}
+
+VPERM_TARGET("ssse3") __m128i aeskeygenassist_ssse3(__m128i key, uint8_t rcon)
+{
+	const vperm_ssse3 v;
+	__m128i s = _mm_xor_si128(v.sub_bytes(key), _mm_set1_epi8(0x63));
+	s = _mm_shuffle_epi8(s, _mm_load_si128(reinterpret_cast<const __m128i*>(vperm_keygen)));
+	return _mm_xor_si128(s, _mm_set_epi32(rcon, 0, rcon, 0));
+}
+
+} // namespace
+
+const char* soft_aes_select(bool ssse3, bool avx2)
+{
+	if(!ssse3)
+	{
+		soft_aes_vperm = { nullptr, nullptr, nullptr, nullptr };
+		return "lookup tables";
+	}
+
+	soft_aes_vperm.aesenc = aesenc_ssse3;
+	soft_aes_vperm.aes_round = avx2 ? aes_round_avx2 : aes_round_ssse3;
+	soft_aes_vperm.aes_round_bittube2 = aes_round_bittube2_ssse3;
+	soft_aes_vperm.aeskeygenassist = aeskeygenassist_ssse3;
+	return avx2 ? "constant time AVX2" : "constant time SSSE3";
+}
@@ -108,11 +108,13 @@ bool jconf::GetThreadConfig(size_t id, thd_cfg &cfg)
 	if(!oThdConf.IsObject())
 		return false;
 
-	const Value *mode, *no_prefetch, *aff, *asm_version;
+	const Value *mode, *no_prefetch, *aff, *asm_version, *pipeline;
 	mode = GetObjectMember(oThdConf, "low_power_mode");
 	no_prefetch = GetObjectMember(oThdConf, "no_prefetch");
 	aff = GetObjectMember(oThdConf, "affine_to_cpu");
 	asm_version = GetObjectMember(oThdConf, "asm");
+	// optional, older config files do not have this value
+	pipeline = GetObjectMember(oThdConf, "pipeline");
 
 	if(mode == nullptr || no_prefetch == nullptr || aff == nullptr || asm_version == nullptr)
 		return false;
@@ -145,6 +147,10 @@ bool jconf::GetThreadConfig(size_t id, thd_cfg &cfg)
 		return false;
 	cfg.asm_version_str = asm_version->GetString();
 
+	if(pipeline != nullptr && !pipeline->IsBool())
+		return false;
+	cfg.bPipeline = pipeline != nullptr && pipeline->GetBool();
+
 	return true;
 }
 
@@ -157,6 +163,20 @@ size_t jconf::GetThreadCount()
 		return 0;
 }
 
+bool jconf::GetBackgroundMode()
+{
+	// optional, older config files do not have this value
+	const Value* bg = GetObjectMember(prv->jsonDoc, "background_mode");
+	return bg != nullptr && bg->IsBool() && bg->GetBool();
+}
+
+bool jconf::GetPerfCounters()
+{
+	// optional, older config files do not have this value
+	const Value* perf = GetObjectMember(prv->jsonDoc, "perf_counters");
+	return perf != nullptr && perf->IsBool() && perf->GetBool();
+}
+
 bool jconf::parse_config(const char* sFilename)
 {
 	FILE * pFile;
@@ -250,6 +270,20 @@ bool jconf::parse_config(const char* sFilename)
 		}
 	}
 
+	const Value* bg = GetObjectMember(prv->jsonDoc, "background_mode");
+	if(bg != nullptr && !bg->IsBool())
+	{
+		printer::inst()->print_msg(L0, "Invalid config file '%s'. Value \"background_mode\" has unexpected type.", sFilename);
+		return false;
+	}
+
+	const Value* perf = GetObjectMember(prv->jsonDoc, "perf_counters");
+	if(perf != nullptr && !perf->IsBool())
+	{
+		printer::inst()->print_msg(L0, "Invalid config file '%s'. Value \"perf_counters\" has unexpected type.", sFilename);
+		return false;
+	}
+
 	thd_cfg c;
 	for(size_t i=0; i < GetThreadCount(); i++)
 	{
@@ -26,12 +26,16 @@ public:
 		bool bNoPrefetch;
 		std::string asm_version_str;
 		long long iCpuAff;
+		bool bPipeline;
 	};
 
 	size_t GetThreadCount();
 	bool GetThreadConfig(size_t id, thd_cfg &cfg);
 	bool NeedsAutoconf();
 
+	bool GetBackgroundMode();
+	bool GetPerfCounters();
+
 private:
 	jconf();
 	static jconf* oInst;
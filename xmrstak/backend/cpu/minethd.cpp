@@ -32,6 +32,8 @@
 #include "jconf.hpp"
 
 #include "xmrstak/misc/executor.hpp"
+#include "xmrstak/misc/startupTiming.hpp"
+#include "xmrstak/misc/traceRecorder.hpp"
 #include "minethd.hpp"
 #include "xmrstak/jconf.hpp"
 
@@ -44,12 +46,14 @@
 #   include "autoAdjust.hpp"
 #endif
 
+#include <algorithm>
 #include <assert.h>
 #include <cmath>
 #include <chrono>
 #include <cstring>
 #include <thread>
 #include <bitset>
+#include <initializer_list>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -105,7 +109,7 @@ bool minethd::thd_setaffinity(std::thread::native_handle_type h, uint64_t cpu_id
 #endif
 }
 
-minethd::minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch, int64_t affinity, const std::string& asm_version)
+minethd::minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch, int64_t affinity, const std::string& asm_version, bool pipeline, bool background, bool perf_counters)
 {
 	this->backendType = iBackend::CPU;
 	oWork = pWork;
@@ -115,10 +119,13 @@ minethd::minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch,
 	bNoPrefetch = no_prefetch;
 	this->affinity = affinity;
 	asm_version_str = asm_version;
+	bPipeline = pipeline;
+	bPerfCounters = perf_counters;
+	if(background)
+		pBgSlot = backgroundMonitor::inst()->add_thread(affinity);
 
-	std::unique_lock<std::mutex> lck(thd_aff_set);
-	std::future<void> order_guard = order_fix.get_future();
-
+	// The thread pins itself and allocates its scratchpads, there is no need
+	// to wait for it here. All threads are initialized concurrently.
 	switch (iMultiway)
 	{
 	case 5:
@@ -138,12 +145,6 @@ minethd::minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch,
 		oWorkThd = std::thread(&minethd::work_main, this);
 		break;
 	}
-
-	order_guard.wait();
-
-	if(affinity >= 0) //-1 means no affinity
-		if(!thd_setaffinity(oWorkThd.native_handle(), affinity))
-			printer::inst()->print_msg(L1, "WARNING setting affinity failed.");
 }
 
 cryptonight_ctx* minethd::minethd_alloc_ctx()
@@ -183,6 +184,23 @@ cryptonight_ctx* minethd::minethd_alloc_ctx()
 	return nullptr; //Should never happen
 }
 
+void minethd::select_implementations(bool bPrint)
+{
+	auto cpu_model = getModel();
+	const char* soft_aes = soft_aes_select(cpu_model.ssse3, cpu_model.avx2);
+	const char* keccak = keccak_multi_select(cpu_model.avx2, cpu_model.avx512);
+	const char* final_hashes = extra_hashes_select(::jconf::inst()->HaveHardwareAes() && cpu_model.ssse3, cpu_model.avx2);
+	const char* heavy_div = heavy_div_select();
+	if(!bPrint)
+		return;
+
+	if(!::jconf::inst()->HaveHardwareAes())
+		printer::inst()->print_msg(L0, "Software AES: %s.", soft_aes);
+	printer::inst()->print_msg(L1, "Multi hash keccak: %s.", keccak);
+	printer::inst()->print_msg(L1, "Final hashes: %s.", final_hashes);
+	printer::inst()->print_msg(L1, "Heavy division: %s.", heavy_div);
+}
+
 static constexpr size_t MAX_N = 5;
 bool minethd::self_test()
 {
@@ -190,6 +208,9 @@ bool minethd::self_test()
 	size_t res;
 	bool fatal = false;
 
+	// select before the test, the test vectors verify the selected implementations
+	select_implementations(true);
+
 	switch (::jconf::inst()->GetSlowMemSetting())
 	{
 	case ::jconf::never_use:
@@ -407,6 +428,221 @@ bool minethd::self_test()
 	return bResult;
 }
 
+bool minethd::pipeline_self_test()
+{
+	cryptonight_ctx *ctx[2] = {0};
+	for (int i = 0; i < 2; i++)
+	{
+		if ((ctx[i] = minethd_alloc_ctx()) == nullptr)
+		{
+			printer::inst()->print_msg(L0, "ERROR: miner was not able to allocate memory.");
+			for (int j = 0; j < i; j++)
+				cryptonight_free_ctx(ctx[j]);
+			return false;
+		}
+	}
+
+	// two different blobs, the pipelined hashes must be identical to the lockstep hashes
+	unsigned char in[76 * 2];
+	for(size_t i = 0; i < sizeof(in); i++)
+		in[i] = static_cast<unsigned char>(i * 7 + 3);
+
+	unsigned char out[32 * 2];
+	unsigned char ref[32 * 2];
+
+	coinDescription coin = ::jconf::inst()->GetCurrentCoinSelection().GetDescription(1);
+	xmrstak_algo algos[2] = { coin.GetMiningAlgo(), coin.GetMiningAlgoRoot() };
+	bool bHaveAes = ::jconf::inst()->HaveHardwareAes();
+
+	bool bResult = true;
+	for(xmrstak_algo algo : algos)
+	{
+		func_multi_selector<2>(bHaveAes, false, algo, "off", false)(in, 76, ref, ctx);
+		func_multi_selector<2>(bHaveAes, false, algo, "off", true)(in, 76, out, ctx);
+		bResult = bResult && memcmp(out, ref, sizeof(out)) == 0;
+	}
+
+	for (int i = 0; i < 2; i++)
+		cryptonight_free_ctx(ctx[i]);
+
+	if(!bResult)
+		printer::inst()->print_msg(L0, "Pipelined hash self-test failed, pipeline option disabled.");
+
+	return bResult;
+}
+
+bool minethd::jit_self_test(size_t N)
+{
+	cryptonight_ctx *ctx[MAX_N] = {0};
+	for (size_t i = 0; i < N; i++)
+	{
+		if ((ctx[i] = minethd_alloc_ctx()) == nullptr)
+		{
+			printer::inst()->print_msg(L0, "ERROR: miner was not able to allocate memory.");
+			for (size_t j = 0; j < i; j++)
+				cryptonight_free_ctx(ctx[j]);
+			return false;
+		}
+	}
+
+	// N different blobs, the hashes of the generated main loop must be identical to the single hashes
+	unsigned char in[76 * MAX_N];
+	for(size_t i = 0; i < sizeof(in); i++)
+		in[i] = static_cast<unsigned char>(i * 7 + 3);
+
+	unsigned char out[32 * MAX_N];
+	unsigned char ref[32 * MAX_N];
+
+	coinDescription coin = ::jconf::inst()->GetCurrentCoinSelection().GetDescription(1);
+	xmrstak_algo algos[2] = { coin.GetMiningAlgo(), coin.GetMiningAlgoRoot() };
+	bool bHaveAes = ::jconf::inst()->HaveHardwareAes();
+
+	bool bResult = true;
+	for(xmrstak_algo algo : algos)
+	{
+		cn_hash_fun hashf = func_selector(bHaveAes, false, algo);
+		for(size_t i = 0; i < N; i++)
+			hashf(in + 76 * i, 76, ref + 32 * i, ctx);
+
+		// the prefetch flag changes the generated code, test both
+		for(bool bNoPrefetch : { false, true })
+		{
+			cn_hash_fun hashf_multi = nullptr;
+			switch(N)
+			{
+			case 1:
+				hashf_multi = func_multi_selector<1>(bHaveAes, bNoPrefetch, algo, "jit");
+				break;
+			case 2:
+				hashf_multi = func_multi_selector<2>(bHaveAes, bNoPrefetch, algo, "jit");
+				break;
+			case 3:
+				hashf_multi = func_multi_selector<3>(bHaveAes, bNoPrefetch, algo, "jit");
+				break;
+			case 4:
+				hashf_multi = func_multi_selector<4>(bHaveAes, bNoPrefetch, algo, "jit");
+				break;
+			case 5:
+				hashf_multi = func_multi_selector<5>(bHaveAes, bNoPrefetch, algo, "jit");
+				break;
+			default:
+				break;
+			}
+			if(hashf_multi == nullptr)
+			{
+				bResult = false;
+				break;
+			}
+			memset(out, 0, sizeof(out));
+			hashf_multi(in, 76, out, ctx);
+			bResult = bResult && memcmp(out, ref, 32 * N) == 0;
+		}
+	}
+
+	for (size_t i = 0; i < N; i++)
+		cryptonight_free_ctx(ctx[i]);
+
+	if(!bResult)
+		printer::inst()->print_msg(L0, "JIT main loop self-test failed for low_power_mode %u, asm option 'jit' disabled.", unsigned(N));
+
+	return bResult;
+}
+
+/** check the VAES kernels and compare their hash rate with the normal kernels
+ *
+ * @return true if the hashes are identical and the VAES kernel is faster for the mining algorithm
+ */
+bool minethd::vaes_self_test(size_t N)
+{
+	if(N != 2 && N != 4)
+		return false;
+
+	cryptonight_ctx *ctx[MAX_N] = {0};
+	for (size_t i = 0; i < N; i++)
+	{
+		if ((ctx[i] = minethd_alloc_ctx()) == nullptr)
+		{
+			printer::inst()->print_msg(L0, "ERROR: miner was not able to allocate memory.");
+			for (size_t j = 0; j < i; j++)
+				cryptonight_free_ctx(ctx[j]);
+			return false;
+		}
+	}
+
+	unsigned char in[76 * MAX_N];
+	for(size_t i = 0; i < sizeof(in); i++)
+		in[i] = static_cast<unsigned char>(i * 7 + 3);
+
+	unsigned char out[32 * MAX_N];
+	unsigned char ref[32 * MAX_N];
+
+	coinDescription coin = ::jconf::inst()->GetCurrentCoinSelection().GetDescription(1);
+	xmrstak_algo algos[2] = { coin.GetMiningAlgo(), coin.GetMiningAlgoRoot() };
+	bool bHaveAes = ::jconf::inst()->HaveHardwareAes();
+
+	bool bResult = true;
+	bool bFaster = false;
+	for(xmrstak_algo algo : algos)
+	{
+		cn_hash_fun hashf = func_selector(bHaveAes, false, algo);
+		for(size_t i = 0; i < N; i++)
+			hashf(in + 76 * i, 76, ref + 32 * i, ctx);
+
+		cn_hash_fun hashf_multi = nullptr;
+		cn_hash_fun hashf_vaes = nullptr;
+		if(N == 2)
+		{
+			hashf_multi = func_multi_selector<2>(bHaveAes, false, algo);
+			hashf_vaes = func_multi_selector<2>(bHaveAes, false, algo, "vaes");
+		}
+		else
+		{
+			hashf_multi = func_multi_selector<4>(bHaveAes, false, algo);
+			hashf_vaes = func_multi_selector<4>(bHaveAes, false, algo, "vaes");
+		}
+
+		// the selector falls back to the normal kernel if VAES is not available
+		if(hashf_vaes == hashf_multi)
+		{
+			bResult = false;
+			break;
+		}
+		memset(out, 0, sizeof(out));
+		hashf_vaes(in, 76, out, ctx);
+		bResult = bResult && memcmp(out, ref, 32 * N) == 0;
+
+		// only the mining algorithm is timed, best of three hashes to skip interrupts
+		if(algo != algos[0] || !bResult)
+			continue;
+		uint64_t tMulti = UINT64_MAX;
+		uint64_t tVaes = UINT64_MAX;
+		for(int i = 0; i < 3; i++)
+		{
+			using namespace std::chrono;
+			auto t0 = steady_clock::now();
+			hashf_multi(in, 76, out, ctx);
+			auto t1 = steady_clock::now();
+			hashf_vaes(in, 76, out, ctx);
+			auto t2 = steady_clock::now();
+			tMulti = std::min<uint64_t>(tMulti, duration_cast<microseconds>(t1 - t0).count());
+			tVaes = std::min<uint64_t>(tVaes, duration_cast<microseconds>(t2 - t1).count());
+		}
+		bFaster = tVaes < tMulti;
+		printer::inst()->print_msg(L1, "VAES main loop for low_power_mode %u: %.1f ms per call, normal main loop %.1f ms.",
+			unsigned(N), tVaes / 1000.0, tMulti / 1000.0);
+	}
+
+	for (size_t i = 0; i < N; i++)
+		cryptonight_free_ctx(ctx[i]);
+
+	if(!bResult)
+		printer::inst()->print_msg(L0, "VAES main loop self-test failed for low_power_mode %u, asm option 'vaes' disabled.", unsigned(N));
+	else if(!bFaster)
+		printer::inst()->print_msg(L1, "VAES main loop is slower for low_power_mode %u, asm option 'vaes' disabled.", unsigned(N));
+
+	return bResult && bFaster;
+}
+
 std::vector<iBackend*> minethd::thread_starter(uint32_t threadOffset, miner_work& pWork)
 {
 	std::vector<iBackend*> pvThreads;
@@ -429,26 +665,66 @@ std::vector<iBackend*> minethd::thread_starter(uint32_t threadOffset, miner_work
 	size_t i, n = jconf::inst()->GetThreadCount();
 	pvThreads.reserve(n);
 
+	bool background = jconf::inst()->GetBackgroundMode();
+	bool perf_counters = jconf::inst()->GetPerfCounters();
+	int pipeline_ok = -1;
+	int jit_ok[MAX_N + 1] = { -1, -1, -1, -1, -1, -1 };
+	int vaes_ok[MAX_N + 1] = { -1, -1, -1, -1, -1, -1 };
+
 	jconf::thd_cfg cfg;
 	for (i = 0; i < n; i++)
 	{
 		jconf::inst()->GetThreadConfig(i, cfg);
 
+		if(cfg.bPipeline)
+		{
+			if(cfg.iMultiway < 2)
+			{
+				printer::inst()->print_msg(L1, "WARNING: pipeline needs low_power_mode 2 or more, option ignored.");
+				cfg.bPipeline = false;
+			}
+			else
+			{
+				if(pipeline_ok == -1)
+					pipeline_ok = pipeline_self_test() ? 1 : 0;
+				cfg.bPipeline = pipeline_ok == 1;
+			}
+		}
+
+		if(cfg.asm_version_str == "jit" && !cfg.bPipeline && cfg.iMultiway >= 1 && size_t(cfg.iMultiway) <= MAX_N)
+		{
+			if(jit_ok[cfg.iMultiway] == -1)
+				jit_ok[cfg.iMultiway] = jit_self_test(cfg.iMultiway) ? 1 : 0;
+			if(jit_ok[cfg.iMultiway] == 0)
+				cfg.asm_version_str = "off";
+		}
+
+		if(cfg.asm_version_str == "vaes" && !cfg.bPipeline && cfg.iMultiway >= 1 && size_t(cfg.iMultiway) <= MAX_N)
+		{
+			if(vaes_ok[cfg.iMultiway] == -1)
+				vaes_ok[cfg.iMultiway] = vaes_self_test(cfg.iMultiway) ? 1 : 0;
+			if(vaes_ok[cfg.iMultiway] == 0)
+				cfg.asm_version_str = "off";
+		}
+
 		if(cfg.iCpuAff >= 0)
 		{
 #if defined(__APPLE__)
 			printer::inst()->print_msg(L1, "WARNING on macOS thread affinity is only advisory.");
 #endif
 
-			printer::inst()->print_msg(L1, "Starting %dx thread, affinity: %d.", cfg.iMultiway, (int)cfg.iCpuAff);
+			printer::inst()->print_msg(L1, "Starting %dx%s thread, affinity: %d.", cfg.iMultiway, cfg.bPipeline ? " pipelined" : "", (int)cfg.iCpuAff);
 		}
 		else
-			printer::inst()->print_msg(L1, "Starting %dx thread, no affinity.", cfg.iMultiway);
+			printer::inst()->print_msg(L1, "Starting %dx%s thread, no affinity.", cfg.iMultiway, cfg.bPipeline ? " pipelined" : "");
 
-		minethd* thd = new minethd(pWork, i + threadOffset, cfg.iMultiway, cfg.bNoPrefetch, cfg.iCpuAff, cfg.asm_version_str);
+		minethd* thd = new minethd(pWork, i + threadOffset, cfg.iMultiway, cfg.bNoPrefetch, cfg.iCpuAff, cfg.asm_version_str, cfg.bPipeline, background, perf_counters);
 		pvThreads.push_back(thd);
 	}
 
+	if(background && n != 0)
+		backgroundMonitor::inst()->start();
+
 	return pvThreads;
 }
 
@@ -475,8 +751,163 @@ static std::string getAsmName(const uint32_t num_hashes)
 	return asm_type;
 }
 
+/** select the phase pipelined hash function
+ *
+ * @param idx index in the hash function table, see func_multi_selector
+ * @return nullptr for a single hash, there is nothing to overlap
+ */
 template<size_t N>
-minethd::cn_hash_fun minethd::func_multi_selector(bool bHaveAes, bool bNoPrefetch, xmrstak_algo algo, const std::string& asm_version_str)
+static minethd::cn_hash_fun func_pipelined_selector(size_t idx)
+{
+	static const minethd::cn_hash_fun func_table[] = {
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_monero, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_monero, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_monero, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_monero, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_lite, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_lite, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_lite, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_lite, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_heavy, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_heavy, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_heavy, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_heavy, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_aeon, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_aeon, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_aeon, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_aeon, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_ipbc, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_ipbc, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_ipbc, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_ipbc, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_stellite, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_stellite, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_stellite, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_stellite, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_masari, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_masari, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_masari, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_masari, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_haven, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_haven, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_haven, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_haven, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_bittube2, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_bittube2, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_bittube2, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_bittube2, true, true>,
+
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_monero_v8, false, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_monero_v8, true, false>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_monero_v8, false, true>,
+		Cryptonight_hash_pipelined<N>::template hash<cryptonight_monero_v8, true, true>
+	};
+
+	return func_table[idx];
+}
+
+template<>
+minethd::cn_hash_fun func_pipelined_selector<1>(size_t)
+{
+	return nullptr;
+}
+
+/** get the cryptonight_v8 kernel with lane shared AVX2 division and square root
+ *
+ * @param idx two digit binary index, bit 0 is the soft AES flag and bit 1 the prefetch flag
+ */
+template<size_t N>
+static minethd::cn_hash_fun func_v8_avx2_selector(size_t idx)
+{
+	static const minethd::cn_hash_fun func_table[] = {
+		Cryptonight_hash_v8_avx2<N>::template hash<cryptonight_monero_v8, false, false>,
+		Cryptonight_hash_v8_avx2<N>::template hash<cryptonight_monero_v8, true, false>,
+		Cryptonight_hash_v8_avx2<N>::template hash<cryptonight_monero_v8, false, true>,
+		Cryptonight_hash_v8_avx2<N>::template hash<cryptonight_monero_v8, true, true>
+	};
+
+	return func_table[idx];
+}
+
+template<>
+minethd::cn_hash_fun func_v8_avx2_selector<1>(size_t idx)
+{
+	return nullptr;
+}
+
+/** get the VAES kernel for an algorithm
+ *
+ * @param idx algorithm index (algv in func_multi_selector) times two plus the prefetch flag
+ */
+template<size_t N, bool ZMM>
+static minethd::cn_hash_fun func_vaes_table(size_t idx)
+{
+	static const minethd::cn_hash_fun func_table[] = {
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_monero, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_monero, true>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_lite, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_lite, true>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight, true>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_heavy, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_heavy, true>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_aeon, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_aeon, true>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_ipbc, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_ipbc, true>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_stellite, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_stellite, true>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_masari, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_masari, true>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_haven, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_haven, true>,
+		// cryptonight_bittube2 is not supported
+		nullptr,
+		nullptr,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_monero_v8, false>,
+		Cryptonight_hash_vaes<N, ZMM>::template hash<cryptonight_monero_v8, true>
+	};
+
+	return func_table[idx];
+}
+
+/** VAES kernels exist for two and four hashes per thread
+ *
+ * Four hashes use zmm registers if the CPU has AVX-512F.
+ */
+template<size_t N>
+static minethd::cn_hash_fun func_vaes_selector(size_t)
+{
+	return nullptr;
+}
+
+template<>
+minethd::cn_hash_fun func_vaes_selector<2>(size_t idx)
+{
+	return func_vaes_table<2, false>(idx);
+}
+
+template<>
+minethd::cn_hash_fun func_vaes_selector<4>(size_t idx)
+{
+	return cpu::getModel().avx512 ? func_vaes_table<4, true>(idx) : func_vaes_table<4, false>(idx);
+}
+
+template<size_t N>
+minethd::cn_hash_fun minethd::func_multi_selector(bool bHaveAes, bool bNoPrefetch, xmrstak_algo algo, const std::string& asm_version_str, bool bPipeline, bool bFallback)
 {
 	static_assert(N >= 1, "number of threads must be >= 1" );
 
@@ -588,6 +1019,74 @@ minethd::cn_hash_fun minethd::func_multi_selector(bool bHaveAes, bool bNoPrefetc
 
 	auto selected_function = func_table[ algv << 2 | digit.to_ulong() ];
 
+	if(bPipeline && N >= 2)
+		return func_pipelined_selector<N>(algv << 2 | digit.to_ulong());
+	if(bPipeline && !bFallback)
+		return nullptr;
+
+	// main loop generated at runtime, checked by jit_self_test
+	if(asm_version_str == "jit")
+	{
+		static const cn_hash_fun jit_table[] = {
+			Cryptonight_hash_jit<N>::template hash<cryptonight_monero, false>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_monero, true>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_lite, false>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_lite, true>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight, false>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight, true>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_heavy, false>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_heavy, true>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_aeon, false>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_aeon, true>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_ipbc, false>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_ipbc, true>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_stellite, false>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_stellite, true>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_masari, false>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_masari, true>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_haven, false>,
+			Cryptonight_hash_jit<N>::template hash<cryptonight_haven, true>,
+			// cryptonight_bittube2 and cryptonight_monero_v8 are not supported
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+
+		if(bHaveAes && cn_jit_supported(algo, N) && cn_jit_get(algo, N, !bNoPrefetch) != nullptr)
+			return jit_table[algv << 1 | (bNoPrefetch ? 0 : 1)];
+		if(!bFallback)
+			return nullptr;
+
+		printer::inst()->print_msg(L1, "JIT main loop not available for this algorithm, fallback to non JIT version");
+		return selected_function;
+	}
+
+	// AES rounds of the main loop of all hashes in one instruction, checked and timed by vaes_self_test
+	if(asm_version_str == "vaes")
+	{
+		auto cpu_model = cpu::getModel();
+		cn_hash_fun fun = nullptr;
+		if(bHaveAes && cpu_model.vaes)
+			fun = func_vaes_selector<N>(algv << 1 | (bNoPrefetch ? 0 : 1));
+		if(fun != nullptr || !bFallback)
+			return fun;
+
+		printer::inst()->print_msg(L1, "VAES main loop needs hardware VAES and low_power_mode 2 or 4, not available for cryptonight_bittube2, fallback to non VAES version");
+		return selected_function;
+	}
+
+	// division and square root of all hashes of a thread in one AVX2 register
+	if(algo == cryptonight_monero_v8 && asm_version_str == "avx2_div")
+	{
+		if(N >= 2 && cpu::getModel().avx2)
+			return func_v8_avx2_selector<N>(digit.to_ulong());
+		if(!bFallback)
+			return nullptr;
+
+		printer::inst()->print_msg(L1, "Lane shared division needs AVX2 and low_power_mode 2 or more, fallback to non asm version of cryptonight_v8");
+		return selected_function;
+	}
 
 	// check for asm optimized version for cryptonight_v8
 	if(N <= 2 && algo == cryptonight_monero_v8 && bHaveAes)
@@ -614,11 +1113,15 @@ minethd::cn_hash_fun minethd::func_multi_selector(bool bHaveAes, bool bNoPrefetc
 			}
 			if(asm_version_str == "auto" && (selected_asm != "intel_avx" || selected_asm != "amd_avx"))
 				printer::inst()->print_msg(L3, "Switch to assembler version for '%s' cpu's", selected_asm.c_str());
-			else if(selected_asm != "intel_avx" && selected_asm != "amd_avx") // unknown asm type
+			else if(selected_asm != "intel_avx" && selected_asm != "amd_avx" && bFallback) // unknown asm type
 				printer::inst()->print_msg(L1, "Assembler '%s' unknown, fallback to non asm version of cryptonight_v8", selected_asm.c_str());
 		}
 	}
-	
+
+	// no asm version for this algorithm, number of hashes or CPU
+	if(!bFallback && asm_version_str != "off" && selected_function == func_table[algv << 2 | digit.to_ulong()])
+		return nullptr;
+
 	return selected_function;
 }
 
@@ -627,6 +1130,26 @@ minethd::cn_hash_fun minethd::func_selector(bool bHaveAes, bool bNoPrefetch, xmr
 	return func_multi_selector<1>(bHaveAes, bNoPrefetch, algo);
 }
 
+minethd::cn_hash_fun minethd::func_multiway_selector(size_t N, bool bHaveAes, bool bNoPrefetch, xmrstak_algo algo,
+	const std::string& asm_version_str, bool bPipeline, bool bFallback)
+{
+	switch(N)
+	{
+	case 1:
+		return func_multi_selector<1>(bHaveAes, bNoPrefetch, algo, asm_version_str, bPipeline, bFallback);
+	case 2:
+		return func_multi_selector<2>(bHaveAes, bNoPrefetch, algo, asm_version_str, bPipeline, bFallback);
+	case 3:
+		return func_multi_selector<3>(bHaveAes, bNoPrefetch, algo, asm_version_str, bPipeline, bFallback);
+	case 4:
+		return func_multi_selector<4>(bHaveAes, bNoPrefetch, algo, asm_version_str, bPipeline, bFallback);
+	case 5:
+		return func_multi_selector<5>(bHaveAes, bNoPrefetch, algo, asm_version_str, bPipeline, bFallback);
+	default:
+		return nullptr;
+	}
+}
+
 void minethd::work_main()
 {
 	multiway_work_main<1u>();
@@ -652,6 +1175,19 @@ void minethd::penta_work_main()
 	multiway_work_main<5u>();
 }
 
+void minethd::park_wait(uint64_t iCount)
+{
+	uint64_t iStart = get_timestamp_ms();
+	while (pBgSlot->bParked.load(std::memory_order_relaxed))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		// keep the telemetry going, a parked thread has a hashrate of zero
+		update_hash_count(iCount, get_timestamp_ms());
+	}
+	iParkedTime.fetch_add(get_timestamp_ms() - iStart, std::memory_order_relaxed);
+}
+
 template<size_t N>
 void minethd::prep_multiway_work(uint8_t *bWorkBlob, uint32_t **piNonce)
 {
@@ -666,13 +1202,27 @@ void minethd::prep_multiway_work(uint8_t *bWorkBlob, uint32_t **piNonce)
 template<uint32_t N>
 void minethd::multiway_work_main()
 {
+	size_t iStartupMs = startupTiming::inst()->now();
+
 	if(affinity >= 0) //-1 means no affinity
+	{
 		bindMemoryToNUMANode(affinity);
 
-	order_fix.set_value();
-	std::unique_lock<std::mutex> lck(thd_aff_set);
-	lck.release();
-	std::this_thread::yield();
+#if defined(_WIN32)
+		std::thread::native_handle_type h = GetCurrentThread();
+#else
+		std::thread::native_handle_type h = pthread_self();
+#endif
+		if(!thd_setaffinity(h, affinity))
+			printer::inst()->print_msg(L1, "WARNING setting affinity failed.");
+	}
+
+	if(pBgSlot != nullptr)
+		backgroundMonitor::enter_background(pBgSlot);
+
+	// the counters only count this thread, on whichever core it runs
+	if(bPerfCounters)
+		oPerfCounters.open_thread();
 
 	cryptonight_ctx *ctx[MAX_N];
 	uint64_t iCount = 0;
@@ -697,6 +1247,15 @@ void minethd::multiway_work_main()
 		piNonce[i] = (i == 0) ? (uint32_t*)(bWorkBlob + 39) : nullptr;
 	}
 
+	startupTiming::inst()->record("cpu scratchpad allocation", iStartupMs);
+
+	globalStates::inst().wait_thread_numbers();
+	traceRecorder::inst().set_thread_name("cpu " + std::to_string(iThreadNo));
+
+#ifdef XMRSTAK_PHASE_STATS
+	phaseStats::attach(&oPhaseStats);
+#endif
+
 	if(!oWork.bStall)
 		prep_multiway_work<N>(bWorkBlob, piNonce);
 
@@ -704,7 +1263,7 @@ void minethd::multiway_work_main()
 
 	// start with root algorithm and switch later if fork version is reached
 	auto miner_algo = ::jconf::inst()->GetCurrentCoinSelection().GetDescription(1).GetMiningAlgoRoot();
-	cn_hash_fun hash_fun_multi = func_multi_selector<N>(::jconf::inst()->HaveHardwareAes(), bNoPrefetch, miner_algo, asm_version_str);
+	cn_hash_fun hash_fun_multi = func_multi_selector<N>(::jconf::inst()->HaveHardwareAes(), bNoPrefetch, miner_algo, asm_version_str, bPipeline);
 	uint8_t version = 0;
 	size_t lastPoolId = 0;
 
@@ -716,11 +1275,16 @@ void minethd::multiway_work_main()
 			either because of network latency, or a socket problem. Since we are
 			raison d'etre of this software it us sensible to just wait until we have something*/
 
+			uint64_t iStallStartUs = traceRecorder::now_us();
 			while (globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			XMRSTAK_PHASE(STALL);
 
 			globalStates::inst().consume_work(oWork, iJobNo);
+			traceRecorder::inst().complete("worker", "stall", iStallStartUs, traceRecorder::now_us(),
+				oWork.bStall ? nullptr : oWork.sJobID);
 			prep_multiway_work<N>(bWorkBlob, piNonce);
+			XMRSTAK_PHASE(CONSUME_WORK);
 			continue;
 		}
 
@@ -739,12 +1303,12 @@ void minethd::multiway_work_main()
 			if(new_version >= coinDesc.GetMiningForkVersion())
 			{
 				miner_algo = coinDesc.GetMiningAlgo();
-				hash_fun_multi = func_multi_selector<N>(::jconf::inst()->HaveHardwareAes(), bNoPrefetch, miner_algo, asm_version_str);
+				hash_fun_multi = func_multi_selector<N>(::jconf::inst()->HaveHardwareAes(), bNoPrefetch, miner_algo, asm_version_str, bPipeline);
 			}
 			else
 			{
 				miner_algo = coinDesc.GetMiningAlgoRoot();
-				hash_fun_multi = func_multi_selector<N>(::jconf::inst()->HaveHardwareAes(), bNoPrefetch, miner_algo, asm_version_str);
+				hash_fun_multi = func_multi_selector<N>(::jconf::inst()->HaveHardwareAes(), bNoPrefetch, miner_algo, asm_version_str, bPipeline);
 			}
 			lastPoolId = oWork.iPoolId;
 			version = new_version;
@@ -754,9 +1318,7 @@ void minethd::multiway_work_main()
 		{
 			if ((iCount++ & 0x7) == 0)  //Store stats every 8*N hashes
 			{
-				uint64_t iStamp = get_timestamp_ms();
-				iHashCount.store(iCount * N, std::memory_order_relaxed);
-				iTimestamp.store(iStamp, std::memory_order_relaxed);
+				update_hash_count(iCount * N, get_timestamp_ms());
 			}
 
 			nonce_ctr -= N;
@@ -773,6 +1335,7 @@ void minethd::multiway_work_main()
 				*piNonce[i] = iNonce++;
 
 			hash_fun_multi(bWorkBlob, oWork.iWorkSize, bHashOut, ctx);
+			XMRSTAK_PHASE_HASHES(N);
 
 			for (size_t i = 0; i < N; i++)
 			{
@@ -785,11 +1348,18 @@ void minethd::multiway_work_main()
 				}
 			}
 
-			std::this_thread::yield();
+			if(pBgSlot != nullptr && pBgSlot->bParked.load(std::memory_order_relaxed))
+			{
+				XMRSTAK_PHASE(WORKER);
+				park_wait(iCount * N);
+				XMRSTAK_PHASE(PARKED);
+			}
 		}
 
+		XMRSTAK_PHASE(WORKER);
 		globalStates::inst().consume_work(oWork, iJobNo);
 		prep_multiway_work<N>(bWorkBlob, piNonce);
+		XMRSTAK_PHASE(CONSUME_WORK);
 	}
 
 	for (int i = 0; i < N; i++)
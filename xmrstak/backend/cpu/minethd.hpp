@@ -4,6 +4,7 @@
 #include "crypto/cryptonight.h"
 #include "xmrstak/backend/miner_work.hpp"
 #include "xmrstak/backend/iBackend.hpp"
+#include "backgroundMonitor.hpp"
 
 #include <iostream>
 #include <thread>
@@ -22,9 +23,26 @@ public:
 	static std::vector<iBackend*> thread_starter(uint32_t threadOffset, miner_work& pWork);
 	static bool self_test();
 
+	/** select the software AES, the multi hash keccak, the final hashes and the heavy division
+	 *
+	 * The selection is per module. The GPU plugins have their own copy of the
+	 * CPU hash code and select for it before they verify results on the CPU.
+	 *
+	 * @param bPrint print the selected implementations
+	 */
+	static void select_implementations(bool bPrint);
+
 	typedef void (*cn_hash_fun)(const void*, size_t, void*, cryptonight_ctx**);
 
 	static cn_hash_fun func_selector(bool bHaveAes, bool bNoPrefetch, xmrstak_algo algo);
+	/** kernel of N hashes per call, see func_multi_selector
+	 *
+	 * @param bFallback use the template kernel if the requested asm or pipelined
+	 *                  kernel is not available, else return nullptr without a message
+	 * @return nullptr if N is not 1 to 5
+	 */
+	static cn_hash_fun func_multiway_selector(size_t N, bool bHaveAes, bool bNoPrefetch, xmrstak_algo algo,
+		const std::string& asm_version_str = "off", bool bPipeline = false, bool bFallback = true);
 	static bool thd_setaffinity(std::thread::native_handle_type h, uint64_t cpu_id);
 
 	static cryptonight_ctx* minethd_alloc_ctx();
@@ -32,9 +50,13 @@ public:
 private:
 
 	template<size_t N>
-	static cn_hash_fun func_multi_selector(bool bHaveAes, bool bNoPrefetch, xmrstak_algo algo, const std::string& asm_version_str = "off");
+	static cn_hash_fun func_multi_selector(bool bHaveAes, bool bNoPrefetch, xmrstak_algo algo, const std::string& asm_version_str = "off", bool bPipeline = false, bool bFallback = true);
+
+	static bool pipeline_self_test();
+	static bool jit_self_test(size_t N);
+	static bool vaes_self_test(size_t N);
 
-	minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch, int64_t affinity, const std::string& asm_version);
+	minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch, int64_t affinity, const std::string& asm_version, bool pipeline, bool background, bool perf_counters);
 
 	template<uint32_t N>
 	void multiway_work_main();
@@ -48,19 +70,22 @@ private:
 	void quad_work_main();
 	void penta_work_main();
 
+	void park_wait(uint64_t iCount);
+
 	uint64_t iJobNo;
 
 	miner_work oWork;
 
-	std::promise<void> order_fix;
-	std::mutex thd_aff_set;
-
 	std::thread oWorkThd;
 	int64_t affinity;
 
 	bool bQuit;
 	bool bNoPrefetch;
 	std::string asm_version_str = "off";
+	bool bPipeline = false;
+	bool bPerfCounters = false;
+
+	backgroundMonitor::thd_slot* pBgSlot = nullptr;
 };
 
 } // namespace cpu
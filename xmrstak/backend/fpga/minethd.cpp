@@ -32,6 +32,7 @@
 #include "xmrstak/misc/executor.hpp"
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/environment.hpp"
+#include "xmrstak/misc/traceRecorder.hpp"
 #include "xmrstak/backend/cpu/hwlocMemory.hpp"
 #include "xmrstak/backend/cryptonight.hpp"
 #include "xmrstak/misc/utility.hpp"
@@ -297,6 +298,8 @@ std::vector<iBackend*>* minethd::thread_starter(uint32_t threadOffset, miner_wor
 		win_exit();
 	}
 
+	// the CPU hash code of this plugin verifies the results
+	cpu::minethd::select_implementations(false);
 
 	//Launch the requested number of single and double threads, to distribute
 	//load evenly we need to alternate single and double threads
@@ -366,6 +369,9 @@ void minethd::work_main()
 	cryptonight_ctx* cpu_ctx;
 	cpu_ctx = cpu::minethd::minethd_alloc_ctx();
 
+	globalStates::inst().wait_thread_numbers();
+	traceRecorder::inst().set_thread_name("fpga " + std::to_string(iThreadNo));
+
 	// start with root algorithm and switch later if fork version is reached
 	auto miner_algo = ::jconf::inst()->GetCurrentCoinSelection().GetDescription(1).GetMiningAlgoRoot();
 	cn_hash_fun hash_fun = cpu::minethd::func_selector(::jconf::inst()->HaveHardwareAes(), true /*bNoPrefetch*/, miner_algo);
@@ -380,10 +386,13 @@ void minethd::work_main()
 			either because of network latency, or a socket problem. Since we are
 			raison d'etre of this software it us sensible to just wait until we have something*/
 
+			uint64_t iStallStartUs = traceRecorder::now_us();
 			while (globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 			globalStates::inst().consume_work(oWork, iJobNo);
+			traceRecorder::inst().complete("worker", "stall", iStallStartUs, traceRecorder::now_us(),
+				oWork.bStall ? nullptr : oWork.sJobID);
 			prep_work(bWorkBlob, piNonce);
 			continue;
 		}
@@ -23,6 +23,7 @@
 
 #include "miner_work.hpp"
 #include "globalStates.hpp"
+#include "xmrstak/misc/traceRecorder.hpp"
 
 #include <assert.h>
 #include <cmath>
@@ -41,10 +42,14 @@ void globalStates::consume_work( miner_work& threadWork, uint64_t& currentJobId)
 	currentJobId = iGlobalJobNo.load(std::memory_order_relaxed);
 
 	jobLock.UnLock();
+
+	// a stall job has no id
+	traceRecorder::inst().instant("worker", "pickup", threadWork.bStall ? nullptr : threadWork.sJobID, "job_no", currentJobId);
 }
 
 void globalStates::switch_work(miner_work& pWork, pool_data& dat)
 {
+	uint64_t iStartUs = traceRecorder::now_us();
 	jobLock.WriteLock();
 
 	/* This notifies all threads that the job has changed.
@@ -62,8 +67,12 @@ void globalStates::switch_work(miner_work& pWork, pool_data& dat)
 	 */
 	dat.iSavedNonce = iGlobalNonce.exchange(dat.iSavedNonce, std::memory_order_relaxed);
 	oGlobalWork = pWork;
+	uint64_t iJobNo = iGlobalJobNo.load(std::memory_order_relaxed);
 
 	jobLock.UnLock();
+
+	traceRecorder::inst().complete("job", pWork.bStall ? "switch_work stall" : "switch_work", iStartUs, traceRecorder::now_us(),
+		pWork.bStall ? nullptr : pWork.sJobID, "job_no", iJobNo);
 }
 
 } // namespace xmrstak
@@ -7,10 +7,17 @@
 #include "xmrstak/cpputil/read_write_lock.h"
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <xmmintrin.h>
 
 namespace xmrstak
 {
 
+// Size used to separate data written by different threads
+constexpr std::size_t cache_line_size = 64;
+
 struct globalStates
 {
 	static inline globalStates& inst()
@@ -34,18 +41,39 @@ struct globalStates
 
 	void consume_work( miner_work& threadWork, uint64_t& currentJobId);
 
-	miner_work oGlobalWork;
-	std::atomic<uint64_t> iGlobalJobNo;
-	std::atomic<uint64_t> iConsumeCnt;
-	std::atomic<uint32_t> iGlobalNonce;
+	/** wait until BackendConnector::thread_starter has set the final thread numbers
+	 *
+	 * The backends are started concurrently and number their threads from zero,
+	 * a worker must not read its iThreadNo before this returns.
+	 */
+	inline void wait_thread_numbers()
+	{
+		while(!bThreadsNumbered.load(std::memory_order_acquire))
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	/* The members are grouped by who is writing them, each group starts on its own
+	 * cache line. iGlobalJobNo is polled by all workers on every hash and is only
+	 * written on a job switch, a worker reserving nonces or consuming a job must not
+	 * invalidate the cache line of the job number for all other workers.
+	 */
+	alignas(cache_line_size) std::atomic<uint64_t> iGlobalJobNo;
+	alignas(cache_line_size) std::atomic<uint32_t> iGlobalNonce;
+	alignas(cache_line_size) std::atomic<uint64_t> iConsumeCnt;
+	alignas(cache_line_size) miner_work oGlobalWork;
 	uint64_t iThreadCount;
+	std::atomic<bool> bThreadsNumbered;
 	size_t pool_id = invalid_pool_id;
 
 private:
-	globalStates() : iThreadCount(0), iGlobalJobNo(0), iConsumeCnt(0)
+	globalStates() : iGlobalJobNo(0), iGlobalNonce(0), iConsumeCnt(0), iThreadCount(0), bThreadsNumbered(false)
 	{
 	}
 
+	// the default operator new does not respect the alignment before C++17
+	static void* operator new(std::size_t size) { return _mm_malloc(size, cache_line_size); }
+	static void operator delete(void* ptr) { _mm_free(ptr); }
+
 	::cpputil::RWLock jobLock;
 };
 
@@ -1,12 +1,16 @@
 #pragma once
 
 #include "xmrstak/backend/globalStates.hpp"
+#include "xmrstak/misc/phaseStats.hpp"
+#include "xmrstak/misc/perfCounters.hpp"
+#include "xmrstak/misc/shmStatsLayout.hpp"
 
 #include <atomic>
 #include <cstdint>
 #include <climits>
 #include <vector>
 #include <string>
+#include <xmmintrin.h>
 
 template <typename T, std::size_t N>
 constexpr std::size_t countof(T const (&)[N]) noexcept
@@ -37,14 +41,51 @@ namespace xmrstak
 			return backendNames[i];
 		}
 
-		std::atomic<uint64_t> iHashCount;
+		/* Written by the worker thread and read by the executor, the counters have
+		 * their own cache line so that they do not share it with the members of the
+		 * derived class or with the counters of the next thread.
+		 */
+		alignas(cache_line_size) std::atomic<uint64_t> iHashCount;
 		std::atomic<uint64_t> iTimestamp;
-		uint32_t iThreadNo;
+		// milliseconds the thread was parked by the background mode
+		std::atomic<uint64_t> iParkedTime;
+		// block of the shared memory statistics, set by the executor if they are enabled
+		std::atomic<shm::thread_stats*> pShmSlot;
+
+		// publish the hash count, only called by the worker thread
+		inline void update_hash_count(uint64_t iCount, uint64_t iStamp)
+		{
+			iHashCount.store(iCount, std::memory_order_relaxed);
+			iTimestamp.store(iStamp, std::memory_order_relaxed);
+
+			shm::thread_stats* slot = pShmSlot.load(std::memory_order_acquire);
+			if(slot != nullptr)
+			{
+				shm::write_begin(*slot);
+				slot->hashes = iCount;
+				slot->timestamp_ms = iStamp;
+				shm::write_end(*slot);
+			}
+		}
+
+#ifdef XMRSTAK_PHASE_STATS
+		// cycles of the hash phases, only written by CPU worker threads
+		phaseStats oPhaseStats;
+#endif
+
+		// hardware counters, opened by the worker thread and sampled by the executor
+		perfCounters oPerfCounters;
+
+		alignas(cache_line_size) uint32_t iThreadNo;
 		BackendType backendType = UNKNOWN;
 
-		iBackend() : iHashCount(0), iTimestamp(0)
+		iBackend() : iHashCount(0), iTimestamp(0), iParkedTime(0), pShmSlot(nullptr)
 		{
 		}
+
+		// the default operator new does not respect the alignment before C++17
+		static void* operator new(std::size_t size) { return _mm_malloc(size, cache_line_size); }
+		static void operator delete(void* ptr) { _mm_free(ptr); }
 	};
 
 } // namespace xmrstak
@@ -31,6 +31,7 @@
 #include "xmrstak/misc/executor.hpp"
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/environment.hpp"
+#include "xmrstak/misc/traceRecorder.hpp"
 #include "xmrstak/backend/cpu/hwlocMemory.hpp"
 #include "xmrstak/backend/cryptonight.hpp"
 #include "xmrstak/misc/utility.hpp"
@@ -159,6 +160,9 @@ std::vector<iBackend*>* minethd::thread_starter(uint32_t threadOffset, miner_wor
 		win_exit();
 	}
 
+	// the CPU hash code of this plugin verifies the results
+	cpu::minethd::select_implementations(false);
+
 	int deviceCount = 0;
 	if(cuda_get_devicecount(&deviceCount) != 1)
 	{
@@ -209,7 +213,7 @@ void minethd::work_main()
 
 	if(cuda_get_deviceinfo(&ctx) != 0 || cryptonight_extra_cpu_init(&ctx) != 1)
 	{
-		printer::inst()->print_msg(L0, "Setup failed for GPU %d. Exiting.\n", (int)iThreadNo);
+		printer::inst()->print_msg(L0, "Setup failed for GPU %d. Exiting.\n", ctx.device_id);
 		std::exit(0);
 	}
 
@@ -224,6 +228,9 @@ void minethd::work_main()
 	cryptonight_ctx* cpu_ctx;
 	cpu_ctx = cpu::minethd::minethd_alloc_ctx();
 
+	globalStates::inst().wait_thread_numbers();
+	traceRecorder::inst().set_thread_name("nvidia " + std::to_string(iThreadNo));
+
 	// start with root algorithm and switch later if fork version is reached
 	auto miner_algo = ::jconf::inst()->GetCurrentCoinSelection().GetDescription(1).GetMiningAlgoRoot();
 	cn_hash_fun hash_fun = cpu::minethd::func_selector(::jconf::inst()->HaveHardwareAes(), true /*bNoPrefetch*/, miner_algo);
@@ -242,10 +249,13 @@ void minethd::work_main()
 			 * raison d'etre of this software it us sensible to just wait until we have something
 			 */
 
+			uint64_t iStallStartUs = traceRecorder::now_us();
 			while (globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 			globalStates::inst().consume_work(oWork, iJobNo);
+			traceRecorder::inst().complete("worker", "stall", iStallStartUs, traceRecorder::now_us(),
+				oWork.bStall ? nullptr : oWork.sJobID);
 			continue;
 		}
 		uint8_t new_version = oWork.getVersion();
@@ -318,9 +328,7 @@ void minethd::work_main()
 			iNonce += h_per_round;
 
 			using namespace std::chrono;
-			uint64_t iStamp = get_timestamp_ms();
-			iHashCount.store(iCount, std::memory_order_relaxed);
-			iTimestamp.store(iStamp, std::memory_order_relaxed);
+			update_hash_count(iCount, get_timestamp_ms());
 			std::this_thread::yield();
 		}
 
@@ -27,11 +27,17 @@
 #include "xmrstak/backend/backendConnector.hpp"
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/console.hpp"
+#include "xmrstak/misc/startupTiming.hpp"
+#include "xmrstak/misc/benchmark.hpp"
+#include "xmrstak/misc/shmStats.hpp"
+#include "xmrstak/misc/traceRecorder.hpp"
+#include "xmrstak/net/sessionLog.hpp"
 #include "xmrstak/donate-level.hpp"
 #include "xmrstak/params.hpp"
 #include "xmrstak/misc/configEditor.hpp"
 #include "xmrstak/version.hpp"
 #include "xmrstak/misc/utility.hpp"
+#include "xmrstak/backend/cpu/crypto/cryptonight.h"
 
 #ifndef CONF_NO_HTTPD
 #	include "xmrstak/http/httpd.hpp"
@@ -55,8 +61,6 @@
 #	include "xmrstak/misc/uac.hpp"
 #endif // _WIN32
 
-int do_benchmark(int block_version, int wait_sec, int work_sec);
-
 void help()
 {
 	using namespace std;
@@ -71,10 +75,29 @@ void help()
 	cout<<"  -C, --poolconf FILE        pool configuration file"<<endl;
 #ifdef _WIN32
 	cout<<"  --noUAC                    disable the UAC dialog"<<endl;
+#endif
+#ifdef __linux__
+	cout<<"  --hugepage-cleanup         delete unused scratchpad files in 'hugepage_dir' and exit"<<endl;
 #endif
 	cout<<"  --benchmark BLOCKVERSION   ONLY do a benchmark and exit"<<endl;
+	cout<<"                             use 'all' to benchmark every algorithm of the coin"<<endl;
 	cout<<"  --benchwait WAIT_SEC             ... benchmark wait time"<<endl;
-	cout<<"  --benchwork WORK_SEC             ... benchmark work time"<<endl;
+	cout<<"  --benchwork WORK_SEC             ... benchmark work time per algorithm"<<endl;
+	cout<<"  --benchwarmup WARMUP_SEC         ... discarded warmup time per algorithm"<<endl;
+	cout<<"  --benchsamples SAMPLES           ... number of samples per algorithm"<<endl;
+	cout<<"  --benchjson FILE                 ... write the results as JSON"<<endl;
+	cout<<"  --benchbaseline FILE             ... compare with the JSON of an earlier run"<<endl;
+	cout<<"  --benchthreshold PERCENT         ... allowed hash rate loss against the baseline"<<endl;
+	cout<<"  --record FILE              write the pool sessions to FILE"<<endl;
+	cout<<"  --replay FILE              replay the pool sessions of FILE instead of connecting to the pools"<<endl;
+	cout<<"  --replay-speed SPEED       ... speed of the replay, e.g. 10 for ten times faster"<<endl;
+	cout<<"  --log-json                 write the console and the log file output as JSON lines"<<endl;
+	cout<<"  --trace FILE               record a trace of the job switches and shares from the start, it is"<<endl;
+	cout<<"                             written to FILE every 30 s and on exit or with the key 't'"<<endl;
+#ifndef _WIN32
+	cout<<"  --history FILE             keep the hash rate history in FILE, it is served at /api/history"<<endl;
+	cout<<"  --shm-stats NAME           publish the statistics in the shared memory segment NAME, e.g. /xmr-stak"<<endl;
+#endif
 #ifndef CONF_NO_CPU
 	cout<<"  --noCPU                    disable the CPU miner backend"<<endl;
 	cout<<"  --cpu FILE                 CPU backend miner config file"<<endl;
@@ -381,6 +404,29 @@ void do_guided_config()
 	std::cout<<"Configuration stored in file '"<<params::inst().configFile<<"'"<<std::endl;
 }
 
+void toggle_trace()
+{
+	using namespace xmrstak;
+
+	traceRecorder& trace = traceRecorder::inst();
+	const char* file = params::inst().traceFile.c_str();
+
+	if(!trace.is_enabled())
+	{
+		trace.start();
+		printer::inst()->print_msg(L0, "Trace recording started, press 't' again to write it to %s.", file);
+		return;
+	}
+
+	trace.stop();
+	size_t events;
+	std::string err;
+	if(trace.write(file, events, err))
+		printer::inst()->print_msg(L0, "Trace with %llu events written to %s.", int_port(events), file);
+	else
+		printer::inst()->print_msg(L0, "Trace not written: %s", err.c_str());
+}
+
 int main(int argc, char *argv[])
 {
 #ifndef CONF_NO_TLS
@@ -396,6 +442,9 @@ int main(int argc, char *argv[])
 
 	using namespace xmrstak;
 
+	// starts the clock for the startup report
+	startupTiming::inst();
+
 	std::string pathWithName(argv[0]);
 	std::string separator("/");
 	auto pos = pathWithName.rfind(separator);
@@ -685,12 +734,17 @@ int main(int argc, char *argv[])
 				win_exit();
 				return 1;
 			}
+			if(std::string(argv[i]) == "all")
+			{
+				params::inst().benchmark_block_version = params::benchmark_all_versions;
+				continue;
+			}
 			char* block_version = nullptr;
 			long int bversion = strtol(argv[i], &block_version, 10);
 
 			if(bversion < 0 || bversion >= 256)
 			{
-				printer::inst()->print_msg(L0, "Benchmark block version must be in the range [0,255]");
+				printer::inst()->print_msg(L0, "Benchmark block version must be in the range [0,255] or 'all'");
 				return 1;
 			}
 			params::inst().benchmark_block_version = bversion;
@@ -733,10 +787,173 @@ int main(int argc, char *argv[])
 			}
 			params::inst().benchmark_work_sec = worksec;
 		}
+		else if(opName.compare("--benchwarmup") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--benchwarmup' given");
+				win_exit();
+				return 1;
+			}
+			char* warmup_sec = nullptr;
+			long int warmupsec = strtol(argv[i], &warmup_sec, 10);
+
+			if(warmupsec < 0 || warmupsec >= 300)
+			{
+				printer::inst()->print_msg(L0, "Benchmark warmup seconds must be in the range [0,300]");
+				return 1;
+			}
+			params::inst().benchmark_warmup_sec = warmupsec;
+		}
+		else if(opName.compare("--benchsamples") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--benchsamples' given");
+				win_exit();
+				return 1;
+			}
+			char* samples = nullptr;
+			long int nsamples = strtol(argv[i], &samples, 10);
+
+			if(nsamples < 1 || nsamples > 100)
+			{
+				printer::inst()->print_msg(L0, "Benchmark samples must be in the range [1,100]");
+				return 1;
+			}
+			params::inst().benchmark_samples = nsamples;
+		}
+		else if(opName.compare("--benchjson") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--benchjson' given");
+				win_exit();
+				return 1;
+			}
+			params::inst().benchmark_json = argv[i];
+		}
+		else if(opName.compare("--benchbaseline") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--benchbaseline' given");
+				win_exit();
+				return 1;
+			}
+			params::inst().benchmark_baseline = argv[i];
+		}
+		else if(opName.compare("--benchthreshold") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--benchthreshold' given");
+				win_exit();
+				return 1;
+			}
+			char* threshold = nullptr;
+			double fthreshold = strtod(argv[i], &threshold);
+
+			if(fthreshold < 0.0 || fthreshold > 100.0)
+			{
+				printer::inst()->print_msg(L0, "Benchmark threshold must be in the range [0,100] percent");
+				return 1;
+			}
+			params::inst().benchmark_threshold = fthreshold;
+		}
+		else if(opName.compare("--record") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--record' given");
+				win_exit();
+				return 1;
+			}
+			params::inst().sessionRecordFile = argv[i];
+		}
+		else if(opName.compare("--replay") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--replay' given");
+				win_exit();
+				return 1;
+			}
+			params::inst().sessionReplayFile = argv[i];
+		}
+		else if(opName.compare("--log-json") == 0)
+		{
+			printer::inst()->set_json_output(true);
+		}
+		else if(opName.compare("--trace") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--trace' given");
+				win_exit();
+				return 1;
+			}
+			params::inst().traceFile = argv[i];
+			params::inst().traceStart = true;
+		}
+		else if(opName.compare("--history") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--history' given");
+				win_exit();
+				return 1;
+			}
+			params::inst().historyFile = argv[i];
+		}
+		else if(opName.compare("--shm-stats") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--shm-stats' given");
+				win_exit();
+				return 1;
+			}
+			params::inst().shmStatsName = argv[i];
+		}
+		else if(opName.compare("--replay-speed") == 0)
+		{
+			++i;
+			if( i >= argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--replay-speed' given");
+				win_exit();
+				return 1;
+			}
+			char* end = nullptr;
+			double speed = strtod(argv[i], &end);
+
+			if(end == argv[i] || speed <= 0.0)
+			{
+				printer::inst()->print_msg(L0, "Replay speed must be a positive number");
+				win_exit();
+				return 1;
+			}
+			params::inst().sessionReplaySpeed = speed;
+		}
 		else if (opName.compare("--tests") == 0)
 		{
 			params::inst().testMode = true;
 		}
+		else if(opName.compare("--hugepage-cleanup") == 0)
+		{
+			params::inst().hugepageCleanup = true;
+		}
 		else
 		{
 			printer::inst()->print_msg(L0, "Parameter unknown '%s'",argv[i]);
@@ -770,12 +987,63 @@ int main(int argc, char *argv[])
 	if(strlen(jconf::inst()->GetOutputFile()) != 0)
 		printer::inst()->open_logfile(jconf::inst()->GetOutputFile());
 
+	if(params::inst().hugepageCleanup)
+	{
+		const char* dir = jconf::inst()->GetHugepageDir();
+		if(strlen(dir) == 0)
+		{
+			printer::inst()->print_msg(L0, "hugepage_dir is not set in '%s', nothing to clean up.", params::inst().configFile.c_str());
+			win_exit();
+			return 1;
+		}
+		size_t n = cryptonight_release_hugepage_files(dir);
+		printer::inst()->print_msg(L0, "Deleted %llu unused scratchpad files from %s.", int_port(n), dir);
+		win_exit(0);
+		return 0;
+	}
+
+	if(!params::inst().sessionReplayFile.empty())
+	{
+		std::string err;
+		if(!sessionLog::inst()->load_replay(params::inst().sessionReplayFile.c_str(), params::inst().sessionReplaySpeed, err))
+		{
+			printer::inst()->print_msg(L0, "%s", err.c_str());
+			win_exit();
+			return 1;
+		}
+		printer::inst()->print_msg(L0, "Replaying the pool sessions of '%s'.", params::inst().sessionReplayFile.c_str());
+	}
+
+	if(!params::inst().sessionRecordFile.empty())
+	{
+		std::string err;
+		if(!sessionLog::inst()->open(params::inst().sessionRecordFile.c_str(), err))
+		{
+			printer::inst()->print_msg(L0, "%s", err.c_str());
+			win_exit();
+			return 1;
+		}
+	}
+
+	if(!params::inst().shmStatsName.empty())
+	{
+		std::string err;
+		if(!xmrstak::shmStats::inst()->open(params::inst().shmStatsName.c_str(), err))
+		{
+			printer::inst()->print_msg(L0, "%s", err.c_str());
+			win_exit();
+			return 1;
+		}
+	}
+
+	size_t iSelfTestStart = startupTiming::inst()->now();
 	if (!BackendConnector::self_test())
 	{
 		printer::inst()->print_msg(L0, "Self test not passed!");
 		win_exit();
 		return 1;
 	}
+	startupTiming::inst()->record("self test", iSelfTestStart);
 
 	if(jconf::inst()->GetHttpdPort() != uint16_t(params::httpd_port_disabled))
 	{
@@ -811,6 +1079,7 @@ int main(int argc, char *argv[])
 	printer::inst()->print_str("'h' - hashrate\n");
 	printer::inst()->print_str("'r' - results\n");
 	printer::inst()->print_str("'c' - connection\n");
+	printer::inst()->print_str("'t' - start the trace recording, again to write the trace\n");
 	printer::inst()->print_str("-------------------------------------------------------------------\n");
 	printer::inst()->print_str("Upcoming xmr-stak-gui is sponsored by:\n");
 	printer::inst()->print_str("   #####   ______               ____\n");
@@ -837,7 +1106,13 @@ int main(int argc, char *argv[])
 	if(params::inst().benchmark_block_version >= 0)
 	{
 		printer::inst()->print_str("!!!! Doing only a benchmark and exiting. To mine, remove the '--benchmark' option. !!!!\n");
-		return do_benchmark(params::inst().benchmark_block_version, params::inst().benchmark_wait_sec, params::inst().benchmark_work_sec);
+		return xmrstak::do_benchmark();
+	}
+
+	if(params::inst().traceStart)
+	{
+		xmrstak::traceRecorder::inst().start();
+		xmrstak::traceRecorder::inst().auto_write(params::inst().traceFile);
 	}
 
 	executor::inst()->ex_start(jconf::inst()->DaemonMode());
@@ -859,6 +1134,9 @@ int main(int argc, char *argv[])
 		case 'c':
 			executor::inst()->push_event(ex_event(EV_USR_CONNSTAT));
 			break;
+		case 't':
+			toggle_trace();
+			break;
 		default:
 			break;
 		}
@@ -873,50 +1151,3 @@ int main(int argc, char *argv[])
 
 	return 0;
 }
-
-int do_benchmark(int block_version, int wait_sec, int work_sec)
-{
-	using namespace std::chrono;
-	std::vector<xmrstak::iBackend*>* pvThreads;
-
-	printer::inst()->print_msg(L0, "Prepare benchmark for block version %d", block_version);
-
-	uint8_t work[112];
-	memset(work,0,112);
-	work[0] = static_cast<uint8_t>(block_version);
-
-	xmrstak::pool_data dat;
-
-	xmrstak::miner_work oWork = xmrstak::miner_work();
-	pvThreads = xmrstak::BackendConnector::thread_starter(oWork);
-
-	printer::inst()->print_msg(L0, "Wait %d sec until all backends are initialized",wait_sec);
-	std::this_thread::sleep_for(std::chrono::seconds(wait_sec));
-
-	/* AMD and NVIDIA is currently only supporting work sizes up to 84byte
-	 * \todo fix this issue
-	 */
-	xmrstak::miner_work benchWork = xmrstak::miner_work("", work, 84, 0, false, 0);
-	printer::inst()->print_msg(L0, "Start a %d second benchmark...",work_sec);
-	xmrstak::globalStates::inst().switch_work(benchWork, dat);
-	uint64_t iStartStamp = get_timestamp_ms();
-
-	std::this_thread::sleep_for(std::chrono::seconds(work_sec));
-	xmrstak::globalStates::inst().switch_work(oWork, dat);
-
-	double fTotalHps = 0.0;
-	for (uint32_t i = 0; i < pvThreads->size(); i++)
-	{
-		double fHps = pvThreads->at(i)->iHashCount;
-		fHps /= (pvThreads->at(i)->iTimestamp - iStartStamp) / 1000.0;
-
-		auto bType = static_cast<xmrstak::iBackend::BackendType>(pvThreads->at(i)->backendType);
-		std::string name(xmrstak::iBackend::getName(bType));
-
-		printer::inst()->print_msg(L0, "Benchmark Thread %u %s: %.1f H/S", i,name.c_str(), fHps);
-		fTotalHps += fHps;
-	}
-
-	printer::inst()->print_msg(L0, "Benchmark Total: %.1f H/S", fTotalHps);
-	return 0;
-}
@@ -50,6 +50,9 @@ R"===(// generated by XMRSTAK_VERSION
  * Some VMs don't report AES capability correctly. You can set this value to true to enforce hardware AES or
  * to false to force disable AES or null to let the miner decide if AES is used.
  *
+ * Without hardware AES a constant time software AES is used on CPUs with SSSE3 (AVX2 if available),
+ * older CPUs fall back to lookup tables.
+ *
  * WARNING: setting this to true on a CPU that doesn't support hardware AES will crash the miner.
  */
 "aes_override" : null,
@@ -105,6 +108,16 @@ R"===(// generated by XMRSTAK_VERSION
  */
 "use_slow_memory" : "warn",
 
+/*---LINUX
+ * Persistent large pages---LINUX
+ * Huge pages get harder to allocate the longer a system is running. If hugepage_dir points to a mounted hugetlbfs---LINUX
+ * (e.g. "/dev/hugepages") the scratchpads are backed by files named xmr-stak-<NUMA node>-<index> in this directory.---LINUX
+ * The files are kept when the miner exits, so a restarted miner gets the same huge pages back immediately.---LINUX
+ * Start the miner with "--hugepage-cleanup" to delete all unused files and give the pages back to the system.---LINUX
+ * An empty string disables this feature.---LINUX
+ */---LINUX
+"hugepage_dir" : "",---LINUX
+
 /*
  * TLS Settings
  * If you need real security, make sure tls_secure_algo is enabled (otherwise MITM attack can downgrade encryption
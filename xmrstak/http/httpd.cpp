@@ -29,6 +29,10 @@
 #include "xmrstak/net/msgstruct.hpp"
 #include "xmrstak/misc/console.hpp"
 #include "xmrstak/misc/executor.hpp"
+#include "xmrstak/misc/hashHistory.hpp"
+#include "xmrstak/misc/statsSnapshot.hpp"
+#include "xmrstak/misc/statsStream.hpp"
+#include "xmrstak/misc/traceRecorder.hpp"
 #include "xmrstak/jconf.hpp"
 
 #include <stdlib.h>
@@ -48,6 +52,16 @@ httpd::httpd()
 
 }
 
+static ssize_t stream_reader(void* cls, uint64_t pos, char* buf, size_t max)
+{
+	return ((xmrstak::statsStream::subscriber*)cls)->read(buf, max);
+}
+
+static void stream_free(void* cls)
+{
+	delete (xmrstak::statsStream::subscriber*)cls;
+}
+
 int httpd::req_handler(void * cls,
 			MHD_Connection* connection,
 			const char* url,
@@ -113,6 +127,68 @@ int httpd::req_handler(void * cls,
 		rsp = MHD_create_response_from_buffer(str.size(), (void*)str.c_str(), MHD_RESPMEM_MUST_COPY);
 		MHD_add_response_header(rsp, "Content-Type", "application/json; charset=utf-8");
 	}
+	else if(strcasecmp(url, "/metrics") == 0)
+	{
+		// rendered from the last snapshot, the executor is not involved
+		std::shared_ptr<const xmrstak::statsSnapshot> stats = xmrstak::statsSnapshot::get();
+		if(stats)
+			stats->get_metrics(str);
+
+		rsp = MHD_create_response_from_buffer(str.size(), (void*)str.c_str(), MHD_RESPMEM_MUST_COPY);
+		MHD_add_response_header(rsp, "Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+	}
+	else if(strcasecmp(url, "/api/history") == 0)
+	{
+		const char* from = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "from");
+		const char* to = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "to");
+		const char* tier = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "tier");
+		const char* series = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "series");
+
+		unsigned int status = MHD_HTTP_OK;
+		if(!xmrstak::hashHistory::inst()->is_open())
+		{
+			str = "the hash rate history is not enabled, start the miner with --history FILE";
+			status = MHD_HTTP_NOT_FOUND;
+		}
+		else if(!xmrstak::hashHistory::inst()->get_json(tier, series, from != nullptr ? strtoull(from, nullptr, 10) : 0,
+			to != nullptr ? strtoull(to, nullptr, 10) : 0, str))
+			status = MHD_HTTP_BAD_REQUEST;
+
+		rsp = MHD_create_response_from_buffer(str.size(), (void*)str.c_str(), MHD_RESPMEM_MUST_COPY);
+		if(status == MHD_HTTP_OK)
+			MHD_add_response_header(rsp, "Content-Type", "application/json; charset=utf-8");
+		else
+			MHD_add_response_header(rsp, "Content-Type", "text/plain; charset=utf-8");
+
+		int ret = MHD_queue_response(connection, status, rsp);
+		MHD_destroy_response(rsp);
+		return ret;
+	}
+	else if(strcasecmp(url, "/trace") == 0)
+	{
+		// record=1 starts a new recording, record=0 stops it, the events are returned in both cases
+		const char* record = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "record");
+		if(record != nullptr && strcmp(record, "1") == 0)
+			xmrstak::traceRecorder::inst().start();
+		else if(record != nullptr && strcmp(record, "0") == 0)
+			xmrstak::traceRecorder::inst().stop();
+
+		xmrstak::traceRecorder::inst().get_json(str);
+
+		rsp = MHD_create_response_from_buffer(str.size(), (void*)str.c_str(), MHD_RESPMEM_MUST_COPY);
+		MHD_add_response_header(rsp, "Content-Type", "application/json; charset=utf-8");
+	}
+	else if(strcasecmp(url, "/events") == 0)
+	{
+		// every connection has its own thread, the reader blocks until the next update
+		const char* interval = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "interval");
+		uint64_t interval_ms = interval != nullptr ? strtoull(interval, nullptr, 10) : 1000;
+
+		rsp = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 4096, &stream_reader,
+			new xmrstak::statsStream::subscriber(interval_ms), &stream_free);
+		MHD_add_response_header(rsp, "Content-Type", "text/event-stream; charset=utf-8");
+		MHD_add_response_header(rsp, "Cache-Control", "no-cache");
+	}
 	else if(strcasecmp(url, "/h") == 0 || strcasecmp(url, "/hashrate") == 0)
 	{
 		executor::inst()->get_http_report(EV_HTML_HASHRATE, str);
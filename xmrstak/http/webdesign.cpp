@@ -162,7 +162,9 @@ extern const char sHtmlHashrateTableRow [] =
 extern const char sHtmlHashrateBodyLow [] =
 		"<tr><th>Totals:</th><td>%s</td><td>%s</td><td>%s</td></tr>"
 		"<tr><th>Highest:</th><td>%s</td><td colspan='2'></td></tr>"
-	"</table>"
+	"</table>";
+
+extern const char sHtmlHashrateBodyEnd [] =
 	"</div></div></body></html>";
 
 extern const char sHtmlConnectionBodyHigh [] =
@@ -170,8 +172,18 @@ extern const char sHtmlConnectionBodyHigh [] =
 	"<table>"
 		"<tr><th>Pool address</th><td>%s</td></tr>"
 		"<tr><th>Connected since</th><td>%s</td></tr>"
-		"<tr><th>Pool ping time</th><td>%u ms</td></tr>"
-	"</table>"
+		"<tr><th>Pool ping time</th><td>%.1f ms</td></tr>"
+	"</table>";
+
+extern const char sHtmlPoolStatsHigh [] =
+	"<h4>Pool statistics</h4>"
+	"<table>"
+		"<tr><th>Value</th><th>Window</th><th>Count</th><th>p50</th><th>p90</th><th>p99</th><th>max</th></tr>";
+
+extern const char sHtmlPoolStatsRow [] =
+	"<tr><th>%s</th><td>%s</td><td>%llu</td><td>%.*f</td><td>%.*f</td><td>%.*f</td><td>%.*f</td></tr>";
+
+extern const char sHtmlConnectionErrorHigh [] =
 	"<h4>Network error log</h4>"
 	"<table>"
 		"<tr><th style='width: 20%; min-width: 10em;'>Date</th><th>Error</th></tr>";
@@ -225,7 +237,8 @@ extern const char sJsonApiFormat [] =
 	"\"hashrate\":{"
 		"\"threads\":[%s],"
 		"\"total\":%s,"
-		"\"highest\":%s"
+		"\"highest\":%s,"
+		"\"parked\":[%s]"
 	"},"
 
 	"\"results\":{"
@@ -243,6 +256,14 @@ extern const char sJsonApiFormat [] =
 		"\"uptime\":%llu,"
 		"\"ping\":%llu,"
 		"\"error_log\":[%s]"
-	"}"
+	"},"
+
+	"\"pools\":[%s],"
+
+	"\"startup\":%s,"
+
+	"\"perf\":%s,"
+
+	"\"phases\":%s"
 "}";
 
@@ -19,8 +19,12 @@ extern const char sHtmlMotdBoxEnd[];
 extern const char sHtmlHashrateBodyHigh[];
 extern const char sHtmlHashrateTableRow[];
 extern const char sHtmlHashrateBodyLow[];
+extern const char sHtmlHashrateBodyEnd[];
 
 extern const char sHtmlConnectionBodyHigh[];
+extern const char sHtmlPoolStatsHigh[];
+extern const char sHtmlPoolStatsRow[];
+extern const char sHtmlConnectionErrorHigh[];
 extern const char sHtmlConnectionTableRow[];
 extern const char sHtmlConnectionBodyLow[];
 
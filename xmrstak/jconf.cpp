@@ -302,6 +302,15 @@ jconf::slow_mem_cfg jconf::GetSlowMemSetting()
 		return unknown_value;
 }
 
+const char* jconf::GetHugepageDir()
+{
+	// optional, older config files do not have this value
+	const Value* dir = GetObjectMember(prv->jsonDoc, "hugepage_dir");
+	if(dir == nullptr || !dir->IsString())
+		return "";
+	return dir->GetString();
+}
+
 std::string jconf::GetMiningCoin()
 {
 	if(xmrstak::params::inst().currency.length() > 0)
@@ -598,6 +607,18 @@ bool jconf::parse_config(const char* sFilename, const char* sFilenamePools)
 	}
 #endif // _WIN32
 
+	const Value* hugepage_dir = GetObjectMember(prv->jsonDoc, "hugepage_dir");
+	if(hugepage_dir != nullptr && !hugepage_dir->IsString())
+	{
+		printer::inst()->print_msg(L0, "Invalid config file. hugepage_dir has to be a string.");
+		return false;
+	}
+
+#ifndef __linux__
+	if(strlen(GetHugepageDir()) != 0)
+		printer::inst()->print_msg(L0, "WARNING: hugepage_dir is only supported on Linux, option ignored.");
+#endif // __linux__
+
 	std::string ctmp = GetMiningCoin();
 	std::transform(ctmp.begin(), ctmp.end(), ctmp.begin(), ::tolower);
 
@@ -80,6 +80,8 @@ public:
 
 	slow_mem_cfg GetSlowMemSetting();
 
+	const char* GetHugepageDir();
+
 private:
 	jconf();
 
@@ -0,0 +1,477 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "benchmark.hpp"
+#include "xmrstak/backend/backendConnector.hpp"
+#include "xmrstak/backend/globalStates.hpp"
+#include "xmrstak/backend/iBackend.hpp"
+#include "xmrstak/backend/miner_work.hpp"
+#include "xmrstak/jconf.hpp"
+#include "xmrstak/misc/console.hpp"
+#include "xmrstak/misc/jext.hpp"
+#include "xmrstak/net/msgstruct.hpp"
+#include "xmrstak/params.hpp"
+#include "xmrstak/version.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+namespace xmrstak
+{
+
+namespace
+{
+
+// the executor gives the dev pool id 0, the benchmark hashes the coin of the user pools
+constexpr size_t user_pool_id = 1;
+
+/* AMD and NVIDIA is currently only supporting work sizes up to 84byte
+ * \todo fix this issue
+ */
+constexpr uint32_t bench_work_size = 84;
+
+const char* algo_name(xmrstak_algo algo)
+{
+	switch(algo)
+	{
+	case cryptonight:
+		return "cryptonight";
+	case cryptonight_lite:
+		return "cryptonight_lite";
+	case cryptonight_monero:
+		return "cryptonight_monero";
+	case cryptonight_heavy:
+		return "cryptonight_heavy";
+	case cryptonight_aeon:
+		return "cryptonight_aeon";
+	case cryptonight_ipbc:
+		return "cryptonight_ipbc";
+	case cryptonight_stellite:
+		return "cryptonight_stellite";
+	case cryptonight_masari:
+		return "cryptonight_masari";
+	case cryptonight_haven:
+		return "cryptonight_haven";
+	case cryptonight_bittube2:
+		return "cryptonight_bittube2";
+	case cryptonight_monero_v8:
+		return "cryptonight_monero_v8";
+	default:
+		return "unknown";
+	}
+}
+
+struct sample_stats
+{
+	double mean = 0.0;
+	double median = 0.0;
+	//! sample variance
+	double variance = 0.0;
+	double stddev = 0.0;
+	double min = 0.0;
+	double max = 0.0;
+};
+
+sample_stats calc_stats(std::vector<double> v)
+{
+	sample_stats s;
+	if(v.empty())
+		return s;
+
+	std::sort(v.begin(), v.end());
+	const size_t n = v.size();
+	s.min = v.front();
+	s.max = v.back();
+	s.median = (n & 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+	for(double x : v)
+		s.mean += x;
+	s.mean /= double(n);
+	for(double x : v)
+		s.variance += (x - s.mean) * (x - s.mean);
+	s.variance = n > 1 ? s.variance / double(n - 1) : 0.0;
+	s.stddev = std::sqrt(s.variance);
+	return s;
+}
+
+struct hash_snapshot
+{
+	uint64_t hashes;
+	uint64_t time_ms;
+};
+
+/** hash count and the time stamp of the same update of a thread
+ *
+ * The threads store the count before the time stamp, using both stamps of one
+ * update avoids the bias of the reporting granularity of the threads.
+ */
+hash_snapshot take_snapshot(const iBackend* thd)
+{
+	hash_snapshot s;
+	uint64_t check;
+	do
+	{
+		s.hashes = thd->iHashCount.load(std::memory_order_relaxed);
+		s.time_ms = thd->iTimestamp.load(std::memory_order_relaxed);
+		check = thd->iHashCount.load(std::memory_order_relaxed);
+	}
+	while(check != s.hashes);
+	return s;
+}
+
+struct algo_result
+{
+	xmrstak_algo algo;
+	int block_version;
+	/** hash rate of each thread and sample
+	 *
+	 * A thread without an update in the last samples has fewer samples.
+	 */
+	std::vector<std::vector<double>> thread_samples;
+};
+
+/** sum of the samples of the threads selected by `backend`, UNKNOWN selects all threads
+ *
+ * Only the samples which all selected threads have are summed.
+ */
+std::vector<double> sum_samples(const algo_result& res, const std::vector<iBackend*>& threads, iBackend::BackendType backend)
+{
+	std::vector<double> sum;
+	bool first = true;
+	for(size_t t = 0; t < threads.size(); t++)
+	{
+		if(backend != iBackend::UNKNOWN && threads[t]->backendType != backend)
+			continue;
+		const std::vector<double>& v = res.thread_samples[t];
+		if(first || v.size() < sum.size())
+			sum.resize(v.size(), 0.0);
+		first = false;
+		for(size_t i = 0; i < sum.size(); i++)
+			sum[i] += v[i];
+	}
+	return sum;
+}
+
+std::vector<iBackend::BackendType> used_backends(const std::vector<iBackend*>& threads)
+{
+	std::vector<iBackend::BackendType> types;
+	for(const iBackend* thd : threads)
+	{
+		if(std::find(types.begin(), types.end(), thd->backendType) == types.end())
+			types.push_back(thd->backendType);
+	}
+	return types;
+}
+
+void append_stats_row(std::string& out, const char* name, const sample_stats& s)
+{
+	char buffer[160];
+	snprintf(buffer, sizeof(buffer), "| %-14s | %10.1f | %10.1f | %9.1f | %10.1f | %10.1f |\n",
+		name, s.mean, s.median, s.stddev, s.min, s.max);
+	out.append(buffer);
+}
+
+void append_stats_json(std::string& out, const sample_stats& s, const std::vector<double>& samples)
+{
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "\"mean\":%.2f,\"median\":%.2f,\"variance\":%.2f,\"stddev\":%.2f,\"min\":%.2f,\"max\":%.2f,\"samples\":[",
+		s.mean, s.median, s.variance, s.stddev, s.min, s.max);
+	out.append(buffer);
+	for(size_t i = 0; i < samples.size(); i++)
+	{
+		snprintf(buffer, sizeof(buffer), "%s%.2f", i != 0 ? "," : "", samples[i]);
+		out.append(buffer);
+	}
+	out.append(1, ']');
+}
+
+void print_result(const algo_result& res, const std::vector<iBackend*>& threads)
+{
+	std::string out;
+	char name[32];
+	out.append("| Thread         |   Mean H/s | Median H/s |   Std dev |    Min H/s |    Max H/s |\n");
+	for(size_t t = 0; t < threads.size(); t++)
+	{
+		snprintf(name, sizeof(name), "%u %s", unsigned(t), iBackend::getName(threads[t]->backendType));
+		append_stats_row(out, name, calc_stats(res.thread_samples[t]));
+	}
+	for(iBackend::BackendType type : used_backends(threads))
+	{
+		snprintf(name, sizeof(name), "total %s", iBackend::getName(type));
+		append_stats_row(out, name, calc_stats(sum_samples(res, threads, type)));
+	}
+	append_stats_row(out, "total", calc_stats(sum_samples(res, threads, iBackend::UNKNOWN)));
+	printer::inst()->print_str(out.c_str());
+}
+
+void results_json(std::string& out, const std::vector<algo_result>& results, const std::vector<iBackend*>& threads,
+	uint32_t seed, const std::string& verdict)
+{
+	const params& p = params::inst();
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer), "{\"version\":\"%s\",\"coin\":\"%s\",\"seed\":%u,\"warmup_sec\":%d,\"work_sec\":%d,\"samples\":%d,\"algorithms\":[",
+		get_version_str().c_str(), jconf::inst()->GetMiningCoin().c_str(), seed, p.benchmark_warmup_sec,
+		p.benchmark_work_sec, p.benchmark_samples);
+	out.append(buffer);
+
+	for(size_t a = 0; a < results.size(); a++)
+	{
+		const algo_result& res = results[a];
+		snprintf(buffer, sizeof(buffer), "%s\n{\"algo\":\"%s\",\"block_version\":%d,\"total\":{",
+			a != 0 ? "," : "", algo_name(res.algo), res.block_version);
+		out.append(buffer);
+		std::vector<double> total = sum_samples(res, threads, iBackend::UNKNOWN);
+		append_stats_json(out, calc_stats(total), total);
+
+		out.append("},\"backends\":[");
+		bool first = true;
+		for(iBackend::BackendType type : used_backends(threads))
+		{
+			std::vector<double> sum = sum_samples(res, threads, type);
+			snprintf(buffer, sizeof(buffer), "%s{\"backend\":\"%s\",", first ? "" : ",", iBackend::getName(type));
+			out.append(buffer);
+			append_stats_json(out, calc_stats(sum), sum);
+			out.append(1, '}');
+			first = false;
+		}
+
+		out.append("],\"threads\":[");
+		for(size_t t = 0; t < threads.size(); t++)
+		{
+			snprintf(buffer, sizeof(buffer), "%s{\"id\":%u,\"backend\":\"%s\",", t != 0 ? "," : "",
+				unsigned(t), iBackend::getName(threads[t]->backendType));
+			out.append(buffer);
+			append_stats_json(out, calc_stats(res.thread_samples[t]), res.thread_samples[t]);
+			out.append(1, '}');
+		}
+		out.append("]}");
+	}
+	out.append("\n],\"baseline\":").append(verdict).append("}\n");
+}
+
+/** compare the mean total hash rate of each algorithm with the baseline
+ *
+ * @param verdict json object of the comparison
+ * @return false if an algorithm is slower than allowed or the baseline can not be read
+ */
+bool compare_baseline(const std::vector<algo_result>& results, const std::vector<iBackend*>& threads, std::string& verdict)
+{
+	const params& p = params::inst();
+	char buffer[256];
+
+	FILE* f = fopen(p.benchmark_baseline.c_str(), "rb");
+	if(f == nullptr)
+	{
+		printer::inst()->print_msg(L0, "ERROR: can not open the benchmark baseline %s.", p.benchmark_baseline.c_str());
+		verdict = "null";
+		return false;
+	}
+	std::string data;
+	size_t len;
+	while((len = fread(buffer, 1, sizeof(buffer), f)) != 0)
+		data.append(buffer, len);
+	fclose(f);
+
+	Document doc;
+	doc.Parse(data.c_str());
+	const Value* algos = doc.IsObject() ? GetObjectMember(doc, "algorithms") : nullptr;
+	if(doc.HasParseError() || algos == nullptr || !algos->IsArray())
+	{
+		printer::inst()->print_msg(L0, "ERROR: %s is not a benchmark result file.", p.benchmark_baseline.c_str());
+		verdict = "null";
+		return false;
+	}
+
+	bool pass = true;
+	size_t compared = 0;
+	snprintf(buffer, sizeof(buffer), "{\"file\":\"%s\",\"threshold\":%.2f,\"algorithms\":[", p.benchmark_baseline.c_str(), p.benchmark_threshold);
+	verdict = buffer;
+	for(size_t a = 0; a < results.size(); a++)
+	{
+		const char* name = algo_name(results[a].algo);
+		const double current = calc_stats(sum_samples(results[a], threads, iBackend::UNKNOWN)).mean;
+
+		double base = -1.0;
+		for(const Value& entry : algos->GetArray())
+		{
+			const Value* ename = GetObjectMember(entry, "algo");
+			const Value* total = GetObjectMember(entry, "total");
+			const Value* mean = total != nullptr && total->IsObject() ? GetObjectMember(*total, "mean") : nullptr;
+			if(ename != nullptr && ename->IsString() && mean != nullptr && mean->IsNumber() && strcmp(ename->GetString(), name) == 0)
+				base = mean->GetDouble();
+		}
+
+		if(base <= 0.0)
+		{
+			printer::inst()->print_msg(L0, "Baseline %s: no baseline value.", name);
+			continue;
+		}
+
+		const double change = 100.0 * (current - base) / base;
+		const bool ok = change >= -p.benchmark_threshold;
+		pass = pass && ok;
+		compared++;
+		printer::inst()->print_msg(L0, "Baseline %s: %.1f -> %.1f H/s (%+.1f %%) %s", name, base, current, change, ok ? "PASS" : "FAIL");
+
+		snprintf(buffer, sizeof(buffer), "%s{\"algo\":\"%s\",\"baseline\":%.2f,\"current\":%.2f,\"change\":%.2f,\"pass\":%s}",
+			verdict.back() == '[' ? "" : ",", name, base, current, change, ok ? "true" : "false");
+		verdict.append(buffer);
+	}
+	// a baseline of other algorithms must not let every run pass
+	if(compared == 0)
+	{
+		printer::inst()->print_msg(L0, "ERROR: %s has no value for the benchmarked algorithms.", p.benchmark_baseline.c_str());
+		pass = false;
+	}
+	verdict.append("],\"pass\":").append(pass ? "true" : "false").append("}");
+	return pass;
+}
+
+} // namespace
+
+int do_benchmark()
+{
+	const params& p = params::inst();
+	const coinDescription coin = jconf::inst()->GetCurrentCoinSelection().GetDescription(user_pool_id);
+
+	std::vector<int> versions;
+	if(p.benchmark_block_version == params::benchmark_all_versions)
+	{
+		// the last version before the fork selects the root algorithm
+		if(coin.GetMiningForkVersion() != 0 && coin.GetMiningAlgoRoot() != coin.GetMiningAlgo())
+			versions.push_back(coin.GetMiningForkVersion() - 1);
+		versions.push_back(coin.GetMiningForkVersion());
+	}
+	else
+		versions.push_back(p.benchmark_block_version);
+
+	printer::inst()->print_msg(L0, "Prepare benchmark for %u algorithm(s)", unsigned(versions.size()));
+
+	miner_work oWork = miner_work();
+	pool_data dat;
+	std::vector<iBackend*>* pvThreads = BackendConnector::thread_starter(oWork);
+
+	printer::inst()->print_msg(L0, "Wait %d sec until all backends are initialized", p.benchmark_wait_sec);
+	std::this_thread::sleep_for(std::chrono::seconds(p.benchmark_wait_sec));
+
+	std::random_device rd;
+	const uint32_t seed = rd();
+	std::mt19937 rng(seed);
+	const uint64_t sample_ms = uint64_t(p.benchmark_work_sec) * 1000 / p.benchmark_samples;
+
+	/* a new random blob for the warmup and for each sample, byte 0 is the block version
+	 * and selects the algorithm, the backends write the nonce
+	 */
+	size_t job_no = 0;
+	auto switch_random_work = [&](int version)
+	{
+		uint8_t work[bench_work_size];
+		for(uint8_t& b : work)
+			b = static_cast<uint8_t>(rng());
+		work[0] = static_cast<uint8_t>(version);
+
+		char job_id[64] = { 0 };
+		snprintf(job_id, sizeof(job_id), "benchmark-%u", unsigned(job_no++));
+		miner_work benchWork = miner_work(job_id, work, bench_work_size, 0, false, user_pool_id);
+		globalStates::inst().switch_work(benchWork, dat);
+	};
+
+	std::vector<algo_result> results;
+	for(int version : versions)
+	{
+		algo_result res;
+		res.block_version = version;
+		res.algo = version >= coin.GetMiningForkVersion() ? coin.GetMiningAlgo() : coin.GetMiningAlgoRoot();
+		res.thread_samples.resize(pvThreads->size());
+
+		printer::inst()->print_msg(L0, "Benchmark %s (block version %d): %d sec warmup, %d samples of %.1f sec",
+			algo_name(res.algo), version, p.benchmark_warmup_sec, p.benchmark_samples, sample_ms / 1000.0);
+
+		switch_random_work(version);
+		std::this_thread::sleep_for(std::chrono::seconds(p.benchmark_warmup_sec));
+
+		std::vector<hash_snapshot> last(pvThreads->size());
+		//! samples since the last update of a thread
+		std::vector<size_t> pending(pvThreads->size(), 0);
+		for(size_t t = 0; t < pvThreads->size(); t++)
+			last[t] = take_snapshot(pvThreads->at(t));
+
+		for(int s = 0; s < p.benchmark_samples; s++)
+		{
+			switch_random_work(version);
+			std::this_thread::sleep_for(std::chrono::milliseconds(sample_ms));
+
+			/* A slow thread may not update its hash count during a sample, the
+			 * rate of its next update is the rate of all samples it covers.
+			 */
+			for(size_t t = 0; t < pvThreads->size(); t++)
+			{
+				hash_snapshot now = take_snapshot(pvThreads->at(t));
+				pending[t]++;
+				if(now.time_ms <= last[t].time_ms)
+					continue;
+				double fHps = double(now.hashes - last[t].hashes) * 1000.0 / double(now.time_ms - last[t].time_ms);
+				res.thread_samples[t].insert(res.thread_samples[t].end(), pending[t], fHps);
+				pending[t] = 0;
+				last[t] = now;
+			}
+		}
+
+		print_result(res, *pvThreads);
+		results.push_back(std::move(res));
+	}
+
+	globalStates::inst().switch_work(oWork, dat);
+
+	int ret = 0;
+	std::string verdict = "null";
+	if(!p.benchmark_baseline.empty() && !compare_baseline(results, *pvThreads, verdict))
+	{
+		printer::inst()->print_msg(L0, "Benchmark FAILED against the baseline (threshold %.1f %%).", p.benchmark_threshold);
+		ret = 1;
+	}
+
+	if(!p.benchmark_json.empty())
+	{
+		std::string out;
+		results_json(out, results, *pvThreads, seed, verdict);
+		FILE* f = fopen(p.benchmark_json.c_str(), "wb");
+		if(f == nullptr || fwrite(out.data(), 1, out.size(), f) != out.size())
+		{
+			printer::inst()->print_msg(L0, "ERROR: can not write the benchmark result to %s.", p.benchmark_json.c_str());
+			ret = 1;
+		}
+		if(f != nullptr)
+			fclose(f);
+	}
+
+	return ret;
+}
+
+} // namespace xmrstak
@@ -0,0 +1,17 @@
+#pragma once
+
+namespace xmrstak
+{
+
+/** benchmark of all enabled backends without a pool (--benchmark)
+ *
+ * Every algorithm of the selected block version(s) is hashed with random blobs.
+ * After a warmup the hash rate of each thread is sampled several times, the
+ * statistics are printed and optionally written as JSON and compared with the
+ * JSON of an earlier run. The settings are taken from params.
+ *
+ * @return 0 on success, 1 if the hash rate dropped below the baseline threshold or on an error
+ */
+int do_benchmark();
+
+} // namespace xmrstak
@@ -27,7 +27,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <thread>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -152,17 +155,104 @@ inline void comp_localtime(const time_t* ctime, tm* stime)
 #endif // __WIN32
 }
 
-printer::printer()
+/** single producer, single consumer queue of one thread
+ *
+ * The owning thread writes the messages, the consumer holds printer::flush_mutex.
+ */
+struct log_ring
+{
+	static constexpr size_t SIZE = 256;
+
+	std::string text[SIZE];
+	int64_t time_ms[SIZE];
+	uint64_t seq[SIZE];
+	int level[SIZE];
+
+	//! next slot written by the owner
+	std::atomic<size_t> head;
+	//! next slot read by the consumer
+	std::atomic<size_t> tail;
+	std::atomic<uint64_t> dropped;
+	//! the owning thread has exited, the ring is deleted once it is empty
+	std::atomic<bool> closed;
+
+	log_ring() : head(0), tail(0), dropped(0), closed(false) {}
+};
+
+namespace
+{
+/** ring of the calling thread, closed when the thread exits
+ *
+ * Backends loaded as a library have their own instance but share the printer.
+ */
+struct thread_ring_ref
+{
+	log_ring* ring = nullptr;
+
+	~thread_ring_ref()
+	{
+		if(ring != nullptr)
+			ring->closed.store(true, std::memory_order_release);
+		ring = nullptr;
+	}
+};
+
+thread_local thread_ring_ref tls_ring;
+
+//! the flusher waits at most this long for a wake up which raced with its wait
+constexpr int FLUSH_INTERVAL_MS = 100;
+
+void json_escape(const std::string& str, std::string& out)
+{
+	for(char c : str)
+	{
+		switch(c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if((unsigned char)c < 0x20)
+			{
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+				out += buf;
+			}
+			else
+				out += c;
+		}
+	}
+}
+}
+
+printer::printer() : iDroppedDeleted(0), iSeq(0), bPending(false), iNextSeq(0), iDroppedReported(0), bStopped(false),
+	logfile(nullptr), bJson(false)
 {
 	verbose_level = LINF;
-	logfile = nullptr;
 	// Windows doesn't do line buffering, so it needs to enable full buffering and manually flush the buffer
 	setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
+
+	std::thread(&printer::flusher, this).detach();
+	std::atexit(&printer::exit_handler);
+}
+
+void printer::exit_handler()
+{
+	printer* self = inst();
+	std::unique_lock<std::mutex> lck(self->flush_mutex);
+	// a thread which is stopped inside push() never publishes its message
+	self->drain(true);
+	// stdout and the log file are closed after the exit handlers
+	self->bStopped = true;
 }
 
 bool printer::open_logfile(const char* file)
 {
-	logfile = fopen(file, "ab+");
+	FILE* f = fopen(file, "ab+");
+	std::unique_lock<std::mutex> lck(flush_mutex);
+	logfile = f;
 	return logfile != nullptr;
 }
 
@@ -172,40 +262,207 @@ void printer::print_msg(verbosity verbose, const char* fmt, ...)
 		return;
 
 	char buf[1024];
-	size_t bpos;
-	tm stime;
-
-	time_t now = time(nullptr);
-	comp_localtime(&now, &stime);
-	strftime(buf, sizeof(buf), "[%F %T] : ", &stime);
-	bpos = strlen(buf);
 
 	va_list args;
 	va_start(args, fmt);
-	vsnprintf(buf+bpos, sizeof(buf)-bpos, fmt, args);
+	int len = vsnprintf(buf, sizeof(buf), fmt, args);
 	va_end(args);
-	bpos = strlen(buf);
 
-	if(bpos+2 >= sizeof(buf))
+	if(len < 0 || size_t(len) + 2 >= sizeof(buf))
 		return;
 
-	buf[bpos] = '\n';
-	buf[bpos+1] = '\0';
-
-    print_str(buf);
+	push(verbose, std::string(buf, len));
 }
 
 void printer::print_str(const char* str)
 {
-	std::unique_lock<std::mutex> lck(print_mutex);
-	fputs(str, stdout);
-	fflush(stdout);
+	push(-1, std::string(str));
+}
 
-	if(logfile != nullptr)
+log_ring* printer::thread_ring()
+{
+	if(tls_ring.ring == nullptr)
 	{
-		fputs(str, logfile);
+		log_ring* ring = new log_ring;
+		std::unique_lock<std::mutex> lck(rings_mutex);
+		vRings.push_back(ring);
+		tls_ring.ring = ring;
+	}
+	return tls_ring.ring;
+}
+
+void printer::push(int level, std::string&& text)
+{
+	log_ring* ring = thread_ring();
+
+	size_t head = ring->head.load(std::memory_order_relaxed);
+	if(head - ring->tail.load(std::memory_order_acquire) >= log_ring::SIZE)
+	{
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	size_t slot = head % log_ring::SIZE;
+	ring->text[slot] = std::move(text);
+	ring->level[slot] = level;
+	ring->time_ms[slot] = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	ring->seq[slot] = iSeq.fetch_add(1, std::memory_order_relaxed);
+	ring->head.store(head + 1, std::memory_order_release);
+
+	if(!bPending.exchange(true))
+		oWakeCv.notify_one();
+}
+
+void printer::flusher()
+{
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lck(wake_mutex);
+			oWakeCv.wait_for(lck, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] { return bPending.load(); });
+		}
+		bPending = false;
+
+		std::unique_lock<std::mutex> lck(flush_mutex);
+		if(bStopped)
+			return;
+		drain();
+	}
+}
+
+void printer::flush()
+{
+	std::unique_lock<std::mutex> lck(flush_mutex);
+	drain();
+}
+
+uint64_t printer::get_dropped()
+{
+	std::unique_lock<std::mutex> lck(rings_mutex);
+	uint64_t dropped = iDroppedDeleted;
+	for(log_ring* ring : vRings)
+		dropped += ring->dropped.load(std::memory_order_relaxed);
+	return dropped;
+}
+
+void printer::drain(bool bAll)
+{
+	if(bStopped)
+		return;
+
+	std::vector<log_ring*> rings;
+	{
+		std::unique_lock<std::mutex> lck(rings_mutex);
+		rings = vRings;
+	}
+
+	std::vector<log_ring*> finished;
+	for(log_ring* ring : rings)
+	{
+		// a closed ring gets no more messages once they are taken
+		bool closed = ring->closed.load(std::memory_order_acquire);
+
+		size_t tail = ring->tail.load(std::memory_order_relaxed);
+		size_t head = ring->head.load(std::memory_order_acquire);
+		for(; tail != head; ++tail)
+		{
+			size_t slot = tail % log_ring::SIZE;
+			vBatch.push_back({ring->seq[slot], ring->time_ms[slot], ring->level[slot], std::move(ring->text[slot])});
+			ring->text[slot].clear();
+		}
+		ring->tail.store(tail, std::memory_order_release);
+
+		if(closed)
+			finished.push_back(ring);
+	}
+
+	if(!finished.empty())
+	{
+		std::unique_lock<std::mutex> lck(rings_mutex);
+		for(log_ring* ring : finished)
+		{
+			iDroppedDeleted += ring->dropped.load(std::memory_order_relaxed);
+			vRings.erase(std::find(vRings.begin(), vRings.end(), ring));
+			delete ring;
+		}
+	}
+
+	uint64_t dropped = get_dropped();
+	if(vBatch.empty() && dropped == iDroppedReported)
+		return;
+
+	/* A thread takes its sequence number before it publishes the message, a
+	 * message is held back while an older one is not published yet.
+	 */
+	std::sort(vBatch.begin(), vBatch.end(), [](const message& a, const message& b) { return a.seq < b.seq; });
+	size_t written = 0;
+	for(; written < vBatch.size(); written++)
+	{
+		const message& msg = vBatch[written];
+		if(msg.seq != iNextSeq && !bAll)
+			break;
+		write_message(msg);
+		iNextSeq = msg.seq + 1;
+	}
+	vBatch.erase(vBatch.begin(), vBatch.begin() + written);
+
+	if(dropped != iDroppedReported)
+	{
+		message msg;
+		msg.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		msg.level = L0;
+		msg.text = std::to_string(dropped - iDroppedReported) + " log messages dropped, the output is too slow.";
+		write_message(msg);
+		iDroppedReported = dropped;
+	}
+
+	fflush(stdout);
+	if(logfile != nullptr)
 		fflush(logfile);
+}
+
+void printer::write_message(const message& msg)
+{
+	time_t now = msg.time_ms / 1000;
+	tm stime;
+	comp_localtime(&now, &stime);
+
+	std::string line;
+	if(bJson)
+	{
+		// the reports of print_str are framed by empty lines which are not needed in a record
+		size_t first = msg.text.find_first_not_of('\n');
+		if(first == std::string::npos)
+			return;
+		size_t last = msg.text.find_last_not_of('\n');
+
+		char buf[64];
+		strftime(buf, sizeof(buf), "%FT%T", &stime);
+		line = "{\"time\":\"";
+		line += buf;
+		snprintf(buf, sizeof(buf), ".%03d\"", int(msg.time_ms % 1000));
+		line += buf;
+		if(msg.level >= 0)
+			line += ",\"level\":" + std::to_string(msg.level);
+		line += ",\"msg\":\"";
+		json_escape(msg.text.substr(first, last - first + 1), line);
+		line += "\"}\n";
+	}
+	else if(msg.level >= 0)
+	{
+		char buf[32];
+		strftime(buf, sizeof(buf), "[%F %T] : ", &stime);
+		line = buf;
+		line += msg.text;
+		line += '\n';
 	}
+
+	const std::string& out = line.empty() ? msg.text : line;
+	fputs(out.c_str(), stdout);
+	if(logfile != nullptr)
+		fputs(out.c_str(), logfile);
 }
 
 // Do a press any key for the windows folk. *insert any key joke here*
@@ -217,6 +474,7 @@ void win_exit(int code)
 	if(envSize == 0)
 	{
 		printer::inst()->print_str("Press any key to exit.");
+		printer::inst()->flush();
 		get_key();
 	}
 	std::exit(code);
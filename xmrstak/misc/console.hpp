@@ -2,7 +2,12 @@
 
 #include "xmrstak/misc/environment.hpp"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <mutex>
+#include <string>
+#include <vector>
 
 
 enum out_colours { K_RED, K_GREEN, K_BLUE, K_YELLOW, K_CYAN, K_MAGENTA, K_WHITE, K_NONE };
@@ -23,6 +28,18 @@ inline long long unsigned int int_port(size_t i)
 
 enum verbosity : size_t { L0 = 0, L1 = 1, L2 = 2, L3 = 3, L4 = 4, LINF = 100};
 
+struct log_ring;
+
+/** asynchronous console and log file output
+ *
+ * The messages are queued in a lock-free ring buffer of the calling thread and
+ * written by a background thread, a slow terminal or log file never blocks the
+ * miner threads. If the ring of a thread is full the message is dropped and
+ * counted, the number of dropped messages is printed with the next output.
+ * The messages of all threads are written in the order they were queued, a
+ * message waits until every older message is published by its thread.
+ * The queued messages are written when the process exits.
+ */
 class printer
 {
 public:
@@ -35,16 +52,66 @@ public:
 	};
 
 	inline void set_verbose_level(size_t level) { verbose_level = (verbosity)level; }
+	//! write every message as a JSON object on its own line
+	inline void set_json_output(bool enable) { bJson = enable; }
 	void print_msg(verbosity verbose, const char* fmt, ...);
 	void print_str(const char* str);
 	bool open_logfile(const char* file);
 
+	/** write all queued messages before returning */
+	void flush();
+
+	/** number of messages dropped because the ring of a thread was full */
+	uint64_t get_dropped();
+
 private:
 	printer();
 
-	std::mutex print_mutex;
-	verbosity verbose_level;
+	struct message
+	{
+		uint64_t seq;
+		//! milliseconds since the epoch
+		int64_t time_ms;
+		//! verbosity of print_msg, -1 for print_str
+		int level;
+		std::string text;
+	};
+
+	log_ring* thread_ring();
+	void push(int level, std::string&& text);
+	void flusher();
+	/** write the queued messages, requires flush_mutex
+	 *
+	 * @param bAll also write the messages behind a sequence number which is not
+	 *             published yet
+	 */
+	void drain(bool bAll = false);
+	void write_message(const message& msg);
+
+	static void exit_handler();
+
+	std::mutex rings_mutex;
+	std::vector<log_ring*> vRings;
+	//! dropped messages of the rings which are already deleted
+	uint64_t iDroppedDeleted;
+	std::atomic<uint64_t> iSeq;
+
+	std::mutex wake_mutex;
+	std::condition_variable oWakeCv;
+	std::atomic<bool> bPending;
+
+	//! serializes the output, guards the members below
+	std::mutex flush_mutex;
+	//! taken messages, the ones behind a missing sequence number are kept for the next drain
+	std::vector<message> vBatch;
+	//! sequence number of the next message to write
+	uint64_t iNextSeq;
+	uint64_t iDroppedReported;
+	bool bStopped;
 	FILE* logfile;
+
+	std::atomic<bool> bJson;
+	verbosity verbose_level;
 };
 
 void win_exit(int code = 1);
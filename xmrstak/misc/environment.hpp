@@ -9,6 +9,7 @@ namespace xmrstak
 
 struct globalStates;
 struct params;
+class traceRecorder;
 
 struct environment
 {
@@ -36,6 +37,7 @@ struct environment
 	jconf* pJconfConfig = nullptr;
 	executor* pExecutor = nullptr;
 	params* pParams = nullptr;
+	traceRecorder* pTraceRecorder = nullptr;
 };
 
 } // namespace xmrstak
@@ -24,6 +24,7 @@
 #include "xmrstak/jconf.hpp"
 #include "executor.hpp"
 #include "xmrstak/net/jpsock.hpp"
+#include "xmrstak/net/sessionLog.hpp"
 
 #include "telemetry.hpp"
 #include "xmrstak/backend/miner_work.hpp"
@@ -33,6 +34,10 @@
 
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/console.hpp"
+#include "xmrstak/misc/startupTiming.hpp"
+#include "xmrstak/misc/shmStats.hpp"
+#include "xmrstak/misc/hashHistory.hpp"
+#include "xmrstak/misc/statsStream.hpp"
 #include "xmrstak/donate-level.hpp"
 #include "xmrstak/version.hpp"
 #include "xmrstak/http/webdesign.hpp"
@@ -50,7 +55,17 @@
 #define strncasecmp _strnicmp
 #endif // _WIN32
 
-executor::executor()
+// Upper bounds of the histogram buckets in seconds
+static const double fSubmitLatencyBounds[] = { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0 };
+static const double fJobSwitchBounds[] = { 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.1 };
+
+executor::executor() :
+	oJobSwitchTimes(fJobSwitchBounds, countof(fJobSwitchBounds))
+{
+}
+
+executor::pool_stats::pool_stats() :
+	submit_latency(fSubmitLatencyBounds, countof(fSubmitLatencyBounds))
 {
 }
 
@@ -215,7 +230,7 @@ void executor::eval_pool_choice()
 
 			size_t prev_pool_id = current_pool_id;
 			current_pool_id = goal->get_pool_id();
-			on_pool_have_job(current_pool_id, oPoolJob);
+			on_pool_have_job(current_pool_id, oPoolJob, false);
 
 			jpsock* prev_pool = pick_pool_by_id(prev_pool_id);
 			if(prev_pool == nullptr || (!prev_pool->is_dev_pool() && !goal->is_dev_pool()))
@@ -358,7 +373,7 @@ void executor::on_sock_error(size_t pool_id, std::string&& sError, bool silent)
 		printer::inst()->print_msg(L1, "Dev pool socket error - mining on user pool...");
 }
 
-void executor::on_pool_have_job(size_t pool_id, pool_job& oPoolJob)
+void executor::on_pool_have_job(size_t pool_id, pool_job& oPoolJob, bool bNewJob)
 {
 	if(pool_id != current_pool_id)
 		return;
@@ -373,6 +388,41 @@ void executor::on_pool_have_job(size_t pool_id, pool_job& oPoolJob)
 
 	xmrstak::globalStates::inst().switch_work(oWork, dat);
 
+	// the cached job of a pool switch was received long ago and is already counted
+	const bool bHaveRecvTime = bNewJob && oPoolJob.iRecvTimeUs != 0;
+	uint64_t iSwitchUs = bHaveRecvTime ? get_timestamp_us() - oPoolJob.iRecvTimeUs : 0;
+	if(bHaveRecvTime)
+		oJobSwitchTimes.add(double(iSwitchUs) / 1000000.0);
+
+	pool_stats& stats = mPoolStats[pool_id];
+	uint64_t iJobUs = oPoolJob.iRecvTimeUs != 0 ? oPoolJob.iRecvTimeUs : get_timestamp_us();
+	if(bNewJob)
+	{
+		stats.jobs++;
+		if(iLastJobPoolId == pool_id && iJobUs > iLastJobUs)
+			stats.job_intervals.add((iJobUs - iLastJobUs) / 1000, get_timestamp());
+	}
+	iLastJobPoolId = pool_id;
+	iLastJobUs = iJobUs;
+
+	if(xmrstak::statsStream::inst()->is_active())
+	{
+		std::string json = "{\"pool\":\"";
+		xmrstak::statsStream::json_escape(pool->get_pool_addr(), json);
+		json.append("\",\"job_id\":\"");
+		xmrstak::statsStream::json_escape(oPoolJob.sJobID, json);
+		json.append("\",\"difficulty\":").append(std::to_string(jpsock::t64_to_diff(oPoolJob.iTarget)));
+		json.append(",\"switch_us\":").append(std::to_string(iSwitchUs)).append(1, '}');
+		xmrstak::statsStream::inst()->push("job", std::move(json));
+	}
+
+	if(sessionLog::inst()->is_recording())
+	{
+		char buf[128];
+		int len = snprintf(buf, sizeof(buf), "%s %llu", oPoolJob.sJobID, int_port(jpsock::t64_to_diff(oPoolJob.iTarget)));
+		sessionLog::inst()->record(sessionLog::REC_JOB, pool_id, buf, len);
+	}
+
 	if(dat.pool_id != pool_id)
 	{
 		jpsock* prev_pool;
@@ -380,6 +430,12 @@ void executor::on_pool_have_job(size_t pool_id, pool_job& oPoolJob)
 			prev_pool->save_nonce(dat.iSavedNonce);
 	}
 
+	if(!bHaveFirstJob)
+	{
+		bHaveFirstJob = true;
+		xmrstak::startupTiming::inst()->record("pool connect and login", iPoolConnectStart);
+	}
+
 	if(pool->is_dev_pool())
 		return;
 
@@ -410,6 +466,13 @@ void executor::on_miner_result(size_t pool_id, job_result& oResult)
 {
 	jpsock* pool = pick_pool_by_id(pool_id);
 
+	if(sessionLog::inst()->is_recording())
+	{
+		char buf[128];
+		int len = snprintf(buf, sizeof(buf), "%s %08x %u", oResult.sJobID, oResult.iNonce, unsigned(oResult.iThreadId));
+		sessionLog::inst()->record(sessionLog::REC_RESULT, pool_id, buf, len);
+	}
+
 	const char* backend_name = xmrstak::iBackend::getName(pvThreads->at(oResult.iThreadId)->backendType);
 	uint64_t backend_hashcount, total_hashcount = 0;
 
@@ -429,24 +492,37 @@ void executor::on_miner_result(size_t pool_id, job_result& oResult)
 
 	if (!pool->is_running() || !pool->is_logged_in())
 	{
+		stream_share(pool, oResult, false, 0, "[NETWORK ERROR]");
 		log_result_error("[NETWORK ERROR]");
 		return;
 	}
 
-	size_t t_start = get_timestamp_ms();
+	pool_job oCurrentJob;
+	bool bStale = pool->get_current_job(oCurrentJob) && strcmp(oCurrentJob.sJobID, oResult.sJobID) != 0;
+	if(bStale)
+		iStaleShares++;
+
+	uint64_t t_start = get_timestamp_us();
 	bool bResult = pool->cmd_submit(oResult.sJobID, oResult.iNonce, oResult.bResult,
 		backend_name, backend_hashcount, total_hashcount, oResult.algorithm
 	);
-	size_t t_len = get_timestamp_ms() - t_start;
-
-	if(t_len > 0xFFFF)
-		t_len = 0xFFFF;
-	iPoolCallTimes.push_back((uint16_t)t_len);
+	uint64_t t_end = get_timestamp_us();
+	uint64_t t_us = t_end - t_start;
+	xmrstak::traceRecorder::inst().complete("share", bResult ? "submit accepted" : "submit rejected", t_start, t_end,
+		oResult.sJobID, "stale", bStale ? 1 : 0);
+	uint64_t* targets = (uint64_t*)oResult.bResult;
+
+	size_t now = get_timestamp();
+	pool_stats& stats = mPoolStats[pool_id];
+	stats.submit_latency.add(double(t_us) / 1000000.0);
+	stats.submit_times.add(t_us, now);
+	stats.share_diffs.add(jpsock::t64_to_diff(targets[3]), now);
+	oPoolCallTimes.add(t_us);
 
 	if(bResult)
 	{
-		uint64_t* targets = (uint64_t*)oResult.bResult;
 		log_result_ok(jpsock::t64_to_diff(targets[3]));
+		stream_share(pool, oResult, bStale, t_us, nullptr);
 		printer::inst()->print_msg(L3, "Result accepted by the pool.");
 	}
 	else
@@ -463,13 +539,42 @@ void executor::on_miner_result(size_t pool_id, job_result& oResult)
 				pool->disconnect();
 			}
 
+			stream_share(pool, oResult, bStale, t_us, error.c_str());
 			log_result_error(std::move(error));
 		}
 		else
+		{
+			stream_share(pool, oResult, bStale, t_us, "[NETWORK ERROR]");
 			log_result_error("[NETWORK ERROR]");
+		}
 	}
 }
 
+void executor::stream_share(jpsock* pool, const job_result& oResult, bool stale, uint64_t latency_us, const char* error)
+{
+	if(!xmrstak::statsStream::inst()->is_active())
+		return;
+
+	uint64_t* targets = (uint64_t*)oResult.bResult;
+	std::string json = "{\"pool\":\"";
+	xmrstak::statsStream::json_escape(pool->get_pool_addr(), json);
+	json.append("\",\"job_id\":\"");
+	xmrstak::statsStream::json_escape(oResult.sJobID, json);
+	json.append("\",\"thread\":").append(std::to_string(oResult.iThreadId));
+	json.append(",\"backend\":\"").append(xmrstak::iBackend::getName(pvThreads->at(oResult.iThreadId)->backendType));
+	json.append("\",\"difficulty\":").append(std::to_string(jpsock::t64_to_diff(targets[3])));
+	json.append(",\"accepted\":").append(error == nullptr ? "true" : "false");
+	if(error != nullptr)
+	{
+		json.append(",\"reason\":\"");
+		xmrstak::statsStream::json_escape(error, json);
+		json.append(1, '"');
+	}
+	json.append(",\"stale\":").append(stale ? "true" : "false");
+	json.append(",\"latency_us\":").append(std::to_string(latency_us)).append(1, '}');
+	xmrstak::statsStream::inst()->push("share", std::move(json));
+}
+
 #ifndef _WIN32
 
 #include <signal.h>
@@ -490,23 +595,20 @@ inline void disable_sigpipe() {}
 void executor::ex_main()
 {
 	disable_sigpipe();
+	xmrstak::traceRecorder::inst().set_thread_name("executor");
 
 	assert(1000 % iTickTime == 0);
 
 	xmrstak::miner_work oWork = xmrstak::miner_work();
 
-	// \todo collect all backend threads
-	pvThreads = xmrstak::BackendConnector::thread_starter(oWork);
-
-	if(pvThreads->size()==0)
-	{
-		printer::inst()->print_msg(L1, "ERROR: No miner backend enabled.");
-		win_exit();
-	}
-
-	telem = new xmrstak::telemetry(pvThreads->size());
+	// Start the backends in the background, scratchpad population and GPU
+	// setup overlap with the pool connect and login below. Socket events are
+	// queued until we enter the event loop.
+	std::future<std::vector<xmrstak::iBackend*>*> backends =
+		std::async(std::launch::async, xmrstak::BackendConnector::thread_starter, std::ref(oWork));
 
 	set_timestamp();
+	iStartTimestamp = get_timestamp();
 	size_t pc = jconf::inst()->GetPoolCount();
 	bool dev_tls = true;
 	bool already_have_cli_pool = false;
@@ -587,11 +689,42 @@ void executor::ex_main()
 		break;
 	}
 
+	iPoolConnectStart = xmrstak::startupTiming::inst()->now();
+	eval_pool_choice();
+
+	// \todo collect all backend threads
+	pvThreads = backends.get();
+
+	if(pvThreads->size()==0)
+	{
+		printer::inst()->print_msg(L1, "ERROR: No miner backend enabled.");
+		win_exit();
+	}
+
+	telem = new xmrstak::telemetry(pvThreads->size());
+
+	if(!xmrstak::params::inst().historyFile.empty())
+	{
+		std::vector<uint32_t> backends;
+		for(xmrstak::iBackend* backend : *pvThreads)
+			backends.push_back(backend->backendType);
+
+		std::string err;
+		if(!xmrstak::hashHistory::inst()->open(xmrstak::params::inst().historyFile.c_str(), backends, err))
+			printer::inst()->print_msg(L0, "ERROR: %s", err.c_str());
+	}
+
+	if(xmrstak::shmStats::inst()->is_open())
+	{
+		for(xmrstak::iBackend* backend : *pvThreads)
+			backend->pShmSlot.store(xmrstak::shmStats::inst()->thread_block(backend->iThreadNo, backend->backendType), std::memory_order_release);
+		if(pvThreads->size() > xmrstak::shm::MAX_THREADS)
+			printer::inst()->print_msg(L0, "WARNING: only the first %u threads have a block in the shared memory statistics.", unsigned(xmrstak::shm::MAX_THREADS));
+	}
+
 	ex_event ev;
 	std::thread clock_thd(&executor::ex_clock_thd, this);
 
-	eval_pool_choice();
-
 	// Place the default success result at position 0, it needs to
 	// be here even if our first result is a failure
 	vMineResults.emplace_back();
@@ -636,8 +769,30 @@ void executor::ex_main()
 
 		case EV_PERF_TICK:
 			for (i = 0; i < pvThreads->size(); i++)
-				telem->push_perf_value(i, pvThreads->at(i)->iHashCount.load(std::memory_order_relaxed),
-				pvThreads->at(i)->iTimestamp.load(std::memory_order_relaxed));
+			{
+				uint64_t iHashCount = pvThreads->at(i)->iHashCount.load(std::memory_order_relaxed);
+				telem->push_perf_value(i, iHashCount, pvThreads->at(i)->iTimestamp.load(std::memory_order_relaxed));
+				pvThreads->at(i)->oPerfCounters.sample(iHashCount);
+
+				// the startup report is printed once, with the tick of the first hash
+				if(!bHaveFirstHash && iHashCount != 0)
+				{
+					bHaveFirstHash = true;
+					xmrstak::startupTiming::inst()->first_hash();
+				}
+			}
+
+			if(xmrstak::hashHistory::inst()->is_open())
+			{
+				std::vector<uint64_t> hashes, stamps;
+				for(xmrstak::iBackend* backend : *pvThreads)
+				{
+					// same order as the telemetry, the hash count is published before its time stamp
+					hashes.push_back(backend->iHashCount.load(std::memory_order_relaxed));
+					stamps.push_back(backend->iTimestamp.load(std::memory_order_relaxed));
+				}
+				xmrstak::hashHistory::inst()->tick(hashes, stamps, vMineResults[0].count);
+			}
 
 			if((cnt++ & 0xF) == 0) //Every 16 ticks
 			{
@@ -662,6 +817,8 @@ void executor::ex_main()
 				if(normal && fHighestHps < fHps)
 					fHighestHps = fHps;
 			}
+
+			publish_stats();
 			break;
 
 		case EV_USR_HASHRATE:
@@ -751,6 +908,29 @@ bool executor::motd_filter_web(std::string& motd)
 	return true;
 }
 
+//! hardware counters of all threads, indexed like the hashrate of the threads
+std::vector<const xmrstak::perfCounters*> executor::all_perf_counters()
+{
+	std::vector<const xmrstak::perfCounters*> perf;
+	for(xmrstak::iBackend* backend : *pvThreads)
+		perf.push_back(&backend->oPerfCounters);
+	return perf;
+}
+
+#ifdef XMRSTAK_PHASE_STATS
+//! phase counters of the CPU threads
+std::vector<const xmrstak::phaseStats*> executor::cpu_phase_stats()
+{
+	std::vector<const xmrstak::phaseStats*> stats;
+	for(xmrstak::iBackend* backend : *pvThreads)
+	{
+		if(backend->backendType == xmrstak::iBackend::CPU)
+			stats.push_back(&backend->oPhaseStats);
+	}
+	return stats;
+}
+#endif
+
 void executor::hashrate_report(std::string& out)
 {
 	out.reserve(2048 + pvThreads->size() * 64);
@@ -846,7 +1026,28 @@ void executor::hashrate_report(std::string& out)
 	out.append(" H/s\nHighest: ");
 	out.append(hps_format(fHighestHps, num, sizeof(num)));
 	out.append(" H/s\n");
+
+	uint64_t iParkedTime = 0;
+	for(xmrstak::iBackend* backend : *pvThreads)
+		iParkedTime += backend->iParkedTime.load(std::memory_order_relaxed);
+	if(iParkedTime != 0)
+	{
+		snprintf(num, sizeof(num), "%.1f", double(iParkedTime) / 1000.0);
+		out.append("Parked (background mode): ").append(num).append(" thread-seconds\n");
+	}
 	out.append("-----------------------------------------------------------------\n");
+
+	std::vector<const xmrstak::perfCounters*> perf;
+	for(xmrstak::iBackend* backend : *pvThreads)
+	{
+		if(backend->backendType == xmrstak::iBackend::CPU)
+			perf.push_back(&backend->oPerfCounters);
+	}
+	xmrstak::perfCounters::get_report(perf, out);
+
+#ifdef XMRSTAK_PHASE_STATS
+	xmrstak::phaseStats::get_report(cpu_phase_stats(), out);
+#endif
 }
 
 char* time_format(char* buf, size_t len, std::chrono::system_clock::time_point time)
@@ -902,10 +1103,10 @@ void executor::result_report(std::string& out)
 	out.append("Good results     : ").append(std::to_string(iGoodRes)).append(" / ").
 		append(std::to_string(iTotalRes)).append(num);
 
-	if(iPoolCallTimes.size() != 0)
+	if(oPoolCallTimes.count() != 0)
 	{
-		// Here we use iPoolCallTimes since it also gets reset when we disconnect
-		snprintf(num, sizeof(num), "%.1f sec\n", dConnSec / iPoolCallTimes.size());
+		// Here we use oPoolCallTimes since it also gets reset when we disconnect
+		snprintf(num, sizeof(num), "%.1f sec\n", dConnSec / oPoolCallTimes.count());
 		out.append("Avg result time  : ").append(num);
 	}
 	out.append("Pool-side hashes : ").append(std::to_string(iPoolHashes)).append(2, '\n');
@@ -951,16 +1152,19 @@ void executor::connection_report(std::string& out)
 	else
 		out.append("Connected since : <not connected>\n");
 
-	size_t n_calls = iPoolCallTimes.size();
-	if (n_calls > 1)
+	if(oPoolCallTimes.count() != 0)
 	{
-		//Not-really-but-good-enough median
-		std::nth_element(iPoolCallTimes.begin(), iPoolCallTimes.begin() + n_calls/2, iPoolCallTimes.end());
-		out.append("Pool ping time  : ").append(std::to_string(iPoolCallTimes[n_calls/2])).append(" ms\n");
+		snprintf(num, sizeof(num), "Pool ping time  : %.1f ms (p90 %.1f ms, p99 %.1f ms, max %.1f ms)\n",
+			oPoolCallTimes.quantile(0.5) / 1000.0, oPoolCallTimes.quantile(0.9) / 1000.0,
+			oPoolCallTimes.quantile(0.99) / 1000.0, oPoolCallTimes.max() / 1000.0);
+		out.append(num);
 	}
 	else
 		out.append("Pool ping time  : (n/a)\n");
 
+	if(pool != nullptr)
+		pool_stats_report(pool->get_pool_id(), out);
+
 	out.append("\nNetwork error log:\n");
 	size_t ln = vSocketLog.size();
 	if(ln > 0)
@@ -977,6 +1181,52 @@ void executor::connection_report(std::string& out)
 		out.append("Yay! No errors.\n");
 }
 
+// rows of the pool statistics, the values of the sketches are divided by the scale
+static const char* const sPoolStatsNames[] = { "Submit time ms", "Job interval s", "Share difficulty" };
+static const double fPoolStatsScale[] = { 1000.0, 1000.0, 1.0 };
+static const int iPoolStatsPrecision[] = { 1, 1, 0 };
+
+/** one row per statistic and window
+ *
+ * @param fmt format of a row with the arguments name, window, count and
+ *            precision and value of p50, p90, p99 and max
+ */
+static void pool_stats_rows(const xmrstak::windowedSketch* const* sketches, const char* fmt, std::string& out)
+{
+	using xmrstak::windowedSketch;
+	char buffer[512];
+	xmrstak::quantileSketch s;
+	size_t now = get_timestamp();
+
+	for(size_t r = 0; r < countof(sPoolStatsNames); r++)
+	{
+		double scale = fPoolStatsScale[r];
+		int prec = iPoolStatsPrecision[r];
+		for(size_t i = 0; i < windowedSketch::WINDOW_COUNT; i++)
+		{
+			sketches[r]->get(windowedSketch::window_sec[i], now, s);
+			snprintf(buffer, sizeof(buffer), fmt, i == 0 ? sPoolStatsNames[r] : "", windowedSketch::window_names[i],
+				int_port(s.count()), prec, s.quantile(0.5) / scale, prec, s.quantile(0.9) / scale,
+				prec, s.quantile(0.99) / scale, prec, s.max() / scale);
+			out.append(buffer);
+		}
+	}
+}
+
+void executor::pool_stats_report(size_t pool_id, std::string& out)
+{
+	auto it = mPoolStats.find(pool_id);
+	if(it == mPoolStats.end())
+		return;
+
+	const pool_stats& stats = it->second;
+	const xmrstak::windowedSketch* sketches[] = { &stats.submit_times, &stats.job_intervals, &stats.share_diffs };
+
+	out.append("\nPool statistics:\n");
+	out.append("|                  | Window |   Count |         p50 |         p90 |         p99 |         max |\n");
+	pool_stats_rows(sketches, "| %-16s | %-6s | %7llu | %11.*f | %11.*f | %11.*f | %11.*f |\n", out);
+}
+
 void executor::print_report(ex_event_name ev)
 {
 	std::string out;
@@ -1069,6 +1319,9 @@ void executor::http_hashrate_report(std::string& out)
 
 	snprintf(buffer, sizeof(buffer), sHtmlHashrateBodyLow, num_a, num_b, num_c, num_d);
 	out.append(buffer);
+
+	xmrstak::perfCounters::get_html(all_perf_counters(), out);
+	out.append(sHtmlHashrateBodyEnd);
 }
 
 void executor::http_result_report(std::string& out)
@@ -1092,11 +1345,11 @@ void executor::http_result_report(std::string& out)
 		fGoodResPrc = 100.0 * iGoodRes / iTotalRes;
 
 	double fAvgResTime = 0.0;
-	if(iPoolCallTimes.size() > 0)
+	if(oPoolCallTimes.count() > 0)
 	{
 		using namespace std::chrono;
 		fAvgResTime = ((double)duration_cast<seconds>(system_clock::now() - tPoolConnTime).count())
-			/ iPoolCallTimes.size();
+			/ oPoolCallTimes.count();
 	}
 
 	snprintf(buffer, sizeof(buffer), sHtmlResultBodyHigh,
@@ -1135,20 +1388,15 @@ void executor::http_connection_report(std::string& out)
 	if (pool != nullptr && pool->is_running() && pool->is_logged_in())
 		cdate = time_format(date, sizeof(date), tPoolConnTime);
 
-	size_t n_calls = iPoolCallTimes.size();
-	unsigned int ping_time = 0;
-	if (n_calls > 1)
-	{
-		//Not-really-but-good-enough median
-		std::nth_element(iPoolCallTimes.begin(), iPoolCallTimes.begin() + n_calls/2, iPoolCallTimes.end());
-		ping_time = iPoolCallTimes[n_calls/2];
-	}
-
 	snprintf(buffer, sizeof(buffer), sHtmlConnectionBodyHigh,
 		pool != nullptr ? pool->get_pool_addr() : "not connected",
-		cdate, ping_time);
+		cdate, oPoolCallTimes.quantile(0.5) / 1000.0);
 	out.append(buffer);
 
+	if(pool != nullptr)
+		http_pool_stats_report(pool->get_pool_id(), out);
+
+	out.append(sHtmlConnectionErrorHigh);
 
 	for(size_t i=0; i < vSocketLog.size(); i++)
 	{
@@ -1160,6 +1408,20 @@ void executor::http_connection_report(std::string& out)
 	out.append(sHtmlConnectionBodyLow);
 }
 
+void executor::http_pool_stats_report(size_t pool_id, std::string& out)
+{
+	auto it = mPoolStats.find(pool_id);
+	if(it == mPoolStats.end())
+		return;
+
+	const pool_stats& stats = it->second;
+	const xmrstak::windowedSketch* sketches[] = { &stats.submit_times, &stats.job_intervals, &stats.share_diffs };
+
+	out.append(sHtmlPoolStatsHigh);
+	pool_stats_rows(sketches, sHtmlPoolStatsRow, out);
+	out.append("</table>");
+}
+
 inline const char* hps_format_json(double h, char* buf, size_t l)
 {
 	if(std::isnormal(h) || h == 0.0)
@@ -1176,15 +1438,20 @@ void executor::http_json_report(std::string& out)
 	const char *a, *b, *c;
 	char num_a[32], num_b[32], num_c[32];
 	char hr_buffer[64];
-	std::string hr_thds, res_error, cn_error;
+	std::string hr_thds, hr_parked, res_error, cn_error;
 
 	size_t nthd = pvThreads->size();
 	double fTotal[3] = { 0.0, 0.0, 0.0};
 	hr_thds.reserve(nthd * 32);
+	hr_parked.reserve(nthd * 16);
 
 	for(size_t i=0; i < nthd; i++)
 	{
 		if(i != 0) hr_thds.append(1, ',');
+		if(i != 0) hr_parked.append(1, ',');
+
+		snprintf(num_a, sizeof(num_a), "%.1f", double(pvThreads->at(i)->iParkedTime.load(std::memory_order_relaxed)) / 1000.0);
+		hr_parked.append(num_a);
 
 		double fHps[3];
 		fHps[0] = telem->calc_telemetry_data(10000, i);
@@ -1227,8 +1494,8 @@ void executor::http_json_report(std::string& out)
 	}
 
 	double fAvgResTime = 0.0;
-	if(iPoolCallTimes.size() > 0)
-		fAvgResTime = double(iConnSec) / iPoolCallTimes.size();
+	if(oPoolCallTimes.count() > 0)
+		fAvgResTime = double(iConnSec) / oPoolCallTimes.count();
 
 	char buffer[2048];
 	res_error.reserve((vMineResults.size() - 1) * 128);
@@ -1243,13 +1510,24 @@ void executor::http_json_report(std::string& out)
 		res_error.append(buffer);
 	}
 
-	size_t n_calls = iPoolCallTimes.size();
-	size_t iPoolPing = 0;
-	if (n_calls > 1)
+	size_t iPoolPing = oPoolCallTimes.quantile(0.5) / 1000;
+
+	std::string pool_json;
+	size_t now = get_timestamp();
+	for(jpsock& usr_pool : pools)
 	{
-		//Not-really-but-good-enough median
-		std::nth_element(iPoolCallTimes.begin(), iPoolCallTimes.begin() + n_calls/2, iPoolCallTimes.end());
-		iPoolPing = iPoolCallTimes[n_calls/2];
+		auto it = mPoolStats.find(usr_pool.get_pool_id());
+		if(usr_pool.is_dev_pool() || it == mPoolStats.end())
+			continue;
+
+		if(!pool_json.empty()) pool_json.append(1, ',');
+		pool_json.append("{\"pool\":\"").append(usr_pool.get_pool_addr()).append("\",\"submit_time_ms\":");
+		it->second.submit_times.get_json(now, 1000.0, pool_json);
+		pool_json.append(",\"job_interval_s\":");
+		it->second.job_intervals.get_json(now, 1000.0, pool_json);
+		pool_json.append(",\"share_difficulty\":");
+		it->second.share_diffs.get_json(now, 1.0, pool_json);
+		pool_json.append(1, '}');
 	}
 
 	cn_error.reserve(vSocketLog.size() * 256);
@@ -1264,19 +1542,107 @@ void executor::http_json_report(std::string& out)
 		cn_error.append(buffer);
 	}
 
-	size_t bb_size = 2048 + hr_thds.size() + res_error.size() + cn_error.size();
+	std::string startup;
+	xmrstak::startupTiming::inst()->get_json(startup);
+
+	std::string perf;
+	xmrstak::perfCounters::get_json(all_perf_counters(), perf);
+
+	std::string phases;
+#ifdef XMRSTAK_PHASE_STATS
+	xmrstak::phaseStats::get_json(cpu_phase_stats(), phases);
+#else
+	phases = "null";
+#endif
+
+	size_t bb_size = 2048 + hr_thds.size() + hr_parked.size() + res_error.size() + cn_error.size() + pool_json.size() +
+		startup.size() + perf.size() + phases.size();
 	std::unique_ptr<char[]> bigbuf( new char[ bb_size ] );
 
 	int bb_len = snprintf(bigbuf.get(), bb_size, sJsonApiFormat,
-		get_version_str().c_str(), hr_thds.c_str(), hr_buffer, a,
+		get_version_str().c_str(), hr_thds.c_str(), hr_buffer, a, hr_parked.c_str(),
 		int_port(iPoolDiff), int_port(iGoodRes), int_port(iTotalRes), fAvgResTime, int_port(iPoolHashes),
 		int_port(iTopDiff[0]), int_port(iTopDiff[1]), int_port(iTopDiff[2]), int_port(iTopDiff[3]), int_port(iTopDiff[4]),
 		int_port(iTopDiff[5]), int_port(iTopDiff[6]), int_port(iTopDiff[7]), int_port(iTopDiff[8]), int_port(iTopDiff[9]),
-		res_error.c_str(), pool != nullptr ? pool->get_pool_addr() : "not connected", int_port(iConnSec), int_port(iPoolPing), cn_error.c_str());
+		res_error.c_str(), pool != nullptr ? pool->get_pool_addr() : "not connected", int_port(iConnSec), int_port(iPoolPing), cn_error.c_str(),
+		pool_json.c_str(), startup.c_str(), perf.c_str(), phases.c_str());
 
 	out = std::string(bigbuf.get(), bigbuf.get() + bb_len);
 }
 
+void executor::publish_stats()
+{
+	using namespace std::chrono;
+	std::shared_ptr<xmrstak::statsSnapshot> snap = std::make_shared<xmrstak::statsSnapshot>();
+
+	snap->uptime_sec = get_timestamp() - iStartTimestamp;
+
+	size_t nthd = pvThreads->size();
+	snap->threads.resize(nthd);
+	for(size_t i=0; i < nthd; i++)
+	{
+		xmrstak::iBackend* backend = pvThreads->at(i);
+		xmrstak::statsSnapshot::thread& thd = snap->threads[i];
+		thd.backend = xmrstak::iBackend::getName(backend->backendType);
+		thd.type = backend->backendType;
+		thd.hashes = backend->iHashCount.load(std::memory_order_relaxed);
+		thd.hps[0] = telem->calc_telemetry_data(10000, i);
+		thd.hps[1] = telem->calc_telemetry_data(60000, i);
+		thd.hps[2] = telem->calc_telemetry_data(900000, i);
+		thd.parked_sec = double(backend->iParkedTime.load(std::memory_order_relaxed)) / 1000.0;
+	}
+	snap->highest_hps = fHighestHps;
+
+	snap->shares_accepted = vMineResults[0].count;
+	for(size_t i=1; i < vMineResults.size(); i++)
+		snap->shares_rejected.emplace_back(vMineResults[i].msg, vMineResults[i].count);
+	snap->shares_stale = iStaleShares;
+	snap->best_share_diff = iTopDiff[0];
+	snap->pool_hashes = iPoolHashes;
+	snap->socket_errors = vSocketLog.size();
+	snap->log_dropped = printer::inst()->get_dropped();
+
+	jpsock* usr_pool = pick_pool_by_id(current_pool_id);
+	if(usr_pool != nullptr && usr_pool->is_dev_pool())
+		usr_pool = pick_pool_by_id(last_usr_pool_id);
+	if(usr_pool != nullptr && usr_pool->is_running() && usr_pool->is_logged_in())
+		snap->connected_sec = duration_cast<seconds>(system_clock::now() - tPoolConnTime).count();
+
+	snap->job_switch_latency = oJobSwitchTimes;
+
+	for(jpsock& pool : pools)
+	{
+		snap->pools.emplace_back();
+		xmrstak::statsSnapshot::pool& p = snap->pools.back();
+		size_t attempts, dtime;
+		pool.get_disconnects(attempts, dtime);
+
+		p.addr = pool.get_pool_addr();
+		p.dev_pool = pool.is_dev_pool();
+		p.active = pool.get_pool_id() == current_pool_id;
+		p.connected = pool.is_running();
+		p.logged_in = pool.is_logged_in();
+		p.connect_attempts = attempts;
+		p.difficulty = pool.get_current_diff();
+
+		const pool_stats& stats = mPoolStats[pool.get_pool_id()];
+		p.jobs = stats.jobs;
+		p.submit_latency = stats.submit_latency;
+	}
+
+	if(xmrstak::shmStats::inst()->is_open())
+	{
+		pool_job oJob;
+		jpsock* pool = pick_pool_by_id(current_pool_id);
+		if(pool != nullptr && pool->is_logged_in() && pool->get_current_job(oJob))
+			xmrstak::shmStats::inst()->update(*snap, pool->get_pool_addr(), oJob.sJobID, pool->get_current_diff());
+		else
+			xmrstak::shmStats::inst()->update(*snap, nullptr, nullptr, 0);
+	}
+
+	xmrstak::statsSnapshot::publish(std::move(snap));
+}
+
 void executor::http_report(ex_event_name ev)
 {
 	assert(pHttpString != nullptr);
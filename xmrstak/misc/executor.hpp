@@ -2,6 +2,9 @@
 
 #include "thdq.hpp"
 #include "telemetry.hpp"
+#include "statsSnapshot.hpp"
+#include "quantileSketch.hpp"
+#include "traceRecorder.hpp"
 #include "xmrstak/backend/iBackend.hpp"
 #include "xmrstak/misc/environment.hpp"
 #include "xmrstak/net/msgstruct.hpp"
@@ -10,6 +13,7 @@
 #include <atomic>
 #include <array>
 #include <list>
+#include <map>
 #include <vector>
 #include <future>
 #include <chrono>
@@ -40,7 +44,12 @@ public:
 
 	void get_http_report(ex_event_name ev_id, std::string& data);
 
-	inline void push_event(ex_event&& ev) { oEventQ.push(std::move(ev)); }
+	inline void push_event(ex_event&& ev)
+	{
+		if(ev.iName == EV_MINER_HAVE_RESULT)
+			xmrstak::traceRecorder::inst().instant("share", "result found", ev.oJobResult.sJobID, "nonce", ev.oJobResult.iNonce);
+		oEventQ.push(std::move(ev));
+	}
 	void push_timed_event(ex_event&& ev, size_t sec);
 
 private:
@@ -98,18 +107,26 @@ private:
 	bool motd_filter_console(std::string& motd);
 	bool motd_filter_web(std::string& motd);
 
+	std::vector<const xmrstak::perfCounters*> all_perf_counters();
+#ifdef XMRSTAK_PHASE_STATS
+	std::vector<const xmrstak::phaseStats*> cpu_phase_stats();
+#endif
 	void hashrate_report(std::string& out);
 	void result_report(std::string& out);
 	void connection_report(std::string& out);
+	void pool_stats_report(size_t pool_id, std::string& out);
 
 	void http_hashrate_report(std::string& out);
 	void http_result_report(std::string& out);
 	void http_connection_report(std::string& out);
+	void http_pool_stats_report(size_t pool_id, std::string& out);
 	void http_json_report(std::string& out);
 
 	void http_report(ex_event_name ev);
 	void print_report(ex_event_name ev);
 
+	void publish_stats();
+
 	std::string* pHttpString = nullptr;
 	std::promise<void> httpReady;
 	std::mutex httpMutex;
@@ -167,28 +184,58 @@ private:
 	size_t iPoolHashes = 0;
 	uint64_t iPoolDiff = 0;
 
-	// Set it to 16 bit so that we can just let it grow
-	// Maximum realistic growth rate - 5MB / month
-	std::vector<uint16_t> iPoolCallTimes;
+	// Submit times in microseconds
+	xmrstak::quantileSketch oPoolCallTimes;
 
 	//Those stats are reset if we disconnect
 	inline void reset_stats()
 	{
-		iPoolCallTimes.clear();
+		oPoolCallTimes.clear();
 		tPoolConnTime = std::chrono::system_clock::now();
 		iPoolHashes = 0;
 	}
 
 	double fHighestHps = 0.0;
 
+	// Statistics of the stats snapshot, they are not reset on disconnect
+	struct pool_stats
+	{
+		pool_stats();
+
+		xmrstak::histogram submit_latency;
+		size_t jobs = 0;
+
+		// submit time in microseconds, difficulty of the submitted shares and
+		// the time between two jobs in milliseconds
+		xmrstak::windowedSketch submit_times;
+		xmrstak::windowedSketch share_diffs;
+		xmrstak::windowedSketch job_intervals;
+	};
+	std::map<size_t, pool_stats> mPoolStats;
+	size_t iLastJobPoolId = invalid_pool_id;
+	uint64_t iLastJobUs = 0;
+	xmrstak::histogram oJobSwitchTimes;
+	size_t iStaleShares = 0;
+	size_t iStartTimestamp = 0;
+
+	// startup timing
+	size_t iPoolConnectStart = 0;
+	bool bHaveFirstJob = false;
+	bool bHaveFirstHash = false;
+
 	void log_socket_error(jpsock* pool, std::string&& sError);
 	void log_result_error(std::string&& sError);
 	void log_result_ok(uint64_t iActualDiff);
 
 	void on_sock_ready(size_t pool_id);
 	void on_sock_error(size_t pool_id, std::string&& sError, bool silent);
-	void on_pool_have_job(size_t pool_id, pool_job& oPoolJob);
+	/** switch the miners to a job of the current pool
+	 *
+	 * @param bNewJob the job was just received, false for the cached job of a pool switch
+	 */
+	void on_pool_have_job(size_t pool_id, pool_job& oPoolJob, bool bNewJob = true);
 	void on_miner_result(size_t pool_id, job_result& oResult);
+	void stream_share(jpsock* pool, const job_result& oResult, bool stale, uint64_t latency_us, const char* error);
 	void connect_to_pools(std::list<jpsock*>& eval_pools);
 	bool get_live_pools(std::vector<jpsock*>& eval_pools, bool is_dev);
 	void eval_pool_choice();
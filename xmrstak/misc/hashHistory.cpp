@@ -0,0 +1,482 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "hashHistory.hpp"
+#include "xmrstak/misc/console.hpp"
+#include "xmrstak/net/msgstruct.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace xmrstak
+{
+
+hashHistory* hashHistory::oInst = nullptr;
+
+// 1 hour of seconds, 1 day of minutes and 30 days of quarter hours, the first
+// tier must cover an interval of the others
+const hashHistory::tier hashHistory::tiers[TIER_COUNT] = {
+	{ "1s", 1, 3600 },
+	{ "1m", 60, 1440 },
+	{ "15m", 900, 2880 }
+};
+
+namespace
+{
+constexpr uint32_t VERSION = 1;
+constexpr size_t MAX_THREADS = 256;
+//! total hash rate, accepted shares per minute, backends, threads
+constexpr size_t SERIES_TOTAL = 0;
+constexpr size_t SERIES_SHARES = 1;
+constexpr size_t SERIES_BACKEND = 2;
+const char* backend_names[] = { "unknown", "cpu", "amd", "nvidia", "fpga" };
+//! a thread which did not update its hash count for this time is counted with 0
+constexpr uint64_t THREAD_TIMEOUT_MS = 10000;
+
+struct file_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t thread_count;
+	uint32_t series_count;
+	uint32_t tier_count;
+	uint32_t resolution[hashHistory::TIER_COUNT];
+	uint32_t slots[hashHistory::TIER_COUNT];
+	uint8_t backends[MAX_THREADS];
+};
+
+uint64_t unix_sec()
+{
+	using namespace std::chrono;
+	return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+}
+
+//! both files have the same tiers, only the threads can differ
+bool same_tiers(const file_header& a, const file_header& b)
+{
+	return memcmp(a.magic, b.magic, sizeof(a.magic)) == 0 && a.version == b.version && a.tier_count == b.tier_count &&
+		memcmp(a.resolution, b.resolution, sizeof(a.resolution)) == 0 && memcmp(a.slots, b.slots, sizeof(a.slots)) == 0;
+}
+
+size_t file_size(const file_header& hdr)
+{
+	size_t size = sizeof(file_header);
+	for(size_t t = 0; t < hashHistory::TIER_COUNT; t++)
+		size += hdr.slots[t] * (sizeof(uint64_t) + hdr.series_count * sizeof(float));
+	return size;
+}
+
+/** copy the slots of an old file with other threads into a new file image
+ *
+ * The total, shares and backend series are kept, the series of a thread only
+ * if the thread existed before with the same backend.
+ *
+ * @return number of threads whose series were reset
+ */
+size_t convert_history(const file_header& old, const std::vector<uint8_t>& old_img, const file_header& hdr, std::vector<uint8_t>& img)
+{
+	constexpr size_t fixed = SERIES_BACKEND + hashHistory::MAX_BACKENDS;
+	size_t old_slot = sizeof(uint64_t) + old.series_count * sizeof(float);
+	size_t new_slot = sizeof(uint64_t) + hdr.series_count * sizeof(float);
+
+	size_t reset = 0;
+	std::vector<bool> keep(hdr.thread_count);
+	for(size_t i = 0; i < hdr.thread_count; i++)
+	{
+		keep[i] = i < old.thread_count && old.backends[i] == hdr.backends[i];
+		if(!keep[i])
+			reset++;
+	}
+
+	img.assign(file_size(hdr), 0);
+	memcpy(img.data(), &hdr, sizeof(hdr));
+	size_t old_off = sizeof(file_header);
+	size_t new_off = sizeof(file_header);
+	std::vector<float> v(hdr.series_count);
+	for(size_t t = 0; t < hashHistory::TIER_COUNT; t++)
+	{
+		for(size_t s = 0; s < hdr.slots[t]; s++)
+		{
+			const uint8_t* src = old_img.data() + old_off + s * old_slot;
+			uint8_t* dst = img.data() + new_off + s * new_slot;
+			uint64_t time;
+			memcpy(&time, src, sizeof(time));
+			// a slot with time 0 is a gap
+			if(time == 0)
+				continue;
+
+			const float* old_v = (const float*)(src + sizeof(uint64_t));
+			for(size_t i = 0; i < fixed; i++)
+				v[i] = old_v[i];
+			for(size_t i = 0; i < hdr.thread_count; i++)
+				v[fixed + i] = keep[i] ? old_v[fixed + i] : NAN;
+			memcpy(dst, &time, sizeof(time));
+			memcpy(dst + sizeof(uint64_t), v.data(), v.size() * sizeof(float));
+		}
+		old_off += hdr.slots[t] * old_slot;
+		new_off += hdr.slots[t] * new_slot;
+	}
+	return reset;
+}
+} // namespace
+
+#ifndef _WIN32
+bool hashHistory::open(const char* sFilename, const std::vector<uint32_t>& backends, std::string& err)
+{
+	if(backends.size() > MAX_THREADS)
+	{
+		err = "the hash rate history supports at most 256 threads";
+		return false;
+	}
+
+	file_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, "XSHIST1\n", sizeof(hdr.magic));
+	hdr.version = VERSION;
+	hdr.thread_count = backends.size();
+	hdr.series_count = SERIES_BACKEND + MAX_BACKENDS + backends.size();
+	hdr.tier_count = TIER_COUNT;
+	for(size_t t = 0; t < TIER_COUNT; t++)
+	{
+		hdr.resolution[t] = tiers[t].resolution;
+		hdr.slots[t] = tiers[t].slots;
+	}
+	for(size_t i = 0; i < backends.size(); i++)
+		hdr.backends[i] = backends[i];
+
+	iSeriesCount = hdr.series_count;
+	size_t size = sizeof(file_header);
+	for(size_t t = 0; t < TIER_COUNT; t++)
+	{
+		iTierOffset[t] = size;
+		size += tiers[t].slots * slot_size();
+	}
+
+	int fd = ::open(sFilename, O_RDWR | O_CREAT, 0644);
+	if(fd < 0)
+	{
+		err = std::string("cannot open the hash rate history '") + sFilename + "': " + strerror(errno);
+		return false;
+	}
+
+	struct stat st;
+	file_header old;
+	bool have_old = fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(old) && pread(fd, &old, sizeof(old), 0) == sizeof(old);
+	bool reuse = have_old && size_t(st.st_size) == size && memcmp(&old, &hdr, sizeof(hdr)) == 0;
+
+	// the threads changed, keep everything but the series of the changed threads
+	std::vector<uint8_t> img;
+	size_t reset = 0;
+	if(!reuse && have_old && same_tiers(old, hdr) && old.thread_count <= MAX_THREADS &&
+		old.series_count == SERIES_BACKEND + MAX_BACKENDS + old.thread_count && size_t(st.st_size) == file_size(old))
+	{
+		std::vector<uint8_t> old_img(st.st_size);
+		if(pread(fd, old_img.data(), old_img.size(), 0) == ssize_t(old_img.size()))
+			reset = convert_history(old, old_img, hdr, img);
+	}
+
+	// a new file is zero filled, every slot is a gap
+	if(!reuse)
+	{
+		if(img.empty())
+		{
+			img.assign(sizeof(hdr), 0);
+			memcpy(img.data(), &hdr, sizeof(hdr));
+		}
+		if(ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0 || pwrite(fd, img.data(), img.size(), 0) != ssize_t(img.size()))
+		{
+			err = std::string("cannot create the hash rate history '") + sFilename + "': " + strerror(errno);
+			::close(fd);
+			return false;
+		}
+	}
+
+	void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(p == MAP_FAILED)
+	{
+		err = std::string("cannot map the hash rate history '") + sFilename + "': " + strerror(errno);
+		return false;
+	}
+
+	vBackends = backends;
+	vLastHashes.assign(backends.size(), 0);
+	vLastStamps.assign(backends.size(), 0);
+	vLastRate.assign(backends.size(), NAN);
+	for(size_t t = 0; t < TIER_COUNT; t++)
+	{
+		oAcc[t].sum.assign(iSeriesCount, 0.0);
+		oAcc[t].count.assign(iSeriesCount, 0);
+	}
+
+	std::unique_lock<std::mutex> lck(mtx);
+	iMemSize = size;
+	pMem = (uint8_t*)p;
+	lck.unlock();
+
+	if(reuse)
+		printer::inst()->print_msg(L1, "Continuing the hash rate history in '%s'.", sFilename);
+	else if(img.size() == size)
+		printer::inst()->print_msg(L1, "Continuing the hash rate history in '%s', the threads changed, the series of %u threads start empty.",
+			sFilename, unsigned(reset));
+	else
+		printer::inst()->print_msg(L1, "Created the hash rate history '%s'.", sFilename);
+	return true;
+}
+#else
+bool hashHistory::open(const char* sFilename, const std::vector<uint32_t>& backends, std::string& err)
+{
+	err = "the hash rate history is not supported on Windows";
+	return false;
+}
+#endif
+
+uint8_t* hashHistory::slot(size_t t, uint64_t time)
+{
+	return pMem + iTierOffset[t] + (time / tiers[t].resolution % tiers[t].slots) * slot_size();
+}
+
+void hashHistory::write_slot(size_t t, uint64_t time, const std::vector<double>& values, const std::vector<uint32_t>* count)
+{
+	uint8_t* s = slot(t, time);
+	float* v = (float*)(s + sizeof(uint64_t));
+	for(size_t i = 0; i < iSeriesCount; i++)
+	{
+		if(count == nullptr)
+			v[i] = values[i];
+		else
+			v[i] = (*count)[i] != 0 ? values[i] / (*count)[i] : NAN;
+	}
+	memcpy(s, &time, sizeof(time));
+}
+
+void hashHistory::tick(const std::vector<uint64_t>& hashes, const std::vector<uint64_t>& stamps, uint64_t accepted)
+{
+	if(pMem == nullptr)
+		return;
+
+	uint64_t now = unix_sec();
+	if(now == iLastSecond)
+		return;
+
+	uint64_t now_ms = get_timestamp_ms();
+	std::vector<double> values(iSeriesCount, NAN);
+	for(size_t i = 0; i < vBackends.size() && i < hashes.size(); i++)
+	{
+		double rate;
+		if(stamps[i] == 0)
+			rate = NAN;
+		else if(stamps[i] > vLastStamps[i])
+		{
+			rate = vLastStamps[i] != 0 ? double(hashes[i] - vLastHashes[i]) * 1000.0 / double(stamps[i] - vLastStamps[i]) : NAN;
+			vLastHashes[i] = hashes[i];
+			vLastStamps[i] = stamps[i];
+			vLastRate[i] = rate;
+		}
+		else if(now_ms - stamps[i] > THREAD_TIMEOUT_MS)
+			rate = 0.0;
+		else
+			rate = vLastRate[i];
+
+		values[SERIES_BACKEND + MAX_BACKENDS + i] = rate;
+		if(std::isnan(rate))
+			continue;
+		double& backend = values[SERIES_BACKEND + (vBackends[i] < MAX_BACKENDS ? vBackends[i] : 0)];
+		double& total = values[SERIES_TOTAL];
+		backend = std::isnan(backend) ? rate : backend + rate;
+		total = std::isnan(total) ? rate : total + rate;
+	}
+
+	if(iLastSecond != 0)
+		values[SERIES_SHARES] = double(accepted - iLastAccepted) * 60.0 / double(now - iLastSecond);
+	iLastAccepted = accepted;
+	iLastSecond = now;
+
+	std::unique_lock<std::mutex> lck(mtx);
+	write_slot(0, now, values, nullptr);
+	for(size_t t = 1; t < TIER_COUNT; t++)
+	{
+		accumulator& acc = oAcc[t];
+		uint64_t slot_time = now / tiers[t].resolution * tiers[t].resolution;
+		if(acc.time != slot_time)
+		{
+			acc.time = slot_time;
+			acc.sum.assign(iSeriesCount, 0.0);
+			acc.count.assign(iSeriesCount, 0);
+			// after a restart the seconds of the previous run in this interval are still in the first tier
+			for(uint64_t time = slot_time; time < now; time++)
+			{
+				const uint8_t* s = slot(0, time);
+				uint64_t second;
+				memcpy(&second, s, sizeof(second));
+				if(second != time)
+					continue;
+				const float* v = (const float*)(s + sizeof(uint64_t));
+				for(size_t i = 0; i < iSeriesCount; i++)
+				{
+					if(std::isnan(v[i]))
+						continue;
+					acc.sum[i] += v[i];
+					acc.count[i]++;
+				}
+			}
+		}
+		for(size_t i = 0; i < iSeriesCount; i++)
+		{
+			if(std::isnan(values[i]))
+				continue;
+			acc.sum[i] += values[i];
+			acc.count[i]++;
+		}
+		// the slot of the current interval holds the mean of the seconds so far
+		write_slot(t, slot_time, acc.sum, &acc.count);
+	}
+}
+
+bool hashHistory::get_json(const char* tier_name, const char* series, uint64_t from, uint64_t to, std::string& out)
+{
+	uint64_t now = unix_sec();
+	if(to == 0 || to > now)
+		to = now;
+	if(from == 0)
+		from = to > 3600 ? to - 3600 : 0;
+	if(from > to)
+	{
+		out = "from is after to";
+		return false;
+	}
+
+	size_t t = 0;
+	if(tier_name != nullptr)
+	{
+		while(t < TIER_COUNT && strcmp(tier_name, tiers[t].name) != 0)
+			t++;
+		if(t == TIER_COUNT)
+		{
+			out = std::string("unknown tier '") + tier_name + "', use 1s, 1m or 15m";
+			return false;
+		}
+	}
+	else
+	{
+		while(t + 1 < TIER_COUNT && now - from > uint64_t(tiers[t].resolution) * tiers[t].slots)
+			t++;
+	}
+
+	// the ring only covers the last slots of the tier
+	uint64_t res = tiers[t].resolution;
+	uint64_t oldest = now / res * res - uint64_t(tiers[t].slots - 1) * res;
+	if(from < oldest)
+		from = oldest;
+	from = from / res * res;
+
+	std::vector<size_t> idx;
+	std::vector<std::string> names;
+	std::string list = series != nullptr && series[0] != '\0' ? series : "total";
+	size_t pos = 0;
+	while(pos <= list.size())
+	{
+		size_t end = list.find(',', pos);
+		if(end == std::string::npos)
+			end = list.size();
+		std::string name = list.substr(pos, end - pos);
+		pos = end + 1;
+
+		size_t i = iSeriesCount;
+		if(name == "total")
+			i = SERIES_TOTAL;
+		else if(name == "shares")
+			i = SERIES_SHARES;
+		else if(!name.empty() && name.find_first_not_of("0123456789") == std::string::npos)
+		{
+			size_t thd = strtoul(name.c_str(), nullptr, 10);
+			if(thd < vBackends.size())
+				i = SERIES_BACKEND + MAX_BACKENDS + thd;
+		}
+		else
+		{
+			for(size_t b = 1; b < sizeof(backend_names) / sizeof(backend_names[0]); b++)
+			{
+				if(name == backend_names[b])
+					i = SERIES_BACKEND + b;
+			}
+		}
+
+		if(i >= iSeriesCount)
+		{
+			out = "unknown series '" + name + "', use total, shares, cpu, amd, nvidia, fpga or a thread number";
+			return false;
+		}
+		idx.push_back(i);
+		names.push_back(name);
+	}
+
+	char buf[64];
+	snprintf(buf, sizeof(buf), "{\"tier\":\"%s\",\"resolution\":%u,\"series\":[", tiers[t].name, unsigned(res));
+	out.assign(buf);
+	for(size_t i = 0; i < names.size(); i++)
+		out.append(i != 0 ? ",\"" : "\"").append(names[i]).append(1, '"');
+	out.append("],\"data\":[");
+
+	std::unique_lock<std::mutex> lck(mtx);
+	bool first = true;
+	for(uint64_t time = from; time <= to; time += res)
+	{
+		const uint8_t* s = slot(t, time);
+		uint64_t slot_time;
+		memcpy(&slot_time, s, sizeof(slot_time));
+		if(slot_time != time)
+			continue;
+
+		const float* v = (const float*)(s + sizeof(uint64_t));
+		snprintf(buf, sizeof(buf), "%s[%llu", first ? "" : ",", (unsigned long long)time);
+		out.append(buf);
+		for(size_t i : idx)
+		{
+			if(std::isnan(v[i]))
+				out.append(",null");
+			else
+			{
+				snprintf(buf, sizeof(buf), ",%.2f", v[i]);
+				out.append(buf);
+			}
+		}
+		out.append(1, ']');
+		first = false;
+	}
+	out.append("]}");
+	return true;
+}
+
+} // namespace xmrstak
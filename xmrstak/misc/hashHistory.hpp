@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xmrstak
+{
+
+/** persistent hash rate history with the tiers 1 sec, 1 min and 15 min
+ *
+ * The history is a memory mapped file with a fixed size ring per tier. A slot
+ * holds its unix time and one float per series, the slot of a time is
+ * `time / resolution % slots`, slots with another time are gaps. The series
+ * are the total hash rate, the accepted shares per minute, the hash rate of
+ * every backend type and of every thread. The executor samples the hash
+ * counts every second, the coarser tiers store the mean of their seconds.
+ *
+ * The file is reused after a restart. If the threads changed, only the
+ * series of the threads which are new or have another backend start empty.
+ */
+class hashHistory
+{
+public:
+	static hashHistory* inst()
+	{
+		if (oInst == nullptr) oInst = new hashHistory;
+		return oInst;
+	};
+
+	static constexpr size_t TIER_COUNT = 3;
+	static constexpr uint32_t MAX_BACKENDS = 8;
+
+	struct tier
+	{
+		const char* name;
+		//! seconds per slot
+		uint32_t resolution;
+		uint32_t slots;
+	};
+	static const tier tiers[TIER_COUNT];
+
+	/** open the file or create it if it does not exist
+	 *
+	 * @param backends backend type of every thread, xmrstak::iBackend::BackendType
+	 */
+	bool open(const char* sFilename, const std::vector<uint32_t>& backends, std::string& err);
+
+	inline bool is_open() const { return pMem != nullptr; }
+
+	/** called by the executor on every tick, samples once per second
+	 *
+	 * @param hashes hash count of every thread
+	 * @param stamps steady clock in milliseconds of the last update of the hash count
+	 */
+	void tick(const std::vector<uint64_t>& hashes, const std::vector<uint64_t>& stamps, uint64_t accepted);
+
+	/** json of the series between from and to (unix seconds)
+	 *
+	 * Slots without data are left out, a value is null if it was not known.
+	 * @param tier_name 1s, 1m, 15m or nullptr to select the finest tier which covers from
+	 * @param series comma separated list of total, shares, cpu, amd, nvidia, fpga and thread numbers
+	 * @return false and the reason in out for an invalid query
+	 */
+	bool get_json(const char* tier_name, const char* series, uint64_t from, uint64_t to, std::string& out);
+
+private:
+	hashHistory() {}
+
+	static hashHistory* oInst;
+
+	struct accumulator
+	{
+		uint64_t time = 0;
+		std::vector<double> sum;
+		std::vector<uint32_t> count;
+	};
+
+	size_t slot_size() const { return sizeof(uint64_t) + iSeriesCount * sizeof(float); }
+	uint8_t* slot(size_t t, uint64_t time);
+	void write_slot(size_t t, uint64_t time, const std::vector<double>& values, const std::vector<uint32_t>* count);
+
+	std::mutex mtx;
+	uint8_t* pMem = nullptr;
+	size_t iMemSize = 0;
+	size_t iTierOffset[TIER_COUNT];
+	size_t iSeriesCount = 0;
+	std::vector<uint32_t> vBackends;
+
+	// only used by the executor thread
+	uint64_t iLastSecond = 0;
+	std::vector<uint64_t> vLastHashes;
+	std::vector<uint64_t> vLastStamps;
+	std::vector<double> vLastRate;
+	uint64_t iLastAccepted = 0;
+	accumulator oAcc[TIER_COUNT];
+};
+
+} // namespace xmrstak
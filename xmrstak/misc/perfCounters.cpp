@@ -0,0 +1,312 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "perfCounters.hpp"
+#include "xmrstak/misc/console.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace xmrstak
+{
+
+namespace
+{
+
+#if defined(__linux__)
+int open_counter(uint32_t type, uint64_t config, int group)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// user space only, allowed up to perf_event_paranoid 2
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.disabled = group == -1 ? 1 : 0;
+
+	// pid 0 and cpu -1: the calling thread on any cpu
+	return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+int read_paranoid()
+{
+	FILE* f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+	int level = -100;
+	if(f != nullptr)
+	{
+		if(fscanf(f, "%d", &level) != 1)
+			level = -100;
+		fclose(f);
+	}
+	return level;
+}
+#endif
+
+std::atomic<bool> bMessagePrinted(false);
+
+const char* num_format(double v, const char* fmt, char* buf, size_t len, const char* na)
+{
+	if(!std::isfinite(v))
+		return na;
+	snprintf(buf, len, fmt, v);
+	return buf;
+}
+
+} // namespace
+
+perfCounters::perfCounters()
+{
+	for(auto& fd : iFd)
+		fd.store(-1, std::memory_order_relaxed);
+}
+
+perfCounters::~perfCounters()
+{
+#if defined(__linux__)
+	for(auto& fd : iFd)
+	{
+		if(fd.load(std::memory_order_relaxed) >= 0)
+			close(fd.load(std::memory_order_relaxed));
+	}
+#endif
+}
+
+bool perfCounters::open_thread()
+{
+#if defined(__linux__)
+	const uint32_t type[COUNTER_COUNT] = {
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HW_CACHE
+	};
+	const uint64_t config[COUNTER_COUNT] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_REFERENCES,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+	};
+
+	int leader = open_counter(type[CYCLES], config[CYCLES], -1);
+	if(leader < 0)
+	{
+		int err = errno;
+		if(!bMessagePrinted.exchange(true))
+		{
+			if(err == EACCES || err == EPERM)
+				printer::inst()->print_msg(L0, "WARNING: hardware counters are not allowed, /proc/sys/kernel/perf_event_paranoid is %d (2 or less is required).",
+					read_paranoid());
+			else if(err == ENOENT || err == ENODEV || err == EOPNOTSUPP)
+				printer::inst()->print_msg(L0, "WARNING: hardware counters are not supported by this CPU or virtual machine.");
+			else
+				printer::inst()->print_msg(L0, "WARNING: hardware counters are not available: %s.", strerror(err));
+		}
+		return false;
+	}
+
+	// the other counters are optional, e.g. virtual machines often lack the cache events
+	int fd[COUNTER_COUNT];
+	fd[CYCLES] = leader;
+	for(size_t i = INSTRUCTIONS; i < COUNTER_COUNT; i++)
+		fd[i] = open_counter(type[i], config[i], leader);
+
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+	for(size_t i = 0; i < COUNTER_COUNT; i++)
+		iFd[i].store(fd[i], std::memory_order_release);
+	return true;
+#else
+	if(!bMessagePrinted.exchange(true))
+		printer::inst()->print_msg(L0, "WARNING: hardware counters are only supported on Linux.");
+	return false;
+#endif
+}
+
+bool perfCounters::read(snapshot& s) const
+{
+#if defined(__linux__)
+	if(iFd[CYCLES].load(std::memory_order_acquire) < 0)
+		return false;
+
+	for(size_t i = 0; i < COUNTER_COUNT; i++)
+	{
+		s.value[i] = NAN;
+		int fd = iFd[i].load(std::memory_order_acquire);
+		uint64_t data[3];
+		if(fd < 0 || ::read(fd, data, sizeof(data)) != sizeof(data) || data[2] == 0)
+			continue;
+		// scale the count if the kernel had to multiplex the counters
+		s.value[i] = double(data[0]) * double(data[1]) / double(data[2]);
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void perfCounters::sample(uint64_t hash_count)
+{
+	using namespace std::chrono;
+	const uint64_t now = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+	if(oStart.valid && now - oStart.time_ms < WINDOW_MS)
+		return;
+
+	snapshot cur;
+	if(!read(cur))
+		return;
+	cur.valid = true;
+	cur.hashes = hash_count;
+	cur.time_ms = now;
+
+	if(oStart.valid && cur.hashes != oStart.hashes)
+	{
+		double d[COUNTER_COUNT];
+		for(size_t i = 0; i < COUNTER_COUNT; i++)
+			d[i] = cur.value[i] - oStart.value[i];
+		const double hashes = double(cur.hashes - oStart.hashes);
+		const double seconds = double(cur.time_ms - oStart.time_ms) / 1000.0;
+
+		oLast.valid = true;
+		oLast.ipc = d[INSTRUCTIONS] / d[CYCLES];
+		oLast.llc_miss_rate = 100.0 * d[LLC_MISSES] / d[LLC_REFERENCES];
+		oLast.llc_miss_per_hash = d[LLC_MISSES] / hashes;
+		oLast.dtlb_miss_per_hash = d[DTLB_MISSES] / hashes;
+		// every miss fills one cache line, write backs are not counted
+		oLast.mem_mbps = d[LLC_MISSES] * 64.0 / seconds / (1024.0 * 1024.0);
+	}
+	oStart = cur;
+}
+
+void perfCounters::get_report(const std::vector<const perfCounters*>& threads, std::string& out)
+{
+	// the widest row has five numbers of 23 characters and a 10 digit ID
+	char buffer[256];
+	char num[5][24];
+	bool header = false;
+
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		if(threads[i] == nullptr || !threads[i]->get().valid)
+			continue;
+		if(!header)
+		{
+			out.append("HARDWARE COUNTERS - CPU (last 10s)\n");
+			out.append("| ID |  IPC | L3 miss | L3 miss/hash | dTLB miss/hash |   MiB/s |\n");
+			header = true;
+		}
+		const metrics& m = threads[i]->get();
+		snprintf(buffer, sizeof(buffer), "| %2u | %4s | %6s%% | %12s | %14s | %7s |\n", unsigned(i),
+			num_format(m.ipc, "%.2f", num[0], sizeof(num[0]), "n/a"),
+			num_format(m.llc_miss_rate, "%.1f", num[1], sizeof(num[1]), "n/a"),
+			num_format(m.llc_miss_per_hash, "%.0f", num[2], sizeof(num[2]), "n/a"),
+			num_format(m.dtlb_miss_per_hash, "%.0f", num[3], sizeof(num[3]), "n/a"),
+			num_format(m.mem_mbps, "%.1f", num[4], sizeof(num[4]), "n/a"));
+		out.append(buffer);
+	}
+
+	if(header)
+		out.append("-----------------------------------------------------------------\n");
+}
+
+void perfCounters::get_html(const std::vector<const perfCounters*>& threads, std::string& out)
+{
+	char buffer[256];
+	char num[5][24];
+	bool header = false;
+
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		if(threads[i] == nullptr || !threads[i]->get().valid)
+			continue;
+		if(!header)
+		{
+			out.append("<h4>Hardware counters (last 10s)</h4><table>"
+				"<tr><th>Thread ID</th><th>IPC</th><th>L3 miss %</th><th>L3 miss/hash</th><th>dTLB miss/hash</th><th>MiB/s</th></tr>");
+			header = true;
+		}
+		const metrics& m = threads[i]->get();
+		snprintf(buffer, sizeof(buffer), "<tr><th>%u</th><td>%s</td><td>%s</td><td>%s</td><td>%s</td><td>%s</td></tr>", unsigned(i),
+			num_format(m.ipc, "%.2f", num[0], sizeof(num[0]), "n/a"),
+			num_format(m.llc_miss_rate, "%.1f", num[1], sizeof(num[1]), "n/a"),
+			num_format(m.llc_miss_per_hash, "%.0f", num[2], sizeof(num[2]), "n/a"),
+			num_format(m.dtlb_miss_per_hash, "%.0f", num[3], sizeof(num[3]), "n/a"),
+			num_format(m.mem_mbps, "%.1f", num[4], sizeof(num[4]), "n/a"));
+		out.append(buffer);
+	}
+
+	if(header)
+		out.append("</table>");
+}
+
+void perfCounters::get_json(const std::vector<const perfCounters*>& threads, std::string& out)
+{
+	char buffer[256];
+	char num[5][24];
+	bool any = false;
+	std::string thds;
+
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		if(i != 0)
+			thds.append(1, ',');
+		if(threads[i] == nullptr || !threads[i]->get().valid)
+		{
+			thds.append("null");
+			continue;
+		}
+		const metrics& m = threads[i]->get();
+		snprintf(buffer, sizeof(buffer), "{\"ipc\":%s,\"l3_miss_rate\":%s,\"l3_miss_per_hash\":%s,\"dtlb_miss_per_hash\":%s,\"mem_mbps\":%s}",
+			num_format(m.ipc, "%.3f", num[0], sizeof(num[0]), "null"),
+			num_format(m.llc_miss_rate, "%.2f", num[1], sizeof(num[1]), "null"),
+			num_format(m.llc_miss_per_hash, "%.1f", num[2], sizeof(num[2]), "null"),
+			num_format(m.dtlb_miss_per_hash, "%.1f", num[3], sizeof(num[3]), "null"),
+			num_format(m.mem_mbps, "%.1f", num[4], sizeof(num[4]), "null"));
+		thds.append(buffer);
+		any = true;
+	}
+
+	if(!any)
+	{
+		out.append("null");
+		return;
+	}
+	snprintf(buffer, sizeof(buffer), "{\"window\":%u,\"threads\":[", unsigned(WINDOW_MS / 1000));
+	out.append(buffer).append(thds).append("]}");
+}
+
+} // namespace xmrstak
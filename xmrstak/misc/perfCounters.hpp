@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xmrstak
+{
+
+/** hardware performance counters of one worker thread
+ *
+ * The counters are opened with perf_event_open (Linux only) by the worker thread
+ * itself after it has set its affinity. The executor samples them on its perf
+ * tick and derives the metrics of the last complete window of WINDOW_MS.
+ * Counters which are not supported by the CPU or the kernel are reported as n/a.
+ */
+class perfCounters
+{
+public:
+	enum counter : uint32_t
+	{
+		CYCLES,
+		INSTRUCTIONS,
+		LLC_REFERENCES,
+		LLC_MISSES,
+		DTLB_MISSES,
+		COUNTER_COUNT
+	};
+
+	//! length of the measurement window in milliseconds
+	static constexpr uint64_t WINDOW_MS = 10000;
+
+	/** metrics of one window, NaN if a counter is not available */
+	struct metrics
+	{
+		bool valid = false;
+		//! instructions per cycle
+		double ipc;
+		//! percent of the last level cache references which missed
+		double llc_miss_rate;
+		double llc_miss_per_hash;
+		double dtlb_miss_per_hash;
+		//! memory bandwidth in MiB/s (2^20 bytes) estimated from the last level cache misses
+		double mem_mbps;
+	};
+
+	perfCounters();
+	~perfCounters();
+
+	perfCounters(const perfCounters&) = delete;
+	perfCounters& operator=(const perfCounters&) = delete;
+
+	/** open the counters of the calling thread
+	 *
+	 * If no counter can be opened the reason is printed once per process.
+	 *
+	 * @return true if at least the cycle counter is available
+	 */
+	bool open_thread();
+
+	/** read the counters if the current window is complete
+	 *
+	 * Only called by the executor thread.
+	 *
+	 * @param hash_count hashes of the thread since the start
+	 */
+	void sample(uint64_t hash_count);
+
+	//! metrics of the last complete window, only used by the executor thread
+	const metrics& get() const { return oLast; }
+
+	/** console table of the threads with valid metrics
+	 *
+	 * @param threads counters of the threads, nullptr entries are skipped
+	 */
+	static void get_report(const std::vector<const perfCounters*>& threads, std::string& out);
+
+	/** html table rows, same layout as get_report */
+	static void get_html(const std::vector<const perfCounters*>& threads, std::string& out);
+
+	/** json object with one entry per thread, `null` if no thread has metrics */
+	static void get_json(const std::vector<const perfCounters*>& threads, std::string& out);
+
+private:
+	struct snapshot
+	{
+		bool valid = false;
+		double value[COUNTER_COUNT];
+		uint64_t hashes;
+		uint64_t time_ms;
+	};
+
+	bool read(snapshot& s) const;
+
+	//! file descriptors, written once by the worker and read by the executor
+	std::atomic<int> iFd[COUNTER_COUNT];
+	snapshot oStart;
+	metrics oLast;
+};
+
+} // namespace xmrstak
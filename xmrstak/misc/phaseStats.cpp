@@ -0,0 +1,121 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "phaseStats.hpp"
+
+#include <stdio.h>
+
+namespace xmrstak
+{
+
+const char* const phaseStats::names[phaseStats::PHASE_COUNT] = {
+	"worker",
+	"keccak",
+	"explode",
+	"main_loop",
+	"implode",
+	"final",
+	"consume_work",
+	"stall",
+	"parked"
+};
+
+thread_local phaseStats* phaseStats::pThread = nullptr;
+
+namespace
+{
+
+/** sum of the counters of all threads
+ *
+ * @return number of hashes
+ */
+uint64_t sum(const std::vector<const phaseStats*>& threads, uint64_t (&cycles)[phaseStats::PHASE_COUNT])
+{
+	uint64_t hashes = 0;
+	for(uint64_t& c : cycles)
+		c = 0;
+	for(const phaseStats* t : threads)
+	{
+		hashes += t->iHashes.load(std::memory_order_relaxed);
+		for(size_t p = 0; p < phaseStats::PHASE_COUNT; p++)
+			cycles[p] += t->iCycles[p].load(std::memory_order_relaxed);
+	}
+	return hashes;
+}
+
+void append_json(const std::vector<const phaseStats*>& threads, std::string& out)
+{
+	char buffer[64];
+	uint64_t cycles[phaseStats::PHASE_COUNT];
+	const uint64_t hashes = sum(threads, cycles);
+
+	out.append(1, '{');
+	for(size_t p = 0; p < phaseStats::PHASE_COUNT; p++)
+	{
+		snprintf(buffer, sizeof(buffer), "%s\"%s\":%.0f", p != 0 ? "," : "", phaseStats::names[p],
+			hashes != 0 ? double(cycles[p]) / double(hashes) : 0.0);
+		out.append(buffer);
+	}
+	out.append(1, '}');
+}
+
+} // namespace
+
+void phaseStats::get_report(const std::vector<const phaseStats*>& threads, std::string& out)
+{
+	char buffer[128];
+	uint64_t cycles[PHASE_COUNT];
+	const uint64_t hashes = sum(threads, cycles);
+	if(hashes == 0)
+		return;
+
+	uint64_t total = 0;
+	for(uint64_t c : cycles)
+		total += c;
+
+	out.append("PHASE REPORT - CPU (cycles per hash since start)\n");
+	out.append("| Phase        | Cycles/hash |  Share |\n");
+	for(size_t p = 0; p < PHASE_COUNT; p++)
+	{
+		snprintf(buffer, sizeof(buffer), "| %-12s | %11.0f | %5.1f%% |\n", names[p],
+			double(cycles[p]) / double(hashes), total != 0 ? 100.0 * double(cycles[p]) / double(total) : 0.0);
+		out.append(buffer);
+	}
+	out.append("-----------------------------------------------------------------\n");
+}
+
+void phaseStats::get_json(const std::vector<const phaseStats*>& threads, std::string& out)
+{
+	out.append("{\"unit\":\"cycles per hash\",\"threads\":[");
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		if(i != 0)
+			out.append(1, ',');
+		append_json(std::vector<const phaseStats*>(1, threads[i]), out);
+	}
+	out.append("],\"total\":");
+	append_json(threads, out);
+	out.append(1, '}');
+}
+
+} // namespace xmrstak
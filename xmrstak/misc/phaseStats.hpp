@@ -0,0 +1,103 @@
+#pragma once
+
+#include "xmrstak/backend/globalStates.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef __GNUC__
+#include <x86intrin.h>
+#else
+#include <intrin.h>
+#endif // __GNUC__
+
+namespace xmrstak
+{
+
+/** CPU cycles of the phases of the hash loop of one worker thread
+ *
+ * Only compiled in with the cmake option XMR-STAK_PHASE_STATS. The thread
+ * attaches its counters once, afterwards every XMRSTAK_PHASE(p) adds the
+ * cycles since the previous mark of the thread to phase p. Only the owning
+ * thread writes the counters, the report reads them with relaxed loads.
+ */
+struct alignas(cache_line_size) phaseStats
+{
+	enum phase : uint32_t
+	{
+		//! nonces, result checks and job checks of the worker loop
+		WORKER,
+		KECCAK,
+		EXPLODE,
+		MAIN_LOOP,
+		IMPLODE,
+		//! keccak permutation and the final hash (blake, groestl, jh or skein)
+		FINAL,
+		CONSUME_WORK,
+		//! waiting for the first job or after a connection loss
+		STALL,
+		//! parked by the background mode
+		PARKED,
+		PHASE_COUNT
+	};
+
+	//! phase names, also the keys in the json report
+	static const char* const names[PHASE_COUNT];
+
+	std::atomic<uint64_t> iCycles[PHASE_COUNT];
+	std::atomic<uint64_t> iHashes;
+	//! time stamp of the last mark, only used by the owning thread
+	uint64_t iLast = 0;
+
+	phaseStats() : iHashes(0)
+	{
+		for(auto& c : iCycles)
+			c.store(0, std::memory_order_relaxed);
+	}
+
+	//! counters of the calling thread, nullptr if the thread is not measured
+	static thread_local phaseStats* pThread;
+
+	static void attach(phaseStats* stats)
+	{
+		stats->iLast = __rdtsc();
+		pThread = stats;
+	}
+
+	//! add the cycles since the last mark of the calling thread to phase p
+	static inline void mark(phase p)
+	{
+		phaseStats* s = pThread;
+		if(s == nullptr)
+			return;
+		const uint64_t t = __rdtsc();
+		s->iCycles[p].store(s->iCycles[p].load(std::memory_order_relaxed) + (t - s->iLast), std::memory_order_relaxed);
+		s->iLast = t;
+	}
+
+	static inline void add_hashes(uint64_t n)
+	{
+		phaseStats* s = pThread;
+		if(s != nullptr)
+			s->iHashes.store(s->iHashes.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	/** cycles per hash of each phase since the start
+	 *
+	 * @param threads counters of the threads
+	 */
+	static void get_report(const std::vector<const phaseStats*>& threads, std::string& out);
+	static void get_json(const std::vector<const phaseStats*>& threads, std::string& out);
+};
+
+} // namespace xmrstak
+
+#ifdef XMRSTAK_PHASE_STATS
+#	define XMRSTAK_PHASE(p) xmrstak::phaseStats::mark(xmrstak::phaseStats::p)
+#	define XMRSTAK_PHASE_HASHES(n) xmrstak::phaseStats::add_hashes(n)
+#else
+#	define XMRSTAK_PHASE(p)
+#	define XMRSTAK_PHASE_HASHES(n)
+#endif
@@ -0,0 +1,193 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "quantileSketch.hpp"
+
+#include <cmath>
+#include <string.h>
+#include <stdio.h>
+
+namespace xmrstak
+{
+
+namespace
+{
+inline uint32_t log2_floor(uint64_t v)
+{
+	uint32_t r = 0;
+	while(v >>= 1)
+		r++;
+	return r;
+}
+}
+
+size_t quantileSketch::bucket(uint64_t v)
+{
+	if(v < SUB_COUNT)
+		return size_t(v);
+
+	uint32_t exp = log2_floor(v);
+	uint32_t shift = exp - SUB_BITS;
+	return size_t(shift + 1) * SUB_COUNT + size_t((v >> shift) - SUB_COUNT);
+}
+
+uint64_t quantileSketch::bucket_mid(size_t idx)
+{
+	size_t block = idx / SUB_COUNT;
+	uint64_t sub = idx % SUB_COUNT;
+	if(block == 0)
+		return sub;
+
+	uint64_t width = uint64_t(1) << (block - 1);
+	uint64_t lower = (SUB_COUNT + sub) << (block - 1);
+	return lower + (width - 1) / 2;
+}
+
+void quantileSketch::clear()
+{
+	memset(iBuckets, 0, sizeof(iBuckets));
+	iCount = 0;
+	iSum = 0;
+	iMin = UINT64_MAX;
+	iMax = 0;
+}
+
+void quantileSketch::add(uint64_t v)
+{
+	iBuckets[bucket(v)]++;
+	iCount++;
+	iSum += v;
+	if(v < iMin)
+		iMin = v;
+	if(v > iMax)
+		iMax = v;
+}
+
+void quantileSketch::merge(const quantileSketch& o)
+{
+	if(o.iCount == 0)
+		return;
+
+	for(size_t i = 0; i < BUCKET_COUNT; i++)
+		iBuckets[i] += o.iBuckets[i];
+	iCount += o.iCount;
+	iSum += o.iSum;
+	if(o.iMin < iMin)
+		iMin = o.iMin;
+	if(o.iMax > iMax)
+		iMax = o.iMax;
+}
+
+uint64_t quantileSketch::quantile(double q) const
+{
+	if(iCount == 0)
+		return 0;
+
+	// rank of the value, 1 based
+	uint64_t rank = uint64_t(std::ceil(q * double(iCount)));
+	if(rank < 1)
+		rank = 1;
+	if(rank >= iCount)
+		return iMax;
+
+	uint64_t seen = 0;
+	for(size_t i = 0; i < BUCKET_COUNT; i++)
+	{
+		seen += iBuckets[i];
+		if(seen >= rank)
+		{
+			uint64_t v = bucket_mid(i);
+			if(v < iMin)
+				return iMin;
+			if(v > iMax)
+				return iMax;
+			return v;
+		}
+	}
+	return iMax;
+}
+
+const uint64_t windowedSketch::window_sec[windowedSketch::WINDOW_COUNT] = { 15 * 60, 60 * 60, 0 };
+const char* const windowedSketch::window_names[windowedSketch::WINDOW_COUNT] = { "15m", "1h", "total" };
+
+windowedSketch::windowedSketch()
+{
+	for(size_t i = 0; i < SLICE_COUNT; i++)
+		iSliceNo[i] = UINT64_MAX;
+}
+
+void windowedSketch::add(uint64_t v, uint64_t now_sec)
+{
+	uint64_t no = now_sec / SLICE_SEC;
+	size_t pos = no % SLICE_COUNT;
+	if(iSliceNo[pos] != no)
+	{
+		vSlices[pos].clear();
+		iSliceNo[pos] = no;
+	}
+
+	vSlices[pos].add(v);
+	oTotal.add(v);
+}
+
+void windowedSketch::get(uint64_t window_sec, uint64_t now_sec, quantileSketch& out) const
+{
+	out.clear();
+	if(window_sec == 0)
+	{
+		out.merge(oTotal);
+		return;
+	}
+
+	uint64_t no = now_sec / SLICE_SEC;
+	uint64_t n = (window_sec + SLICE_SEC - 1) / SLICE_SEC;
+	if(n > SLICE_COUNT)
+		n = SLICE_COUNT;
+
+	for(size_t i = 0; i < SLICE_COUNT; i++)
+	{
+		if(iSliceNo[i] <= no && no - iSliceNo[i] < n)
+			out.merge(vSlices[i]);
+	}
+}
+
+void windowedSketch::get_json(uint64_t now_sec, double scale, std::string& out) const
+{
+	char buf[192];
+	quantileSketch s;
+
+	out.append(1, '{');
+	for(size_t i = 0; i < WINDOW_COUNT; i++)
+	{
+		get(window_sec[i], now_sec, s);
+		if(i != 0)
+			out.append(1, ',');
+		snprintf(buf, sizeof(buf), "\"%s\":{\"count\":%llu,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"max\":%.1f}",
+			window_names[i], (unsigned long long)s.count(), s.quantile(0.5) / scale, s.quantile(0.9) / scale,
+			s.quantile(0.99) / scale, s.max() / scale);
+		out.append(buf);
+	}
+	out.append(1, '}');
+}
+
+} // namespace xmrstak
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace xmrstak
+{
+
+/** log-linear histogram of integer values with a fixed size
+ *
+ * The values below 16 are counted exactly, above every power of two is split
+ * into 16 buckets. A quantile is the middle of its bucket and is at most 3.2%
+ * off, the minimum and the maximum are exact. Uses 4 KiB for the full 64 bit range.
+ */
+class quantileSketch
+{
+public:
+	static constexpr uint32_t SUB_BITS = 4;
+	static constexpr uint32_t SUB_COUNT = 1u << SUB_BITS;
+	static constexpr size_t BUCKET_COUNT = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+	quantileSketch() { clear(); }
+
+	void add(uint64_t v);
+	void merge(const quantileSketch& o);
+	void clear();
+
+	uint64_t count() const { return iCount; }
+	uint64_t min() const { return iCount != 0 ? iMin : 0; }
+	uint64_t max() const { return iMax; }
+	double mean() const { return iCount != 0 ? double(iSum) / iCount : 0.0; }
+
+	/** value of the quantile q in [0, 1], 0 if the sketch is empty */
+	uint64_t quantile(double q) const;
+
+private:
+	static size_t bucket(uint64_t v);
+	static uint64_t bucket_mid(size_t idx);
+
+	uint32_t iBuckets[BUCKET_COUNT];
+	uint64_t iCount;
+	uint64_t iSum;
+	uint64_t iMin;
+	uint64_t iMax;
+};
+
+/** quantile sketches of the last hour and since the start
+ *
+ * The values are kept in SLICE_COUNT slices of SLICE_SEC seconds, a window
+ * merges the slices it covers. The oldest slice is only partially inside the
+ * window, so a window is up to SLICE_SEC shorter than requested.
+ */
+class windowedSketch
+{
+public:
+	static constexpr uint64_t SLICE_SEC = 300;
+	static constexpr size_t SLICE_COUNT = 12;
+
+	//! windows of the reports, 0 is the time since the start
+	static constexpr size_t WINDOW_COUNT = 3;
+	static const uint64_t window_sec[WINDOW_COUNT];
+	static const char* const window_names[WINDOW_COUNT];
+
+	windowedSketch();
+
+	/** @param now_sec steady clock time in seconds, see get_timestamp() */
+	void add(uint64_t v, uint64_t now_sec);
+
+	/** merge the values of the last window_sec seconds into out, 0 for all values */
+	void get(uint64_t window_sec, uint64_t now_sec, quantileSketch& out) const;
+
+	/** json object with count, p50, p90, p99 and max of every window
+	 *
+	 * @param scale the values are divided by scale
+	 */
+	void get_json(uint64_t now_sec, double scale, std::string& out) const;
+
+private:
+	quantileSketch vSlices[SLICE_COUNT];
+	//! number of the slice, now_sec / SLICE_SEC, stored in a position
+	uint64_t iSliceNo[SLICE_COUNT];
+	quantileSketch oTotal;
+};
+
+} // namespace xmrstak
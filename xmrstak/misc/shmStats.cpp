@@ -0,0 +1,198 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "shmStats.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <string.h>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+namespace xmrstak
+{
+
+shmStats* shmStats::oInst = nullptr;
+
+namespace
+{
+uint64_t unix_ms()
+{
+	using namespace std::chrono;
+	return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+void copy_str(char* dst, size_t len, const char* src)
+{
+	strncpy(dst, src != nullptr ? src : "", len - 1);
+	dst[len - 1] = '\0';
+}
+} // namespace
+
+#ifndef _WIN32
+bool shmStats::open(const char* name, std::string& err)
+{
+	if(name[0] != '/' || strchr(name + 1, '/') != nullptr)
+	{
+		err = std::string("the name '") + name + "' must start with a / and contain no other /";
+		return false;
+	}
+
+	// a segment left behind by a killed miner is replaced, the one of a running miner is not
+	int fd = shm_open(name, O_RDONLY, 0);
+	if(fd >= 0)
+	{
+		shm::header hdr;
+		bool is_miner = read(fd, &hdr, sizeof(hdr)) == sizeof(hdr) && hdr.magic == shm::MAGIC;
+		::close(fd);
+		if(!is_miner)
+		{
+			err = std::string(name) + " exists and is not a statistics segment of the miner";
+			return false;
+		}
+		if(hdr.pid != 0 && pid_t(hdr.pid) != getpid() && (kill(pid_t(hdr.pid), 0) == 0 || errno == EPERM))
+		{
+			err = std::string(name) + " is used by the running miner with pid " + std::to_string(hdr.pid);
+			return false;
+		}
+		shm_unlink(name);
+	}
+
+	fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if(fd < 0)
+	{
+		err = std::string("cannot create ") + name + ": " + strerror(errno);
+		return false;
+	}
+	if(ftruncate(fd, sizeof(shm::region)) != 0)
+	{
+		err = std::string("cannot resize ") + name + ": " + strerror(errno);
+		::close(fd);
+		shm_unlink(name);
+		return false;
+	}
+	void* p = mmap(nullptr, sizeof(shm::region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(p == MAP_FAILED)
+	{
+		err = std::string("cannot map ") + name + ": " + strerror(errno);
+		shm_unlink(name);
+		return false;
+	}
+
+	// the new segment is zero filled, the magic is written last
+	shm::region* r = (shm::region*)p;
+	r->hdr.version = shm::VERSION;
+	r->hdr.size = sizeof(shm::region);
+	r->hdr.max_threads = shm::MAX_THREADS;
+	r->hdr.max_backends = shm::MAX_BACKENDS;
+	r->hdr.pid = getpid();
+	r->hdr.start_ms = unix_ms();
+	std::atomic_thread_fence(std::memory_order_release);
+	r->hdr.magic = shm::MAGIC;
+
+	sName = name;
+	pRegion = r;
+	std::atexit(&shmStats::unlink_at_exit);
+	return true;
+}
+
+void shmStats::unlink_at_exit()
+{
+	shm_unlink(oInst->sName.c_str());
+}
+#else
+bool shmStats::open(const char* name, std::string& err)
+{
+	err = "shared memory statistics are not supported on Windows";
+	return false;
+}
+
+void shmStats::unlink_at_exit()
+{
+}
+#endif
+
+shm::thread_stats* shmStats::thread_block(uint32_t thread_no, uint32_t backend)
+{
+	if(pRegion == nullptr || thread_no >= shm::MAX_THREADS)
+		return nullptr;
+
+	shm::thread_stats& thd = pRegion->threads[thread_no];
+	shm::write_begin(thd);
+	thd.backend = backend;
+	shm::write_end(thd);
+	return &thd;
+}
+
+void shmStats::update(const statsSnapshot& snap, const char* pool, const char* job_id, uint64_t difficulty)
+{
+	if(pRegion == nullptr)
+		return;
+
+	shm::global_stats& g = pRegion->global;
+	shm::write_begin(g);
+
+	g.thread_count = snap.threads.size();
+	g.thread_blocks = snap.threads.size() < shm::MAX_THREADS ? snap.threads.size() : shm::MAX_THREADS;
+	g.update_ms = unix_ms();
+	g.uptime_sec = snap.uptime_sec;
+	for(size_t w = 0; w < 3; w++)
+		g.hashrate[w] = 0.0;
+	for(size_t b = 0; b < shm::MAX_BACKENDS; b++)
+	{
+		g.backend_hashrate[b] = 0.0;
+		g.backend_hashes[b] = 0;
+		g.backend_threads[b] = 0;
+	}
+	for(const statsSnapshot::thread& t : snap.threads)
+	{
+		for(size_t w = 0; w < 3; w++)
+			g.hashrate[w] += t.hps[w];
+		if(t.type < shm::MAX_BACKENDS)
+		{
+			g.backend_hashrate[t.type] += t.hps[0];
+			g.backend_hashes[t.type] += t.hashes;
+			g.backend_threads[t.type]++;
+		}
+	}
+
+	uint64_t rejected = 0;
+	for(const auto& r : snap.shares_rejected)
+		rejected += r.second;
+	g.shares_accepted = snap.shares_accepted;
+	g.shares_rejected = rejected;
+	g.shares_stale = snap.shares_stale;
+	g.pool_hashes = snap.pool_hashes;
+	g.difficulty = difficulty;
+	g.pool_connected = pool != nullptr ? 1 : 0;
+	copy_str(g.pool, sizeof(g.pool), pool);
+	copy_str(g.job_id, sizeof(g.job_id), pool != nullptr ? job_id : nullptr);
+
+	shm::write_end(g);
+}
+
+} // namespace xmrstak
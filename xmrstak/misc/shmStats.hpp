@@ -0,0 +1,56 @@
+#pragma once
+
+#include "shmStatsLayout.hpp"
+#include "statsSnapshot.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace xmrstak
+{
+
+/** writer of the shared memory statistics, see shmStatsLayout.hpp
+ *
+ * The executor creates the segment, hands every worker its thread block with
+ * iBackend::pShmSlot and updates the global block on every tick. The segment
+ * is removed when the miner exits.
+ */
+class shmStats
+{
+public:
+	static shmStats* inst()
+	{
+		if (oInst == nullptr) oInst = new shmStats;
+		return oInst;
+	};
+
+	/** create the segment
+	 *
+	 * A segment of the name which was left behind by a miner that is no longer
+	 * running is replaced, the segment of a running miner is not touched.
+	 */
+	bool open(const char* name, std::string& err);
+
+	inline bool is_open() const { return pRegion != nullptr; }
+
+	/** block of a thread, nullptr if the segment is not open or thread_no >= shm::MAX_THREADS */
+	shm::thread_stats* thread_block(uint32_t thread_no, uint32_t backend);
+
+	/** update the global block from the executor tick
+	 *
+	 * @param pool address of the active user pool, nullptr if not logged in
+	 * @param job_id current job of the pool
+	 */
+	void update(const statsSnapshot& snap, const char* pool, const char* job_id, uint64_t difficulty);
+
+private:
+	shmStats() {}
+
+	static shmStats* oInst;
+	static void unlink_at_exit();
+
+	shm::region* pRegion = nullptr;
+	std::string sName;
+};
+
+} // namespace xmrstak
@@ -0,0 +1,209 @@
+#pragma once
+
+/* Layout of the shared memory statistics of the miner and a reader for local
+ * monitoring agents. This header only depends on the C++ standard library and
+ * POSIX, an agent can include it without the rest of the miner.
+ *
+ * The miner creates the segment with `--shm-stats NAME`. The segment starts
+ * with a header, followed by the global block written by the executor every
+ * 500 ms and one block per thread written by the thread itself whenever it
+ * publishes its hash count. Every block is protected by its own sequence lock:
+ * the sequence is odd while the block is written and a reader retries until it
+ * copied a block with the same even sequence before and after the copy.
+ *
+ * All integers are in the byte order of the host. The layout only changes
+ * together with VERSION.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace xmrstak
+{
+namespace shm
+{
+
+constexpr uint32_t MAGIC = 0x4b545358; // "XSTK"
+constexpr uint32_t VERSION = 1;
+//! threads with a higher thread number have no block, see global_stats::thread_count
+constexpr uint32_t MAX_THREADS = 256;
+//! indexed by xmrstak::iBackend::BackendType
+constexpr uint32_t MAX_BACKENDS = 8;
+
+struct header
+{
+	uint32_t magic;
+	uint32_t version;
+	//! size of the whole segment in bytes
+	uint32_t size;
+	uint32_t max_threads;
+	uint32_t max_backends;
+	uint32_t pid;
+	//! unix time in milliseconds when the miner created the segment
+	uint64_t start_ms;
+};
+
+struct alignas(64) global_stats
+{
+	std::atomic<uint32_t> seq;
+	//! number of threads of the miner, can be larger than MAX_THREADS
+	uint32_t thread_count;
+	//! unix time in milliseconds of the last update, a reader should treat old data as a dead miner
+	uint64_t update_ms;
+	uint64_t uptime_sec;
+	//! hashes per second of all threads over 10 sec, 60 sec and 15 min, NaN if unknown
+	double hashrate[3];
+	//! 10 sec hash rate, hashes and threads per backend type
+	double backend_hashrate[MAX_BACKENDS];
+	uint64_t backend_hashes[MAX_BACKENDS];
+	uint32_t backend_threads[MAX_BACKENDS];
+	uint64_t shares_accepted;
+	uint64_t shares_rejected;
+	uint64_t shares_stale;
+	uint64_t pool_hashes;
+	//! share difficulty of the current job
+	uint64_t difficulty;
+	//! 1 if the miner is logged in to the pool it works for
+	uint32_t pool_connected;
+	//! number of used thread blocks, the smaller of thread_count and MAX_THREADS
+	uint32_t thread_blocks;
+	//! nul terminated, empty if no pool is active
+	char pool[128];
+	char job_id[64];
+};
+
+struct alignas(64) thread_stats
+{
+	std::atomic<uint32_t> seq;
+	//! xmrstak::iBackend::BackendType, 0 if the block is not used
+	uint32_t backend;
+	uint64_t hashes;
+	//! steady clock of the miner in milliseconds of the last update of hashes
+	uint64_t timestamp_ms;
+};
+
+struct region
+{
+	header hdr;
+	global_stats global;
+	thread_stats threads[MAX_THREADS];
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the sequence must have the size of an integer");
+
+/** start writing a block, only one thread may write a block */
+template<typename T>
+inline void write_begin(T& block)
+{
+	block.seq.store(block.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+template<typename T>
+inline void write_end(T& block)
+{
+	block.seq.store(block.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/** consistent copy of a block
+ *
+ * @return false if the writer did not finish in max_tries attempts
+ */
+template<typename T>
+inline bool read_block(const T& block, T& out, size_t max_tries = 1000)
+{
+	for(size_t i = 0; i < max_tries; i++)
+	{
+		uint32_t before = block.seq.load(std::memory_order_acquire);
+		if(before & 1)
+			continue;
+		memcpy((void*)&out, (const void*)&block, sizeof(T));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(block.seq.load(std::memory_order_relaxed) == before)
+			return true;
+	}
+	return false;
+}
+
+#ifndef _WIN32
+/** read only mapping of the segment of a running miner */
+class reader
+{
+public:
+	reader() {}
+	~reader() { close(); }
+
+	reader(const reader&) = delete;
+	reader& operator=(const reader&) = delete;
+
+	/** map the segment
+	 *
+	 * @param name segment name as given to `--shm-stats`, e.g. `/xmr-stak`
+	 */
+	bool open(const char* name, std::string& err)
+	{
+		close();
+		int fd = shm_open(name, O_RDONLY, 0);
+		if(fd < 0)
+		{
+			err = std::string("cannot open ") + name + ": " + strerror(errno);
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(region))
+		{
+			::close(fd);
+			err = std::string(name) + " is not a statistics segment of the miner";
+			return false;
+		}
+		void* p = mmap(nullptr, sizeof(region), PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(p == MAP_FAILED)
+		{
+			err = std::string("cannot map ") + name + ": " + strerror(errno);
+			return false;
+		}
+		pRegion = (const region*)p;
+		if(pRegion->hdr.magic != MAGIC || pRegion->hdr.version != VERSION)
+		{
+			close();
+			err = std::string(name) + " has an unknown layout";
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+		if(pRegion != nullptr)
+			munmap((void*)pRegion, sizeof(region));
+		pRegion = nullptr;
+	}
+
+	const header& get_header() const { return pRegion->hdr; }
+
+	bool read_global(global_stats& out) const { return read_block(pRegion->global, out); }
+
+	bool read_thread(size_t i, thread_stats& out) const
+	{
+		return i < MAX_THREADS && read_block(pRegion->threads[i], out);
+	}
+
+private:
+	const region* pRegion = nullptr;
+};
+#endif
+
+} // namespace shm
+} // namespace xmrstak
@@ -0,0 +1,116 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "startupTiming.hpp"
+#include "console.hpp"
+#include "xmrstak/net/msgstruct.hpp"
+
+#include <stdio.h>
+
+namespace xmrstak
+{
+
+startupTiming* startupTiming::oInst = nullptr;
+
+startupTiming::startupTiming() : iOrigin(get_timestamp_ms())
+{
+}
+
+size_t startupTiming::now()
+{
+	return get_timestamp_ms() - iOrigin;
+}
+
+void startupTiming::record(const std::string& name, size_t iStart)
+{
+	size_t iEnd = now();
+	std::unique_lock<std::mutex> lck(mtx);
+
+	for(phase& p : vPhases)
+	{
+		if(p.name == name)
+		{
+			if(iStart < p.iStart) p.iStart = iStart;
+			if(iEnd > p.iEnd) p.iEnd = iEnd;
+			return;
+		}
+	}
+	vPhases.push_back({name, iStart, iEnd});
+}
+
+void startupTiming::first_hash()
+{
+	std::unique_lock<std::mutex> lck(mtx);
+	if(iFirstHash != 0)
+		return;
+	iFirstHash = now();
+	lck.unlock();
+
+	std::string out;
+	get_report(out);
+	printer::inst()->print_str(out.c_str());
+}
+
+void startupTiming::get_report(std::string& out)
+{
+	char buffer[256];
+	std::unique_lock<std::mutex> lck(mtx);
+
+	out.append("STARTUP REPORT\n");
+	out.append("| Phase                            |    Start |  Duration |\n");
+	for(const phase& p : vPhases)
+	{
+		snprintf(buffer, sizeof(buffer), "| %-32.32s | %6llums | %7llums |\n", p.name.c_str(),
+			int_port(p.iStart), int_port(p.iEnd - p.iStart));
+		out.append(buffer);
+	}
+
+	if(iFirstHash != 0)
+		snprintf(buffer, sizeof(buffer), "Time to first hash: %llu ms\n", int_port(iFirstHash));
+	else
+		snprintf(buffer, sizeof(buffer), "Time to first hash: (n/a)\n");
+	out.append(buffer);
+	out.append("-----------------------------------------------------------------\n");
+}
+
+void startupTiming::get_json(std::string& out)
+{
+	char buffer[256];
+	std::unique_lock<std::mutex> lck(mtx);
+
+	out.append("{\"phases\":[");
+	for(size_t i=0; i < vPhases.size(); i++)
+	{
+		snprintf(buffer, sizeof(buffer), "%s{\"name\":\"%s\",\"start\":%llu,\"duration\":%llu}", i != 0 ? "," : "",
+			vPhases[i].name.c_str(), int_port(vPhases[i].iStart), int_port(vPhases[i].iEnd - vPhases[i].iStart));
+		out.append(buffer);
+	}
+
+	if(iFirstHash != 0)
+		snprintf(buffer, sizeof(buffer), "],\"first_hash\":%llu}", int_port(iFirstHash));
+	else
+		snprintf(buffer, sizeof(buffer), "],\"first_hash\":null}");
+	out.append(buffer);
+}
+
+} // namespace xmrstak
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xmrstak
+{
+
+/** Collects the time spent in each startup phase
+ *
+ * All timestamps are milliseconds relative to the first call of inst(),
+ * which happens at the start of main.
+ */
+class startupTiming
+{
+public:
+	static startupTiming* inst()
+	{
+		if (oInst == nullptr) oInst = new startupTiming;
+		return oInst;
+	};
+
+	/** milliseconds since the process start */
+	size_t now();
+
+	/** record a finished phase
+	 *
+	 * @param name phase name, phases with the same name are merged (earliest start, latest end)
+	 * @param iStart phase start as returned by now()
+	 */
+	void record(const std::string& name, size_t iStart);
+
+	/** mark the first hash, prints the breakdown the first time it is called */
+	void first_hash();
+
+	void get_report(std::string& out);
+	void get_json(std::string& out);
+
+private:
+	startupTiming();
+	static startupTiming* oInst;
+
+	struct phase
+	{
+		std::string name;
+		size_t iStart;
+		size_t iEnd;
+	};
+
+	std::mutex mtx;
+	size_t iOrigin;
+	size_t iFirstHash = 0;
+	std::vector<phase> vPhases;
+};
+
+} // namespace xmrstak
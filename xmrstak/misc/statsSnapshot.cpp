@@ -0,0 +1,270 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "statsSnapshot.hpp"
+#include "xmrstak/version.hpp"
+
+#include <cmath>
+#include <stdio.h>
+
+namespace xmrstak
+{
+
+const char* const statsSnapshot::window_names[WINDOW_COUNT] = { "10s", "60s", "15m" };
+
+namespace
+{
+std::shared_ptr<const statsSnapshot> oCurrent;
+
+//! label values may contain any character except for unescaped quotes, back slashes and new lines
+std::string label_escape(const std::string& in)
+{
+	std::string out;
+	out.reserve(in.size());
+	for(char c : in)
+	{
+		if(c == '\\')
+			out.append("\\\\");
+		else if(c == '"')
+			out.append("\\\"");
+		else if(c == '\n')
+			out.append("\\n");
+		else
+			out.append(1, c);
+	}
+	return out;
+}
+
+const char* num_format(double v, char* buf, size_t l)
+{
+	if(std::isnan(v))
+		return "NaN";
+	if(std::isinf(v))
+		return v > 0 ? "+Inf" : "-Inf";
+	snprintf(buf, l, "%.6g", v);
+	return buf;
+}
+
+void family(std::string& out, const char* name, const char* type, const char* help)
+{
+	out.append("# HELP ").append(name).append(1, ' ').append(help).append(1, '\n');
+	out.append("# TYPE ").append(name).append(1, ' ').append(type).append(1, '\n');
+}
+
+void sample(std::string& out, const char* name, const std::string& labels, double v)
+{
+	char num[32];
+	out.append(name);
+	if(!labels.empty())
+		out.append(1, '{').append(labels).append(1, '}');
+	out.append(1, ' ').append(num_format(v, num, sizeof(num))).append(1, '\n');
+}
+
+void sample(std::string& out, const char* name, const std::string& labels, uint64_t v)
+{
+	out.append(name);
+	if(!labels.empty())
+		out.append(1, '{').append(labels).append(1, '}');
+	out.append(1, ' ').append(std::to_string(v)).append(1, '\n');
+}
+
+void histogram_samples(std::string& out, const char* name, const std::string& labels, const histogram& h)
+{
+	std::string bucket = std::string(name) + "_bucket";
+	std::string lbl = labels.empty() ? std::string() : labels + ",";
+	char num[32];
+	uint64_t cumulative = 0;
+	for(size_t i = 0; i < h.bounds.size(); i++)
+	{
+		cumulative += h.counts[i];
+		sample(out, bucket.c_str(), lbl + "le=\"" + num_format(h.bounds[i], num, sizeof(num)) + "\"", cumulative);
+	}
+	sample(out, bucket.c_str(), lbl + "le=\"+Inf\"", h.count);
+	sample(out, (std::string(name) + "_sum").c_str(), labels, h.sum);
+	sample(out, (std::string(name) + "_count").c_str(), labels, h.count);
+}
+} // namespace
+
+void histogram::add(double v)
+{
+	size_t i = 0;
+	while(i < bounds.size() && v > bounds[i])
+		i++;
+	counts[i]++;
+	sum += v;
+	count++;
+}
+
+void statsSnapshot::publish(std::shared_ptr<const statsSnapshot> snap)
+{
+	std::atomic_store(&oCurrent, std::move(snap));
+}
+
+std::shared_ptr<const statsSnapshot> statsSnapshot::get()
+{
+	return std::atomic_load(&oCurrent);
+}
+
+void statsSnapshot::get_metrics(std::string& out) const
+{
+	out.reserve(4096 + threads.size() * 512 + pools.size() * 2048);
+
+	family(out, "xmrstak_info", "gauge", "Version of the miner.");
+	sample(out, "xmrstak_info", "version=\"" + label_escape(get_version_str()) + "\"", uint64_t(1));
+
+	family(out, "xmrstak_uptime_seconds", "gauge", "Seconds since the miner started.");
+	sample(out, "xmrstak_uptime_seconds", std::string(), uptime_sec);
+
+	// threads and the backend totals
+	std::vector<std::string> backends;
+	std::vector<std::string> thd_labels;
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		std::string b = threads[i].backend;
+		thd_labels.emplace_back("thread=\"" + std::to_string(i) + "\",backend=\"" + b + "\"");
+		bool found = false;
+		for(const std::string& n : backends)
+			found = found || n == b;
+		if(!found)
+			backends.emplace_back(std::move(b));
+	}
+
+	family(out, "xmrstak_thread_hashes_total", "counter", "Hashes calculated by the thread.");
+	for(size_t i = 0; i < threads.size(); i++)
+		sample(out, "xmrstak_thread_hashes_total", thd_labels[i], threads[i].hashes);
+
+	family(out, "xmrstak_thread_hashrate", "gauge", "Hashes per second of the thread averaged over the window.");
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		for(size_t w = 0; w < WINDOW_COUNT; w++)
+			sample(out, "xmrstak_thread_hashrate", thd_labels[i] + ",window=\"" + window_names[w] + "\"", threads[i].hps[w]);
+	}
+
+	family(out, "xmrstak_thread_parked_seconds_total", "counter", "Seconds the thread yielded the CPU to other processes.");
+	for(size_t i = 0; i < threads.size(); i++)
+		sample(out, "xmrstak_thread_parked_seconds_total", thd_labels[i], threads[i].parked_sec);
+
+	std::vector<double> backend_hps(backends.size() * WINDOW_COUNT, 0.0);
+	std::vector<uint64_t> backend_hashes(backends.size(), 0);
+	std::vector<uint64_t> backend_threads(backends.size(), 0);
+	double total_hps[WINDOW_COUNT] = { 0.0, 0.0, 0.0 };
+	for(const thread& t : threads)
+	{
+		size_t b = 0;
+		while(backends[b] != t.backend)
+			b++;
+		backend_hashes[b] += t.hashes;
+		backend_threads[b]++;
+		for(size_t w = 0; w < WINDOW_COUNT; w++)
+		{
+			backend_hps[b * WINDOW_COUNT + w] += t.hps[w];
+			total_hps[w] += t.hps[w];
+		}
+	}
+
+	family(out, "xmrstak_backend_threads", "gauge", "Mining threads of the backend.");
+	for(size_t b = 0; b < backends.size(); b++)
+		sample(out, "xmrstak_backend_threads", "backend=\"" + backends[b] + "\"", backend_threads[b]);
+
+	family(out, "xmrstak_backend_hashes_total", "counter", "Hashes calculated by all threads of the backend.");
+	for(size_t b = 0; b < backends.size(); b++)
+		sample(out, "xmrstak_backend_hashes_total", "backend=\"" + backends[b] + "\"", backend_hashes[b]);
+
+	family(out, "xmrstak_backend_hashrate", "gauge", "Hashes per second of the backend, NaN until every thread has filled the window.");
+	for(size_t b = 0; b < backends.size(); b++)
+	{
+		for(size_t w = 0; w < WINDOW_COUNT; w++)
+			sample(out, "xmrstak_backend_hashrate", "backend=\"" + backends[b] + "\",window=\"" + window_names[w] + "\"", backend_hps[b * WINDOW_COUNT + w]);
+	}
+
+	family(out, "xmrstak_hashrate", "gauge", "Hashes per second of all threads.");
+	for(size_t w = 0; w < WINDOW_COUNT; w++)
+		sample(out, "xmrstak_hashrate", std::string("window=\"") + window_names[w] + "\"", total_hps[w]);
+
+	family(out, "xmrstak_hashrate_highest", "gauge", "Highest 10 second hash rate of all threads.");
+	sample(out, "xmrstak_hashrate_highest", std::string(), highest_hps);
+
+	// results
+	family(out, "xmrstak_shares_accepted_total", "counter", "Shares accepted by the user pools.");
+	sample(out, "xmrstak_shares_accepted_total", std::string(), shares_accepted);
+
+	family(out, "xmrstak_shares_rejected_total", "counter", "Shares which were not accepted by reason.");
+	for(const auto& r : shares_rejected)
+		sample(out, "xmrstak_shares_rejected_total", "reason=\"" + label_escape(r.first) + "\"", r.second);
+
+	family(out, "xmrstak_shares_stale_total", "counter", "Shares found for a job the pool had replaced already.");
+	sample(out, "xmrstak_shares_stale_total", std::string(), shares_stale);
+
+	family(out, "xmrstak_share_difficulty_best", "gauge", "Highest difficulty of an accepted share.");
+	sample(out, "xmrstak_share_difficulty_best", std::string(), best_share_diff);
+
+	family(out, "xmrstak_pool_hashes_total", "counter", "Sum of the difficulties of the accepted shares since the last login.");
+	sample(out, "xmrstak_pool_hashes_total", std::string(), pool_hashes);
+
+	// connections
+	family(out, "xmrstak_socket_errors_total", "counter", "Socket and login errors of the user pools.");
+	sample(out, "xmrstak_socket_errors_total", std::string(), socket_errors);
+
+	family(out, "xmrstak_log_dropped_total", "counter", "Log messages dropped because the output was too slow.");
+	sample(out, "xmrstak_log_dropped_total", std::string(), log_dropped);
+
+	family(out, "xmrstak_connected_seconds", "gauge", "Seconds since the login to the current user pool, 0 if not connected.");
+	sample(out, "xmrstak_connected_seconds", std::string(), connected_sec);
+
+	std::vector<std::string> pool_labels;
+	for(const pool& p : pools)
+		pool_labels.emplace_back("pool=\"" + label_escape(p.addr) + "\",dev=\"" + (p.dev_pool ? "1" : "0") + "\"");
+
+	family(out, "xmrstak_pool_active", "gauge", "1 if the miner is working for the pool.");
+	for(size_t i = 0; i < pools.size(); i++)
+		sample(out, "xmrstak_pool_active", pool_labels[i], uint64_t(pools[i].active));
+
+	family(out, "xmrstak_pool_connected", "gauge", "1 if the socket to the pool is open.");
+	for(size_t i = 0; i < pools.size(); i++)
+		sample(out, "xmrstak_pool_connected", pool_labels[i], uint64_t(pools[i].connected));
+
+	family(out, "xmrstak_pool_logged_in", "gauge", "1 if the miner is logged in to the pool.");
+	for(size_t i = 0; i < pools.size(); i++)
+		sample(out, "xmrstak_pool_logged_in", pool_labels[i], uint64_t(pools[i].logged_in));
+
+	family(out, "xmrstak_pool_connect_attempts", "gauge", "Connect attempts since the last successful login.");
+	for(size_t i = 0; i < pools.size(); i++)
+		sample(out, "xmrstak_pool_connect_attempts", pool_labels[i], pools[i].connect_attempts);
+
+	family(out, "xmrstak_pool_difficulty", "gauge", "Share difficulty of the current job of the pool.");
+	for(size_t i = 0; i < pools.size(); i++)
+		sample(out, "xmrstak_pool_difficulty", pool_labels[i], pools[i].difficulty);
+
+	family(out, "xmrstak_pool_jobs_total", "counter", "Jobs of the pool the miners were switched to.");
+	for(size_t i = 0; i < pools.size(); i++)
+		sample(out, "xmrstak_pool_jobs_total", pool_labels[i], pools[i].jobs);
+
+	family(out, "xmrstak_pool_submit_latency_seconds", "histogram", "Time from sending a share to the response of the pool.");
+	for(size_t i = 0; i < pools.size(); i++)
+		histogram_samples(out, "xmrstak_pool_submit_latency_seconds", pool_labels[i], pools[i].submit_latency);
+
+	family(out, "xmrstak_job_switch_latency_seconds", "histogram", "Time from receiving a job from the pool to switching the miners to it.");
+	histogram_samples(out, "xmrstak_job_switch_latency_seconds", std::string(), job_switch_latency);
+}
+
+} // namespace xmrstak
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace xmrstak
+{
+
+/** histogram with fixed upper bucket bounds, the layout of a Prometheus histogram */
+struct histogram
+{
+	histogram() {}
+	histogram(const double* bounds, size_t n) : bounds(bounds, bounds + n), counts(n + 1, 0) {}
+
+	void add(double v);
+
+	std::vector<double> bounds;
+	//! per bucket, the last entry counts the values above the last bound
+	std::vector<uint64_t> counts;
+	double sum = 0.0;
+	uint64_t count = 0;
+};
+
+/** immutable copy of the miner statistics
+ *
+ * The executor builds a new snapshot on every tick and publishes it. Readers
+ * like the `/metrics` handler of the http daemon take a reference with get()
+ * and render it without sending an event to the executor.
+ */
+struct statsSnapshot
+{
+	//! hash rate windows of the reports, 10 sec, 60 sec and 15 min
+	static constexpr size_t WINDOW_COUNT = 3;
+	static const char* const window_names[WINDOW_COUNT];
+
+	struct thread
+	{
+		const char* backend;
+		//! xmrstak::iBackend::BackendType
+		uint32_t type;
+		uint64_t hashes;
+		//! hashes per second, NaN if the window is not filled yet
+		double hps[WINDOW_COUNT];
+		double parked_sec;
+	};
+
+	struct pool
+	{
+		std::string addr;
+		bool dev_pool;
+		//! pool the miner is working for
+		bool active;
+		bool connected;
+		bool logged_in;
+		uint64_t connect_attempts;
+		uint64_t difficulty;
+		uint64_t jobs;
+		//! time from sending a share to the response of the pool in seconds
+		histogram submit_latency;
+	};
+
+	uint64_t uptime_sec = 0;
+	std::vector<thread> threads;
+	double highest_hps = 0.0;
+
+	uint64_t shares_accepted = 0;
+	//! rejected shares by the reason reported by the pool or the miner
+	std::vector<std::pair<std::string, uint64_t>> shares_rejected;
+	//! shares found for a job the pool had replaced already
+	uint64_t shares_stale = 0;
+	uint64_t best_share_diff = 0;
+	uint64_t pool_hashes = 0;
+	uint64_t socket_errors = 0;
+	//! log messages dropped because the output was too slow
+	uint64_t log_dropped = 0;
+	//! seconds since the login to the current user pool, 0 if not connected
+	uint64_t connected_sec = 0;
+
+	//! time from receiving a job to switching the miners to it in seconds
+	histogram job_switch_latency;
+	std::vector<pool> pools;
+
+	/** Prometheus text exposition format 0.0.4 */
+	void get_metrics(std::string& out) const;
+
+	/** replace the current snapshot, only called by the executor */
+	static void publish(std::shared_ptr<const statsSnapshot> snap);
+
+	/** current snapshot, nullptr until the executor has published one */
+	static std::shared_ptr<const statsSnapshot> get();
+};
+
+} // namespace xmrstak
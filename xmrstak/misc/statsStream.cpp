@@ -0,0 +1,243 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "statsStream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+namespace xmrstak
+{
+
+statsStream* statsStream::oInst = nullptr;
+
+namespace
+{
+//! interval of the keep alive comments of an idle stream
+constexpr uint64_t KEEPALIVE_MS = 15000;
+
+uint64_t now_ms()
+{
+	using namespace std::chrono;
+	return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+const char* hps_json(double h, char* buf, size_t l)
+{
+	if(!std::isnormal(h) && h != 0.0)
+		return "null";
+	snprintf(buf, l, "%.1f", h);
+	return buf;
+}
+
+double total_hps(const statsSnapshot& snap)
+{
+	double total = 0.0;
+	for(const statsSnapshot::thread& t : snap.threads)
+		total += t.hps[0];
+	return total;
+}
+
+void append_event(std::string& out, const char* type, const std::string& json)
+{
+	out.append("event: ").append(type).append("\ndata: ").append(json).append("\n\n");
+}
+
+void pool_json(const statsSnapshot::pool& p, std::string& out)
+{
+	out.append("{\"pool\":\"");
+	statsStream::json_escape(p.addr, out);
+	out.append("\",\"dev\":").append(p.dev_pool ? "true" : "false");
+	out.append(",\"active\":").append(p.active ? "true" : "false");
+	out.append(",\"connected\":").append(p.connected ? "true" : "false");
+	out.append(",\"logged_in\":").append(p.logged_in ? "true" : "false");
+	out.append(",\"difficulty\":").append(std::to_string(p.difficulty)).append(1, '}');
+}
+
+inline bool pool_changed(const statsSnapshot::pool& a, const statsSnapshot::pool& b)
+{
+	return a.active != b.active || a.connected != b.connected || a.logged_in != b.logged_in || a.difficulty != b.difficulty;
+}
+} // namespace
+
+void statsStream::json_escape(const std::string& in, std::string& out)
+{
+	char buf[8];
+	for(unsigned char c : in)
+	{
+		if(c == '"' || c == '\\')
+			out.append(1, '\\').append(1, c);
+		else if(c < 0x20)
+		{
+			snprintf(buf, sizeof(buf), "\\u%04x", unsigned(c));
+			out.append(buf);
+		}
+		else
+			out.append(1, c);
+	}
+}
+
+void statsStream::push(const char* type, std::string&& json)
+{
+	if(!is_active())
+		return;
+
+	std::unique_lock<std::mutex> lck(queue_mutex);
+	qEvents.push_back(event{iNextSeq++, type, std::move(json)});
+	if(qEvents.size() > QUEUE_SIZE)
+		qEvents.pop_front();
+}
+
+statsStream::subscriber::subscriber(uint64_t interval_ms)
+{
+	if(interval_ms < MIN_INTERVAL_MS)
+		interval_ms = MIN_INTERVAL_MS;
+	if(interval_ms > MAX_INTERVAL_MS)
+		interval_ms = MAX_INTERVAL_MS;
+	iIntervalMs = interval_ms;
+	iNextUpdateMs = iLastSendMs = now_ms();
+
+	statsStream* s = statsStream::inst();
+	std::unique_lock<std::mutex> lck(s->queue_mutex);
+	s->iSubscribers++;
+	iNextSeq = s->iNextSeq;
+}
+
+statsStream::subscriber::~subscriber()
+{
+	statsStream::inst()->iSubscribers--;
+}
+
+size_t statsStream::subscriber::read(char* buf, size_t max)
+{
+	while(iPendingPos == sPending.size())
+		next_update();
+
+	size_t len = sPending.size() - iPendingPos;
+	if(len > max)
+		len = max;
+	memcpy(buf, sPending.data() + iPendingPos, len);
+	iPendingPos += len;
+	return len;
+}
+
+void statsStream::subscriber::next_update()
+{
+	uint64_t now = now_ms();
+	if(now < iNextUpdateMs)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(iNextUpdateMs - now));
+		now = iNextUpdateMs;
+	}
+	// skip the missed updates of a slow client instead of sending them in a burst
+	iNextUpdateMs = std::max(iNextUpdateMs + iIntervalMs, now);
+
+	sPending.clear();
+	iPendingPos = 0;
+
+	char num[32];
+	std::string json;
+	std::shared_ptr<const statsSnapshot> snap = statsSnapshot::get();
+	if(snap != nullptr && oLastSnap == nullptr)
+	{
+		json.append("{\"uptime\":").append(std::to_string(snap->uptime_sec));
+		json.append(",\"hashrate\":{\"total\":").append(hps_json(total_hps(*snap), num, sizeof(num)));
+		json.append(",\"threads\":[");
+		for(size_t i = 0; i < snap->threads.size(); i++)
+		{
+			if(i != 0) json.append(1, ',');
+			json.append(hps_json(snap->threads[i].hps[0], num, sizeof(num)));
+		}
+		uint64_t rejected = 0;
+		for(const auto& r : snap->shares_rejected)
+			rejected += r.second;
+		json.append("]},\"shares\":{\"accepted\":").append(std::to_string(snap->shares_accepted));
+		json.append(",\"rejected\":").append(std::to_string(rejected));
+		json.append(",\"stale\":").append(std::to_string(snap->shares_stale));
+		json.append("},\"pools\":[");
+		for(size_t i = 0; i < snap->pools.size(); i++)
+		{
+			if(i != 0) json.append(1, ',');
+			pool_json(snap->pools[i], json);
+		}
+		json.append("]}");
+		append_event(sPending, "state", json);
+	}
+	else if(snap != nullptr && snap != oLastSnap)
+	{
+		// hash rates are compared as they are printed, rounding noise is not sent
+		char old[32];
+		bool changed = false;
+		json.append("{\"threads\":{");
+		for(size_t i = 0; i < snap->threads.size() && i < oLastSnap->threads.size(); i++)
+		{
+			const char* cur = hps_json(snap->threads[i].hps[0], num, sizeof(num));
+			if(strcmp(cur, hps_json(oLastSnap->threads[i].hps[0], old, sizeof(old))) == 0)
+				continue;
+			if(changed) json.append(1, ',');
+			json.append(1, '"').append(std::to_string(i)).append("\":").append(cur);
+			changed = true;
+		}
+		if(changed)
+		{
+			json.append("},\"total\":").append(hps_json(total_hps(*snap), num, sizeof(num))).append(1, '}');
+			append_event(sPending, "hashrate", json);
+		}
+
+		for(size_t i = 0; i < snap->pools.size() && i < oLastSnap->pools.size(); i++)
+		{
+			if(!pool_changed(snap->pools[i], oLastSnap->pools[i]))
+				continue;
+			json.clear();
+			pool_json(snap->pools[i], json);
+			append_event(sPending, "pool", json);
+		}
+	}
+	if(snap != nullptr)
+		oLastSnap = std::move(snap);
+
+	statsStream* s = statsStream::inst();
+	std::unique_lock<std::mutex> lck(s->queue_mutex);
+	if(!s->qEvents.empty() && s->qEvents.front().seq > iNextSeq)
+	{
+		json = "{\"events\":" + std::to_string(s->qEvents.front().seq - iNextSeq) + "}";
+		append_event(sPending, "dropped", json);
+		iNextSeq = s->qEvents.front().seq;
+	}
+	size_t first = s->qEvents.empty() ? 0 : iNextSeq - s->qEvents.front().seq;
+	for(size_t i = first; i < s->qEvents.size(); i++)
+		append_event(sPending, s->qEvents[i].type, s->qEvents[i].json);
+	iNextSeq = s->iNextSeq;
+	lck.unlock();
+
+	if(sPending.empty() && now - iLastSendMs >= KEEPALIVE_MS)
+		sPending = ": keepalive\n\n";
+	if(!sPending.empty())
+		iLastSendMs = now;
+}
+
+} // namespace xmrstak
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "statsSnapshot.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace xmrstak
+{
+
+/** push updates of the miner statistics as Server-Sent Events
+ *
+ * The executor pushes job and share events into a bounded queue. Every
+ * subscriber wakes up at its own interval and sends the queued events and the
+ * differences between the last published statsSnapshot and the one it sent
+ * before: hash rates which changed and pools whose state changed. The first
+ * update of a subscriber is the complete state.
+ */
+class statsStream
+{
+public:
+	static statsStream* inst()
+	{
+		if (oInst == nullptr) oInst = new statsStream;
+		return oInst;
+	};
+
+	//! events kept for subscribers which are behind
+	static constexpr size_t QUEUE_SIZE = 1024;
+	static constexpr uint64_t MIN_INTERVAL_MS = 100;
+	static constexpr uint64_t MAX_INTERVAL_MS = 60000;
+
+	/** true if any client is subscribed, events are not queued otherwise */
+	inline bool is_active() const { return iSubscribers.load(std::memory_order_relaxed) != 0; }
+
+	/** queue an event
+	 *
+	 * @param type SSE event name
+	 * @param json data of the event, a json object
+	 */
+	void push(const char* type, std::string&& json);
+
+	class subscriber
+	{
+	public:
+		subscriber(uint64_t interval_ms);
+		~subscriber();
+
+		subscriber(const subscriber&) = delete;
+		subscriber& operator=(const subscriber&) = delete;
+
+		/** copy the next bytes of the stream, blocks until the next update is due */
+		size_t read(char* buf, size_t max);
+
+	private:
+		void next_update();
+
+		uint64_t iIntervalMs;
+		uint64_t iNextUpdateMs;
+		uint64_t iLastSendMs;
+		uint64_t iNextSeq = 0;
+		std::shared_ptr<const statsSnapshot> oLastSnap;
+		std::string sPending;
+		size_t iPendingPos = 0;
+	};
+
+	static void json_escape(const std::string& in, std::string& out);
+
+private:
+	statsStream() : iSubscribers(0) {}
+
+	static statsStream* oInst;
+
+	struct event
+	{
+		uint64_t seq;
+		const char* type;
+		std::string json;
+	};
+
+	std::atomic<size_t> iSubscribers;
+	std::mutex queue_mutex;
+	std::deque<event> qEvents;
+	uint64_t iNextSeq = 0;
+};
+
+} // namespace xmrstak
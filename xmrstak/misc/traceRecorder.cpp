@@ -0,0 +1,343 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "traceRecorder.hpp"
+#include "xmrstak/misc/statsStream.hpp"
+
+#include "xmrstak/misc/console.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+namespace xmrstak
+{
+
+/** one event, guarded by a sequence lock so that get_json() can read while the owner writes */
+struct trace_event
+{
+	//! 2 * index + 1 while the event at index is written, 2 * index + 2 when it is complete
+	std::atomic<uint64_t> seq;
+	char phase;
+	const char* cat;
+	const char* name;
+	const char* arg_name;
+	uint64_t ts_us;
+	uint64_t dur_us;
+	uint64_t arg;
+	char job[64];
+};
+
+struct trace_ring
+{
+	trace_event events[traceRecorder::RING_SIZE];
+	//! number of events written, only incremented by the owner
+	std::atomic<uint64_t> head;
+	uint32_t id;
+	//! guarded by traceRecorder::rings_mutex
+	std::string name;
+	//! the events before this index are from the previous owner of the ring
+	std::atomic<uint64_t> iOwnerSinceIdx;
+	//! the owner has exited, the ring can be taken by a new thread
+	std::atomic<bool> bFree;
+	//! time the owner exited
+	std::atomic<uint64_t> iFreeSinceUs;
+
+	trace_ring(uint32_t id) : head(0), id(id), iOwnerSinceIdx(0), bFree(false), iFreeSinceUs(0)
+	{
+		for(trace_event& e : events)
+			e.seq.store(0, std::memory_order_relaxed);
+	}
+};
+
+namespace
+{
+/** ring and name of the calling thread
+ *
+ * Backends loaded as a library have their own instance but share the recorder.
+ */
+struct thread_trace
+{
+	trace_ring* ring = nullptr;
+	std::string name;
+
+	~thread_trace()
+	{
+		if(ring != nullptr)
+		{
+			ring->iFreeSinceUs.store(traceRecorder::now_us(), std::memory_order_relaxed);
+			ring->bFree.store(true, std::memory_order_release);
+		}
+		ring = nullptr;
+	}
+};
+
+thread_local thread_trace tls_trace;
+}
+
+uint64_t traceRecorder::now_us()
+{
+	using namespace std::chrono;
+	return time_point_cast<microseconds>(steady_clock::now()).time_since_epoch().count();
+}
+
+void traceRecorder::start()
+{
+	iStartUs = now_us();
+	bEnabled = true;
+}
+
+void traceRecorder::stop()
+{
+	bEnabled = false;
+}
+
+void traceRecorder::set_thread_name(const std::string& name)
+{
+	tls_trace.name = name;
+	if(tls_trace.ring != nullptr)
+	{
+		std::unique_lock<std::mutex> lck(rings_mutex);
+		tls_trace.ring->name = name;
+	}
+}
+
+trace_ring* traceRecorder::thread_ring()
+{
+	if(tls_trace.ring != nullptr)
+		return tls_trace.ring;
+
+	// the rings of exited threads are kept for the trace, e.g. a pool thread which
+	// was disconnected, until MAX_FREE_RINGS are unused
+	std::unique_lock<std::mutex> lck(rings_mutex);
+	trace_ring* ring = nullptr;
+	size_t free_rings = 0;
+	for(trace_ring* r : vRings)
+	{
+		if(!r->bFree.load(std::memory_order_acquire))
+			continue;
+
+		free_rings++;
+		if(ring == nullptr || r->iFreeSinceUs.load(std::memory_order_relaxed) < ring->iFreeSinceUs.load(std::memory_order_relaxed))
+			ring = r;
+	}
+
+	if(free_rings < MAX_FREE_RINGS)
+	{
+		ring = new trace_ring(vRings.size() + 1);
+		vRings.push_back(ring);
+	}
+
+	ring->bFree = false;
+	ring->iOwnerSinceIdx = ring->head.load(std::memory_order_relaxed);
+	ring->name = tls_trace.name.empty() ? "thread " + std::to_string(ring->id) : tls_trace.name;
+	tls_trace.ring = ring;
+	return ring;
+}
+
+void traceRecorder::record(char phase, const char* cat, const char* name, uint64_t ts_us, uint64_t dur_us,
+	const char* job, const char* arg_name, uint64_t arg)
+{
+	trace_ring* ring = thread_ring();
+	uint64_t idx = ring->head.load(std::memory_order_relaxed);
+	trace_event& e = ring->events[idx % RING_SIZE];
+
+	e.seq.store(2 * idx + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	e.phase = phase;
+	e.cat = cat;
+	e.name = name;
+	e.arg_name = arg_name;
+	e.ts_us = ts_us;
+	e.dur_us = dur_us;
+	e.arg = arg;
+	if(job != nullptr)
+	{
+		strncpy(e.job, job, sizeof(e.job) - 1);
+		e.job[sizeof(e.job) - 1] = '\0';
+	}
+	else
+		e.job[0] = '\0';
+
+	e.seq.store(2 * idx + 2, std::memory_order_release);
+	ring->head.store(idx + 1, std::memory_order_release);
+}
+
+size_t traceRecorder::get_json(std::string& out)
+{
+	std::vector<std::pair<trace_ring*, std::string>> rings;
+	{
+		std::unique_lock<std::mutex> lck(rings_mutex);
+		for(trace_ring* r : vRings)
+			rings.emplace_back(r, r->name);
+	}
+
+	uint64_t start_us = iStartUs.load();
+	size_t count = 0;
+	char buf[256];
+
+	out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out.append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"xmr-stak\"}}");
+
+	for(auto& r : rings)
+	{
+		trace_ring* ring = r.first;
+		out.append(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":").append(std::to_string(ring->id));
+		out.append(",\"args\":{\"name\":\"");
+		statsStream::json_escape(r.second, out);
+		out.append("\"}}");
+
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+		uint64_t owner_idx = ring->iOwnerSinceIdx.load(std::memory_order_acquire);
+		if(first < owner_idx)
+			first = owner_idx;
+		for(uint64_t idx = first; idx < head; idx++)
+		{
+			const trace_event& e = ring->events[idx % RING_SIZE];
+			uint64_t seq = e.seq.load(std::memory_order_acquire);
+			if(seq != 2 * idx + 2)
+				continue;
+
+			char phase = e.phase;
+			const char* cat = e.cat;
+			const char* name = e.name;
+			const char* arg_name = e.arg_name;
+			uint64_t ts_us = e.ts_us;
+			uint64_t dur_us = e.dur_us;
+			uint64_t arg = e.arg;
+			char job[sizeof(e.job)];
+			memcpy(job, e.job, sizeof(job));
+			job[sizeof(job) - 1] = '\0';
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(e.seq.load(std::memory_order_relaxed) != seq)
+				continue;
+
+			// a stall which began before the start is still shown
+			if(ts_us + dur_us < start_us)
+				continue;
+
+			snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,",
+				name, cat, phase, (unsigned long long)ts_us);
+			out.append(buf);
+			if(phase == 'X')
+				snprintf(buf, sizeof(buf), "\"dur\":%llu,", (unsigned long long)dur_us);
+			else
+				snprintf(buf, sizeof(buf), "\"s\":\"t\",");
+			out.append(buf);
+			out.append("\"pid\":1,\"tid\":").append(std::to_string(ring->id)).append(",\"args\":{");
+
+			bool have_arg = false;
+			if(job[0] != '\0')
+			{
+				out.append("\"job\":\"");
+				statsStream::json_escape(job, out);
+				out.append(1, '"');
+				have_arg = true;
+			}
+			if(arg_name != nullptr)
+			{
+				if(have_arg)
+					out.append(1, ',');
+				out.append(1, '"').append(arg_name).append("\":").append(std::to_string(arg));
+			}
+			out.append("}}");
+			count++;
+		}
+	}
+
+	out.append("\n]}\n");
+	return count;
+}
+
+bool traceRecorder::write(const char* file, size_t& events, std::string& err)
+{
+	std::string json;
+	events = get_json(json);
+
+	// a reader never sees a partly written trace
+	std::unique_lock<std::mutex> lck(write_mutex);
+	std::string tmp = std::string(file) + ".tmp";
+	FILE* f = fopen(tmp.c_str(), "wb");
+	if(f == nullptr)
+	{
+		err = "cannot open " + tmp + ": " + strerror(errno);
+		return false;
+	}
+
+	bool ok = fwrite(json.data(), 1, json.size(), f) == json.size();
+	ok = fclose(f) == 0 && ok;
+	if(ok && rename(tmp.c_str(), file) != 0)
+	{
+		err = std::string("cannot replace ") + file + ": " + strerror(errno);
+		remove(tmp.c_str());
+		return false;
+	}
+	if(!ok)
+	{
+		err = "cannot write " + tmp;
+		remove(tmp.c_str());
+	}
+	return ok;
+}
+
+void traceRecorder::auto_write(const std::string& file)
+{
+	sAutoFile = file;
+	std::atexit(&traceRecorder::write_at_exit);
+
+	std::thread([this]() {
+		while(true)
+		{
+			std::this_thread::sleep_for(std::chrono::seconds(AUTO_WRITE_SEC));
+			if(!is_enabled())
+				continue;
+			size_t events;
+			std::string err;
+			if(!write(sAutoFile.c_str(), events, err))
+				printer::inst()->print_msg(L1, "Trace not written: %s", err.c_str());
+		}
+	}).detach();
+}
+
+void traceRecorder::write_at_exit()
+{
+	traceRecorder& trace = inst();
+	if(!trace.is_enabled())
+		return;
+
+	trace.stop();
+	size_t events;
+	std::string err;
+	if(trace.write(trace.sAutoFile.c_str(), events, err))
+		printer::inst()->print_msg(L0, "Trace with %llu events written to %s.", (unsigned long long)events, trace.sAutoFile.c_str());
+	else
+		printer::inst()->print_msg(L0, "Trace not written: %s", err.c_str());
+}
+
+} // namespace xmrstak
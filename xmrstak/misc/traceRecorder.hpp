@@ -0,0 +1,114 @@
+#pragma once
+
+#include "xmrstak/misc/environment.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xmrstak
+{
+
+struct trace_ring;
+
+/** recorder of the job switches, the share lifecycle and the thread stalls
+ *
+ * Every thread writes its events into its own ring buffer of RING_SIZE events,
+ * the oldest events are overwritten. While the recorder is stopped an event
+ * costs one relaxed load. get_json() renders the events of all threads in the
+ * Chrome Trace Event format which can be opened in ui.perfetto.dev or
+ * chrome://tracing.
+ *
+ * The names, categories and argument names must be string literals.
+ */
+class traceRecorder
+{
+public:
+	static inline traceRecorder& inst()
+	{
+		auto& env = environment::inst();
+		if(env.pTraceRecorder == nullptr)
+			env.pTraceRecorder = new traceRecorder;
+		return *env.pTraceRecorder;
+	}
+
+	static constexpr size_t RING_SIZE = 2048;
+	//! rings of exited threads which are kept before a new thread takes one
+	static constexpr size_t MAX_FREE_RINGS = 16;
+	//! period of auto_write()
+	static constexpr uint32_t AUTO_WRITE_SEC = 30;
+
+	inline bool is_enabled() const { return bEnabled.load(std::memory_order_relaxed); }
+
+	/** start recording, the events of an earlier recording are discarded */
+	void start();
+	void stop();
+
+	//! steady clock in microseconds, the time base of the events
+	static uint64_t now_us();
+
+	/** event with a duration
+	 *
+	 * @param job job id shown as argument, nullptr if the event has no job
+	 * @param arg_name name of the numeric argument, nullptr if there is none
+	 */
+	inline void complete(const char* cat, const char* name, uint64_t start_us, uint64_t end_us,
+		const char* job = nullptr, const char* arg_name = nullptr, uint64_t arg = 0)
+	{
+		if(is_enabled())
+			record('X', cat, name, start_us, end_us - start_us, job, arg_name, arg);
+	}
+
+	/** event without a duration at the current time */
+	inline void instant(const char* cat, const char* name, const char* job = nullptr,
+		const char* arg_name = nullptr, uint64_t arg = 0)
+	{
+		if(is_enabled())
+			record('i', cat, name, now_us(), 0, job, arg_name, arg);
+	}
+
+	/** name of the calling thread in the trace, e.g. "cpu 0" */
+	void set_thread_name(const std::string& name);
+
+	/** trace of all threads in the Chrome Trace Event JSON format
+	 *
+	 * Can be called while recording, events which are overwritten during the
+	 * call are skipped.
+	 *
+	 * @return number of events
+	 */
+	size_t get_json(std::string& out);
+
+	/** write get_json() to a file, the file is replaced at once */
+	bool write(const char* file, size_t& events, std::string& err);
+
+	/** write the trace to file every AUTO_WRITE_SEC seconds and when the miner exits
+	 *
+	 * Only while recording. For --trace, a daemon may never see the key or the
+	 * HTTP request which writes the trace.
+	 */
+	void auto_write(const std::string& file);
+
+private:
+	traceRecorder() : bEnabled(false), iStartUs(0) {}
+
+	static void write_at_exit();
+
+	trace_ring* thread_ring();
+	void record(char phase, const char* cat, const char* name, uint64_t ts_us, uint64_t dur_us,
+		const char* job, const char* arg_name, uint64_t arg);
+
+	std::atomic<bool> bEnabled;
+	//! events before this time belong to an earlier recording
+	std::atomic<uint64_t> iStartUs;
+
+	std::mutex rings_mutex;
+	std::vector<trace_ring*> vRings;
+
+	std::mutex write_mutex;
+	std::string sAutoFile;
+};
+
+} // namespace xmrstak
@@ -29,10 +29,12 @@
 #include "jpsock.hpp"
 #include "socks.hpp"
 #include "socket.hpp"
+#include "sessionLog.hpp"
 
 #include "xmrstak/misc/executor.hpp"
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/jext.hpp"
+#include "xmrstak/misc/traceRecorder.hpp"
 #include "xmrstak/version.hpp"
 
 using namespace rapidjson;
@@ -107,12 +109,17 @@ jpsock::jpsock(size_t id, const char* sAddr, const char* sLogin, const char* sRi
 	prv = new opaque_private(bJsonCallMem, bJsonRecvMem, bJsonParseMem);
 
 #ifndef CONF_NO_TLS
-	if(tls)
+	if(sessionLog::inst()->is_replaying())
+		sck = new replay_socket(this);
+	else if(tls)
 		sck = new tls_socket(this);
 	else
 		sck = new plain_socket(this);
 #else
-	sck = new plain_socket(this);
+	if(sessionLog::inst()->is_replaying())
+		sck = new replay_socket(this);
+	else
+		sck = new plain_socket(this);
 #endif
 
 	oRecvThd = nullptr;
@@ -191,11 +198,14 @@ bool jpsock::set_socket_error_strerr(const char* a, int res)
 
 void jpsock::jpsock_thread()
 {
+	xmrstak::traceRecorder::inst().set_thread_name(std::string("pool ") + get_pool_addr());
 	jpsock_thd_main();
 
 	if(!bHaveSocketError)
 		set_socket_error("Socket closed.");
 
+	sessionLog::inst()->record(sessionLog::REC_CLOSE, pool_id, sSocketError);
+
 	executor::inst()->push_event(ex_event(std::move(sSocketError), quiet_close, pool_id));
 
 	std::unique_lock<std::mutex> mlock(call_mutex);
@@ -238,6 +248,7 @@ void jpsock::jpsock_thread()
 
 bool jpsock::jpsock_thd_main()
 {
+	sessionLog::inst()->record(sessionLog::REC_CONNECT, pool_id, net_addr);
 	if(!sck->connect())
 		return false;
 
@@ -290,6 +301,8 @@ bool jpsock::process_line(char* line, size_t len)
 	prv->callAllocator.Clear();
 	++iMessageCnt;
 
+	sessionLog::inst()->record(sessionLog::REC_RECV, pool_id, line, len-1);
+
 	/*NULL terminate the line instead of '\n', parsing will add some more NULLs*/
 	line[len-1] = '\0';
 
@@ -388,6 +401,7 @@ bool jpsock::process_line(char* line, size_t len)
 
 bool jpsock::process_pool_job(const opq_json_val* params, const uint64_t messageId)
 {
+	uint64_t iRecvTimeUs = get_timestamp_us();
 	std::unique_lock<std::mutex> mlock(job_mutex);
 	if(messageId < iLastMessageId)
 	{
@@ -481,10 +495,14 @@ bool jpsock::process_pool_job(const opq_json_val* params, const uint64_t message
 		return set_socket_error("PARSE error: Job error 5");
 
 	iJobDiff = t64_to_diff(oPoolJob.iTarget);
+	oPoolJob.iRecvTimeUs = iRecvTimeUs;
 
 	std::unique_lock<std::mutex> lck(job_mutex);
 	oCurrentJob = oPoolJob;
 	lck.unlock();
+
+	xmrstak::traceRecorder::inst().complete("pool", "job parse", iRecvTimeUs, get_timestamp_us(), oPoolJob.sJobID,
+		"difficulty", iJobDiff);
 	// send event after current job data are updated
 	executor::inst()->push_event(ex_event(oPoolJob, pool_id));
 
@@ -516,6 +534,7 @@ bool jpsock::connect(std::string& sConnectError)
 
 void jpsock::disconnect(bool quiet)
 {
+	sessionLog::inst()->record(sessionLog::REC_CLOSE_LOCAL, pool_id, nullptr, 0);
 	quiet_close = quiet;
 	sck->close(false);
 
@@ -530,7 +549,7 @@ void jpsock::disconnect(bool quiet)
 	quiet_close = false;
 }
 
-bool jpsock::cmd_ret_wait(const char* sPacket, opq_json_val& poResult, uint64_t& messageId)
+bool jpsock::cmd_ret_wait(const char* sPacket, opq_json_val& poResult, uint64_t& messageId, const char* sRecord)
 {
 	//printf("SEND: %s\n", sPacket);
 
@@ -542,6 +561,12 @@ bool jpsock::cmd_ret_wait(const char* sPacket, opq_json_val& poResult, uint64_t&
 	prv->oCallRsp = call_rsp(&prv->oCallValue);
 	mlock.unlock();
 
+	if(sessionLog::inst()->is_recording())
+	{
+		const char* rec = sRecord != nullptr ? sRecord : sPacket;
+		sessionLog::inst()->record(sessionLog::REC_SEND, pool_id, rec, strlen(rec) - 1);
+	}
+
 	if(!sck->send(sPacket))
 	{
 		disconnect(); //This will join the other thread;
@@ -584,11 +609,18 @@ bool jpsock::cmd_login()
 	snprintf(cmd_buffer, sizeof(cmd_buffer), "{\"method\":\"login\",\"params\":{\"login\":\"%s\",\"pass\":\"%s\",\"rigid\":\"%s\",\"agent\":\"%s\"},\"id\":1}\n",
 		usr_login.c_str(), usr_pass.c_str(), usr_rigid.c_str(), get_version_str().c_str());
 
+	// the session log is shared with bug reports, it gets neither the password nor the rig id
+	char rec_buffer[1024];
+	rec_buffer[0] = '\0';
+	if(sessionLog::inst()->is_recording())
+		snprintf(rec_buffer, sizeof(rec_buffer), "{\"method\":\"login\",\"params\":{\"login\":\"%s\",\"pass\":\"<redacted>\",\"rigid\":\"<redacted>\",\"agent\":\"%s\"},\"id\":1}\n",
+			usr_login.c_str(), get_version_str().c_str());
+
 	opq_json_val oResult(nullptr);
 	uint64_t messageId = 0;
 
 	/*Normal error conditions (failed login etc..) will end here*/
-	if (!cmd_ret_wait(cmd_buffer, oResult, messageId))
+	if (!cmd_ret_wait(cmd_buffer, oResult, messageId, rec_buffer[0] != '\0' ? rec_buffer : nullptr))
 		return false;
 
 	if (!oResult.val->IsObject())
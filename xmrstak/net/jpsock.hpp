@@ -125,7 +125,8 @@ private:
 	bool jpsock_thd_main();
 	bool process_line(char* line, size_t len);
 	bool process_pool_job(const opq_json_val* params, const uint64_t messageId);
-	bool cmd_ret_wait(const char* sPacket, opq_json_val& poResult, uint64_t& messageId);
+	/** @param sRecord packet written to the session log instead of sPacket, e.g. without the password */
+	bool cmd_ret_wait(const char* sPacket, opq_json_val& poResult, uint64_t& messageId, const char* sRecord = nullptr);
 
 	char sMinerId[64];
 	std::atomic<uint64_t> iJobDiff;
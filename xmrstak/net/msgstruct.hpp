@@ -16,10 +16,12 @@ struct pool_job
 	uint64_t	iTarget;
 	uint32_t	iWorkLen;
 	uint32_t	iSavedNonce;
+	// get_timestamp_us() when the job message was received, 0 if unknown
+	uint64_t	iRecvTimeUs;
 
-	pool_job() : iWorkLen(0), iSavedNonce(0) {}
+	pool_job() : iWorkLen(0), iSavedNonce(0), iRecvTimeUs(0) {}
 	pool_job(const char* sJobID, uint64_t iTarget, const uint8_t* bWorkBlob, uint32_t iWorkLen) :
-		iTarget(iTarget), iWorkLen(iWorkLen), iSavedNonce(0)
+		iTarget(iTarget), iWorkLen(iWorkLen), iSavedNonce(0), iRecvTimeUs(0)
 	{
 		assert(iWorkLen <= sizeof(pool_job::bWorkBlob));
 		memcpy(this->sJobID, sJobID, sizeof(pool_job::sJobID));
@@ -192,3 +194,10 @@ inline size_t get_timestamp_ms()
 	else
 		return time_point_cast<milliseconds>(steady_clock::now()).time_since_epoch().count();
 }
+
+//Get microsecond timestamp
+inline uint64_t get_timestamp_us()
+{
+	using namespace std::chrono;
+	return time_point_cast<microseconds>(steady_clock::now()).time_since_epoch().count();
+}
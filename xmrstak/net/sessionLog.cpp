@@ -0,0 +1,255 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "sessionLog.hpp"
+#include "xmrstak/misc/jext.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <errno.h>
+
+sessionLog* sessionLog::oInst = nullptr;
+
+namespace
+{
+
+const char sMagic[8] = { 'X', 'S', 'S', 'L', 'O', 'G', '1', '\n' };
+constexpr size_t iHeaderSize = 16;
+
+inline uint64_t now_us()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+const char* sessionLog::type_name(uint8_t type)
+{
+	switch(type)
+	{
+	case REC_CONNECT:
+		return "connect";
+	case REC_SEND:
+		return "send";
+	case REC_RECV:
+		return "recv";
+	case REC_CLOSE_LOCAL:
+		return "close_local";
+	case REC_CLOSE:
+		return "close";
+	case REC_JOB:
+		return "job";
+	case REC_RESULT:
+		return "result";
+	default:
+		return "unknown";
+	}
+}
+
+std::string sessionLog::call_method(const char* line)
+{
+	Document doc;
+	if(doc.Parse(line).HasParseError() || !doc.IsObject())
+		return std::string();
+
+	const Value* method = GetObjectMember(doc, "method");
+	if(method == nullptr || !method->IsString())
+		return std::string();
+	return std::string(method->GetString(), method->GetStringLength());
+}
+
+bool sessionLog::open(const char* sFilename, std::string& err)
+{
+	std::unique_lock<std::mutex> lck(log_mutex);
+	fLog = fopen(sFilename, "wb");
+	if(fLog == nullptr)
+	{
+		err = std::string("Cannot open session log '") + sFilename + "': " + strerror(errno);
+		return false;
+	}
+
+	fwrite(sMagic, 1, sizeof(sMagic), fLog);
+	fflush(fLog);
+	iStartUs = now_us();
+	return true;
+}
+
+void sessionLog::record(rec_type type, size_t pool_id, const char* data, size_t len)
+{
+	if(fLog == nullptr)
+		return;
+
+	uint8_t hdr[iHeaderSize] = { 0 };
+	uint32_t len32 = uint32_t(len);
+	uint16_t id16 = uint16_t(pool_id);
+
+	std::unique_lock<std::mutex> lck(log_mutex);
+	uint64_t t = now_us() - iStartUs;
+	memcpy(hdr, &t, 8);
+	memcpy(hdr + 8, &len32, 4);
+	memcpy(hdr + 12, &id16, 2);
+	hdr[14] = type;
+
+	fwrite(hdr, 1, sizeof(hdr), fLog);
+	fwrite(data, 1, len, fLog);
+	fflush(fLog);
+}
+
+bool sessionLog::read(const char* sFilename, std::vector<entry>& out, std::string& err)
+{
+	FILE* f = fopen(sFilename, "rb");
+	if(f == nullptr)
+	{
+		err = std::string("Cannot open session log '") + sFilename + "': " + strerror(errno);
+		return false;
+	}
+
+	char magic[sizeof(sMagic)];
+	if(fread(magic, 1, sizeof(magic), f) != sizeof(magic) || memcmp(magic, sMagic, sizeof(sMagic)) != 0)
+	{
+		fclose(f);
+		err = std::string("'") + sFilename + "' is not a session log.";
+		return false;
+	}
+
+	uint8_t hdr[iHeaderSize];
+	while(fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr))
+	{
+		entry r;
+		uint32_t len;
+		memcpy(&r.time_us, hdr, 8);
+		memcpy(&len, hdr + 8, 4);
+		memcpy(&r.pool_id, hdr + 12, 2);
+		r.type = hdr[14];
+
+		r.data.resize(len);
+		// a record cut off by a killed miner ends the log
+		if(len != 0 && fread(&r.data[0], 1, len, f) != len)
+			break;
+		out.push_back(std::move(r));
+	}
+
+	fclose(f);
+	return true;
+}
+
+bool sessionLog::load_replay(const char* sFilename, double speed, std::string& err)
+{
+	std::vector<entry> recs;
+	if(!read(sFilename, recs, err))
+		return false;
+
+	struct open_session
+	{
+		session s;
+		uint64_t connect_us;
+		//! method of the last call, the calls of jpsock are synchronous
+		std::string last_call;
+		bool local_close;
+		bool have_data;
+	};
+	std::map<uint16_t, open_session> open;
+
+	auto finish = [this](open_session& o) {
+		mSessions[o.s.addr].push_back(std::move(o.s));
+	};
+
+	for(const entry& r : recs)
+	{
+		if(r.type == REC_CONNECT)
+		{
+			auto it = open.find(r.pool_id);
+			if(it != open.end())
+			{
+				finish(it->second);
+				open.erase(it);
+			}
+
+			open_session& o = open[r.pool_id];
+			o.s.addr = r.data;
+			o.connect_us = r.time_us;
+			o.last_call.clear();
+			o.local_close = false;
+			o.have_data = false;
+			continue;
+		}
+
+		auto it = open.find(r.pool_id);
+		if(it == open.end())
+			continue;
+		open_session& o = it->second;
+
+		switch(r.type)
+		{
+		case REC_SEND:
+			o.have_data = true;
+			o.last_call = call_method(r.data.c_str());
+			break;
+		case REC_RECV:
+		{
+			o.have_data = true;
+			Document doc;
+			if(doc.Parse(r.data.c_str()).HasParseError() || !doc.IsObject())
+				break;
+			if(doc.HasMember("method"))
+				o.s.jobs.emplace_back(r.time_us - o.connect_us, r.data);
+			else if(!o.last_call.empty())
+				o.s.call_rsp[o.last_call].push_back(r.data);
+			break;
+		}
+		case REC_CLOSE_LOCAL:
+			o.local_close = true;
+			break;
+		case REC_CLOSE:
+			o.s.close_us = r.time_us - o.connect_us;
+			o.s.close_error = r.data;
+			o.s.connect_failed = !o.have_data && r.data.compare(0, 13, "CONNECT error") == 0;
+			o.s.remote_close = !o.local_close;
+			finish(o);
+			open.erase(it);
+			break;
+		default:
+			break;
+		}
+	}
+
+	for(auto& o : open)
+		finish(o.second);
+
+	fReplaySpeed = speed;
+	bReplay = true;
+	return true;
+}
+
+bool sessionLog::next_session(const std::string& addr, session& out)
+{
+	std::unique_lock<std::mutex> lck(replay_mutex);
+	auto it = mSessions.find(addr);
+	if(it == mSessions.end() || it->second.empty())
+		return false;
+
+	out = std::move(it->second.front());
+	it->second.pop_front();
+	return true;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** append-only log of the pool sessions for recording and deterministic replay
+ *
+ * The file starts with the 8 byte magic `XSSLOG1\n` followed by records:
+ *   uint64_t time in microseconds since the log was opened (steady clock)
+ *   uint32_t length of the data
+ *   uint16_t pool id
+ *   uint8_t  record type
+ *   uint8_t  reserved, 0
+ *   data
+ * All integers are little endian. Every record is flushed when it is written,
+ * a log of a killed miner is complete up to the last record.
+ */
+class sessionLog
+{
+public:
+	static sessionLog* inst()
+	{
+		if (oInst == nullptr) oInst = new sessionLog;
+		return oInst;
+	};
+
+	enum rec_type : uint8_t
+	{
+		//! jpsock starts a connection, data is the pool address
+		REC_CONNECT = 1,
+		//! line sent to the pool without the new line
+		REC_SEND = 2,
+		//! line received from the pool without the new line
+		REC_RECV = 3,
+		//! the miner closes the connection
+		REC_CLOSE_LOCAL = 4,
+		//! the connection is closed, data is the socket error
+		REC_CLOSE = 5,
+		//! the executor switched the miners to a job, data is "job_id difficulty"
+		REC_JOB = 6,
+		//! the executor got a result, data is "job_id nonce thread"
+		REC_RESULT = 7
+	};
+
+	struct entry
+	{
+		uint64_t time_us;
+		uint16_t pool_id;
+		uint8_t type;
+		std::string data;
+	};
+
+	/** recorded connection to a pool prepared for the replay */
+	struct session
+	{
+		std::string addr;
+		//! the connect failed with close_error
+		bool connect_failed = false;
+		//! the pool closed the connection at close_us after the connect
+		bool remote_close = false;
+		uint64_t close_us = 0;
+		std::string close_error;
+		//! job notifications and their time after the connect
+		std::vector<std::pair<uint64_t, std::string>> jobs;
+		//! call responses by the method of the call in the order they were received
+		std::map<std::string, std::deque<std::string>> call_rsp;
+	};
+
+	static const char* type_name(uint8_t type);
+
+	/** method of a call sent to the pool, empty if the line has none */
+	static std::string call_method(const char* line);
+
+	/** start recording, the file is truncated */
+	bool open(const char* sFilename, std::string& err);
+
+	inline bool is_recording() const { return fLog != nullptr; }
+
+	void record(rec_type type, size_t pool_id, const char* data, size_t len);
+
+	inline void record(rec_type type, size_t pool_id, const std::string& data)
+	{
+		record(type, pool_id, data.data(), data.size());
+	}
+
+	/** read all records of a log file */
+	static bool read(const char* sFilename, std::vector<entry>& out, std::string& err);
+
+	/** load a log for the replay
+	 *
+	 * @param speed replay speed, 2.0 sends the jobs twice as fast as recorded
+	 *
+	 * The executor still evaluates the pools at its own pace, with a high speed
+	 * jobs which arrive before a pool is selected are skipped as on a live pool.
+	 */
+	bool load_replay(const char* sFilename, double speed, std::string& err);
+
+	inline bool is_replaying() const { return bReplay; }
+	inline double get_replay_speed() const { return fReplaySpeed; }
+
+	/** take the next recorded session of a pool address
+	 *
+	 * @return false if all sessions of the address are used
+	 */
+	bool next_session(const std::string& addr, session& out);
+
+private:
+	sessionLog() {}
+
+	static sessionLog* oInst;
+
+	std::mutex log_mutex;
+	FILE* fLog = nullptr;
+	uint64_t iStartUs = 0;
+
+	bool bReplay = false;
+	double fReplaySpeed = 1.0;
+	std::mutex replay_mutex;
+	std::map<std::string, std::deque<session>> mSessions;
+};
@@ -27,6 +27,9 @@
 #include "xmrstak/misc/console.hpp"
 #include "xmrstak/misc/executor.hpp"
 
+#include <algorithm>
+#include <chrono>
+
 #ifndef CONF_NO_TLS
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -183,6 +186,132 @@ void plain_socket::close(bool free)
 	}
 }
 
+namespace
+{
+
+inline uint64_t replay_now_us()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+replay_socket::replay_socket(jpsock* err_callback) : pCallback(err_callback), iNextJob(0), iConnectUs(0), bLoginDone(false)
+{
+	sock_closed = true;
+}
+
+bool replay_socket::set_hostname(const char* sAddr)
+{
+	if(!sessionLog::inst()->next_session(sAddr, oSession))
+		return pCallback->set_socket_error("CONNECT error: No recorded session of this pool left to replay.");
+	return true;
+}
+
+bool replay_socket::connect()
+{
+	std::unique_lock<std::mutex> lck(mtx);
+	if(oSession.connect_failed)
+		return pCallback->set_socket_error(oSession.close_error.c_str());
+
+	sock_closed = false;
+	iConnectUs = replay_now_us();
+	iNextJob = 0;
+	bLoginDone = false;
+	sPending.clear();
+	return true;
+}
+
+uint64_t replay_socket::due_us(uint64_t offset_us) const
+{
+	return iConnectUs + uint64_t(offset_us / sessionLog::inst()->get_replay_speed());
+}
+
+int replay_socket::recv(char* buf, unsigned int len)
+{
+	std::unique_lock<std::mutex> lck(mtx);
+	while(true)
+	{
+		if(sock_closed)
+			return 0;
+
+		if(!sPending.empty())
+		{
+			size_t n = std::min<size_t>(len, sPending.size());
+			memcpy(buf, sPending.data(), n);
+			sPending.erase(0, n);
+			return int(n);
+		}
+
+		uint64_t now = replay_now_us();
+		// 0 waits for a call or the close
+		uint64_t next = 0;
+		if(iNextJob < oSession.jobs.size())
+		{
+			// the jobs follow the login response as on the recorded connection
+			if(bLoginDone)
+			{
+				next = due_us(oSession.jobs[iNextJob].first);
+				if(next <= now)
+				{
+					sPending.append(oSession.jobs[iNextJob].second).append("\n");
+					iNextJob++;
+					continue;
+				}
+			}
+		}
+		else if(oSession.remote_close)
+		{
+			next = due_us(oSession.close_us);
+			if(next <= now)
+			{
+				pCallback->set_socket_error(oSession.close_error.c_str());
+				return -1;
+			}
+		}
+
+		if(next == 0)
+			cv.wait(lck);
+		else
+			cv.wait_for(lck, std::chrono::microseconds(next - now));
+	}
+}
+
+bool replay_socket::send(const char* buf)
+{
+	std::unique_lock<std::mutex> lck(mtx);
+	if(sock_closed)
+		return pCallback->set_socket_error("SEND error: socket closed");
+
+	const std::string method = sessionLog::call_method(buf);
+	std::deque<std::string>* rsp = &oSession.call_rsp[method];
+	if(method == "login")
+	{
+		if(rsp->empty())
+			return pCallback->set_socket_error("SEND error: No recorded login response left to replay.");
+		bLoginDone = true;
+	}
+
+	if(rsp->empty())
+		sPending.append("{\"id\":1,\"jsonrpc\":\"2.0\",\"error\":null,\"result\":{\"status\":\"OK\"}}\n");
+	else
+	{
+		sPending.append(rsp->front()).append("\n");
+		rsp->pop_front();
+	}
+
+	cv.notify_all();
+	return true;
+}
+
+void replay_socket::close(bool free)
+{
+	std::unique_lock<std::mutex> lck(mtx);
+	sock_closed = true;
+	cv.notify_all();
+}
+
 #ifndef CONF_NO_TLS
 tls_socket::tls_socket(jpsock* err_callback) : pCallback(err_callback)
 {
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
 #include "socks.hpp"
+#include "sessionLog.hpp"
 
 class jpsock;
 
@@ -36,6 +40,38 @@ private:
 	SOCKET hSocket;
 };
 
+/** socket replaying a recorded session of a pool, see sessionLog
+ *
+ * The job notifications are received at their recorded time after the connect,
+ * scaled by the replay speed. Calls are answered with the next recorded response
+ * of the same method, calls other than the login without a recorded response are accepted.
+ */
+class replay_socket : public base_socket
+{
+public:
+	replay_socket(jpsock* err_callback);
+
+	bool set_hostname(const char* sAddr);
+	bool connect();
+	int recv(char* buf, unsigned int len);
+	bool send(const char* buf);
+	void close(bool free);
+
+private:
+	//! scaled time of a recorded offset after the connect
+	uint64_t due_us(uint64_t offset_us) const;
+
+	jpsock* pCallback;
+	sessionLog::session oSession;
+	size_t iNextJob;
+	uint64_t iConnectUs;
+	bool bLoginDone;
+	//! received data which is not yet read by jpsock
+	std::string sPending;
+	std::mutex mtx;
+	std::condition_variable cv;
+};
+
 typedef struct ssl_ctx_st SSL_CTX;
 typedef struct bio_st BIO;
 typedef struct ssl_st SSL;
@@ -56,11 +56,40 @@ struct params
 
 	// block_version >= 0 enable benchmark
 	int benchmark_block_version = -1;
+	// benchmark every algorithm of the coin (root and fork algorithm)
+	static constexpr int benchmark_all_versions = 256;
 	int benchmark_wait_sec = 30;
+	// measured seconds per algorithm, split into benchmark_samples samples
 	int benchmark_work_sec = 60;
+	int benchmark_warmup_sec = 10;
+	int benchmark_samples = 5;
+	std::string benchmark_json;
+	std::string benchmark_baseline;
+	// allowed hash rate loss against the baseline in percent
+	double benchmark_threshold = 5.0;
 
 	bool testMode = false;
 
+	// write the pool sessions to a log
+	std::string sessionRecordFile;
+	// replay the pool sessions of a log instead of connecting to the pools
+	std::string sessionReplayFile;
+	// 2.0 replays twice as fast as recorded
+	double sessionReplaySpeed = 1.0;
+
+	// name of the POSIX shared memory segment with the statistics, empty disables it
+	std::string shmStatsName;
+
+	// file of the persistent hash rate history, empty disables it
+	std::string historyFile;
+
+	// record a trace from the start, the key 't' writes it to traceFile
+	bool traceStart = false;
+	std::string traceFile = "xmr-stak-trace.json";
+
+	// delete unused hugetlbfs scratchpad files and exit
+	bool hugepageCleanup = false;
+
 	params() :
 		binaryName("xmr-stak"),
 		executablePrefix(""),
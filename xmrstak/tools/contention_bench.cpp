@@ -0,0 +1,207 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Contention microbenchmark for the state shared between the worker threads.
+ *
+ * Every worker runs the access pattern of the CPU hash loop (poll the job number,
+ * reserve nonces, publish the hash counter) around a short busy loop which stands
+ * in for the hash function. The executor thread reads all counters like the
+ * telemetry does. This is done once with the old packed layout and once with
+ * the cache line separated layout of globalStates / iBackend.
+ *
+ * Usage: xmr-stak-contention [SECONDS] [WORK_ITERATIONS] [THREADS]...
+ */
+
+#include "xmrstak/backend/globalStates.hpp"
+#include "xmrstak/backend/iBackend.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// globalStates and iBackend as they were before the members were separated
+struct packed_state
+{
+	std::atomic<uint64_t> iGlobalJobNo;
+	std::atomic<uint64_t> iConsumeCnt;
+	std::atomic<uint32_t> iGlobalNonce;
+
+	packed_state() : iGlobalJobNo(0), iConsumeCnt(0), iGlobalNonce(0) {}
+};
+
+struct packed_backend
+{
+	std::atomic<uint64_t> iHashCount;
+	std::atomic<uint64_t> iTimestamp;
+	uint32_t iThreadNo;
+
+	packed_backend() : iHashCount(0), iTimestamp(0), iThreadNo(0) {}
+};
+
+struct padded_state
+{
+	alignas(xmrstak::cache_line_size) std::atomic<uint64_t> iGlobalJobNo;
+	alignas(xmrstak::cache_line_size) std::atomic<uint32_t> iGlobalNonce;
+	alignas(xmrstak::cache_line_size) std::atomic<uint64_t> iConsumeCnt;
+
+	padded_state() : iGlobalJobNo(0), iGlobalNonce(0), iConsumeCnt(0) {}
+
+	static void* operator new(std::size_t size) { return _mm_malloc(size, xmrstak::cache_line_size); }
+	static void operator delete(void* ptr) { _mm_free(ptr); }
+};
+
+inline uint64_t now_ms()
+{
+	using namespace std::chrono;
+	return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/** run the hash loop access pattern
+ *
+ * @return hashes per second and thread
+ */
+template<typename STATE, typename BACKEND>
+double run(size_t threads, size_t seconds, size_t work)
+{
+	STATE* state = new STATE;
+	// the packed counters are allocated together like small heap objects usually are
+	std::vector<BACKEND*> backends;
+	std::vector<std::thread> workers;
+	std::atomic<bool> quit(false);
+
+	for(size_t i = 0; i < threads; i++)
+		backends.push_back(new BACKEND);
+
+	for(size_t i = 0; i < threads; i++)
+	{
+		workers.emplace_back([&, i]() {
+			BACKEND* self = backends[i];
+			uint64_t iCount = 0;
+			uint64_t iJobNo = state->iGlobalJobNo.load(std::memory_order_relaxed);
+			int64_t nonce_ctr = 0;
+			volatile uint64_t sink = 0;
+
+			state->iConsumeCnt++;
+			while(!quit.load(std::memory_order_relaxed))
+			{
+				while(state->iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
+				{
+					if((iCount++ & 0x7) == 0)
+					{
+						self->iHashCount.store(iCount, std::memory_order_relaxed);
+						self->iTimestamp.store(now_ms(), std::memory_order_relaxed);
+					}
+
+					if(--nonce_ctr <= 0)
+					{
+						state->iGlobalNonce.fetch_add(4096);
+						nonce_ctr = 4096;
+					}
+
+					uint64_t h = iCount;
+					for(size_t w = 0; w < work; w++)
+						h = h * 6364136223846793005ull + 1442695040888963407ull;
+					sink = h;
+
+					if(quit.load(std::memory_order_relaxed))
+						break;
+				}
+				iJobNo = state->iGlobalJobNo.load(std::memory_order_relaxed);
+				state->iConsumeCnt++;
+			}
+			self->iHashCount.store(iCount, std::memory_order_relaxed);
+			// read once, the result of the dummy work must not be optimized away
+			(void)sink;
+		});
+	}
+
+	// executor: telemetry every 500ms, a new job every second
+	uint64_t start = now_ms();
+	uint64_t iStartCount = 0;
+	for(size_t tick = 0; tick < seconds * 2; tick++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		uint64_t sum = 0;
+		for(BACKEND* b : backends)
+			sum += b->iHashCount.load(std::memory_order_relaxed) + b->iTimestamp.load(std::memory_order_relaxed);
+		if(tick & 1)
+			state->iGlobalJobNo++;
+		if(tick == 0)
+		{
+			start = now_ms();
+			iStartCount = 0;
+			for(BACKEND* b : backends)
+				iStartCount += b->iHashCount.load(std::memory_order_relaxed);
+		}
+	}
+
+	uint64_t iEndCount = 0;
+	for(BACKEND* b : backends)
+		iEndCount += b->iHashCount.load(std::memory_order_relaxed);
+	uint64_t elapsed = now_ms() - start;
+
+	quit = true;
+	for(std::thread& t : workers)
+		t.join();
+	for(BACKEND* b : backends)
+		delete b;
+	delete state;
+
+	return double(iEndCount - iStartCount) * 1000.0 / double(elapsed) / double(threads);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	size_t seconds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 5;
+	size_t work = argc > 2 ? strtoul(argv[2], nullptr, 10) : 64;
+	std::vector<size_t> threads;
+	for(int i = 3; i < argc; i++)
+		threads.push_back(strtoul(argv[i], nullptr, 10));
+	if(threads.empty())
+		threads = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+
+	if(seconds == 0)
+		seconds = 1;
+
+	printf("work iterations per hash: %llu, %llu s per run\n", (unsigned long long)work, (unsigned long long)seconds);
+	printf("| threads | packed H/s/thd | padded H/s/thd | speedup |\n");
+	for(size_t n : threads)
+	{
+		if(n == 0)
+			continue;
+		double packed = run<packed_state, packed_backend>(n, seconds, work);
+		double padded = run<padded_state, xmrstak::iBackend>(n, seconds, work);
+		printf("| %7llu | %14.0f | %14.0f | %6.2fx |\n", (unsigned long long)n, packed, padded, padded / packed);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,197 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Known answer tests and microbenchmark of the batched final hashes.
+ *
+ * Every implementation supported by the CPU is checked against the scalar
+ * BLAKE-256, Groestl-256, JH-256 and Skein-512-256 for 1 to 8 pseudo random
+ * keccak states with mixed and equal hash selections. Afterwards the time
+ * per state of every hash is printed for 1 to 5 states.
+ *
+ * Usage: xmr-stak-finalhash [SECONDS]
+ */
+
+#include "xmrstak/backend/cpu/crypto/extra_hashes_multi.hpp"
+#include "xmrstak/backend/cpu/cpuType.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C"
+{
+	extern void (* const extra_hashes[4])(const void *, uint32_t, char *);
+}
+
+namespace
+{
+
+constexpr size_t MAX_N = 8;
+constexpr size_t STATE_SIZE = 200;
+
+const char* const hash_names[4] = { "BLAKE-256", "Groestl-256", "JH-256", "Skein-512-256" };
+
+inline uint64_t now_ns()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct impl_entry
+{
+	const char* name;
+	bool aes;
+	bool avx2;
+};
+
+struct states
+{
+	uint8_t st[MAX_N][STATE_SIZE];
+	uint8_t* ptr[MAX_N];
+	uint64_t seed;
+
+	states() : seed(0x9e3779b97f4a7c15ull)
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+			ptr[i] = st[i];
+	}
+
+	/** fill the states with pseudo random bytes, hash >= 0 selects the same hash for all states */
+	void fill(int hash)
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+		{
+			for(size_t j = 0; j < STATE_SIZE; j++)
+			{
+				seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+				st[i][j] = static_cast<uint8_t>(seed >> 56);
+			}
+			if(hash >= 0)
+				st[i][0] = static_cast<uint8_t>((st[i][0] & ~3) | hash);
+		}
+	}
+};
+
+bool known_answer_tests()
+{
+	states s;
+	uint8_t out[32 * MAX_N], ref[32 * MAX_N];
+	size_t failed = 0;
+	for(size_t round = 0; round < 250; round++)
+	{
+		for(int hash = -1; hash < 4; hash++)
+		{
+			for(size_t n = 1; n <= MAX_N; n++)
+			{
+				s.fill(hash);
+				for(size_t i = 0; i < n; i++)
+					extra_hashes[s.st[i][0] & 3](s.st[i], STATE_SIZE, reinterpret_cast<char*>(ref) + 32 * i);
+				extra_hashes_multi(s.ptr, n, out);
+				failed += memcmp(out, ref, 32 * n) != 0;
+			}
+		}
+	}
+
+	if(failed != 0)
+		printf("  %llu known answer tests FAILED\n", (unsigned long long)failed);
+	return failed == 0;
+}
+
+/** @return nanoseconds per state */
+double measure(int hash, size_t n, double seconds)
+{
+	states s;
+	s.fill(hash);
+	uint8_t out[32 * MAX_N];
+
+	uint64_t start = now_ns();
+	uint64_t end = start + uint64_t(seconds * 1e9);
+	uint64_t calls = 0;
+	uint64_t t;
+	do
+	{
+		for(size_t r = 0; r < 16; r++)
+		{
+			s.st[0][1] = static_cast<uint8_t>(r);
+			extra_hashes_multi(s.ptr, n, out);
+		}
+		calls += 16;
+	}
+	while((t = now_ns()) < end);
+
+	return double(t - start) / double(calls * n);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 0.2;
+	if(seconds <= 0.0)
+		seconds = 0.2;
+
+	xmrstak::cpu::Model model = xmrstak::cpu::getModel();
+	const impl_entry impls[] = {
+		{ "sse2", false, false },
+		{ "sse2 aes", true, false },
+		{ "avx2", false, true },
+		{ "avx2 aes", true, true }
+	};
+
+	bool ok = true;
+	printf("| implementation                 | hash          | N=1 ns/state | N=2 ns/state | N=3 ns/state | N=4 ns/state | N=5 ns/state |\n");
+	for(size_t k = 0; k < sizeof(impls) / sizeof(impls[0]) + 1; k++)
+	{
+		// the first run measures the scalar hashes, no implementation is selected yet
+		const char* name = "scalar";
+		if(k > 0)
+		{
+			const impl_entry& e = impls[k - 1];
+			if((e.aes && !(model.aes && model.ssse3)) || (e.avx2 && !model.avx2))
+			{
+				printf("| %-30s | not supported by this CPU |\n", e.name);
+				continue;
+			}
+			name = extra_hashes_select(e.aes, e.avx2);
+			if(!known_answer_tests())
+			{
+				printf("ERROR: %s differs from the scalar hashes.\n", name);
+				ok = false;
+				continue;
+			}
+		}
+
+		for(int hash = 0; hash < 4; hash++)
+		{
+			printf("| %-30s | %-13s |", name, hash_names[hash]);
+			for(size_t n = 1; n <= 5; n++)
+				printf(" %12.1f |", measure(hash, n, seconds));
+			printf("\n");
+			fflush(stdout);
+		}
+	}
+
+	return ok ? 0 : 1;
+}
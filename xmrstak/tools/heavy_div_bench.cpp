@@ -0,0 +1,271 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Checks and times the reciprocal division of the heavy algorithms.
+ *
+ * fast_div_heavy() is compared with the hardware division for ROUNDS random
+ * operands of every bit length in all four float rounding modes. Then a
+ * dependent chain of both divisions is timed and the heavy algorithms are
+ * hashed with both divisions, the hashes must be identical.
+ *
+ * Usage: xmr-stak-heavydiv [SECONDS] [ROUNDS]
+ */
+
+#include "xmrstak/backend/cpu/crypto/cryptonight_aesni.h"
+#include "xmrstak/backend/cpu/cpuType.hpp"
+
+#include <cfenv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace
+{
+
+typedef void (*cn_hash_fun)(const void*, size_t, void*, cryptonight_ctx**);
+
+constexpr size_t MAX_N = 5;
+constexpr size_t BLOB_SIZE = 76;
+
+inline uint64_t now_us()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct bench_ctx
+{
+	cryptonight_ctx* ctx[MAX_N];
+	uint8_t blob[BLOB_SIZE * MAX_N];
+
+	bench_ctx()
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+		{
+			ctx[i] = (cryptonight_ctx*)_mm_malloc(sizeof(cryptonight_ctx), 4096);
+			ctx[i]->long_state = (uint8_t*)_mm_malloc(CRYPTONIGHT_HEAVY_MEMORY, 4096);
+			memset(ctx[i]->long_state, 0, CRYPTONIGHT_HEAVY_MEMORY);
+		}
+		for(size_t i = 0; i < sizeof(blob); i++)
+			blob[i] = static_cast<uint8_t>(i * 13 + 5);
+	}
+
+	~bench_ctx()
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+		{
+			_mm_free(ctx[i]->long_state);
+			_mm_free(ctx[i]);
+		}
+	}
+
+	void set_nonce(uint32_t nonce, size_t n)
+	{
+		for(size_t i = 0; i < n; i++)
+		{
+			uint32_t v = nonce + i;
+			memcpy(blob + BLOB_SIZE * i + 39, &v, sizeof(v));
+		}
+	}
+};
+
+/** hash for at least `seconds`
+ *
+ * @return hashes per second
+ */
+double measure(cn_hash_fun fun, size_t n, bench_ctx& bctx, double seconds)
+{
+	uint8_t out[32 * MAX_N];
+	uint32_t nonce = 0;
+
+	// warm up the caches and the TLB
+	fun(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+
+	uint64_t start = now_us();
+	uint64_t end = start + uint64_t(seconds * 1e6);
+	uint64_t hashes = 0;
+	uint64_t t;
+	do
+	{
+		bctx.set_nonce(nonce, n);
+		nonce += n;
+		fun(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+		hashes += n;
+	}
+	while((t = now_us()) < end);
+
+	return double(hashes) * 1e6 / double(t - start);
+}
+
+/** compare fast_div_heavy() with the hardware division
+ *
+ * @return number of differences
+ */
+uint64_t check(uint64_t rounds)
+{
+	const int modes[] = { FE_TONEAREST, FE_DOWNWARD, FE_UPWARD, FE_TOWARDZERO };
+	std::mt19937_64 rng(0x5eed);
+	uint64_t bad = 0;
+	for(int mode : modes)
+	{
+		std::fesetround(mode);
+		for(uint64_t i = 0; i < rounds; i++)
+		{
+			const int64_t a = static_cast<int64_t>(rng()) >> (i & 63);
+			const int32_t b = static_cast<int32_t>(static_cast<uint32_t>(rng()) >> (i >> 6 & 31)) | 0x5;
+			// the hardware division raises an exception
+			if(a == INT64_MIN && b == -1)
+				continue;
+			if(fast_div_heavy(a, b) != a / b)
+			{
+				if(bad++ < 8)
+					printf("  %lld / %d: %lld, expected %lld\n", (long long)a, b, (long long)fast_div_heavy(a, b), (long long)(a / b));
+			}
+		}
+	}
+	std::fesetround(FE_TONEAREST);
+	return bad;
+}
+
+/** time a dependent chain of divisions like in CN_STEP5
+ *
+ * @return nanoseconds per division
+ */
+template<bool FAST>
+double time_chain(uint64_t count)
+{
+	uint64_t s = 0x9E3779B97F4A7C15ULL;
+	int64_t q = 0;
+	const uint64_t start = now_us();
+	for(uint64_t i = 0; i < count; i++)
+	{
+		s ^= s << 13;
+		s ^= s >> 7;
+		s ^= s << 17;
+		const int64_t u = static_cast<int64_t>(s ^ static_cast<uint64_t>(q));
+		const int32_t d = static_cast<int32_t>(u >> 17) | 0x5;
+		q = FAST ? fast_div_heavy(u, d) : u / d;
+	}
+	const uint64_t end = now_us();
+	if(q == 42)
+		printf(" ");
+	return double(end - start) * 1e3 / double(count);
+}
+
+struct result
+{
+	bool equal;
+	double hardware;
+	double reciprocal;
+};
+
+template<size_t N, xmrstak_algo ALGO>
+result run(bench_ctx& bctx, double seconds)
+{
+	cn_hash_fun fun = Cryptonight_hash<N>::template hash<ALGO, false, true>;
+
+	result res;
+	uint8_t ref[32 * MAX_N], out[32 * MAX_N];
+	bctx.set_nonce(0x1234, N);
+	cn_heavy_fast_div = false;
+	fun(bctx.blob, BLOB_SIZE, ref, bctx.ctx);
+	res.hardware = measure(fun, N, bctx, seconds);
+
+	bctx.set_nonce(0x1234, N);
+	cn_heavy_fast_div = true;
+	fun(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+	res.reciprocal = measure(fun, N, bctx, seconds);
+	cn_heavy_fast_div = false;
+
+	res.equal = memcmp(ref, out, 32 * N) == 0;
+	return res;
+}
+
+template<xmrstak_algo ALGO>
+bool run_algo(const char* name, bench_ctx& bctx, double seconds)
+{
+	result res[3] = {
+		run<1, ALGO>(bctx, seconds),
+		run<2, ALGO>(bctx, seconds),
+		run<3, ALGO>(bctx, seconds)
+	};
+
+	bool ok = true;
+	for(size_t i = 0; i < 3; i++)
+	{
+		printf("| %-20s | %u | %12.1f | %14.1f | %6.3fx | %s |\n", name, unsigned(i + 1),
+			res[i].hardware, res[i].reciprocal, res[i].reciprocal / res[i].hardware, res[i].equal ? "ok      " : "MISMATCH");
+		ok = ok && res[i].equal;
+	}
+	fflush(stdout);
+	return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+	if(seconds <= 0.0)
+		seconds = 2.0;
+	uint64_t rounds = argc > 2 ? strtoull(argv[2], nullptr, 10) : (1ULL << 26);
+
+	xmrstak::cpu::Model model = xmrstak::cpu::getModel();
+	if(!model.aes)
+	{
+		printf("ERROR: the benchmark needs hardware AES.\n");
+		return 1;
+	}
+	keccak_multi_select(model.avx2, model.avx512);
+	extra_hashes_select(model.ssse3, model.avx2);
+
+	printf("checking %llu divisions in 4 rounding modes\n", (unsigned long long)rounds);
+	const uint64_t bad = check(rounds);
+	if(bad != 0)
+	{
+		printf("ERROR: %llu divisions differ from the hardware division.\n", (unsigned long long)bad);
+		return 1;
+	}
+
+	const uint64_t chain = 1 << 24;
+	const double hw = time_chain<false>(chain);
+	const double fast = time_chain<true>(chain);
+	printf("dependent division: hardware %.2f ns, reciprocal %.2f ns\n", hw, fast);
+	printf("selected by the miner: %s\n", heavy_div_select());
+
+	printf("| algorithm            | N | hardware H/s | reciprocal H/s | speedup | result   |\n");
+	bench_ctx bctx;
+	bool ok = run_algo<cryptonight_heavy>("cryptonight_heavy", bctx, seconds);
+	ok = run_algo<cryptonight_haven>("cryptonight_haven", bctx, seconds) && ok;
+	ok = run_algo<cryptonight_bittube2>("cryptonight_bittube2", bctx, seconds) && ok;
+
+	if(!ok)
+	{
+		printf("ERROR: the hashes with both divisions differ.\n");
+		return 1;
+	}
+	return 0;
+}
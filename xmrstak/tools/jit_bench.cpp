@@ -0,0 +1,251 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Compares the main loops generated at runtime (cn_jit.cpp) with the N-way
+ * template kernels.
+ *
+ * For every supported algorithm and 1 to 5 hashes per call the template kernel
+ * and both schedules of the generated loop hash the same blobs on the calling
+ * thread. The hash rates are printed as a table, the generated hashes must be
+ * bit identical to single hashes. Needs hardware AES.
+ *
+ * Usage: xmr-stak-jit [SECONDS] [ALGORITHM]...
+ */
+
+#include "xmrstak/backend/cpu/crypto/cryptonight_aesni.h"
+#include "xmrstak/backend/cpu/cpuType.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef void (*cn_hash_fun)(const void*, size_t, void*, cryptonight_ctx**);
+
+constexpr size_t MAX_N = 5;
+constexpr size_t BLOB_SIZE = 76;
+
+inline uint64_t now_us()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct bench_ctx
+{
+	cryptonight_ctx* ctx[MAX_N];
+	uint8_t blob[BLOB_SIZE * MAX_N];
+
+	bench_ctx()
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+		{
+			ctx[i] = (cryptonight_ctx*)_mm_malloc(sizeof(cryptonight_ctx), 4096);
+			ctx[i]->long_state = (uint8_t*)_mm_malloc(CRYPTONIGHT_HEAVY_MEMORY, 4096);
+			memset(ctx[i]->long_state, 0, CRYPTONIGHT_HEAVY_MEMORY);
+		}
+		for(size_t i = 0; i < sizeof(blob); i++)
+			blob[i] = static_cast<uint8_t>(i * 13 + 5);
+	}
+
+	~bench_ctx()
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+		{
+			_mm_free(ctx[i]->long_state);
+			_mm_free(ctx[i]);
+		}
+	}
+
+	void set_nonce(uint32_t nonce, size_t n)
+	{
+		for(size_t i = 0; i < n; i++)
+		{
+			uint32_t v = nonce + i;
+			memcpy(blob + BLOB_SIZE * i + 39, &v, sizeof(v));
+		}
+	}
+};
+
+/** hash for at least `seconds`
+ *
+ * @return hashes per second
+ */
+double measure(cn_hash_fun fun, size_t n, bench_ctx& bctx, double seconds)
+{
+	uint8_t out[32 * MAX_N];
+	uint32_t nonce = 0;
+
+	// warm up the caches and the TLB, the first call also generates the code
+	fun(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+
+	uint64_t start = now_us();
+	uint64_t end = start + uint64_t(seconds * 1e6);
+	uint64_t hashes = 0;
+	uint64_t t;
+	do
+	{
+		bctx.set_nonce(nonce, n);
+		nonce += n;
+		fun(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+		hashes += n;
+	}
+	while((t = now_us()) < end);
+
+	return double(hashes) * 1e6 / double(t - start);
+}
+
+struct result
+{
+	bool equal;
+	double tmpl;
+	double interleaved;
+	double sequential;
+};
+
+template<size_t N, xmrstak_algo ALGO>
+result run(bench_ctx& bctx, bool prefetch, double seconds)
+{
+	cn_hash_fun tmpl = prefetch ? Cryptonight_hash<N>::template hash<ALGO, false, true> : Cryptonight_hash<N>::template hash<ALGO, false, false>;
+	cn_hash_fun interleaved = prefetch ? Cryptonight_hash_jit<N>::template hash<ALGO, true, cn_jit_interleaved> : Cryptonight_hash_jit<N>::template hash<ALGO, false, cn_jit_interleaved>;
+	cn_hash_fun sequential = prefetch ? Cryptonight_hash_jit<N>::template hash<ALGO, true, cn_jit_sequential> : Cryptonight_hash_jit<N>::template hash<ALGO, false, cn_jit_sequential>;
+
+	result res;
+	uint8_t ref[32 * MAX_N], out[32 * MAX_N];
+	bctx.set_nonce(0x1234, N);
+	for(size_t i = 0; i < N; i++)
+		Cryptonight_hash<1>::template hash<ALGO, false, false>(bctx.blob + BLOB_SIZE * i, BLOB_SIZE, ref + 32 * i, bctx.ctx);
+	interleaved(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+	res.equal = memcmp(ref, out, 32 * N) == 0;
+	sequential(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+	res.equal = res.equal && memcmp(ref, out, 32 * N) == 0;
+
+	res.tmpl = measure(tmpl, N, bctx, seconds);
+	res.interleaved = measure(interleaved, N, bctx, seconds);
+	res.sequential = measure(sequential, N, bctx, seconds);
+	return res;
+}
+
+template<xmrstak_algo ALGO>
+bool run_algo(const char* name, bench_ctx& bctx, bool prefetch, double seconds)
+{
+	result res[MAX_N] = {
+		run<1, ALGO>(bctx, prefetch, seconds),
+		run<2, ALGO>(bctx, prefetch, seconds),
+		run<3, ALGO>(bctx, prefetch, seconds),
+		run<4, ALGO>(bctx, prefetch, seconds),
+		run<5, ALGO>(bctx, prefetch, seconds)
+	};
+
+	bool ok = true;
+	for(size_t i = 0; i < MAX_N; i++)
+	{
+		const double best = res[i].interleaved > res[i].sequential ? res[i].interleaved : res[i].sequential;
+		printf("| %-22s | %u | %12.1f | %15.1f | %14.1f | %6.3fx | %s |\n", name, unsigned(i + 1),
+			res[i].tmpl, res[i].interleaved, res[i].sequential, best / res[i].tmpl, res[i].equal ? "ok      " : "MISMATCH");
+		ok = ok && res[i].equal;
+	}
+	fflush(stdout);
+	return ok;
+}
+
+struct algo_entry
+{
+	const char* name;
+	bool (*fun)(const char*, bench_ctx&, bool, double);
+};
+
+#define ALGO_ENTRY(a) { #a, run_algo<a> }
+
+// all algorithms supported by the code generator
+const algo_entry algo_list[] = {
+	ALGO_ENTRY(cryptonight),
+	ALGO_ENTRY(cryptonight_lite),
+	ALGO_ENTRY(cryptonight_monero),
+	ALGO_ENTRY(cryptonight_aeon),
+	ALGO_ENTRY(cryptonight_ipbc),
+	ALGO_ENTRY(cryptonight_stellite),
+	ALGO_ENTRY(cryptonight_masari),
+	ALGO_ENTRY(cryptonight_heavy),
+	ALGO_ENTRY(cryptonight_haven)
+};
+
+#undef ALGO_ENTRY
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+	if(seconds <= 0.0)
+		seconds = 2.0;
+
+	std::vector<std::string> selected;
+	bool prefetch = true;
+	for(int i = 2; i < argc; i++)
+	{
+		if(std::string(argv[i]) == "--no-prefetch")
+			prefetch = false;
+		else
+			selected.push_back(argv[i]);
+	}
+
+	xmrstak::cpu::Model model = xmrstak::cpu::getModel();
+	if(!model.aes)
+	{
+		printf("ERROR: the generated main loop needs hardware AES.\n");
+		return 1;
+	}
+	keccak_multi_select(model.avx2, model.avx512);
+	extra_hashes_select(model.ssse3, model.avx2);
+	printf("%s, prefetch %s, %.1f s per measurement\n", model.type_name.c_str(), prefetch ? "on" : "off", seconds);
+	printf("| algorithm              | N | template H/s | interleaved H/s | sequential H/s | speedup | result   |\n");
+
+	bench_ctx bctx;
+	bool ok = true;
+	for(const algo_entry& e : algo_list)
+	{
+		if(!selected.empty())
+		{
+			bool found = false;
+			for(const std::string& s : selected)
+				found = found || s == e.name;
+			if(!found)
+				continue;
+		}
+		ok = e.fun(e.name, bctx, prefetch, seconds) && ok;
+	}
+
+	if(!ok)
+	{
+		printf("ERROR: generated and single hashes differ.\n");
+		return 1;
+	}
+	return 0;
+}
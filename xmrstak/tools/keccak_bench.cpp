@@ -0,0 +1,193 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+
+/*
+ * Known answer tests and microbenchmark of the multi state keccak.
+ *
+ * Every implementation supported by the CPU is checked against the scalar
+ * keccak1600 / keccakf for 1 to 8 states and message lengths from 0 to 300
+ * byte. Afterwards the time per state for the keccak of a 76 byte blob (CN_INIT)
+ * and for the permutation (CN_FINALIZE) is printed for 1 to 5 states.
+ *
+ * Usage: xmr-stak-keccak [SECONDS]
+ */
+
+#include "xmrstak/backend/cpu/crypto/keccak_multi.hpp"
+#include "xmrstak/backend/cpu/cpuType.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C"
+{
+	void keccakf(uint64_t st[25], int rounds);
+	void keccak1600(const uint8_t *in, int inlen, uint8_t *md);
+}
+
+namespace
+{
+
+constexpr size_t MAX_N = 8;
+constexpr size_t MAX_LEN = 300;
+constexpr size_t BLOB_SIZE = 76;
+
+inline uint64_t now_ns()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct impl_entry
+{
+	const char* name;
+	bool avx2;
+	bool avx512;
+};
+
+bool known_answer_tests()
+{
+	std::vector<uint8_t> in(MAX_LEN * MAX_N);
+	for(size_t i = 0; i < in.size(); i++)
+		in[i] = static_cast<uint8_t>(i * 167 + 13);
+
+	uint8_t md[MAX_N][200], ref[MAX_N][200];
+	uint8_t* mdp[MAX_N];
+	uint64_t st[MAX_N][25], st_ref[MAX_N][25];
+	uint64_t* stp[MAX_N];
+	for(size_t i = 0; i < MAX_N; i++)
+	{
+		mdp[i] = md[i];
+		stp[i] = st[i];
+	}
+
+	size_t failed = 0;
+	for(size_t n = 1; n <= MAX_N; n++)
+	{
+		for(size_t len = 0; len <= MAX_LEN; len++)
+		{
+			for(size_t i = 0; i < n; i++)
+				keccak1600(in.data() + len * i, static_cast<int>(len), ref[i]);
+			keccak1600_multi(in.data(), len, mdp, n);
+			for(size_t i = 0; i < n; i++)
+				failed += memcmp(md[i], ref[i], 200) != 0;
+		}
+
+		for(size_t i = 0; i < n; i++)
+		{
+			memcpy(st[i], ref[i], 200);
+			memcpy(st_ref[i], ref[i], 200);
+			keccakf(st_ref[i], 24);
+		}
+		keccakf_multi(stp, n);
+		for(size_t i = 0; i < n; i++)
+			failed += memcmp(st[i], st_ref[i], 200) != 0;
+	}
+
+	if(failed != 0)
+		printf("  %llu known answer tests FAILED\n", (unsigned long long)failed);
+	return failed == 0;
+}
+
+/** @return nanoseconds per state */
+double measure(size_t n, bool permute_only, double seconds)
+{
+	uint8_t in[BLOB_SIZE * 5];
+	uint8_t md[5][200];
+	uint8_t* mdp[5];
+	uint64_t* stp[5];
+	for(size_t i = 0; i < sizeof(in); i++)
+		in[i] = static_cast<uint8_t>(i);
+	for(size_t i = 0; i < 5; i++)
+	{
+		mdp[i] = md[i];
+		stp[i] = reinterpret_cast<uint64_t*>(md[i]);
+	}
+	keccak1600_multi(in, BLOB_SIZE, mdp, n);
+
+	uint64_t start = now_ns();
+	uint64_t end = start + uint64_t(seconds * 1e9);
+	uint64_t calls = 0;
+	uint64_t t;
+	do
+	{
+		for(size_t r = 0; r < 64; r++)
+		{
+			if(permute_only)
+				keccakf_multi(stp, n);
+			else
+			{
+				in[0] = static_cast<uint8_t>(r);
+				keccak1600_multi(in, BLOB_SIZE, mdp, n);
+			}
+		}
+		calls += 64;
+	}
+	while((t = now_ns()) < end);
+
+	return double(t - start) / double(calls * n);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+	if(seconds <= 0.0)
+		seconds = 0.5;
+
+	xmrstak::cpu::Model model = xmrstak::cpu::getModel();
+	const impl_entry impls[] = {
+		{ "scalar", false, false },
+		{ "avx2", true, false },
+		{ "avx512", true, true }
+	};
+
+	bool ok = true;
+	printf("| implementation | N | keccak1600 ns/state | keccakf ns/state |\n");
+	for(const impl_entry& e : impls)
+	{
+		if((e.avx2 && !model.avx2) || (e.avx512 && !model.avx512))
+		{
+			printf("| %-14s | not supported by this CPU |\n", e.name);
+			continue;
+		}
+
+		keccak_multi_select(e.avx2, e.avx512);
+		if(!known_answer_tests())
+		{
+			printf("ERROR: %s differs from keccak1600.\n", e.name);
+			ok = false;
+			continue;
+		}
+
+		for(size_t n = 1; n <= 5; n++)
+			printf("| %-14s | %u | %19.1f | %16.1f |\n", e.name, unsigned(n), measure(n, false, seconds), measure(n, true, seconds));
+		fflush(stdout);
+	}
+
+	return ok ? 0 : 1;
+}
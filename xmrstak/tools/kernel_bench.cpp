@@ -0,0 +1,562 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Times the CPU kernels of every algorithm, number of hashes per call and code
+ * path without a config file or a pool.
+ *
+ * Every kernel is taken from the same selector the miner uses. Its hashes are
+ * checked against single hashes, then it is run for a warmup and a number of
+ * repetitions on pinned threads. Mean, standard deviation and the 95% confidence
+ * interval of the repetitions are printed as a table and can be written as JSON
+ * to compare builds.
+ *
+ * Usage: xmr-stak-bench [OPTIONS]
+ *   --algo NAME         algorithm, can be repeated (default: all)
+ *   --n LIST            hashes per call, e.g. 1,2,4 (default: 1,2,3,4,5)
+ *   --path LIST         template,pipeline,intel_avx,amd_avx,jit,avx2_div,vaes (default: all)
+ *   --aes hw|soft|both  AES implementation (default: both, soft only without hardware AES)
+ *   --prefetch on|off|both (default: both)
+ *   --seconds S         length of one repetition (default: 0.5)
+ *   --warmup S          warmup before the repetitions (default: 0.2)
+ *   --reps R            repetitions (default: 5)
+ *   --threads T         threads running the kernel at the same time (default: 1)
+ *   --first-cpu C       thread i is pinned to cpu C + i (default: 0)
+ *   --no-affinity       do not pin the threads
+ *   --json FILE         write the results as JSON, `-` for stdout
+ */
+
+#include "xmrstak/backend/cpu/minethd.hpp"
+#include "xmrstak/backend/cpu/cpuType.hpp"
+#include "xmrstak/backend/cpu/crypto/cryptonight_aesni.h"
+#include "xmrstak/backend/cpu/crypto/fast_div_heavy.hpp"
+
+#include <atomic>
+#include <cfenv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+
+using xmrstak::cpu::minethd;
+typedef minethd::cn_hash_fun cn_hash_fun;
+
+constexpr size_t MAX_N = 5;
+constexpr size_t BLOB_SIZE = 76;
+
+inline uint64_t now_us()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/** scratchpads and blobs of one benchmark thread */
+struct bench_ctx
+{
+	cryptonight_ctx* ctx[MAX_N];
+	uint8_t blob[BLOB_SIZE * MAX_N];
+	bool huge_pages = true;
+
+	bench_ctx(uint32_t seed)
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+		{
+			ctx[i] = (cryptonight_ctx*)_mm_malloc(sizeof(cryptonight_ctx), 4096);
+			ctx[i]->long_state = nullptr;
+			// ctx_info[0] marks memory which has to be unmapped
+			ctx[i]->ctx_info[0] = 0;
+#if defined(__linux__)
+			void* mem = mmap(nullptr, CRYPTONIGHT_HEAVY_MEMORY, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+			if(mem != MAP_FAILED)
+			{
+				ctx[i]->long_state = (uint8_t*)mem;
+				ctx[i]->ctx_info[0] = 1;
+			}
+#endif
+			if(ctx[i]->long_state == nullptr)
+			{
+				huge_pages = false;
+				ctx[i]->long_state = (uint8_t*)_mm_malloc(CRYPTONIGHT_HEAVY_MEMORY, 4096);
+				memset(ctx[i]->long_state, 0, CRYPTONIGHT_HEAVY_MEMORY);
+			}
+		}
+		for(size_t i = 0; i < sizeof(blob); i++)
+			blob[i] = static_cast<uint8_t>(i * 13 + 5 + seed);
+	}
+
+	~bench_ctx()
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+		{
+#if defined(__linux__)
+			if(ctx[i]->ctx_info[0] == 1)
+				munmap(ctx[i]->long_state, CRYPTONIGHT_HEAVY_MEMORY);
+			else
+#endif
+				_mm_free(ctx[i]->long_state);
+			_mm_free(ctx[i]);
+		}
+	}
+
+	void set_nonce(uint32_t nonce, size_t n)
+	{
+		for(size_t i = 0; i < n; i++)
+		{
+			uint32_t v = nonce + i;
+			memcpy(blob + BLOB_SIZE * i + 39, &v, sizeof(v));
+		}
+	}
+};
+
+struct algo_entry
+{
+	const char* name;
+	xmrstak_algo algo;
+};
+
+const algo_entry algo_list[] = {
+	{ "cryptonight", cryptonight },
+	{ "cryptonight_lite", cryptonight_lite },
+	{ "cryptonight_monero", cryptonight_monero },
+	{ "cryptonight_monero_v8", cryptonight_monero_v8 },
+	{ "cryptonight_heavy", cryptonight_heavy },
+	{ "cryptonight_aeon", cryptonight_aeon },
+	{ "cryptonight_ipbc", cryptonight_ipbc },
+	{ "cryptonight_stellite", cryptonight_stellite },
+	{ "cryptonight_masari", cryptonight_masari },
+	{ "cryptonight_haven", cryptonight_haven },
+	{ "cryptonight_bittube2", cryptonight_bittube2 }
+};
+
+/** code path, the value of "asm" in cpu.txt or a pipelined thread */
+struct path_entry
+{
+	const char* name;
+	const char* asm_version;
+	bool pipeline;
+};
+
+const path_entry path_list[] = {
+	{ "template", "off", false },
+	{ "pipeline", "off", true },
+	{ "intel_avx", "intel_avx", false },
+	{ "amd_avx", "amd_avx", false },
+	{ "jit", "jit", false },
+	{ "avx2_div", "avx2_div", false },
+	{ "vaes", "vaes", false }
+};
+
+struct result
+{
+	const char* algo;
+	size_t n;
+	const char* path;
+	bool hw_aes;
+	bool prefetch;
+	bool equal;
+	//! hashes per second of all threads, one per repetition
+	std::vector<double> samples;
+	double mean;
+	double stddev;
+	double ci95;
+	double min;
+	double max;
+};
+
+/** two sided 95% quantile of the t distribution */
+double t95(size_t df)
+{
+	static const double table[] = {
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+	};
+	if(df == 0)
+		return NAN;
+	return df <= 30 ? table[df - 1] : 1.96;
+}
+
+void statistics(result& r)
+{
+	const size_t k = r.samples.size();
+	r.mean = 0.0;
+	r.min = r.samples[0];
+	r.max = r.samples[0];
+	for(double s : r.samples)
+	{
+		r.mean += s;
+		r.min = std::min(r.min, s);
+		r.max = std::max(r.max, s);
+	}
+	r.mean /= double(k);
+
+	double var = 0.0;
+	for(double s : r.samples)
+		var += (s - r.mean) * (s - r.mean);
+	r.stddev = k > 1 ? std::sqrt(var / double(k - 1)) : 0.0;
+	r.ci95 = k > 1 ? t95(k - 1) * r.stddev / std::sqrt(double(k)) : 0.0;
+}
+
+struct options
+{
+	std::vector<std::string> algos;
+	std::vector<size_t> n = { 1, 2, 3, 4, 5 };
+	std::vector<std::string> paths;
+	bool hw_aes = true;
+	bool soft_aes = true;
+	bool prefetch = true;
+	bool no_prefetch = true;
+	double seconds = 0.5;
+	double warmup = 0.2;
+	size_t reps = 5;
+	size_t threads = 1;
+	size_t first_cpu = 0;
+	bool affinity = true;
+	std::string json;
+};
+
+/** run the kernel on all threads at the same time for `seconds`
+ *
+ * @return hashes per second of all threads
+ */
+double run_threads(cn_hash_fun fun, size_t n, std::vector<bench_ctx*>& bctx, const options& opt, double seconds)
+{
+	std::atomic<size_t> ready(0);
+	std::atomic<bool> go(false);
+	std::vector<double> rate(bctx.size(), 0.0);
+	std::vector<std::thread> thds;
+
+	for(size_t t = 0; t < bctx.size(); t++)
+	{
+		thds.emplace_back([&, t]()
+		{
+			if(opt.affinity)
+			{
+#if defined(_WIN32)
+				minethd::thd_setaffinity(GetCurrentThread(), opt.first_cpu + t);
+#else
+				minethd::thd_setaffinity(pthread_self(), opt.first_cpu + t);
+#endif
+			}
+
+			bench_ctx& b = *bctx[t];
+			uint8_t out[32 * MAX_N];
+			uint32_t nonce = 0;
+
+			ready++;
+			while(!go.load())
+				std::this_thread::yield();
+
+			uint64_t start = now_us();
+			uint64_t end = start + uint64_t(seconds * 1e6);
+			uint64_t hashes = 0;
+			uint64_t now;
+			do
+			{
+				b.set_nonce(nonce, n);
+				nonce += n;
+				fun(b.blob, BLOB_SIZE, out, b.ctx);
+				hashes += n;
+			}
+			while((now = now_us()) < end);
+
+			rate[t] = double(hashes) * 1e6 / double(now - start);
+		});
+	}
+
+	while(ready.load() != bctx.size())
+		std::this_thread::yield();
+	go = true;
+
+	double total = 0.0;
+	for(size_t t = 0; t < thds.size(); t++)
+	{
+		thds[t].join();
+		total += rate[t];
+	}
+	return total;
+}
+
+bool run(const algo_entry& a, size_t n, const path_entry& path, bool hw_aes, bool prefetch,
+	std::vector<bench_ctx*>& bctx, const options& opt, result& r)
+{
+	// nullptr if the selector has no such kernel for the algorithm, N, AES mode and CPU
+	cn_hash_fun fun = minethd::func_multiway_selector(n, hw_aes, !prefetch, a.algo, path.asm_version, path.pipeline, false);
+	cn_hash_fun single = minethd::func_multiway_selector(1, hw_aes, true, a.algo);
+	if(fun == nullptr || single == nullptr)
+		return false;
+
+	r.algo = a.name;
+	r.n = n;
+	r.path = path.name;
+	r.hw_aes = hw_aes;
+	r.prefetch = prefetch;
+
+	// some kernels change the rounding mode of the calling thread
+	const int round = std::fegetround();
+	bench_ctx& b = *bctx[0];
+	uint8_t ref[32 * MAX_N], out[32 * MAX_N];
+	b.set_nonce(0x5a5a, n);
+	for(size_t i = 0; i < n; i++)
+		single(b.blob + BLOB_SIZE * i, BLOB_SIZE, ref + 32 * i, b.ctx);
+	fun(b.blob, BLOB_SIZE, out, b.ctx);
+	r.equal = memcmp(ref, out, 32 * n) == 0;
+	std::fesetround(round);
+
+	if(opt.warmup > 0.0)
+		run_threads(fun, n, bctx, opt, opt.warmup);
+	r.samples.clear();
+	for(size_t i = 0; i < opt.reps; i++)
+		r.samples.push_back(run_threads(fun, n, bctx, opt, opt.seconds));
+	statistics(r);
+	return true;
+}
+
+bool selected(const std::vector<std::string>& list, const char* name)
+{
+	if(list.empty())
+		return true;
+	for(const std::string& s : list)
+	{
+		if(s == name)
+			return true;
+	}
+	return false;
+}
+
+std::vector<std::string> split(const char* str)
+{
+	std::vector<std::string> out;
+	std::string s(str);
+	size_t pos = 0;
+	while(pos <= s.size())
+	{
+		size_t end = s.find(',', pos);
+		if(end == std::string::npos)
+			end = s.size();
+		if(end != pos)
+			out.push_back(s.substr(pos, end - pos));
+		pos = end + 1;
+	}
+	return out;
+}
+
+bool both_arg(const char* arg, const char* a, const char* b, bool& first, bool& second)
+{
+	std::string s(arg);
+	first = s == a || s == "both";
+	second = s == b || s == "both";
+	return first || second;
+}
+
+void usage()
+{
+	printf("Usage: xmr-stak-bench [--algo NAME]... [--n LIST] [--path LIST] [--aes hw|soft|both] [--prefetch on|off|both]\n"
+		"                      [--seconds S] [--warmup S] [--reps R] [--threads T] [--first-cpu C] [--no-affinity]\n"
+		"                      [--json FILE]\n");
+}
+
+bool parse_args(int argc, char* argv[], options& opt)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if(arg == "--no-affinity")
+		{
+			opt.affinity = false;
+			continue;
+		}
+		if(i + 1 >= argc)
+			return false;
+		const char* val = argv[++i];
+
+		if(arg == "--algo")
+			opt.algos.push_back(val);
+		else if(arg == "--n")
+		{
+			opt.n.clear();
+			for(const std::string& s : split(val))
+			{
+				size_t n = strtoul(s.c_str(), nullptr, 10);
+				if(n < 1 || n > MAX_N)
+					return false;
+				opt.n.push_back(n);
+			}
+		}
+		else if(arg == "--path")
+			opt.paths = split(val);
+		else if(arg == "--aes")
+		{
+			if(!both_arg(val, "hw", "soft", opt.hw_aes, opt.soft_aes))
+				return false;
+		}
+		else if(arg == "--prefetch")
+		{
+			if(!both_arg(val, "on", "off", opt.prefetch, opt.no_prefetch))
+				return false;
+		}
+		else if(arg == "--seconds")
+			opt.seconds = atof(val);
+		else if(arg == "--warmup")
+			opt.warmup = atof(val);
+		else if(arg == "--reps")
+			opt.reps = strtoul(val, nullptr, 10);
+		else if(arg == "--threads")
+			opt.threads = strtoul(val, nullptr, 10);
+		else if(arg == "--first-cpu")
+			opt.first_cpu = strtoul(val, nullptr, 10);
+		else if(arg == "--json")
+			opt.json = val;
+		else
+			return false;
+	}
+	return opt.seconds > 0.0 && opt.warmup >= 0.0 && opt.reps >= 1 && opt.threads >= 1;
+}
+
+void write_json(FILE* f, const options& opt, const xmrstak::cpu::Model& model, bool huge_pages, const std::vector<result>& results)
+{
+	fprintf(f, "{\"cpu\":{\"aes\":%s,\"avx2\":%s,\"avx512\":%s,\"vaes\":%s},\n",
+		model.aes ? "true" : "false", model.avx2 ? "true" : "false",
+		model.avx512 ? "true" : "false", model.vaes ? "true" : "false");
+	fprintf(f, "\"settings\":{\"seconds\":%.3f,\"warmup\":%.3f,\"reps\":%u,\"threads\":%u,\"affinity\":%s,\"huge_pages\":%s},\n",
+		opt.seconds, opt.warmup, unsigned(opt.reps), unsigned(opt.threads),
+		opt.affinity ? "true" : "false", huge_pages ? "true" : "false");
+	fprintf(f, "\"results\":[");
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		const result& r = results[i];
+		fprintf(f, "%s\n{\"algo\":\"%s\",\"n\":%u,\"path\":\"%s\",\"aes\":\"%s\",\"prefetch\":%s,\"valid\":%s,"
+			"\"mean\":%.2f,\"stddev\":%.2f,\"ci95\":%.2f,\"min\":%.2f,\"max\":%.2f,\"samples\":[",
+			i != 0 ? "," : "", r.algo, unsigned(r.n), r.path, r.hw_aes ? "hw" : "soft", r.prefetch ? "true" : "false",
+			r.equal ? "true" : "false", r.mean, r.stddev, r.ci95, r.min, r.max);
+		for(size_t s = 0; s < r.samples.size(); s++)
+			fprintf(f, "%s%.2f", s != 0 ? "," : "", r.samples[s]);
+		fprintf(f, "]}");
+	}
+	fprintf(f, "\n]}\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	options opt;
+	if(!parse_args(argc, argv, opt))
+	{
+		usage();
+		return 2;
+	}
+
+	xmrstak::cpu::Model model = xmrstak::cpu::getModel();
+	soft_aes_select(model.ssse3, model.avx2);
+	keccak_multi_select(model.avx2, model.avx512);
+	extra_hashes_select(model.aes && model.ssse3, model.avx2);
+	heavy_div_select();
+	if(!model.aes)
+		opt.hw_aes = false;
+	if(!opt.hw_aes && !opt.soft_aes)
+		opt.soft_aes = true;
+
+	std::vector<bench_ctx*> bctx;
+	bool huge_pages = true;
+	for(size_t t = 0; t < opt.threads; t++)
+	{
+		bctx.push_back(new bench_ctx(t));
+		huge_pages = huge_pages && bctx.back()->huge_pages;
+	}
+
+	FILE* table = opt.json == "-" ? stderr : stdout;
+	fprintf(table, "%u thread(s)%s, %s pages, %u x %.2f s after %.2f s warmup\n", unsigned(opt.threads),
+		opt.affinity ? " pinned" : "", huge_pages ? "huge" : "4 KiB", unsigned(opt.reps), opt.seconds, opt.warmup);
+	fprintf(table, "| algorithm              | N | path      | aes  | pf  |      mean H/s |   +-95%% |     min |     max | result   |\n");
+
+	std::vector<result> results;
+	bool ok = true;
+	for(const algo_entry& a : algo_list)
+	{
+		if(!selected(opt.algos, a.name))
+			continue;
+		for(size_t n : opt.n)
+		{
+			for(const path_entry& p : path_list)
+			{
+				if(!selected(opt.paths, p.name))
+					continue;
+				for(int aes = 1; aes >= 0; aes--)
+				{
+					if(!(aes == 1 ? opt.hw_aes : opt.soft_aes))
+						continue;
+					for(int pf = 1; pf >= 0; pf--)
+					{
+						if(!(pf == 1 ? opt.prefetch : opt.no_prefetch))
+							continue;
+						result r;
+						if(!run(a, n, p, aes == 1, pf == 1, bctx, opt, r))
+							continue;
+						fprintf(table, "| %-22s | %u | %-9s | %-4s | %-3s | %13.1f | %7.1f | %7.1f | %7.1f | %s |\n",
+							r.algo, unsigned(r.n), r.path, r.hw_aes ? "hw" : "soft", r.prefetch ? "on" : "off",
+							r.mean, r.ci95, r.min, r.max, r.equal ? "ok      " : "MISMATCH");
+						fflush(table);
+						ok = ok && r.equal;
+						results.push_back(r);
+					}
+				}
+			}
+		}
+	}
+
+	for(bench_ctx* b : bctx)
+		delete b;
+
+	if(!opt.json.empty())
+	{
+		FILE* f = opt.json == "-" ? stdout : fopen(opt.json.c_str(), "w");
+		if(f == nullptr)
+		{
+			fprintf(stderr, "ERROR: can not write %s\n", opt.json.c_str());
+			return 1;
+		}
+		write_json(f, opt, model, huge_pages, results);
+		if(f != stdout)
+			fclose(f);
+	}
+
+	if(!ok)
+	{
+		fprintf(table, "ERROR: some kernels differ from single hashes.\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,669 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * End-to-end latency benchmark of the miner against two simulated pools on
+ * localhost.
+ *
+ * The miner runs in this process with generated config files, the primary pool
+ * has the higher weight and the backup pool is only used for the failover. The
+ * benchmark has three phases:
+ *
+ *  - job switch: difficulty 1, every hash is a share. For every new job the time
+ *    from the notification to the first share of each thread is measured. The
+ *    threads reserve their nonces in chunks of 4096 on a new job, so the first
+ *    share of every chunk is the first hash of one thread. The threads are
+ *    reported by rank, fastest to slowest, because the order of the chunks
+ *    changes with every job.
+ *  - submit: the difficulty is raised so that the threads find no shares and
+ *    results are pushed to the executor at a fixed rate and as one burst. The
+ *    time from the push to the arrival at the pool is the share-found-to-submit
+ *    latency, the arrival rate the executor throughput.
+ *  - failover: the primary pool is stopped and started again, measured are the
+ *    time until the backup pool has a login and the first share and the time
+ *    until the miner mines on the restarted primary pool again.
+ *
+ * Usage: xmr-stak-poolbench [OPTIONS]
+ *   --currency NAME      coin of the generated config (default: monero)
+ *   --threads T          CPU mining threads (default: 1)
+ *   --jobs J             jobs of the job switch phase (default: 20)
+ *   --job-interval MS    time between the jobs (default: 1000)
+ *   --rates LIST         push rates of the submit phase in results/s (default: 1000,2000,5000)
+ *   --rate-seconds S     length of every rate (default: 2)
+ *   --burst N            results pushed at once (default: 10000)
+ *   --failovers F        stops of the primary pool (default: 3)
+ *   --latency MS         delay of every message of the pools (default: 0)
+ *   --jitter MS          additional random delay up to MS (default: 0)
+ *   --reject R           probability that a pool rejects a valid share (default: 0)
+ *   --json FILE          write the results as JSON, `-` for stdout
+ */
+
+#include "pool_sim.hpp"
+
+#include "xmrstak/backend/backendConnector.hpp"
+#include "xmrstak/jconf.hpp"
+#include "xmrstak/misc/console.hpp"
+#include "xmrstak/misc/executor.hpp"
+#include "xmrstak/net/msgstruct.hpp"
+#include "xmrstak/params.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace
+{
+
+using xmrstak::poolSim;
+
+//! nonces a CPU thread reserves on a new job, see minethd::multiway_work_main
+constexpr uint32_t NONCE_CHUNK = 4096;
+//! user pool id of the first pool in the pool list
+constexpr size_t PRIMARY_POOL_ID = 1;
+//! difficulty of the submit phase, no thread finds a share
+constexpr uint64_t SUBMIT_DIFFICULTY = 1ULL << 40;
+
+struct options
+{
+	std::string currency = "monero";
+	size_t threads = 1;
+	size_t jobs = 20;
+	uint32_t job_interval_ms = 1000;
+	std::vector<uint32_t> rates = { 1000, 2000, 5000 };
+	double rate_seconds = 2.0;
+	size_t burst = 10000;
+	size_t failovers = 3;
+	uint32_t latency_ms = 0;
+	uint32_t jitter_ms = 0;
+	double reject_rate = 0.0;
+	std::string json;
+};
+
+/** events of both pools, pool 0 is the primary */
+struct event_log
+{
+	struct entry
+	{
+		size_t pool;
+		poolSim::event ev;
+	};
+
+	std::mutex mtx;
+	std::vector<entry> events;
+
+	poolSim::listener listener(size_t pool)
+	{
+		return [this, pool](const poolSim::event& ev) {
+			std::unique_lock<std::mutex> lck(mtx);
+			events.push_back({ pool, ev });
+		};
+	}
+
+	/** index of the first event at or after `from` matching `pred`, or -1 */
+	size_t find(size_t from, const std::function<bool(const entry&)>& pred)
+	{
+		std::unique_lock<std::mutex> lck(mtx);
+		for(size_t i = from; i < events.size(); i++)
+		{
+			if(pred(events[i]))
+				return i;
+		}
+		return size_t(-1);
+	}
+
+	/** wait for an event matching `pred`
+	 *
+	 * @return the event time or 0 on timeout
+	 */
+	uint64_t wait(size_t from, uint32_t timeout_ms, const std::function<bool(const entry&)>& pred)
+	{
+		uint64_t end = poolSim::now_us() + uint64_t(timeout_ms) * 1000;
+		while(poolSim::now_us() < end)
+		{
+			size_t i = find(from, pred);
+			if(i != size_t(-1))
+			{
+				std::unique_lock<std::mutex> lck(mtx);
+				return events[i].ev.time_us;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return 0;
+	}
+
+	size_t size()
+	{
+		std::unique_lock<std::mutex> lck(mtx);
+		return events.size();
+	}
+
+	std::vector<entry> copy(size_t from)
+	{
+		std::unique_lock<std::mutex> lck(mtx);
+		return std::vector<entry>(events.begin() + std::min(from, events.size()), events.end());
+	}
+};
+
+/** summary of a list of latencies in milliseconds */
+struct dist
+{
+	size_t count = 0;
+	double p50 = 0.0;
+	double p90 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+
+	dist() {}
+
+	explicit dist(std::vector<double> v)
+	{
+		count = v.size();
+		if(count == 0)
+			return;
+		std::sort(v.begin(), v.end());
+		// nearest rank
+		auto rank = [&v](double p) { return v[std::min(v.size() - 1, size_t(p * v.size()))]; };
+		p50 = rank(0.5);
+		p90 = rank(0.9);
+		p99 = rank(0.99);
+		max = v.back();
+	}
+
+	std::string json() const
+	{
+		char buf[192];
+		snprintf(buf, sizeof(buf), "{\"count\":%llu,\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f}",
+			(unsigned long long)count, p50, p90, p99, max);
+		return buf;
+	}
+};
+
+struct rate_result
+{
+	//! 0 for the burst
+	uint32_t offered;
+	size_t pushed;
+	size_t received;
+	double achieved;
+	dist latency;
+};
+
+struct failover_result
+{
+	//! 0 if the event did not happen within the timeout
+	double login_ms;
+	double share_ms;
+	double recover_ms;
+};
+
+void usage()
+{
+	printf("Usage: xmr-stak-poolbench [--currency NAME] [--threads T] [--jobs J] [--job-interval MS] [--rates LIST]\n"
+		"                          [--rate-seconds S] [--burst N] [--failovers F] [--latency MS] [--jitter MS]\n"
+		"                          [--reject R] [--json FILE]\n");
+}
+
+bool parse_args(int argc, char* argv[], options& opt)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if(i + 1 >= argc)
+			return false;
+		const char* val = argv[++i];
+
+		if(arg == "--currency")
+			opt.currency = val;
+		else if(arg == "--threads")
+			opt.threads = strtoul(val, nullptr, 10);
+		else if(arg == "--jobs")
+			opt.jobs = strtoul(val, nullptr, 10);
+		else if(arg == "--job-interval")
+			opt.job_interval_ms = strtoul(val, nullptr, 10);
+		else if(arg == "--rates")
+		{
+			opt.rates.clear();
+			std::string s = val;
+			size_t pos = 0;
+			while(pos <= s.size())
+			{
+				size_t end = s.find(',', pos);
+				if(end == std::string::npos)
+					end = s.size();
+				uint32_t r = strtoul(s.substr(pos, end - pos).c_str(), nullptr, 10);
+				if(r == 0)
+					return false;
+				opt.rates.push_back(r);
+				pos = end + 1;
+			}
+		}
+		else if(arg == "--rate-seconds")
+			opt.rate_seconds = atof(val);
+		else if(arg == "--burst")
+			opt.burst = strtoul(val, nullptr, 10);
+		else if(arg == "--failovers")
+			opt.failovers = strtoul(val, nullptr, 10);
+		else if(arg == "--latency")
+			opt.latency_ms = strtoul(val, nullptr, 10);
+		else if(arg == "--jitter")
+			opt.jitter_ms = strtoul(val, nullptr, 10);
+		else if(arg == "--reject")
+			opt.reject_rate = atof(val);
+		else if(arg == "--json")
+			opt.json = val;
+		else
+			return false;
+	}
+	return opt.threads >= 1 && opt.job_interval_ms >= 100 && opt.rate_seconds > 0.0 &&
+		opt.reject_rate >= 0.0 && opt.reject_rate <= 1.0;
+}
+
+bool write_file(const std::string& name, const std::string& content)
+{
+	FILE* f = fopen(name.c_str(), "w");
+	if(f == nullptr)
+		return false;
+	bool ok = fwrite(content.data(), 1, content.size(), f) == content.size();
+	return fclose(f) == 0 && ok;
+}
+
+/** write config.txt, pools.txt and cpu.txt into dir and point the params to them */
+bool write_configs(const std::string& dir, const options& opt, uint16_t primary, uint16_t backup)
+{
+	std::string config =
+		"\"call_timeout\" : 10,\n"
+		"\"retry_time\" : 2,\n"
+		"\"giveup_limit\" : 0,\n"
+		"\"verbose_level\" : 1,\n"
+		"\"print_motd\" : false,\n"
+		"\"h_print_time\" : 60,\n"
+		"\"aes_override\" : null,\n"
+		"\"use_slow_memory\" : \"warn\",\n"
+		"\"tls_secure_algo\" : true,\n"
+		"\"daemon_mode\" : false,\n"
+		"\"output_file\" : \"\",\n"
+		"\"httpd_port\" : 0,\n"
+		"\"http_login\" : \"\",\n"
+		"\"http_pass\" : \"\",\n"
+		"\"prefer_ipv4\" : true,\n";
+
+	std::string pools = "\"pool_list\" :\n[\n";
+	const uint16_t ports[] = { primary, backup };
+	const int weights[] = { 10, 1 };
+	for(size_t i = 0; i < 2; i++)
+	{
+		pools += "\t{\"pool_address\" : \"127.0.0.1:" + std::to_string(ports[i]) +
+			"\", \"wallet_address\" : \"poolbench\", \"rig_id\" : \"\", \"pool_password\" : \"x\", "
+			"\"use_nicehash\" : false, \"use_tls\" : false, \"tls_fingerprint\" : \"\", \"pool_weight\" : " +
+			std::to_string(weights[i]) + " },\n";
+	}
+	pools += "],\n\"currency\" : \"" + opt.currency + "\",\n";
+
+	std::string cpu = "\"cpu_threads_conf\" :\n[\n";
+	for(size_t i = 0; i < opt.threads; i++)
+		cpu += "\t{ \"low_power_mode\" : false, \"no_prefetch\" : true, \"asm\" : \"auto\", \"affine_to_cpu\" : false },\n";
+	cpu += "],\n\"background_mode\" : false,\n\"perf_counters\" : false,\n";
+
+	auto& params = xmrstak::params::inst();
+	params.configFile = dir + "/config.txt";
+	params.configFilePools = dir + "/pools.txt";
+	params.configFileCPU = dir + "/cpu.txt";
+	params.useAMD = false;
+	params.useNVIDIA = false;
+	params.useFPGA = false;
+	params.currency = opt.currency;
+
+	return write_file(params.configFile, config) && write_file(params.configFilePools, pools) &&
+		write_file(params.configFileCPU, cpu);
+}
+
+bool is_share(const event_log::entry& e, size_t pool, uint64_t job)
+{
+	return e.pool == pool && e.ev.type == poolSim::EV_SUBMIT && e.ev.job == job && !e.ev.stale;
+}
+
+/** time from the notification of a job to the first share of every thread
+ *
+ * @param ranks latencies of the threads sorted fastest first, one vector per rank
+ * @return number of threads with a share
+ */
+size_t job_switch(poolSim& sim, event_log& log, const options& opt, std::vector<std::vector<double>>& ranks)
+{
+	size_t from = log.size();
+	uint64_t job = sim.new_job();
+	std::this_thread::sleep_for(std::chrono::milliseconds(opt.job_interval_ms));
+
+	uint64_t notify_us = 0;
+	std::vector<uint32_t> chunks;
+	std::vector<double> first;
+	for(const event_log::entry& e : log.copy(from))
+	{
+		if(e.pool == 0 && e.ev.type == poolSim::EV_JOB && e.ev.job == job)
+			notify_us = e.ev.time_us;
+		else if(notify_us != 0 && is_share(e, 0, job))
+		{
+			uint32_t chunk = e.ev.nonce / NONCE_CHUNK;
+			if(std::find(chunks.begin(), chunks.end(), chunk) != chunks.end())
+				continue;
+			chunks.push_back(chunk);
+			first.push_back((e.ev.time_us - notify_us) / 1000.0);
+		}
+	}
+
+	std::sort(first.begin(), first.end());
+	for(size_t i = 0; i < first.size() && i < ranks.size(); i++)
+		ranks[i].push_back(first[i]);
+	return first.size();
+}
+
+/** push results to the executor and wait for them at the pool
+ *
+ * @param rate results per second, 0 pushes all at once
+ */
+rate_result push_results(event_log& log, uint64_t job, uint32_t& next_nonce, size_t count, uint32_t rate)
+{
+	char job_id[sizeof(job_result::sJobID)] = { 0 };
+	std::string id = poolSim::job_id(job);
+	memcpy(job_id, id.c_str(), std::min(id.size(), sizeof(job_id) - 1));
+
+	// the hash must meet the target of the job, see log_result_ok for the 1
+	uint8_t hash[32] = { 0 };
+	hash[24] = 1;
+
+	const xmrstak_algo algo = jconf::inst()->GetCurrentCoinSelection().GetDescription(PRIMARY_POOL_ID).GetMiningAlgo();
+	const uint32_t first_nonce = next_nonce;
+	std::vector<uint64_t> push_us(count);
+	size_t from = log.size();
+
+	uint64_t start = poolSim::now_us();
+	for(size_t i = 0; i < count; i++)
+	{
+		if(rate != 0)
+		{
+			uint64_t due = start + uint64_t(i) * 1000000 / rate;
+			while(poolSim::now_us() < due)
+			{
+				if(due - poolSim::now_us() > 1000)
+					std::this_thread::sleep_for(std::chrono::microseconds(500));
+			}
+		}
+		push_us[i] = poolSim::now_us();
+		executor::inst()->push_event(ex_event(job_result(job_id, next_nonce++, hash, 0, algo), PRIMARY_POOL_ID));
+	}
+
+	// wait until every result arrived or nothing arrived for 2 s
+	size_t received = 0;
+	uint64_t last_us = 0;
+	std::vector<double> latency;
+	std::vector<bool> seen(count, false);
+	uint64_t idle_since = poolSim::now_us();
+	while(received < count && poolSim::now_us() - idle_since < 2000000)
+	{
+		std::vector<event_log::entry> events = log.copy(from);
+		from += events.size();
+		for(const event_log::entry& e : events)
+		{
+			if(!is_share(e, 0, job) || e.ev.nonce < first_nonce || e.ev.nonce - first_nonce >= count)
+				continue;
+			size_t i = e.ev.nonce - first_nonce;
+			if(seen[i])
+				continue;
+			seen[i] = true;
+			received++;
+			last_us = std::max(last_us, e.ev.time_us);
+			latency.push_back((e.ev.time_us - push_us[i]) / 1000.0);
+			idle_since = poolSim::now_us();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	rate_result r;
+	r.offered = rate;
+	r.pushed = count;
+	r.received = received;
+	r.achieved = last_us > start ? received / ((last_us - start) / 1e6) : 0.0;
+	r.latency = dist(latency);
+	return r;
+}
+
+/** the last event of the backup pool is a login or a share */
+bool backup_connected(event_log& log)
+{
+	std::unique_lock<std::mutex> lck(log.mtx);
+	for(size_t i = log.events.size(); i-- > 0;)
+	{
+		if(log.events[i].pool == 1)
+			return log.events[i].ev.type != poolSim::EV_CLOSE;
+	}
+	return false;
+}
+
+failover_result failover(poolSim& primary, event_log& log)
+{
+	failover_result r = failover_result();
+
+	// the miner must mine on the primary pool and the backup pool must be disconnected
+	size_t from = log.size();
+	uint64_t job = primary.current_job();
+	if(log.wait(from, 30000, [job](const event_log::entry& e) { return is_share(e, 0, job); }) == 0)
+		return r;
+	for(size_t t = 0; t < 30000 && backup_connected(log); t += 10)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	from = log.size();
+	uint64_t drop_us = poolSim::now_us();
+	primary.stop();
+
+	uint64_t t = log.wait(from, 30000, [](const event_log::entry& e) { return e.pool == 1 && e.ev.type == poolSim::EV_LOGIN; });
+	if(t != 0)
+		r.login_ms = (t - drop_us) / 1000.0;
+	t = log.wait(from, 30000, [](const event_log::entry& e) { return e.pool == 1 && e.ev.type == poolSim::EV_SUBMIT && e.ev.accepted; });
+	if(t != 0)
+		r.share_ms = (t - drop_us) / 1000.0;
+
+	std::string err;
+	if(!primary.start(err))
+	{
+		printf("ERROR: restart of the primary pool: %s\n", err.c_str());
+		return r;
+	}
+	from = log.size();
+	uint64_t up_us = poolSim::now_us();
+	t = log.wait(from, 60000, [](const event_log::entry& e) { return e.pool == 0 && e.ev.type == poolSim::EV_SUBMIT && e.ev.accepted; });
+	if(t != 0)
+		r.recover_ms = (t - up_us) / 1000.0;
+	return r;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	options opt;
+	if(!parse_args(argc, argv, opt))
+	{
+		usage();
+		return 2;
+	}
+
+	event_log log;
+	xmrstak::poolSimConfig cfg;
+	cfg.difficulty = 1;
+	cfg.latency_ms = opt.latency_ms;
+	cfg.jitter_ms = opt.jitter_ms;
+	cfg.reject_rate = opt.reject_rate;
+
+	poolSim primary(cfg, log.listener(0));
+	cfg.seed = 1;
+	poolSim backup(cfg, log.listener(1));
+
+	std::string err;
+	if(!primary.start(err) || !backup.start(err))
+	{
+		printf("ERROR: %s\n", err.c_str());
+		return 1;
+	}
+
+	char dir[] = "/tmp/xmr-stak-poolbench-XXXXXX";
+	if(mkdtemp(dir) == nullptr || !write_configs(dir, opt, primary.get_port(), backup.get_port()))
+	{
+		printf("ERROR: cannot write the config files to %s\n", dir);
+		return 1;
+	}
+
+	auto& params = xmrstak::params::inst();
+	bool configured = jconf::inst()->parse_config(params.configFile.c_str(), params.configFilePools.c_str()) &&
+		xmrstak::BackendConnector::self_test();
+	if(configured)
+		executor::inst()->ex_start(false);
+
+	// the threads read cpu.txt when they start
+	uint64_t started = configured ? log.wait(0, 60000, [](const event_log::entry& e) { return e.pool == 0 && e.ev.type == poolSim::EV_LOGIN; }) : 0;
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	remove(params.configFile.c_str());
+	remove(params.configFilePools.c_str());
+	remove(params.configFileCPU.c_str());
+	rmdir(dir);
+
+	if(started == 0)
+	{
+		printf("ERROR: the miner did not log in to the primary pool\n");
+		return 1;
+	}
+
+	// wait until every thread hashes, the first hash includes the scratchpad allocation
+	uint64_t job = primary.new_job();
+	size_t from = log.size();
+	for(size_t t = 0; t < 120000; t += 100)
+	{
+		std::vector<uint32_t> chunks;
+		for(const event_log::entry& e : log.copy(from))
+		{
+			if(is_share(e, 0, job) && std::find(chunks.begin(), chunks.end(), e.ev.nonce / NONCE_CHUNK) == chunks.end())
+				chunks.push_back(e.ev.nonce / NONCE_CHUNK);
+		}
+		if(chunks.size() >= opt.threads)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	FILE* table = opt.json == "-" ? stderr : stdout;
+	fprintf(table, "\n%u thread(s), pool latency %u+%u ms, reject %.3f\n", unsigned(opt.threads),
+		unsigned(opt.latency_ms), unsigned(opt.jitter_ms), opt.reject_rate);
+
+	// job switch
+	std::vector<std::vector<double>> ranks(opt.threads);
+	size_t missed = 0;
+	for(size_t j = 0; j < opt.jobs; j++)
+		missed += opt.threads - std::min(opt.threads, job_switch(primary, log, opt, ranks));
+
+	fprintf(table, "\nJob notification to first share of every thread, %u jobs, %u thread(s) without a share in time\n",
+		unsigned(opt.jobs), unsigned(missed));
+	fprintf(table, "| thread rank |  jobs |  p50 ms |  p90 ms |  p99 ms |  max ms |\n");
+	std::vector<dist> rank_dist;
+	for(size_t i = 0; i < ranks.size(); i++)
+	{
+		rank_dist.emplace_back(ranks[i]);
+		const dist& d = rank_dist.back();
+		fprintf(table, "| %11u | %5u | %7.2f | %7.2f | %7.2f | %7.2f |\n", unsigned(i + 1), unsigned(d.count), d.p50, d.p90, d.p99, d.max);
+	}
+
+	// submit latency and throughput
+	primary.set_difficulty(SUBMIT_DIFFICULTY);
+	job = primary.new_job();
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+	std::vector<rate_result> rates;
+	uint32_t nonce = 0;
+	for(uint32_t rate : opt.rates)
+		rates.push_back(push_results(log, job, nonce, size_t(rate * opt.rate_seconds), rate));
+	if(opt.burst != 0)
+		rates.push_back(push_results(log, job, nonce, opt.burst, 0));
+
+	fprintf(table, "\nResult pushed to the executor to submit received by the pool\n");
+	fprintf(table, "| offered/s | pushed | received | achieved/s |  p50 ms |  p90 ms |  p99 ms |  max ms |\n");
+	for(const rate_result& r : rates)
+	{
+		std::string offered = r.offered == 0 ? "burst" : std::to_string(r.offered);
+		fprintf(table, "| %9s | %6u | %8u | %10.1f | %7.3f | %7.3f | %7.3f | %7.3f |\n", offered.c_str(), unsigned(r.pushed),
+			unsigned(r.received), r.achieved, r.latency.p50, r.latency.p90, r.latency.p99, r.latency.max);
+	}
+
+	// failover
+	primary.set_difficulty(1);
+	primary.new_job();
+
+	std::vector<failover_result> fails;
+	for(size_t f = 0; f < opt.failovers; f++)
+		fails.push_back(failover(primary, log));
+
+	fprintf(table, "\nPrimary pool stopped, 0 means not within the timeout\n");
+	fprintf(table, "| # | backup login ms | backup share ms | primary restarted, share ms |\n");
+	for(size_t f = 0; f < fails.size(); f++)
+		fprintf(table, "| %u | %15.1f | %15.1f | %27.1f |\n", unsigned(f + 1), fails[f].login_ms, fails[f].share_ms, fails[f].recover_ms);
+
+	if(!opt.json.empty())
+	{
+		FILE* f = opt.json == "-" ? stdout : fopen(opt.json.c_str(), "w");
+		if(f == nullptr)
+		{
+			printf("ERROR: cannot write %s\n", opt.json.c_str());
+			return 1;
+		}
+
+		fprintf(f, "{\"threads\":%u,\"latency_ms\":%u,\"jitter_ms\":%u,\"reject\":%.3f,\n",
+			unsigned(opt.threads), unsigned(opt.latency_ms), unsigned(opt.jitter_ms), opt.reject_rate);
+		fprintf(f, "\"job_switch\":{\"jobs\":%u,\"missed\":%u,\"ranks\":[", unsigned(opt.jobs), unsigned(missed));
+		for(size_t i = 0; i < rank_dist.size(); i++)
+			fprintf(f, "%s%s", i == 0 ? "" : ",", rank_dist[i].json().c_str());
+		fprintf(f, "]},\n\"submit\":[");
+		for(size_t i = 0; i < rates.size(); i++)
+		{
+			fprintf(f, "%s\n{\"offered\":%u,\"pushed\":%u,\"received\":%u,\"achieved\":%.1f,\"latency\":%s}", i == 0 ? "" : ",",
+				unsigned(rates[i].offered), unsigned(rates[i].pushed), unsigned(rates[i].received), rates[i].achieved,
+				rates[i].latency.json().c_str());
+		}
+		fprintf(f, "],\n\"failover\":[");
+		for(size_t i = 0; i < fails.size(); i++)
+		{
+			fprintf(f, "%s\n{\"backup_login_ms\":%.1f,\"backup_share_ms\":%.1f,\"recover_ms\":%.1f}", i == 0 ? "" : ",",
+				fails[i].login_ms, fails[i].share_ms, fails[i].recover_ms);
+		}
+		fprintf(f, "]}\n");
+		if(f != stdout)
+			fclose(f);
+	}
+
+	fflush(stdout);
+	// the executor and the mining threads do not terminate
+	_exit(0);
+}
@@ -0,0 +1,572 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "pool_sim.hpp"
+
+#include "xmrstak/misc/jext.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+// SIGPIPE is ignored by the callers
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace xmrstak
+{
+
+namespace
+{
+
+constexpr size_t BLOB_SIZE = 76;
+//! longest line accepted from a miner
+constexpr size_t MAX_LINE = 16 * 1024;
+
+void bin2hex(const uint8_t* in, size_t len, std::string& out)
+{
+	static const char hex[] = "0123456789abcdef";
+	for(size_t i = 0; i < len; i++)
+	{
+		out += hex[in[i] >> 4];
+		out += hex[in[i] & 0xF];
+	}
+}
+
+bool hex2bin(const char* in, size_t len, uint8_t* out)
+{
+	for(size_t i = 0; i < len; i += 2)
+	{
+		uint8_t v = 0;
+		for(size_t j = 0; j < 2; j++)
+		{
+			char c = in[i + j];
+			v <<= 4;
+			if(c >= '0' && c <= '9')
+				v |= c - '0';
+			else if(c >= 'a' && c <= 'f')
+				v |= c - 'a' + 0xA;
+			else if(c >= 'A' && c <= 'F')
+				v |= c - 'A' + 0xA;
+			else
+				return false;
+		}
+		out[i / 2] = v;
+	}
+	return true;
+}
+
+inline uint64_t now_ms()
+{
+	return poolSim::now_us() / 1000;
+}
+
+/** append a json string with the id of the call or 0 */
+void reply_head(const Value* id, std::string& out)
+{
+	out = "{\"id\":";
+	if(id != nullptr && id->IsUint64())
+		out += std::to_string(id->GetUint64());
+	else
+		out += "0";
+	out += ",\"jsonrpc\":\"2.0\",";
+}
+
+void reply_error(const Value* id, const char* msg, std::string& out)
+{
+	reply_head(id, out);
+	out += "\"error\":{\"code\":-1,\"message\":\"";
+	out += msg;
+	out += "\"},\"result\":null}";
+}
+
+} // namespace
+
+uint64_t poolSim::now_us()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+std::string poolSim::job_id(uint64_t job)
+{
+	return std::to_string(job);
+}
+
+poolSim::poolSim(const poolSimConfig& cfg, listener cb) :
+	cfg(cfg), cb(cb), iListenFd(-1), iPort(cfg.port), bRunning(false),
+	iJobNo(0), iJobDiff(cfg.difficulty), iNextDiff(cfg.difficulty), oRng(cfg.seed)
+{
+	memset(bBlob, 0, sizeof(bBlob));
+}
+
+poolSim::~poolSim()
+{
+	stop();
+}
+
+bool poolSim::start(std::string& err)
+{
+	if(bRunning)
+		return true;
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(fd < 0)
+	{
+		err = std::string("socket: ") + strerror(errno);
+		return false;
+	}
+
+	int flag = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(iPort);
+
+	if(bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+	{
+		err = "127.0.0.1:" + std::to_string(iPort) + ": " + strerror(errno);
+		close(fd);
+		return false;
+	}
+
+	socklen_t len = sizeof(addr);
+	getsockname(fd, (sockaddr*)&addr, &len);
+	iPort = ntohs(addr.sin_port);
+
+	iListenFd = fd;
+	bRunning = true;
+	oAcceptThd = std::thread(&poolSim::accept_thd, this);
+	oTimerThd = std::thread(&poolSim::timer_thd, this);
+	return true;
+}
+
+void poolSim::stop()
+{
+	if(!bRunning.exchange(false))
+		return;
+
+	int fd = iListenFd.exchange(-1);
+	shutdown(fd, SHUT_RDWR);
+	close(fd);
+	oAcceptThd.join();
+	oTimerThd.join();
+
+	// a connection thread can wait for conn_mutex in new_job()
+	std::vector<std::unique_ptr<connection>> conns;
+	{
+		std::unique_lock<std::mutex> lck(conn_mutex);
+		conns.swap(vConns);
+	}
+	for(auto& c : conns)
+		shutdown(c->fd, SHUT_RDWR);
+	for(auto& c : conns)
+	{
+		c->thd.join();
+		close(c->fd);
+	}
+}
+
+void poolSim::set_difficulty(uint64_t diff)
+{
+	std::unique_lock<std::mutex> lck(job_mutex);
+	iNextDiff = diff == 0 ? 1 : diff;
+}
+
+poolSim::stats poolSim::get_stats() const
+{
+	std::unique_lock<std::mutex> lck(stats_mutex);
+	return oStats;
+}
+
+void poolSim::emit(const event& ev)
+{
+	if(cb)
+		cb(ev);
+}
+
+void poolSim::delay()
+{
+	// only called with send_mutex of the connection, see send_line
+	uint64_t ms = cfg.latency_ms;
+	if(cfg.jitter_ms != 0)
+	{
+		thread_local std::minstd_rand rng(cfg.seed ^ (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()));
+		ms += rng() % (cfg.jitter_ms + 1);
+	}
+	if(ms != 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void poolSim::send_line(connection* c, const std::string& msg)
+{
+	delay();
+
+	std::string line = msg + "\n";
+	size_t pos = 0;
+	while(pos < line.size())
+	{
+		ssize_t r = send(c->fd, line.data() + pos, line.size() - pos, MSG_NOSIGNAL);
+		if(r <= 0)
+			return;
+		pos += r;
+	}
+}
+
+void poolSim::job_json(std::string& out)
+{
+	// called with job_mutex
+	uint64_t target = 0xFFFFFFFFFFFFFFFFULL / iJobDiff;
+
+	out = "{\"blob\":\"";
+	bin2hex(bBlob, BLOB_SIZE, out);
+	out += "\",\"job_id\":\"" + job_id(iJobNo.load()) + "\",\"target\":\"";
+	bin2hex((const uint8_t*)&target, sizeof(target), out);
+	out += "\"";
+	if(!cfg.motd.empty())
+	{
+		out += ",\"motd\":\"";
+		bin2hex((const uint8_t*)cfg.motd.data(), cfg.motd.size(), out);
+		out += "\"";
+	}
+	out += "}";
+}
+
+uint64_t poolSim::new_job()
+{
+	std::string msg;
+	uint64_t job;
+	{
+		std::unique_lock<std::mutex> lck(job_mutex);
+		for(size_t i = 0; i < BLOB_SIZE; i += 8)
+		{
+			uint64_t v = oRng();
+			memcpy(bBlob + i, &v, std::min<size_t>(8, BLOB_SIZE - i));
+		}
+		bBlob[0] = cfg.blob_version;
+		// the nonce is filled in by the miner
+		memset(bBlob + 39, 0, 4);
+		iJobDiff = iNextDiff;
+		oNonces.clear();
+		job = ++iJobNo;
+
+		std::string params;
+		job_json(params);
+		msg = "{\"jsonrpc\":\"2.0\",\"method\":\"job\",\"params\":" + params + "}";
+	}
+
+	{
+		std::unique_lock<std::mutex> lck(stats_mutex);
+		oStats.jobs++;
+	}
+
+	std::unique_lock<std::mutex> lck(conn_mutex);
+	for(auto& c : vConns)
+	{
+		std::unique_lock<std::mutex> slck(c->send_mutex);
+		if(!c->logged_in || c->done)
+			continue;
+		send_line(c.get(), msg);
+
+		event ev = event();
+		ev.type = EV_JOB;
+		ev.time_us = now_us();
+		ev.conn = c->id;
+		ev.job = job;
+		emit(ev);
+	}
+	return job;
+}
+
+void poolSim::accept_thd()
+{
+	while(bRunning)
+	{
+		int fd = accept(iListenFd, nullptr, nullptr);
+		if(fd < 0)
+		{
+			if(!bRunning)
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+
+		int flag = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+		std::unique_lock<std::mutex> lck(conn_mutex);
+		// reap the closed connections
+		for(auto it = vConns.begin(); it != vConns.end();)
+		{
+			if((*it)->done)
+			{
+				(*it)->thd.join();
+				close((*it)->fd);
+				it = vConns.erase(it);
+			}
+			else
+				++it;
+		}
+
+		connection* c = new connection();
+		c->fd = fd;
+		c->id = ++iConnCnt;
+		c->connect_ms = now_ms();
+		c->done = false;
+		vConns.emplace_back(c);
+		c->thd = std::thread(&poolSim::connection_thd, this, c);
+	}
+}
+
+void poolSim::timer_thd()
+{
+	uint64_t next_job = now_ms() + cfg.job_interval_ms;
+	while(bRunning)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		uint64_t now = now_ms();
+
+		if(cfg.job_interval_ms != 0 && now >= next_job)
+		{
+			new_job();
+			next_job = now + cfg.job_interval_ms;
+		}
+
+		if(cfg.disconnect_ms != 0)
+		{
+			std::unique_lock<std::mutex> lck(conn_mutex);
+			for(auto& c : vConns)
+			{
+				if(!c->done && now - c->connect_ms >= cfg.disconnect_ms)
+					shutdown(c->fd, SHUT_RDWR);
+			}
+		}
+	}
+}
+
+void poolSim::connection_thd(connection* c)
+{
+	std::string buf;
+	char tmp[4096];
+	bool ok = true;
+
+	while(ok)
+	{
+		ssize_t r = recv(c->fd, tmp, sizeof(tmp), 0);
+		if(r <= 0)
+			break;
+		buf.append(tmp, r);
+
+		size_t pos;
+		while(ok && (pos = buf.find('\n')) != std::string::npos)
+		{
+			std::string line = buf.substr(0, pos);
+			buf.erase(0, pos + 1);
+			ok = handle_line(c, &line[0]);
+		}
+
+		if(buf.size() > MAX_LINE)
+			ok = false;
+	}
+
+	shutdown(c->fd, SHUT_RDWR);
+	{
+		std::unique_lock<std::mutex> lck(stats_mutex);
+		oStats.disconnects++;
+	}
+
+	event ev = event();
+	ev.type = EV_CLOSE;
+	ev.time_us = now_us();
+	ev.conn = c->id;
+	emit(ev);
+
+	c->done = true;
+}
+
+bool poolSim::handle_line(connection* c, char* line)
+{
+	uint64_t recv_us = now_us();
+
+	Document doc;
+	if(doc.ParseInsitu(line).HasParseError() || !doc.IsObject())
+		return false;
+
+	const Value* method = GetObjectMember(doc, "method");
+	const Value* id = GetObjectMember(doc, "id");
+	const Value* params = GetObjectMember(doc, "params");
+	if(method == nullptr || !method->IsString() || params == nullptr || !params->IsObject())
+		return false;
+
+	std::string miner_id = "sim" + std::to_string(c->id);
+	std::string reply;
+
+	if(strcmp(method->GetString(), "login") == 0)
+	{
+		std::string job;
+		uint64_t job_no;
+		{
+			std::unique_lock<std::mutex> lck(job_mutex);
+			job_no = iJobNo.load();
+		}
+		if(job_no == 0)
+			job_no = new_job();
+		{
+			std::unique_lock<std::mutex> lck(job_mutex);
+			job_json(job);
+			job_no = iJobNo.load();
+		}
+
+		reply_head(id, reply);
+		reply += "\"error\":null,\"result\":{\"id\":\"" + miner_id + "\",\"job\":" + job +
+			",\"extensions\":[\"algo\",\"backend\",\"hashcount\",\"motd\"],\"status\":\"OK\"}}";
+
+		std::unique_lock<std::mutex> slck(c->send_mutex);
+		send_line(c, reply);
+		c->logged_in = true;
+		{
+			std::unique_lock<std::mutex> lck(stats_mutex);
+			oStats.logins++;
+		}
+
+		event ev = event();
+		ev.type = EV_LOGIN;
+		ev.time_us = now_us();
+		ev.conn = c->id;
+		ev.job = job_no;
+		emit(ev);
+		return true;
+	}
+
+	if(strcmp(method->GetString(), "submit") != 0)
+	{
+		reply_error(id, "Unknown method", reply);
+		std::unique_lock<std::mutex> slck(c->send_mutex);
+		send_line(c, reply);
+		return true;
+	}
+
+	const Value *pid, *jobid, *nonce, *result, *backend, *hashcount, *algo;
+	pid = GetObjectMember(*params, "id");
+	jobid = GetObjectMember(*params, "job_id");
+	nonce = GetObjectMember(*params, "nonce");
+	result = GetObjectMember(*params, "result");
+	backend = GetObjectMember(*params, "backend");
+	hashcount = GetObjectMember(*params, "hashcount");
+	algo = GetObjectMember(*params, "algo");
+
+	event ev = event();
+	ev.type = EV_SUBMIT;
+	ev.time_us = recv_us;
+	ev.conn = c->id;
+	ev.accepted = false;
+	ev.stale = false;
+	if(backend != nullptr && backend->IsString())
+		ev.backend = backend->GetString();
+	if(algo != nullptr && algo->IsString())
+		ev.algo = algo->GetString();
+	if(hashcount != nullptr && hashcount->IsUint64())
+		ev.hashcount = hashcount->GetUint64();
+
+	const char* error = nullptr;
+	uint8_t hash[32];
+	if(!c->logged_in || pid == nullptr || !pid->IsString() || miner_id != pid->GetString())
+		error = "Unauthenticated";
+	else if(jobid == nullptr || nonce == nullptr || result == nullptr ||
+		!jobid->IsString() || !nonce->IsString() || !result->IsString() ||
+		nonce->GetStringLength() != 8 || result->GetStringLength() != 64 ||
+		!hex2bin(nonce->GetString(), 8, (uint8_t*)&ev.nonce) ||
+		!hex2bin(result->GetString(), 64, hash))
+	{
+		error = "Malformed share";
+	}
+	else if(!cfg.algo.empty() && ev.algo != cfg.algo)
+		error = "Wrong algorithm";
+	else
+	{
+		ev.job = strtoull(jobid->GetString(), nullptr, 10);
+
+		std::unique_lock<std::mutex> lck(job_mutex);
+		uint64_t hash_val;
+		memcpy(&hash_val, hash + 24, sizeof(hash_val));
+		if(ev.job != iJobNo.load())
+		{
+			ev.stale = true;
+			error = "Block expired";
+		}
+		else if(!oNonces.insert(ev.nonce).second)
+			error = "Duplicate share";
+		else if(hash_val >= 0xFFFFFFFFFFFFFFFFULL / iJobDiff)
+			error = "Low difficulty share";
+	}
+
+	if(error == nullptr && cfg.reject_rate > 0.0)
+	{
+		thread_local std::mt19937 rng(cfg.seed + c->id);
+		if(std::uniform_real_distribution<double>(0.0, 1.0)(rng) < cfg.reject_rate)
+			error = "Share rejected by the simulator";
+	}
+
+	ev.accepted = error == nullptr;
+	{
+		std::unique_lock<std::mutex> lck(stats_mutex);
+		oStats.submits++;
+		if(ev.accepted)
+			oStats.accepted++;
+		else
+			oStats.rejected++;
+		if(ev.stale)
+			oStats.stale++;
+		else if(error != nullptr && strcmp(error, "Malformed share") == 0)
+			oStats.invalid++;
+	}
+
+	if(error == nullptr)
+	{
+		reply_head(id, reply);
+		reply += "\"error\":null,\"result\":{\"status\":\"OK\"}}";
+	}
+	else
+		reply_error(id, error, reply);
+
+	emit(ev);
+
+	std::unique_lock<std::mutex> slck(c->send_mutex);
+	send_line(c, reply);
+	return true;
+}
+
+} // namespace xmrstak
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace xmrstak
+{
+
+/** settings of the simulated pool */
+struct poolSimConfig
+{
+	//! listen port on 127.0.0.1, 0 selects a free port
+	uint16_t port = 0;
+	//! share difficulty of the jobs
+	uint64_t difficulty = 1;
+	//! send a new job every job_interval_ms, 0 sends jobs only on login and new_job()
+	uint32_t job_interval_ms = 0;
+	//! delay of every message to the miner
+	uint32_t latency_ms = 0;
+	//! random additional delay, uniform in [0, jitter_ms]
+	uint32_t jitter_ms = 0;
+	//! probability that a valid share is rejected
+	double reject_rate = 0.0;
+	//! close every connection after disconnect_ms, 0 keeps the connections
+	uint32_t disconnect_ms = 0;
+	//! reject shares with a different `algo`, empty accepts every algorithm
+	std::string algo;
+	//! message of the day sent with every job
+	std::string motd;
+	//! first byte of the blob, selects the algorithm fork of the coin
+	uint8_t blob_version = 8;
+	uint32_t seed = 0;
+};
+
+/** Stratum pool on localhost speaking the subset of the protocol jpsock uses
+ *
+ * Supports login, job notifications and submits with the algo, backend, hashcount
+ * and motd extensions. The hashes are not verified, a share is accepted if it
+ * belongs to the current job, is not a duplicate and the submitted result meets
+ * the target. Every message is reported to an optional listener with a time stamp
+ * taken directly after the message was sent or received.
+ */
+class poolSim
+{
+public:
+	enum event_type
+	{
+		EV_LOGIN,
+		EV_JOB,
+		EV_SUBMIT,
+		EV_CLOSE
+	};
+
+	struct event
+	{
+		event_type type;
+		//! steady clock in microseconds, see now_us()
+		uint64_t time_us;
+		//! number of the connection
+		uint32_t conn;
+		//! job number of a notification or of the submitted share, 0 if unknown
+		uint64_t job;
+		uint32_t nonce;
+		bool accepted;
+		//! share of an old job
+		bool stale;
+		//! optional submit fields of the extensions
+		std::string backend;
+		std::string algo;
+		uint64_t hashcount;
+	};
+
+	struct stats
+	{
+		uint64_t logins = 0;
+		uint64_t jobs = 0;
+		uint64_t submits = 0;
+		uint64_t accepted = 0;
+		uint64_t rejected = 0;
+		uint64_t stale = 0;
+		uint64_t invalid = 0;
+		uint64_t disconnects = 0;
+	};
+
+	/** called by the connection threads, must be thread safe */
+	typedef std::function<void(const event&)> listener;
+
+	poolSim(const poolSimConfig& cfg, listener cb = nullptr);
+	~poolSim();
+
+	poolSim(const poolSim&) = delete;
+	poolSim& operator=(const poolSim&) = delete;
+
+	/** listen on 127.0.0.1
+	 *
+	 * Can be called again after stop(), the port is kept.
+	 */
+	bool start(std::string& err);
+
+	/** close the listener and all connections */
+	void stop();
+
+	uint16_t get_port() const { return iPort; }
+
+	/** send a new job to all logged in miners
+	 *
+	 * @return number of the job
+	 */
+	uint64_t new_job();
+
+	/** difficulty of the following jobs */
+	void set_difficulty(uint64_t diff);
+
+	/** number of the job sent last */
+	uint64_t current_job() const { return iJobNo.load(); }
+
+	/** job id of a job number as sent to the miner */
+	static std::string job_id(uint64_t job);
+
+	stats get_stats() const;
+
+	static uint64_t now_us();
+
+private:
+	struct connection
+	{
+		int fd;
+		uint32_t id;
+		uint64_t connect_ms;
+		bool logged_in = false;
+		std::mutex send_mutex;
+		std::thread thd;
+		std::atomic<bool> done;
+	};
+
+	void accept_thd();
+	void timer_thd();
+	void connection_thd(connection* c);
+
+	bool handle_line(connection* c, char* line);
+	void send_line(connection* c, const std::string& msg);
+	void delay();
+	void job_json(std::string& out);
+	void emit(const event& ev);
+
+	poolSimConfig cfg;
+	listener cb;
+
+	std::atomic<int> iListenFd;
+	uint16_t iPort;
+	std::atomic<bool> bRunning;
+	std::thread oAcceptThd;
+	std::thread oTimerThd;
+
+	std::mutex conn_mutex;
+	std::vector<std::unique_ptr<connection>> vConns;
+	uint32_t iConnCnt = 0;
+
+	//! current job, guarded by job_mutex
+	std::mutex job_mutex;
+	std::atomic<uint64_t> iJobNo;
+	uint64_t iJobDiff;
+	uint64_t iNextDiff;
+	uint8_t bBlob[76];
+	std::unordered_set<uint32_t> oNonces;
+	std::mt19937_64 oRng;
+
+	mutable std::mutex stats_mutex;
+	stats oStats;
+};
+
+} // namespace xmrstak
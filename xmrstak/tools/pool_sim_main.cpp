@@ -0,0 +1,218 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Stratum pool simulator on localhost to test the miner without a live pool.
+ *
+ * Point the miner at it with `-o 127.0.0.1:PORT -u x -p x`. Jobs, difficulty,
+ * latency, rejects and disconnects are controlled from the command line, the
+ * shares and the time from a job notification to the first share of the job are
+ * printed every stats interval.
+ *
+ * Usage: xmr-stak-poolsim [OPTIONS]
+ *   --port P            listen port on 127.0.0.1 (default: 3333)
+ *   --difficulty D      share difficulty (default: 1000)
+ *   --job-interval MS   send a new job every MS milliseconds (default: 30000, 0 only on login)
+ *   --latency MS        delay of every message to the miner (default: 0)
+ *   --jitter MS         additional random delay up to MS (default: 0)
+ *   --reject R          probability to reject a valid share (default: 0)
+ *   --disconnect MS     close every connection after MS milliseconds (default: 0, never)
+ *   --algo NAME         reject shares of a different algorithm (default: accept all)
+ *   --motd TEXT         message of the day
+ *   --blob-version V    first byte of the job blob (default: 8)
+ *   --seed S            seed of the blobs, latency jitter and rejects (default: 0)
+ *   --stats S           print the statistics every S seconds (default: 10)
+ */
+
+#include "pool_sim.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+std::atomic<bool> bStop(false);
+
+void on_signal(int)
+{
+	bStop = true;
+}
+
+/** time from a job notification to the first share of the job */
+struct job_latency
+{
+	std::mutex mtx;
+	uint64_t job = 0;
+	uint64_t notify_us = 0;
+	bool have_share = false;
+	uint64_t sum_us = 0;
+	uint64_t max_us = 0;
+	uint64_t count = 0;
+
+	void on_event(const xmrstak::poolSim::event& ev)
+	{
+		std::unique_lock<std::mutex> lck(mtx);
+		if(ev.type == xmrstak::poolSim::EV_JOB || ev.type == xmrstak::poolSim::EV_LOGIN)
+		{
+			if(ev.job != job)
+			{
+				job = ev.job;
+				notify_us = ev.time_us;
+				have_share = false;
+			}
+		}
+		else if(ev.type == xmrstak::poolSim::EV_SUBMIT && ev.job == job && !have_share)
+		{
+			uint64_t t = ev.time_us - notify_us;
+			have_share = true;
+			sum_us += t;
+			max_us = std::max(max_us, t);
+			count++;
+		}
+	}
+};
+
+void usage()
+{
+	printf("Usage: xmr-stak-poolsim [--port P] [--difficulty D] [--job-interval MS] [--latency MS] [--jitter MS]\n"
+		"                        [--reject R] [--disconnect MS] [--algo NAME] [--motd TEXT] [--blob-version V]\n"
+		"                        [--seed S] [--stats S]\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	xmrstak::poolSimConfig cfg;
+	cfg.port = 3333;
+	cfg.difficulty = 1000;
+	cfg.job_interval_ms = 30000;
+	unsigned stats_sec = 10;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if(i + 1 >= argc)
+		{
+			usage();
+			return 2;
+		}
+		const char* val = argv[++i];
+
+		if(arg == "--port")
+			cfg.port = strtoul(val, nullptr, 10);
+		else if(arg == "--difficulty")
+			cfg.difficulty = strtoull(val, nullptr, 10);
+		else if(arg == "--job-interval")
+			cfg.job_interval_ms = strtoul(val, nullptr, 10);
+		else if(arg == "--latency")
+			cfg.latency_ms = strtoul(val, nullptr, 10);
+		else if(arg == "--jitter")
+			cfg.jitter_ms = strtoul(val, nullptr, 10);
+		else if(arg == "--reject")
+			cfg.reject_rate = atof(val);
+		else if(arg == "--disconnect")
+			cfg.disconnect_ms = strtoul(val, nullptr, 10);
+		else if(arg == "--algo")
+			cfg.algo = val;
+		else if(arg == "--motd")
+			cfg.motd = val;
+		else if(arg == "--blob-version")
+			cfg.blob_version = strtoul(val, nullptr, 10);
+		else if(arg == "--seed")
+			cfg.seed = strtoul(val, nullptr, 10);
+		else if(arg == "--stats")
+			stats_sec = strtoul(val, nullptr, 10);
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+
+	if(cfg.difficulty == 0 || stats_sec == 0 || cfg.reject_rate < 0.0 || cfg.reject_rate > 1.0)
+	{
+		usage();
+		return 2;
+	}
+
+	job_latency lat;
+	xmrstak::poolSim sim(cfg, [&lat](const xmrstak::poolSim::event& ev) { lat.on_event(ev); });
+
+	std::string err;
+	if(!sim.start(err))
+	{
+		printf("ERROR: %s\n", err.c_str());
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("Listening on 127.0.0.1:%u, difficulty %llu, new job every %u ms, latency %u+%u ms, reject %.3f, disconnect %u ms\n",
+		unsigned(sim.get_port()), (unsigned long long)cfg.difficulty, unsigned(cfg.job_interval_ms),
+		unsigned(cfg.latency_ms), unsigned(cfg.jitter_ms), cfg.reject_rate, unsigned(cfg.disconnect_ms));
+	printf("|  time s | logins |  jobs | shares/s | accepted | rejected | stale | invalid | job to first share ms (avg/max) |\n");
+
+	auto start = std::chrono::steady_clock::now();
+	xmrstak::poolSim::stats last;
+	while(!bStop)
+	{
+		for(unsigned i = 0; i < stats_sec * 10 && !bStop; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		xmrstak::poolSim::stats s = sim.get_stats();
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		double avg_ms = 0.0, max_ms = 0.0;
+		{
+			std::unique_lock<std::mutex> lck(lat.mtx);
+			if(lat.count != 0)
+			{
+				avg_ms = lat.sum_us / 1000.0 / lat.count;
+				max_ms = lat.max_us / 1000.0;
+			}
+			lat.sum_us = lat.max_us = lat.count = 0;
+		}
+
+		printf("| %7.1f | %6llu | %5llu | %8.1f | %8llu | %8llu | %5llu | %7llu | %14.1f / %14.1f |\n", t,
+			(unsigned long long)s.logins, (unsigned long long)s.jobs,
+			double(s.submits - last.submits) / stats_sec,
+			(unsigned long long)s.accepted, (unsigned long long)s.rejected,
+			(unsigned long long)s.stale, (unsigned long long)s.invalid, avg_ms, max_ms);
+		fflush(stdout);
+		last = s;
+	}
+
+	sim.stop();
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Prints a session log written with `xmr-stak --record FILE`.
+ *
+ * With --jobs only the job switches of the executor are printed without time
+ * stamps, the output of a recording and of its replay (`--replay FILE --record
+ * FILE2`) can be compared with diff.
+ *
+ * Usage: xmr-stak-sessionlog [--jobs] FILE
+ */
+
+#include "xmrstak/net/sessionLog.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+	bool jobs_only = false;
+	const char* file = nullptr;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if(arg == "--jobs")
+			jobs_only = true;
+		else if(file == nullptr && arg.compare(0, 2, "--") != 0)
+			file = argv[i];
+		else
+			file = nullptr, i = argc;
+	}
+
+	if(file == nullptr)
+	{
+		printf("Usage: xmr-stak-sessionlog [--jobs] FILE\n");
+		return 2;
+	}
+
+	std::vector<sessionLog::entry> recs;
+	std::string err;
+	if(!sessionLog::read(file, recs, err))
+	{
+		printf("ERROR: %s\n", err.c_str());
+		return 1;
+	}
+
+	size_t job = 0;
+	for(const sessionLog::entry& r : recs)
+	{
+		if(jobs_only)
+		{
+			if(r.type == sessionLog::REC_JOB)
+				printf("%6u pool %u %s\n", unsigned(++job), unsigned(r.pool_id), r.data.c_str());
+			continue;
+		}
+
+		printf("%12.3f pool %u %-11s %s\n", r.time_us / 1000.0, unsigned(r.pool_id),
+			sessionLog::type_name(r.type), r.data.c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,188 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Reads the statistics a miner publishes with `xmr-stak --shm-stats NAME`.
+ *
+ * Prints the global statistics every --interval milliseconds, with --threads
+ * also the hash rate of every thread calculated from the hash counts of two
+ * consecutive reads. --json prints one json object per read instead. With an
+ * interval of 0 the statistics are read once.
+ *
+ * Usage: xmr-stak-shmstats [--interval MS] [--threads] [--json] [NAME]
+ */
+
+#include "xmrstak/misc/shmStatsLayout.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace xmrstak;
+
+namespace
+{
+const char* backend_names[] = { "unknown", "cpu", "amd", "nvidia", "fpga" };
+
+const char* backend_name(uint32_t type)
+{
+	return type < sizeof(backend_names) / sizeof(backend_names[0]) ? backend_names[type] : "unknown";
+}
+
+uint64_t unix_ms()
+{
+	using namespace std::chrono;
+	return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+const char* hps_format(double h, const char* na, char* buf, size_t l)
+{
+	if(!std::isnormal(h) && h != 0.0)
+		return na;
+	snprintf(buf, l, "%.1f", h);
+	return buf;
+}
+
+struct sample
+{
+	bool valid = false;
+	uint64_t hashes;
+	uint64_t timestamp_ms;
+};
+
+//! hash rate between two reads of a thread, NaN if the thread did not update its count
+double thread_hps(const sample& prev, const shm::thread_stats& cur)
+{
+	if(!prev.valid || cur.timestamp_ms <= prev.timestamp_ms)
+		return NAN;
+	return double(cur.hashes - prev.hashes) * 1000.0 / double(cur.timestamp_ms - prev.timestamp_ms);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	const char* name = "/xmr-stak";
+	uint64_t interval_ms = 1000;
+	bool threads = false;
+	bool json = false;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if(arg == "--interval" && i + 1 < argc)
+			interval_ms = strtoull(argv[++i], nullptr, 10);
+		else if(arg == "--threads")
+			threads = true;
+		else if(arg == "--json")
+			json = true;
+		else if(arg.compare(0, 2, "--") != 0)
+			name = argv[i];
+		else
+		{
+			printf("Usage: xmr-stak-shmstats [--interval MS] [--threads] [--json] [NAME]\n");
+			return 2;
+		}
+	}
+
+	shm::reader rd;
+	std::string err;
+	if(!rd.open(name, err))
+	{
+		printf("ERROR: %s\n", err.c_str());
+		return 1;
+	}
+
+	std::vector<sample> prev(shm::MAX_THREADS);
+	shm::global_stats g;
+	shm::thread_stats t;
+	char num[3][32];
+	while(true)
+	{
+		if(!rd.read_global(g))
+		{
+			printf("ERROR: the statistics are not consistent, the miner stopped while writing them\n");
+			return 1;
+		}
+		bool stale = unix_ms() - g.update_ms > 5000;
+
+		if(json)
+		{
+			printf("{\"pid\":%u,\"update_ms\":%llu,\"stale\":%s,\"uptime\":%llu,\"hashrate\":[%s,%s,%s],\"accepted\":%llu,\"rejected\":%llu,\"stale_shares\":%llu,"
+				"\"pool\":\"%s\",\"job_id\":\"%s\",\"difficulty\":%llu,\"thread_count\":%u",
+				unsigned(rd.get_header().pid), (unsigned long long)g.update_ms, stale ? "true" : "false", (unsigned long long)g.uptime_sec,
+				hps_format(g.hashrate[0], "null", num[0], sizeof(num[0])), hps_format(g.hashrate[1], "null", num[1], sizeof(num[1])),
+				hps_format(g.hashrate[2], "null", num[2], sizeof(num[2])),
+				(unsigned long long)g.shares_accepted, (unsigned long long)g.shares_rejected, (unsigned long long)g.shares_stale,
+				g.pool, g.job_id, (unsigned long long)g.difficulty, unsigned(g.thread_count));
+		}
+		else
+		{
+			printf("%sH/s %s %s %s | shares %llu ok %llu rejected %llu stale | diff %llu | %s %s%s\n",
+				stale ? "STALE " : "",
+				hps_format(g.hashrate[0], "(na)", num[0], sizeof(num[0])), hps_format(g.hashrate[1], "(na)", num[1], sizeof(num[1])),
+				hps_format(g.hashrate[2], "(na)", num[2], sizeof(num[2])),
+				(unsigned long long)g.shares_accepted, (unsigned long long)g.shares_rejected, (unsigned long long)g.shares_stale,
+				(unsigned long long)g.difficulty, g.pool_connected ? g.pool : "not connected", g.job_id,
+				stale ? " (the miner stopped updating)" : "");
+		}
+
+		if(threads)
+		{
+			if(json)
+				printf(",\"threads\":[");
+			size_t n = 0;
+			for(size_t i = 0; i < shm::MAX_THREADS; i++)
+			{
+				if(!rd.read_thread(i, t) || t.backend == 0)
+					continue;
+				double hps = thread_hps(prev[i], t);
+				prev[i].valid = true;
+				prev[i].hashes = t.hashes;
+				prev[i].timestamp_ms = t.timestamp_ms;
+
+				if(json)
+					printf("%s{\"thread\":%u,\"backend\":\"%s\",\"hashes\":%llu,\"hashrate\":%s}", n != 0 ? "," : "", unsigned(i),
+						backend_name(t.backend), (unsigned long long)t.hashes, hps_format(hps, "null", num[0], sizeof(num[0])));
+				else
+					printf("    thread %3u %-7s %14llu hashes %10s H/s\n", unsigned(i), backend_name(t.backend),
+						(unsigned long long)t.hashes, hps_format(hps, "(na)", num[0], sizeof(num[0])));
+				n++;
+			}
+			if(json)
+				printf("]");
+			else if(g.thread_count > g.thread_blocks)
+				printf("    %u more threads have no block\n", unsigned(g.thread_count - g.thread_blocks));
+		}
+		if(json)
+			printf("}\n");
+		fflush(stdout);
+
+		if(interval_ms == 0)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+	}
+	return 0;
+}
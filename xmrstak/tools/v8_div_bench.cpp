@@ -0,0 +1,248 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Compares the cryptonight_monero_v8 kernels: per lane division and square
+ * root (template), lane shared AVX2 division and square root and the asm
+ * main loops.
+ *
+ * The vector division and square root is first checked against the scalar
+ * code with random and edge case inputs, then every kernel hashes the same
+ * blobs on the calling thread and must be bit identical to single hashes.
+ *
+ * Usage: xmr-stak-v8div [SECONDS]
+ */
+
+#include "xmrstak/backend/cpu/crypto/cryptonight_aesni.h"
+#include "xmrstak/backend/cpu/cpuType.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace
+{
+
+typedef void (*cn_hash_fun)(const void*, size_t, void*, cryptonight_ctx**);
+
+constexpr size_t MAX_N = 5;
+constexpr size_t BLOB_SIZE = 76;
+
+inline uint64_t now_us()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct bench_ctx
+{
+	cryptonight_ctx* ctx[MAX_N];
+	uint8_t blob[BLOB_SIZE * MAX_N];
+
+	bench_ctx()
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+		{
+			ctx[i] = (cryptonight_ctx*)_mm_malloc(sizeof(cryptonight_ctx), 4096);
+			ctx[i]->long_state = (uint8_t*)_mm_malloc(CRYPTONIGHT_MEMORY, 4096);
+			memset(ctx[i]->long_state, 0, CRYPTONIGHT_MEMORY);
+		}
+		for(size_t i = 0; i < sizeof(blob); i++)
+			blob[i] = static_cast<uint8_t>(i * 13 + 5);
+	}
+
+	~bench_ctx()
+	{
+		for(size_t i = 0; i < MAX_N; i++)
+		{
+			_mm_free(ctx[i]->long_state);
+			_mm_free(ctx[i]);
+		}
+	}
+
+	void set_nonce(uint32_t nonce, size_t n)
+	{
+		for(size_t i = 0; i < n; i++)
+		{
+			uint32_t v = nonce + i;
+			memcpy(blob + BLOB_SIZE * i + 39, &v, sizeof(v));
+		}
+	}
+};
+
+/** hash for at least `seconds`
+ *
+ * @return hashes per second
+ */
+double measure(cn_hash_fun fun, size_t n, bench_ctx& bctx, double seconds)
+{
+	uint8_t out[32 * MAX_N];
+	uint32_t nonce = 0;
+
+	// warm up the caches and the TLB
+	fun(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+
+	uint64_t start = now_us();
+	uint64_t end = start + uint64_t(seconds * 1e6);
+	uint64_t hashes = 0;
+	uint64_t t;
+	do
+	{
+		bctx.set_nonce(nonce, n);
+		nonce += n;
+		fun(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+		hashes += n;
+	}
+	while((t = now_us()) < end);
+
+	return double(hashes) * 1e6 / double(t - start);
+}
+
+//! compare cn_v8_div_sqrt_avx2 with CN_MONERO_V8_DIV
+CN_TARGET_AVX2 bool check_div_sqrt(size_t rounds)
+{
+	set_float_rounding_mode();
+	std::mt19937_64 rng(0x5eed);
+	for(size_t it = 0; it < rounds; it++)
+	{
+		alignas(32) uint64_t lo[4], hi[4], sqrt_in[4], div_in[4];
+		for(size_t k = 0; k < 4; k++)
+		{
+			lo[k] = rng();
+			hi[k] = rng();
+			sqrt_in[k] = rng() & 0x1FFFFFFFFULL;
+			div_in[k] = rng();
+			// large and small dividends, square roots close to the next integer
+			if(it % 7 == 1)
+				hi[k] = ~0ULL - (rng() & 0xFF);
+			if(it % 11 == 2)
+				hi[k] = rng() & 0xFFFF;
+			if(it % 13 == 3)
+				lo[k] = ~0ULL - (rng() & 0xFFFF);
+		}
+
+		__m256i div = _mm256_load_si256((__m256i*)div_in);
+		__m256i sqrt = _mm256_load_si256((__m256i*)sqrt_in);
+		alignas(32) uint64_t xor_term[4], div_out[4], sqrt_out[4];
+		cn_v8_div_sqrt_avx2(_mm256_load_si256((__m256i*)lo), _mm256_load_si256((__m256i*)hi), div, sqrt, xor_term);
+		_mm256_store_si256((__m256i*)div_out, div);
+		_mm256_store_si256((__m256i*)sqrt_out, sqrt);
+
+		for(size_t k = 0; k < 4; k++)
+		{
+			const uint32_t d = (lo[k] + (sqrt_in[k] << 1)) | 0x80000001UL;
+			const uint64_t division_result = static_cast<uint32_t>(hi[k] / d) + ((hi[k] % d) << 32);
+			const uint64_t sqrt_result = int_sqrt33_1_double_precision(lo[k] + division_result);
+			if(xor_term[k] != (div_in[k] ^ (sqrt_in[k] << 32)) || div_out[k] != division_result || sqrt_out[k] != sqrt_result)
+				return false;
+		}
+	}
+	return true;
+}
+
+struct kernel
+{
+	const char* name;
+	size_t n;
+	cn_hash_fun fun;
+	bool avx2;
+	bool avx;
+};
+
+const kernel kernel_list[] = {
+	{ "per lane",         1, Cryptonight_hash<1>::template hash<cryptonight_monero_v8, false, true>, false, false },
+	{ "asm intel_avx",    1, Cryptonight_hash_asm<1, 0>::template hash<cryptonight_monero_v8>, false, true },
+	{ "asm amd_avx",      1, Cryptonight_hash_asm<1, 1>::template hash<cryptonight_monero_v8>, false, true },
+	{ "per lane",         2, Cryptonight_hash<2>::template hash<cryptonight_monero_v8, false, true>, false, false },
+	{ "lane shared AVX2", 2, Cryptonight_hash_v8_avx2<2>::template hash<cryptonight_monero_v8, false, true>, true, false },
+	{ "asm intel_avx",    2, Cryptonight_hash_asm<2, 0>::template hash<cryptonight_monero_v8>, false, true },
+	{ "per lane",         3, Cryptonight_hash<3>::template hash<cryptonight_monero_v8, false, true>, false, false },
+	{ "lane shared AVX2", 3, Cryptonight_hash_v8_avx2<3>::template hash<cryptonight_monero_v8, false, true>, true, false },
+	{ "per lane",         4, Cryptonight_hash<4>::template hash<cryptonight_monero_v8, false, true>, false, false },
+	{ "lane shared AVX2", 4, Cryptonight_hash_v8_avx2<4>::template hash<cryptonight_monero_v8, false, true>, true, false },
+	{ "per lane",         5, Cryptonight_hash<5>::template hash<cryptonight_monero_v8, false, true>, false, false },
+	{ "lane shared AVX2", 5, Cryptonight_hash_v8_avx2<5>::template hash<cryptonight_monero_v8, false, true>, true, false }
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+	if(seconds <= 0.0)
+		seconds = 2.0;
+
+	xmrstak::cpu::Model model = xmrstak::cpu::getModel();
+	if(!model.aes)
+	{
+		printf("ERROR: the benchmark needs hardware AES.\n");
+		return 1;
+	}
+	keccak_multi_select(model.avx2, model.avx512);
+	extra_hashes_select(model.ssse3, model.avx2);
+	printf("%s, %.1f s per measurement\n", model.type_name.c_str(), seconds);
+
+	if(model.avx2)
+	{
+		if(!check_div_sqrt(1000000))
+		{
+			printf("ERROR: AVX2 division and square root differ from the scalar code.\n");
+			return 1;
+		}
+		printf("AVX2 division and square root: ok\n");
+	}
+
+	printf("| kernel           | N | H/s          | per lane | result   |\n");
+
+	bench_ctx bctx;
+	bool ok = true;
+	uint8_t ref[32 * MAX_N], out[32 * MAX_N];
+	double per_lane = 0.0;
+	for(const kernel& k : kernel_list)
+	{
+		if((k.avx2 && !model.avx2) || (k.avx && !model.avx))
+			continue;
+
+		bctx.set_nonce(0x1234, k.n);
+		for(size_t i = 0; i < k.n; i++)
+			Cryptonight_hash<1>::template hash<cryptonight_monero_v8, false, false>(bctx.blob + BLOB_SIZE * i, BLOB_SIZE, ref + 32 * i, bctx.ctx);
+		k.fun(bctx.blob, BLOB_SIZE, out, bctx.ctx);
+		const bool equal = memcmp(ref, out, 32 * k.n) == 0;
+
+		const double hps = measure(k.fun, k.n, bctx, seconds);
+		if(strcmp(k.name, "per lane") == 0)
+			per_lane = hps;
+		printf("| %-16s | %u | %12.1f | %7.3fx | %s |\n", k.name, unsigned(k.n), hps, hps / per_lane, equal ? "ok      " : "MISMATCH");
+		fflush(stdout);
+		ok = ok && equal;
+	}
+
+	if(!ok)
+	{
+		printf("ERROR: the kernels and single hashes differ.\n");
+		return 1;
+	}
+	return 0;
+}